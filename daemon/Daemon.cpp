@@ -113,10 +113,14 @@ namespace util
 		std::string logfile  = ""; i2p::config::GetOption("logfile",    logfile);
 		std::string loglevel = ""; i2p::config::GetOption("loglevel",   loglevel);
 		bool logclftime;           i2p::config::GetOption("logclftime", logclftime);
+		std::string logformat = ""; i2p::config::GetOption("logformat", logformat);
+		uint16_t logratelimit;     i2p::config::GetOption("logratelimit", logratelimit);
 
 		/* setup logging */
 		if (logclftime)
 			i2p::log::Logger().SetTimeFormat ("[%d/%b/%Y:%H:%M:%S %z]");
+		i2p::log::Logger().SetLogFormat (logformat);
+		i2p::log::Logger().SetRateLimit (logratelimit);
 
 #if defined(WIN32_APP) || defined(__HAIKU__)
 		// Win32 app with GUI or Haiku supports only logging to file
@@ -182,6 +186,10 @@ namespace util
 		if (isFloodfill && i2p::config::IsDefault ("limits.transittunnels"))
 			transitTunnels *= 2; // double default number of transit tunnels for floodfill
 		i2p::tunnel::tunnels.SetMaxNumTransitTunnels (transitTunnels);
+		uint16_t tunnelThreads; i2p::config::GetOption("limits.tunnelthreads", tunnelThreads);
+		i2p::tunnel::tunnels.SetNumDataThreads (tunnelThreads);
+		uint16_t buildThreads; i2p::config::GetOption("limits.buildthreads", buildThreads);
+		i2p::tunnel::tunnels.SetNumBuildThreads (buildThreads);
 
 		/* this section also honors 'floodfill' flag, if set above */
 		std::string bandwidth; i2p::config::GetOption("bandwidth", bandwidth);
@@ -23,6 +23,7 @@
 #include "Transports.h"
 #include "NetDb.hpp"
 #include "HTTP.h"
+#include "Metrics.h"
 #include "LeaseSet.h"
 #include "Destination.h"
 #include "RouterContext.h"
@@ -90,6 +91,7 @@ namespace http {
 	const char HTTP_COMMAND_SETLANGUAGE[] = "setlanguage";
 	const char HTTP_COMMAND_RELOAD_CSS[] = "reload_css";
 	const char HTTP_COMMAND_EXPIRELEASE[] = "expirelease";
+	const char HTTP_PATH_METRICS[] = "metrics"; // relative to webroot
 
 	static std::string ConvertTime (uint64_t time)
 	{
@@ -284,6 +286,23 @@ namespace http {
 		}
 	}
 
+	static void ShowI2NPBuffers (std::stringstream& s)
+	{
+		auto stats = i2p::util::Slab::GetAllStats ();
+		if (stats.empty ()) return;
+		s << "<b>" << tr("I2NP buffers") << ":</b><br>\r\n";
+		s << "<table><thead><th>" << tr("Size") << "</th><th>" << tr("Live") << "</th><th>" << tr("Peak") << "</th><th>"
+			<< tr("Free") << "</th><th>" << tr("Hit rate") << "</th></thead><tbody class=\"tableitem\">";
+		for (const auto& it: stats)
+		{
+			s << "<tr><td>" << it.blockSize << "</td><td>" << it.numLive << "</td><td>" << it.numPeakLive << "</td><td>" << it.numFree << "</td><td>";
+			if (it.numAcquired)
+				s << (it.numHits * 100 / it.numAcquired) << "%";
+			s << "</td></tr>\r\n";
+		}
+		s << "</tbody></table><br>\r\n";
+	}
+
 	void ShowStatus (std::stringstream& s, bool includeHiddenContent, i2p::http::OutputFormatEnum outputFormat)
 	{
 		s << "<b>" << tr("Uptime") << ":</b> ";
@@ -394,6 +413,7 @@ namespace http {
 		s << "<b>" << tr("Transit Tunnels") << ":</b> " << std::to_string(transitTunnelCount) << "<br>\r\n<br>\r\n";
 
 		if (outputFormat==OutputFormatEnum::forWebConsole) {
+			ShowI2NPBuffers (s);
 			bool httpproxy  = i2p::client::context.GetHttpProxy ()         ? true : false;
 			bool socksproxy = i2p::client::context.GetSocksProxy ()        ? true : false;
 			bool bob        = i2p::client::context.GetBOBCommandChannel () ? true : false;
@@ -726,7 +746,14 @@ namespace http {
 	{
 		s << "<b>" << tr("Tunnels") << ":</b><br>\r\n";
 		s << "<b>" << tr("Queue size") << ":</b> " << i2p::tunnel::tunnels.GetQueueSize () << "<br>\r\n<br>\r\n";
-		s << "<b>" << tr("TBM Queue size") << ":</b> " << i2p::tunnel::tunnels.GetTBMQueueSize () << "<br>\r\n<br>\r\n";
+		s << "<b>" << tr("TBM Queue size") << ":</b> " << i2p::tunnel::tunnels.GetTBMQueueSize () << "<br>\r\n";
+		auto tbmStats = i2p::tunnel::tunnels.GetTBMStats ();
+		s << "<b>" << tr("TBM latency") << ":</b> " << tr("queue") << " " << (int)tbmStats.queueLatency << "&#181;s, "
+			<< tr("decryption") << " " << (int)tbmStats.decryptionLatency << "&#181;s, "
+			<< tr("admission") << " " << (int)tbmStats.admissionLatency << "&#181;s, "
+			<< tr("reply") << " " << (int)tbmStats.replyLatency << "&#181;s";
+		if (tbmStats.numBuildThreads) s << " (" << tbmStats.numBuildThreads << " " << tr("threads") << ")";
+		s << "<br>\r\n<br>\r\n";
 
 		auto ExplPool = i2p::tunnel::tunnels.GetExploratoryPool ();
 
@@ -871,6 +898,19 @@ namespace http {
 		}
 	}
 
+	template<typename Session>
+	static void ShowSessionCongestionControl (std::stringstream& s, const Session& session)
+	{
+	}
+
+	static void ShowSessionCongestionControl (std::stringstream& s, const std::shared_ptr<i2p::transport::SSU2Session>& session)
+	{
+		s << " [cwnd:" << session->GetCongestionWindow ()/1024 << "K rtt:" << (int)session->GetRTT () << "ms";
+		auto pacingRate = session->GetPacingRate ();
+		if (pacingRate) s << " pacing:" << pacingRate/1024 << "K/s";
+		s << "]";
+	}
+
 	template<typename Sessions>
 	static void ShowTransportSessions (std::stringstream& s, const Sessions& sessions, const std::string name)
 	{
@@ -899,6 +939,7 @@ namespace http {
 					tmp_s << " [itag:" << it->GetRelayTag () << "]";
 				if (it->GetSendQueueSize () > 0)
 					tmp_s << " [queue:" << it->GetSendQueueSize () << "]";
+				ShowSessionCongestionControl (tmp_s, it);
 				if (it->IsSlow ()) tmp_s << " [slow]";
 				tmp_s << "</div>\r\n" << std::endl;
 				cnt++;
@@ -915,6 +956,7 @@ namespace http {
 					tmp_s6 << " [itag:" << it->GetRelayTag () << "]";
 				if (it->GetSendQueueSize () > 0)
 					tmp_s6 << " [queue:" << it->GetSendQueueSize () << "]";
+				ShowSessionCongestionControl (tmp_s6, it);
 				tmp_s6 << "</div>\r\n" << std::endl;
 				cnt6++;
 			}
@@ -1226,6 +1268,16 @@ namespace http {
 			}
 		}
 
+		if (IsMetricsRequest (req))
+		{
+			i2p::metrics::GetRegistry ().WritePrometheusText (s);
+			res.code = 200;
+			res.add_header("Content-Type", "text/plain; version=0.0.4; charset=utf-8");
+			content = s.str ();
+			SendReply (res, content);
+			return;
+		}
+
 		// HTML head start
 		ShowPageHead (s);
 		if (req.uri.find("page=") != std::string::npos) {
@@ -1243,6 +1295,17 @@ namespace http {
 		SendReply (res, content);
 	}
 
+	bool HTTPConnection::IsMetricsRequest (const HTTPReq& req) const
+	{
+		bool metrics; i2p::config::GetOption("http.metrics", metrics);
+		if (!metrics) return false;
+		URL url;
+		if (!url.parse (req.uri)) return false;
+		std::string webroot; i2p::config::GetOption("http.webroot", webroot);
+		if (webroot.empty () || webroot.back () != '/') webroot += '/';
+		return url.path == webroot + HTTP_PATH_METRICS;
+	}
+
 	std::map<uint32_t, uint32_t> HTTPConnection::m_Tokens;
 
 	uint32_t HTTPConnection::CreateToken ()
@@ -41,6 +41,7 @@ namespace http
 
 			void RunRequest ();
 			bool CheckAuth     (const HTTPReq & req);
+			bool IsMetricsRequest (const HTTPReq & req) const;
 			void HandleRequest (const HTTPReq & req);
 			void HandlePage    (const HTTPReq & req, HTTPRes & res, std::stringstream& data);
 			void HandleCommand (const HTTPReq & req, HTTPRes & res, std::stringstream& data);
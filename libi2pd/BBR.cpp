@@ -0,0 +1,212 @@
+/*
+* Copyright (c) 2013-2025, The PurpleI2P Project
+*
+* This file is part of Purple i2pd project and licensed under BSD3
+*
+* See full license text in LICENSE file at top of project tree
+*/
+
+#include <algorithm>
+#include "Log.h"
+#include "BBR.h"
+
+namespace i2p
+{
+namespace util
+{
+	BBRModel::BBRModel (double initialRTT, double initialWindow):
+		m_InitialRTT (initialRTT), m_InitialWindow (initialWindow), m_Mode (eModeStartup),
+		m_Delivered (0), m_DeliveredTime (0), m_FirstSentTime (0), m_NextRoundDelivered (0), m_RoundCount (0),
+		m_IsRoundStart (false), m_IsFilledPipe (false), m_FullBandwidth (0), m_FullBandwidthCount (0),
+		m_MinRTT (initialRTT), m_MinRTTTime (0), m_ProbeRTTDoneTime (0), m_CycleStartTime (0), m_CycleIndex (0),
+		m_PacingGain (BBR_HIGH_GAIN), m_WindowGain (BBR_HIGH_GAIN), m_Window (initialWindow), m_PriorWindow (0)
+	{
+		Reset ();
+	}
+
+	void BBRModel::Reset ()
+	{
+		m_NextRoundDelivered = m_Delivered;
+		m_RoundCount = 0;
+		m_IsRoundStart = false;
+		m_IsFilledPipe = false;
+		for (auto& it: m_BandwidthFilter) it = 0;
+		m_FullBandwidth = 0;
+		m_FullBandwidthCount = 0;
+		m_MinRTT = m_InitialRTT;
+		m_MinRTTTime = 0;
+		m_ProbeRTTDoneTime = 0;
+		m_Window = m_InitialWindow;
+		m_PriorWindow = 0;
+		SetMode (eModeStartup, 0);
+	}
+
+	double BBRModel::GetBandwidth () const
+	{
+		double bandwidth = 0;
+		for (auto it: m_BandwidthFilter)
+			if (it > bandwidth) bandwidth = it;
+		return bandwidth;
+	}
+
+	void BBRModel::SetMode (Mode mode, uint64_t ts)
+	{
+		m_Mode = mode;
+		switch (mode)
+		{
+			case eModeStartup:
+				m_PacingGain = BBR_HIGH_GAIN;
+				m_WindowGain = BBR_HIGH_GAIN;
+			break;
+			case eModeDrain:
+				m_PacingGain = 1/BBR_HIGH_GAIN;
+				m_WindowGain = BBR_HIGH_GAIN;
+			break;
+			case eModeProbeBW:
+				m_CycleIndex = 0;
+				m_CycleStartTime = ts;
+				m_PacingGain = BBR_PACING_GAINS[m_CycleIndex];
+				m_WindowGain = BBR_WINDOW_GAIN;
+			break;
+			case eModeProbeRTT:
+				m_PacingGain = 1;
+				m_WindowGain = 1;
+				m_ProbeRTTDoneTime = 0;
+				m_PriorWindow = m_Window;
+			break;
+		}
+	}
+
+	void BBRModel::OnPacketSent (BBRDeliveryState& state, uint64_t inFlight, uint64_t ts)
+	{
+		if (!inFlight || !m_DeliveredTime)
+		{
+			// nothing to ack, start new interval
+			m_FirstSentTime = ts;
+			m_DeliveredTime = ts;
+		}
+		state.delivered = m_Delivered;
+		state.deliveredTime = m_DeliveredTime;
+		state.firstSentTime = m_FirstSentTime;
+	}
+
+	void BBRModel::OnPacketAcked (const BBRDeliveryState& state, uint64_t amount, uint64_t sendTime, uint64_t ts)
+	{
+		m_Delivered += amount;
+		m_DeliveredTime = ts;
+		m_FirstSentTime = sendTime;
+		if (state.delivered >= m_NextRoundDelivered)
+		{
+			// packet sent after previous round start is acked
+			m_NextRoundDelivered = m_Delivered;
+			m_RoundCount++;
+			m_BandwidthFilter[m_RoundCount % BBR_BANDWIDTH_WINDOW] = 0;
+			m_IsRoundStart = true;
+		}
+		if (!state.deliveredTime) return; // sent before reset
+		// delivery rate sample, can't be faster than packets were sent
+		uint64_t sendInterval = sendTime > state.firstSentTime ? sendTime - state.firstSentTime : 0;
+		uint64_t ackInterval = ts > state.deliveredTime ? ts - state.deliveredTime : 0;
+		auto interval = std::max (sendInterval, ackInterval);
+		if (interval > 0 && interval >= m_MinRTT/2)
+		{
+			double bandwidth = (double)(m_Delivered - state.delivered)/interval;
+			auto& maxBandwidth = m_BandwidthFilter[m_RoundCount % BBR_BANDWIDTH_WINDOW];
+			if (bandwidth > maxBandwidth) maxBandwidth = bandwidth;
+		}
+	}
+
+	void BBRModel::OnAck (uint64_t ts, int rttSample, uint64_t acked, uint64_t inFlight,
+		double minWindow, double maxWindow)
+	{
+		bool isMinRTTExpired = m_MinRTTTime && ts > m_MinRTTTime + BBR_MIN_RTT_WINDOW;
+		if (rttSample >= 0 && (rttSample < m_MinRTT || !m_MinRTTTime || isMinRTTExpired))
+		{
+			m_MinRTT = std::max (rttSample, 1);
+			m_MinRTTTime = ts;
+		}
+		if (isMinRTTExpired && m_Mode != eModeProbeRTT)
+			SetMode (eModeProbeRTT, ts);
+		UpdateMode (ts, inFlight, minWindow);
+		UpdateWindow (acked, minWindow, maxWindow);
+		m_IsRoundStart = false;
+	}
+
+	void BBRModel::UpdateMode (uint64_t ts, uint64_t inFlight, double minWindow)
+	{
+		if (!m_IsFilledPipe && m_IsRoundStart)
+		{
+			// bandwidth stops growing
+			auto bandwidth = GetBandwidth ();
+			if (bandwidth >= m_FullBandwidth*BBR_FULL_BANDWIDTH_GROWTH)
+			{
+				m_FullBandwidth = bandwidth;
+				m_FullBandwidthCount = 0;
+			}
+			else if (++m_FullBandwidthCount >= BBR_FULL_BANDWIDTH_ROUNDS)
+				m_IsFilledPipe = true;
+		}
+		switch (m_Mode)
+		{
+			case eModeStartup:
+				if (m_IsFilledPipe)
+				{
+					LogPrint (eLogDebug, "BBR: Pipe is filled, bandwidth=", GetBandwidth (), " per ms, minRTT=", m_MinRTT);
+					SetMode (eModeDrain, ts);
+				}
+			break;
+			case eModeDrain:
+				if (inFlight <= GetBDP ())
+					SetMode (eModeProbeBW, ts);
+			break;
+			case eModeProbeBW:
+				if (ts > m_CycleStartTime + m_MinRTT ||
+					(m_PacingGain < 1 && inFlight <= GetBDP ())) // queue is drained
+				{
+					m_CycleIndex = (m_CycleIndex + 1) % BBR_NUM_PACING_GAINS;
+					m_CycleStartTime = ts;
+					m_PacingGain = BBR_PACING_GAINS[m_CycleIndex];
+				}
+			break;
+			case eModeProbeRTT:
+				if (!m_ProbeRTTDoneTime)
+				{
+					if (inFlight <= minWindow)
+						m_ProbeRTTDoneTime = ts + std::max ((double)BBR_PROBE_RTT_DURATION, m_MinRTT);
+				}
+				else if (ts >= m_ProbeRTTDoneTime)
+				{
+					m_MinRTTTime = ts;
+					if (m_Window < m_PriorWindow) m_Window = m_PriorWindow;
+					SetMode (m_IsFilledPipe ? eModeProbeBW : eModeStartup, ts);
+				}
+			break;
+		}
+	}
+
+	void BBRModel::UpdateWindow (uint64_t acked, double minWindow, double maxWindow)
+	{
+		if (GetBandwidth () > 0)
+		{
+			double targetWindow = m_WindowGain*GetBDP ();
+			if (m_IsFilledPipe)
+				m_Window = std::min (m_Window + acked, targetWindow);
+			else if (m_Window < targetWindow)
+				m_Window += acked;
+		}
+		else
+			m_Window += acked; // no delivery rate yet
+		if (m_Mode == eModeProbeRTT && m_Window > minWindow)
+			m_Window = minWindow;
+		if (m_Window < minWindow) m_Window = minWindow;
+		if (m_Window > maxWindow) m_Window = maxWindow;
+	}
+
+	void BBRModel::OnLoss (uint64_t inFlight, double minWindow)
+	{
+		// window grows back with ACKs
+		if (m_Window > inFlight)
+			m_Window = std::max ((double)inFlight, minWindow);
+	}
+}
+}
@@ -0,0 +1,86 @@
+/*
+* Copyright (c) 2013-2025, The PurpleI2P Project
+*
+* This file is part of Purple i2pd project and licensed under BSD3
+*
+* See full license text in LICENSE file at top of project tree
+*/
+
+#ifndef BBR_H__
+#define BBR_H__
+
+#include <inttypes.h>
+
+namespace i2p
+{
+namespace util
+{
+	const int BBR_MIN_RTT_WINDOW = 10000; // in milliseconds
+	const int BBR_BANDWIDTH_WINDOW = 10; // in rounds
+	const int BBR_PROBE_RTT_DURATION = 200; // in milliseconds
+	const int BBR_FULL_BANDWIDTH_ROUNDS = 3;
+	const double BBR_FULL_BANDWIDTH_GROWTH = 1.25;
+	const double BBR_HIGH_GAIN = 2.885; // 2/ln(2)
+	const double BBR_WINDOW_GAIN = 2.0;
+	const int BBR_NUM_PACING_GAINS = 8;
+	const double BBR_PACING_GAINS[BBR_NUM_PACING_GAINS] = { 1.25, 0.75, 1, 1, 1, 1, 1, 1 };
+
+	struct BBRDeliveryState // of sent packet, set by BBRModel::OnPacketSent
+	{
+		uint64_t delivered = 0, deliveredTime = 0, firstSentTime = 0;
+	};
+
+	// delivery rate and min RTT model, amounts are in packets or bytes, times in milliseconds
+	class BBRModel
+	{
+		enum Mode
+		{
+			eModeStartup = 0,
+			eModeDrain,
+			eModeProbeBW,
+			eModeProbeRTT
+		};
+
+		public:
+
+			BBRModel (double initialRTT, double initialWindow);
+
+			void Reset (); // path has changed, start measuring from scratch
+			double GetWindow () const { return m_Window; };
+			void SetWindow (double window) { m_Window = window; };
+			double GetPacingGain () const { return m_PacingGain; };
+			double GetBandwidth () const; // max delivery rate, amount per millisecond
+			double GetMinRTT () const { return m_MinRTT; };
+
+			void OnPacketSent (BBRDeliveryState& state, uint64_t inFlight, uint64_t ts);
+			void OnPacketAcked (const BBRDeliveryState& state, uint64_t amount, uint64_t sendTime, uint64_t ts);
+			void OnAck (uint64_t ts, int rttSample, uint64_t acked, uint64_t inFlight,
+				double minWindow, double maxWindow); // after acked packets
+			void OnLoss (uint64_t inFlight, double minWindow); // packet conservation
+
+		private:
+
+			void UpdateMode (uint64_t ts, uint64_t inFlight, double minWindow);
+			void UpdateWindow (uint64_t acked, double minWindow, double maxWindow);
+			void SetMode (Mode mode, uint64_t ts);
+			double GetBDP () const { return GetBandwidth ()*m_MinRTT; };
+
+		private:
+
+			double m_InitialRTT, m_InitialWindow;
+			Mode m_Mode;
+			uint64_t m_Delivered, m_DeliveredTime, m_FirstSentTime, m_NextRoundDelivered, m_RoundCount;
+			bool m_IsRoundStart, m_IsFilledPipe;
+			double m_BandwidthFilter[BBR_BANDWIDTH_WINDOW]; // max per round
+			double m_FullBandwidth;
+			int m_FullBandwidthCount;
+			double m_MinRTT;
+			uint64_t m_MinRTTTime, m_ProbeRTTDoneTime, m_CycleStartTime;
+			int m_CycleIndex;
+			double m_PacingGain, m_WindowGain;
+			double m_Window, m_PriorWindow; // before ProbeRTT
+	};
+}
+}
+
+#endif
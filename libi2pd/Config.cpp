@@ -43,6 +43,8 @@ namespace config {
 			("logfile", value<std::string>()->default_value(""),              "Path to logfile (stdout if not set, autodetect if daemon)")
 			("loglevel", value<std::string>()->default_value("warn"),         "Set the minimal level of log messages (debug, info, warn, error, none)")
 			("logclftime", bool_switch()->default_value(false),               "Write full CLF-formatted date and time to log (default: disabled, write only time)")
+			("logformat", value<std::string>()->default_value("text"),        "Format of log messages: text, json (one JSON object per line)")
+			("logratelimit", value<uint16_t>()->default_value(0),             "Max same log messages per second, rest are counted and reported (default: 0, unlimited)")
 			("family", value<std::string>()->default_value(""),               "Specify a family, router belongs to")
 			("datadir", value<std::string>()->default_value(""),              "Path to storage of i2pd data (RI, keys, peer profiles, ...)")
 			("host", value<std::string>()->default_value(""),                 "External IP")
@@ -85,6 +87,8 @@ namespace config {
 #endif			
 			("limits.transittunnels", value<uint32_t>()->default_value(10000), "Maximum active transit tunnels (default:10000)")
 			("limits.zombies", value<double>()->default_value(0),             "Minimum percentage of successfully created tunnels under which tunnel cleanup is paused (default [%]: 0.00)")
+			("limits.tunnelthreads", value<uint16_t>()->default_value(0),     "Number of threads for tunnel data messages (0 - handle in tunnels thread)")
+			("limits.buildthreads", value<uint16_t>()->default_value(0),      "Number of threads decrypting transit tunnel build requests (0 - handle in TBM thread)")
 			("limits.ntcpsoft", value<uint16_t>()->default_value(0),          "Ignored")
 			("limits.ntcphard", value<uint16_t>()->default_value(0),          "Ignored")
 			("limits.ntcpthreads", value<uint16_t>()->default_value(1),       "Ignored")
@@ -104,6 +108,7 @@ namespace config {
 			("http.lang", value<std::string>()->default_value("english"),       "WebUI language (default: english )")
 			("http.showTotalTCSR", value<bool>()->default_value(false),         "Show additional value with total TCSR since router's start (default: false)")
 			("http.theme", value<std::string>()->default_value("light"), 	    "Theme for http web console")
+			("http.metrics", value<bool>()->default_value(true),                "Expose metrics in Prometheus format at <webroot>metrics (default: true)")
 		;
 
 		options_description httpproxy("HTTP Proxy options");
@@ -136,6 +141,7 @@ namespace config {
 			("httpproxy.i2p.streaming.maxInboundSpeed", value<std::string>()->default_value("1730000000"), "Max inbound speed of HTTP proxy stream in bytes/sec")
 			("httpproxy.i2p.streaming.profile", value<std::string>()->default_value("1"), "HTTP Proxy bandwidth usage profile. 1 - bulk(high), 2- interactive(low)")
 			("httpproxy.i2p.streaming.maxWindowSize", value<std::string>()->default_value("512"), "HTTP Proxy stream max window size. 512 by default")
+			("httpproxy.i2p.streaming.congestionControl", value<std::string>()->default_value("delay"), "HTTP Proxy stream congestion control. delay or bbr")
 		;
 
 		options_description socksproxy("SOCKS Proxy options");
@@ -168,6 +174,7 @@ namespace config {
 			("socksproxy.i2p.streaming.maxInboundSpeed", value<std::string>()->default_value("1730000000"), "Max inbound speed of SOCKS proxy stream in bytes/sec")
 			("socksproxy.i2p.streaming.profile", value<std::string>()->default_value("1"), "SOCKS Proxy bandwidth usage profile. 1 - bulk(high), 2- interactive(low)")
 			("socksproxy.i2p.streaming.maxWindowSize", value<std::string>()->default_value("512"), "SOCKS Proxy stream max window size. 512 by default")
+			("socksproxy.i2p.streaming.congestionControl", value<std::string>()->default_value("delay"), "SOCKS Proxy stream congestion control. delay or bbr")
 		;
 
 		options_description shareddest("Shared local destination options");
@@ -313,6 +320,7 @@ namespace config {
 			("ntcp2.port", value<uint16_t>()->default_value(0),            "Port to listen for incoming NTCP2 connections (default: auto)")
 			("ntcp2.addressv6", value<std::string>()->default_value("::"), "Address to publish NTCP2 with")
 			("ntcp2.proxy", value<std::string>()->default_value(""),       "Proxy URL for NTCP2 transport")
+			("ntcp2.threads", value<uint16_t>()->default_value(0),         "Number of threads processing established NTCP2 sessions (default: 0 - NTCP2 thread)")
 		;
 
 		options_description ssu2("SSU2 Options");
@@ -325,6 +333,10 @@ namespace config {
 			("ssu2.proxy", value<std::string>()->default_value(""),       "Socks5 proxy URL for SSU2 transport")
 			("ssu2.firewalled4", value<bool>()->default_value(false),     "Set ipv4 network status to Firewalled even if OK (default: disabled)")
 			("ssu2.firewalled6", value<bool>()->default_value(false),     "Set ipv6 network status to Firewalled even if OK (default: disabled)")
+			("ssu2.gso", value<bool>()->default_value(false),             "Use UDP segmentation offload (GSO/GRO) if supported by kernel (default: disabled)")
+			("ssu2.receivethreads", value<uint16_t>()->default_value(1),  "Number of receive threads with own SO_REUSEPORT socket per address (default: 1)")
+			("ssu2.datathreads", value<uint16_t>()->default_value(0),     "Number of threads decrypting data packets, sharded by connection ID (default: 0 - SSU2 thread)")
+			("ssu2.congestioncontrol", value<std::string>()->default_value("default"), "Congestion control of SSU2 sessions: default, cubic or bbr (default: default)")
 		;
 
 		options_description nettime("Time sync options");
@@ -344,6 +356,7 @@ namespace config {
 		persist.add_options()
 			("persist.profiles", value<bool>()->default_value(true),       "Persist peer profiles (default: true)")
 			("persist.addressbook", value<bool>()->default_value(true),    "Persist full addresses (default: true)")
+			("persist.netdbsnapshot", value<bool>()->default_value(false), "Keep single file snapshot of netDb to load at startup (default: false)")
 		;
 
 		options_description cpuext("CPU encryption extensions options. Deprecated");
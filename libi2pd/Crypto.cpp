@@ -11,6 +11,7 @@
 #include <vector>
 #include <mutex>
 #include <memory>
+#include <algorithm>
 #include <openssl/dh.h>
 #include <openssl/md5.h>
 #include <openssl/crypto.h>
@@ -548,7 +549,7 @@ namespace crypto
 	}
 
 // AES
-	ECBEncryption::ECBEncryption ()
+	ECBEncryption::ECBEncryption (): m_IsKeySet (false)
 	{
 		m_Ctx = EVP_CIPHER_CTX_new ();
 	}
@@ -559,16 +560,22 @@ namespace crypto
 			EVP_CIPHER_CTX_free (m_Ctx);
 	}	
 	
-	void ECBEncryption::Encrypt (const uint8_t * in, uint8_t * out)
+	void ECBEncryption::Encrypt (const uint8_t * in, size_t len, uint8_t * out)
 	{
-		EVP_EncryptInit_ex (m_Ctx, EVP_aes_256_ecb(), NULL, m_Key, NULL);
-		EVP_CIPHER_CTX_set_padding (m_Ctx, 0);
-		int len;
-		EVP_EncryptUpdate (m_Ctx, out, &len, in, 16);
-		EVP_EncryptFinal_ex (m_Ctx, out + len, &len);
+		if (!m_IsKeySet)
+		{
+			// expand key once, next time reset only
+			EVP_EncryptInit_ex (m_Ctx, EVP_aes_256_ecb(), NULL, m_Key, NULL);
+			EVP_CIPHER_CTX_set_padding (m_Ctx, 0);
+			m_IsKeySet = true;
+		}
+		else
+			EVP_EncryptInit_ex (m_Ctx, NULL, NULL, NULL, NULL);
+		int l;
+		EVP_EncryptUpdate (m_Ctx, out, &l, in, len);
 	}
 
-	ECBDecryption::ECBDecryption ()
+	ECBDecryption::ECBDecryption (): m_IsKeySet (false)
 	{
 		m_Ctx = EVP_CIPHER_CTX_new ();
 	}
@@ -579,17 +586,22 @@ namespace crypto
 			EVP_CIPHER_CTX_free (m_Ctx);
 	}	
 	
-	void ECBDecryption::Decrypt (const uint8_t * in, uint8_t * out)
+	void ECBDecryption::Decrypt (const uint8_t * in, size_t len, uint8_t * out)
 	{
-		EVP_DecryptInit_ex (m_Ctx, EVP_aes_256_ecb(), NULL, m_Key, NULL);
-		EVP_CIPHER_CTX_set_padding (m_Ctx, 0);
-		int len;
-		EVP_DecryptUpdate (m_Ctx, out, &len, in, 16);
-		EVP_DecryptFinal_ex (m_Ctx, out + len, &len);
+		if (!m_IsKeySet)
+		{
+			EVP_DecryptInit_ex (m_Ctx, EVP_aes_256_ecb(), NULL, m_Key, NULL);
+			EVP_CIPHER_CTX_set_padding (m_Ctx, 0);
+			m_IsKeySet = true;
+		}
+		else
+			EVP_DecryptInit_ex (m_Ctx, NULL, NULL, NULL, NULL);
+		int l;
+		EVP_DecryptUpdate (m_Ctx, out, &l, in, len);
 	}
 
 
-	CBCEncryption::CBCEncryption () 
+	CBCEncryption::CBCEncryption (): m_IsKeySet (false)
 	{ 
 		m_Ctx = EVP_CIPHER_CTX_new ();
 	}
@@ -603,14 +615,19 @@ namespace crypto
 	void CBCEncryption::Encrypt (const uint8_t * in, size_t len, const uint8_t * iv, uint8_t * out)
 	{
 		// len/16
-		EVP_EncryptInit_ex (m_Ctx, EVP_aes_256_cbc(), NULL, m_Key, iv);
-		EVP_CIPHER_CTX_set_padding (m_Ctx, 0);
+		if (!m_IsKeySet)
+		{
+			EVP_EncryptInit_ex (m_Ctx, EVP_aes_256_cbc(), NULL, m_Key, iv);
+			EVP_CIPHER_CTX_set_padding (m_Ctx, 0);
+			m_IsKeySet = true;
+		}
+		else
+			EVP_EncryptInit_ex (m_Ctx, NULL, NULL, NULL, iv); // new iv only
 		int l;
 		EVP_EncryptUpdate (m_Ctx, out, &l, in, len);
-		EVP_EncryptFinal_ex (m_Ctx, out + l, &l);
 	}
 
-	CBCDecryption::CBCDecryption () 
+	CBCDecryption::CBCDecryption (): m_IsKeySet (false)
 	{ 
 		m_Ctx = EVP_CIPHER_CTX_new ();
 	}
@@ -624,11 +641,16 @@ namespace crypto
 	void CBCDecryption::Decrypt (const uint8_t * in, size_t len, const uint8_t * iv, uint8_t * out)
 	{
 		// len/16
-		EVP_DecryptInit_ex (m_Ctx, EVP_aes_256_cbc(), NULL, m_Key, iv);
-		EVP_CIPHER_CTX_set_padding (m_Ctx, 0);
+		if (!m_IsKeySet)
+		{
+			EVP_DecryptInit_ex (m_Ctx, EVP_aes_256_cbc(), NULL, m_Key, iv);
+			EVP_CIPHER_CTX_set_padding (m_Ctx, 0);
+			m_IsKeySet = true;
+		}
+		else
+			EVP_DecryptInit_ex (m_Ctx, NULL, NULL, NULL, iv); // new iv only
 		int l;
 		EVP_DecryptUpdate (m_Ctx, out, &l, in, len);
-		EVP_DecryptFinal_ex (m_Ctx, out + l, &l);
 	}
 
 	void TunnelEncryption::Encrypt (const uint8_t * in, uint8_t * out)
@@ -639,6 +661,23 @@ namespace crypto
 		m_IVEncryption.Encrypt (iv, out); // double iv
 	}
 
+	void TunnelEncryption::Encrypt (const uint8_t * const * in, uint8_t * const * out, size_t num)
+	{
+		uint8_t ivs[TUNNEL_ENCRYPTION_BATCH_SIZE*16];
+		for (size_t offset = 0; offset < num; offset += TUNNEL_ENCRYPTION_BATCH_SIZE)
+		{
+			size_t n = std::min (num - offset, TUNNEL_ENCRYPTION_BATCH_SIZE);
+			for (size_t i = 0; i < n; i++)
+				memcpy (ivs + i*16, in[offset + i], 16);
+			m_IVEncryption.Encrypt (ivs, n*16, ivs); // ivs of all messages in one pass
+			for (size_t i = 0; i < n; i++)
+				m_LayerEncryption.Encrypt (in[offset + i] + 16, i2p::tunnel::TUNNEL_DATA_ENCRYPTED_SIZE, ivs + i*16, out[offset + i] + 16); // data
+			m_IVEncryption.Encrypt (ivs, n*16, ivs); // double ivs
+			for (size_t i = 0; i < n; i++)
+				memcpy (out[offset + i], ivs + i*16, 16);
+		}
+	}
+
 	void TunnelDecryption::Decrypt (const uint8_t * in, uint8_t * out)
 	{
 		uint8_t iv[16];
@@ -647,6 +686,23 @@ namespace crypto
 		m_IVDecryption.Decrypt (iv, out); // double iv
 	}
 
+	void TunnelDecryption::Decrypt (const uint8_t * const * in, uint8_t * const * out, size_t num)
+	{
+		uint8_t ivs[TUNNEL_ENCRYPTION_BATCH_SIZE*16];
+		for (size_t offset = 0; offset < num; offset += TUNNEL_ENCRYPTION_BATCH_SIZE)
+		{
+			size_t n = std::min (num - offset, TUNNEL_ENCRYPTION_BATCH_SIZE);
+			for (size_t i = 0; i < n; i++)
+				memcpy (ivs + i*16, in[offset + i], 16);
+			m_IVDecryption.Decrypt (ivs, n*16, ivs); // ivs of all messages in one pass
+			for (size_t i = 0; i < n; i++)
+				m_LayerDecryption.Decrypt (in[offset + i] + 16, i2p::tunnel::TUNNEL_DATA_ENCRYPTED_SIZE, ivs + i*16, out[offset + i] + 16); // data
+			m_IVDecryption.Decrypt (ivs, n*16, ivs); // double ivs
+			for (size_t i = 0; i < n; i++)
+				memcpy (out[offset + i], ivs + i*16, 16);
+		}
+	}
+
 // AEAD/ChaCha20/Poly1305
 
 	static bool AEADChaCha20Poly1305 (EVP_CIPHER_CTX * ctx, const uint8_t * msg, size_t msgLen, 
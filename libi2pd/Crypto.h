@@ -89,6 +89,7 @@ namespace crypto
 
 	// AES
 	typedef i2p::data::Tag<32> AESKey;
+	const size_t TUNNEL_ENCRYPTION_BATCH_SIZE = 64; // IVs of that many messages are encrypted at once
 	
 	class ECBEncryption
 	{
@@ -97,13 +98,15 @@ namespace crypto
 			ECBEncryption ();
 			~ECBEncryption ();
 			
-			void SetKey (const uint8_t * key) { m_Key = key; };
-			void Encrypt(const uint8_t * in, uint8_t * out);
+			void SetKey (const uint8_t * key) { m_Key = key; m_IsKeySet = false; };
+			void Encrypt (const uint8_t * in, uint8_t * out) { Encrypt (in, 16, out); };
+			void Encrypt (const uint8_t * in, size_t len, uint8_t * out); // len/16 blocks
 
 		private:
 
 			AESKey m_Key;
 			EVP_CIPHER_CTX * m_Ctx;	
+			bool m_IsKeySet; // key schedule is in m_Ctx
 	};
 
 	class ECBDecryption
@@ -113,13 +116,15 @@ namespace crypto
 			ECBDecryption ();
 			~ECBDecryption ();
 			
-			void SetKey (const uint8_t * key) { m_Key = key; };
-			void Decrypt (const uint8_t * in, uint8_t * out);
+			void SetKey (const uint8_t * key) { m_Key = key; m_IsKeySet = false; };
+			void Decrypt (const uint8_t * in, uint8_t * out) { Decrypt (in, 16, out); };
+			void Decrypt (const uint8_t * in, size_t len, uint8_t * out); // len/16 blocks
 			
 		private:
 			
 			AESKey m_Key;
 			EVP_CIPHER_CTX * m_Ctx;	
+			bool m_IsKeySet;
 	};
 
 	class CBCEncryption
@@ -129,13 +134,14 @@ namespace crypto
 			CBCEncryption ();
 			~CBCEncryption ();
 
-			void SetKey (const uint8_t * key) { m_Key = key; }; // 32 bytes		
+			void SetKey (const uint8_t * key) { m_Key = key; m_IsKeySet = false; }; // 32 bytes		
 			void Encrypt (const uint8_t * in, size_t len, const uint8_t * iv, uint8_t * out);
 			
 		private:
 
 			AESKey m_Key;
 			EVP_CIPHER_CTX * m_Ctx;	
+			bool m_IsKeySet;
 	};
 
 	class CBCDecryption
@@ -145,13 +151,14 @@ namespace crypto
 			CBCDecryption ();
 			~CBCDecryption ();
 			
-			void SetKey (const uint8_t * key) { m_Key = key; }; // 32 bytes
+			void SetKey (const uint8_t * key) { m_Key = key; m_IsKeySet = false; }; // 32 bytes
 			void Decrypt (const uint8_t * in, size_t len, const uint8_t * iv, uint8_t * out);
 
 		private:
 
 			AESKey m_Key;
 			EVP_CIPHER_CTX * m_Ctx;	
+			bool m_IsKeySet;
 	};
 
 	class TunnelEncryption // with double IV encryption
@@ -165,6 +172,7 @@ namespace crypto
 			}
 
 			void Encrypt (const uint8_t * in, uint8_t * out); // 1024 bytes (16 IV + 1008 data)
+			void Encrypt (const uint8_t * const * in, uint8_t * const * out, size_t num); // num messages, might be in place
 
 		private:
 
@@ -183,6 +191,7 @@ namespace crypto
 			}
 
 			void Decrypt (const uint8_t * in, uint8_t * out); // 1024 bytes (16 IV + 1008 data)
+			void Decrypt (const uint8_t * const * in, uint8_t * const * out, size_t num); // num messages, might be in place
 
 		private:
 
@@ -976,7 +976,8 @@ namespace client
 		m_StreamingInboundSpeed (DEFAULT_MAX_INBOUND_SPEED),
 		m_StreamingMaxConcurrentStreams (DEFAULT_MAX_CONCURRENT_STREAMS),
 		m_StreamingMaxWindowSize (i2p::stream::MAX_WINDOW_SIZE),
-		m_IsStreamingAnswerPings (DEFAULT_ANSWER_PINGS), m_IsStreamingDontSign (DEFAULT_DONT_SIGN), 
+		m_IsStreamingAnswerPings (DEFAULT_ANSWER_PINGS), m_IsStreamingDontSign (DEFAULT_DONT_SIGN),
+		m_StreamingCongestionControl (i2p::stream::eCongestionControlDelay),
 		m_LastPort (0), m_DatagramDestination (nullptr), m_RefCounter (0), 
 		m_LastPublishedTimestamp (0), m_ReadyChecker(service)
 	{
@@ -1053,6 +1054,11 @@ namespace client
 						m_StreamingMaxWindowSize = i2p::stream::MIN_WINDOW_SIZE;
 				params->Get (I2CP_PARAM_STREAMING_ANSWER_PINGS, m_IsStreamingAnswerPings);
 				params->Get (I2CP_PARAM_STREAMING_DONT_SIGN, m_IsStreamingDontSign);
+				auto congestionControl = (*params)[I2CP_PARAM_STREAMING_CONGESTION_CONTROL];
+				if (congestionControl == "bbr")
+					m_StreamingCongestionControl = i2p::stream::eCongestionControlBBR;
+				else if (!congestionControl.empty () && congestionControl != "delay")
+					LogPrint (eLogWarning, "Destination: Unknown streaming congestion control ", congestionControl, ". Using delay");
 				
 				if (GetLeaseSetType () == i2p::data::NETDB_STORE_TYPE_ENCRYPTED_LEASESET2)
 				{
@@ -104,6 +104,8 @@ namespace client
 	const char I2CP_PARAM_STREAMING_MAX_WINDOW_SIZE[] = "i2p.streaming.maxWindowSize";
 	const char I2CP_PARAM_STREAMING_DONT_SIGN[] = "i2p.streaming.dontSign";
 	const int DEFAULT_DONT_SIGN = false;
+	const char I2CP_PARAM_STREAMING_CONGESTION_CONTROL[] = "i2p.streaming.congestionControl";
+	const char DEFAULT_STREAMING_CONGESTION_CONTROL[] = "delay"; // delay or bbr
 	
 	typedef std::function<void (std::shared_ptr<i2p::stream::Stream> stream)> StreamRequestComplete;
 
@@ -276,6 +278,7 @@ namespace client
 			bool IsStreamingAnswerPings () const { return m_IsStreamingAnswerPings; }
 			bool IsStreamingDontSign () const { return m_IsStreamingDontSign; }
 			int GetStreamingMaxWindowSize () const { return m_StreamingMaxWindowSize; }
+			i2p::stream::CongestionControlType GetStreamingCongestionControl () const { return m_StreamingCongestionControl; }
 
 			// datagram
 			i2p::datagram::DatagramDestination * GetDatagramDestination () const { return m_DatagramDestination; };
@@ -318,6 +321,7 @@ namespace client
 			
 			int m_StreamingAckDelay,m_StreamingOutboundSpeed, m_StreamingInboundSpeed, m_StreamingMaxConcurrentStreams, m_StreamingMaxWindowSize;
 			bool m_IsStreamingAnswerPings, m_IsStreamingDontSign;
+			i2p::stream::CongestionControlType m_StreamingCongestionControl;
 			std::shared_ptr<i2p::stream::StreamingDestination> m_StreamingDestination; // default
 			std::map<uint16_t, std::shared_ptr<i2p::stream::StreamingDestination> > m_StreamingDestinationsByPorts;
 			std::shared_ptr<i2p::stream::StreamingDestination> m_LastStreamingDestination; uint16_t m_LastPort; // for server tunnels
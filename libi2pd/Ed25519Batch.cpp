@@ -0,0 +1,635 @@
+/*
+* Copyright (c) 2013-2025, The PurpleI2P Project
+*
+* This file is part of Purple i2pd project and licensed under BSD3
+*
+* See full license text in LICENSE file at top of project tree
+*/
+
+#include <string.h>
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include "Crypto.h"
+#include "Signature.h"
+#include "Ed25519Batch.h"
+
+namespace i2p
+{
+namespace crypto
+{
+#if defined(__SIZEOF_INT128__)
+	__extension__ typedef unsigned __int128 uint128_t;
+
+	// GF(2^255-19) element as 5 limbs of 51 bits
+	struct FieldElement
+	{
+		uint64_t v[5];
+	};
+	const uint64_t FE_MASK = (1ULL << 51) - 1;
+
+	static inline void FECarry (FieldElement& h)
+	{
+		uint64_t c;
+		c = h.v[0] >> 51; h.v[0] &= FE_MASK; h.v[1] += c;
+		c = h.v[1] >> 51; h.v[1] &= FE_MASK; h.v[2] += c;
+		c = h.v[2] >> 51; h.v[2] &= FE_MASK; h.v[3] += c;
+		c = h.v[3] >> 51; h.v[3] &= FE_MASK; h.v[4] += c;
+		c = h.v[4] >> 51; h.v[4] &= FE_MASK; h.v[0] += 19*c;
+	}
+
+	static inline void FEAdd (FieldElement& h, const FieldElement& f, const FieldElement& g)
+	{
+		for (int i = 0; i < 5; i++) h.v[i] = f.v[i] + g.v[i];
+		FECarry (h);
+	}
+
+	static inline void FESub (FieldElement& h, const FieldElement& f, const FieldElement& g)
+	{
+		// add 4*p to stay positive
+		h.v[0] = f.v[0] + 0x1FFFFFFFFFFFB4ULL - g.v[0];
+		for (int i = 1; i < 5; i++) h.v[i] = f.v[i] + 0x1FFFFFFFFFFFFCULL - g.v[i];
+		FECarry (h);
+	}
+
+	static inline void FEReduce (FieldElement& h, uint128_t r0, uint128_t r1, uint128_t r2, uint128_t r3, uint128_t r4)
+	{
+		r1 += (uint64_t)(r0 >> 51); uint64_t h0 = (uint64_t)r0 & FE_MASK;
+		r2 += (uint64_t)(r1 >> 51); h.v[1] = (uint64_t)r1 & FE_MASK;
+		r3 += (uint64_t)(r2 >> 51); h.v[2] = (uint64_t)r2 & FE_MASK;
+		r4 += (uint64_t)(r3 >> 51); h.v[3] = (uint64_t)r3 & FE_MASK;
+		uint128_t t = (uint128_t)h0 + (uint128_t)(uint64_t)(r4 >> 51)*19; h.v[4] = (uint64_t)r4 & FE_MASK;
+		h.v[0] = (uint64_t)t & FE_MASK; h.v[1] += (uint64_t)(t >> 51);
+	}
+
+	static inline void FEMul (FieldElement& h, const FieldElement& f, const FieldElement& g)
+	{
+		uint64_t f0 = f.v[0], f1 = f.v[1], f2 = f.v[2], f3 = f.v[3], f4 = f.v[4];
+		uint64_t g0 = g.v[0], g1 = g.v[1], g2 = g.v[2], g3 = g.v[3], g4 = g.v[4];
+		uint64_t g1_19 = 19*g1, g2_19 = 19*g2, g3_19 = 19*g3, g4_19 = 19*g4;
+		uint128_t r0 = (uint128_t)f0*g0 + (uint128_t)f1*g4_19 + (uint128_t)f2*g3_19 + (uint128_t)f3*g2_19 + (uint128_t)f4*g1_19;
+		uint128_t r1 = (uint128_t)f0*g1 + (uint128_t)f1*g0 + (uint128_t)f2*g4_19 + (uint128_t)f3*g3_19 + (uint128_t)f4*g2_19;
+		uint128_t r2 = (uint128_t)f0*g2 + (uint128_t)f1*g1 + (uint128_t)f2*g0 + (uint128_t)f3*g4_19 + (uint128_t)f4*g3_19;
+		uint128_t r3 = (uint128_t)f0*g3 + (uint128_t)f1*g2 + (uint128_t)f2*g1 + (uint128_t)f3*g0 + (uint128_t)f4*g4_19;
+		uint128_t r4 = (uint128_t)f0*g4 + (uint128_t)f1*g3 + (uint128_t)f2*g2 + (uint128_t)f3*g1 + (uint128_t)f4*g0;
+		FEReduce (h, r0, r1, r2, r3, r4);
+	}
+
+	static inline void FESq (FieldElement& h, const FieldElement& f)
+	{
+		uint64_t f0 = f.v[0], f1 = f.v[1], f2 = f.v[2], f3 = f.v[3], f4 = f.v[4];
+		uint64_t f0_2 = 2*f0, f1_2 = 2*f1, f3_19 = 19*f3, f4_19 = 19*f4;
+		uint128_t r0 = (uint128_t)f0*f0 + (uint128_t)f1_2*f4_19 + (uint128_t)(2*f2)*f3_19;
+		uint128_t r1 = (uint128_t)f0_2*f1 + (uint128_t)(2*f2)*f4_19 + (uint128_t)f3*f3_19;
+		uint128_t r2 = (uint128_t)f0_2*f2 + (uint128_t)f1*f1 + (uint128_t)(2*f3)*f4_19;
+		uint128_t r3 = (uint128_t)f0_2*f3 + (uint128_t)f1_2*f2 + (uint128_t)f4*f4_19;
+		uint128_t r4 = (uint128_t)f0_2*f4 + (uint128_t)f1_2*f3 + (uint128_t)f2*f2;
+		FEReduce (h, r0, r1, r2, r3, r4);
+	}
+
+	static inline void FESqN (FieldElement& h, const FieldElement& f, int n)
+	{
+		FESq (h, f);
+		for (int i = 1; i < n; i++) FESq (h, h);
+	}
+
+	static void FEFromBytes (FieldElement& h, const uint8_t * s) // 32 bytes Little Endian, highest bit ignored
+	{
+		uint64_t w[4];
+		for (int i = 0; i < 4; i++)
+		{
+			w[i] = 0;
+			for (int j = 7; j >= 0; j--) w[i] = (w[i] << 8) | s[8*i + j];
+		}
+		h.v[0] = w[0] & FE_MASK;
+		h.v[1] = ((w[0] >> 51) | (w[1] << 13)) & FE_MASK;
+		h.v[2] = ((w[1] >> 38) | (w[2] << 26)) & FE_MASK;
+		h.v[3] = ((w[2] >> 25) | (w[3] << 39)) & FE_MASK;
+		h.v[4] = (w[3] >> 12) & FE_MASK;
+	}
+
+	static void FEToBytes (uint8_t * s, const FieldElement& f) // fully reduced
+	{
+		FieldElement h = f;
+		FECarry (h); FECarry (h);
+		// h < 2^255 + small, subtract p if h >= p
+		uint64_t q = (h.v[0] + 19) >> 51;
+		q = (h.v[1] + q) >> 51;
+		q = (h.v[2] + q) >> 51;
+		q = (h.v[3] + q) >> 51;
+		q = (h.v[4] + q) >> 51;
+		h.v[0] += 19*q;
+		uint64_t c;
+		c = h.v[0] >> 51; h.v[0] &= FE_MASK; h.v[1] += c;
+		c = h.v[1] >> 51; h.v[1] &= FE_MASK; h.v[2] += c;
+		c = h.v[2] >> 51; h.v[2] &= FE_MASK; h.v[3] += c;
+		c = h.v[3] >> 51; h.v[3] &= FE_MASK; h.v[4] += c;
+		h.v[4] &= FE_MASK;
+		uint64_t w[4] =
+		{
+			h.v[0] | (h.v[1] << 51),
+			(h.v[1] >> 13) | (h.v[2] << 38),
+			(h.v[2] >> 26) | (h.v[3] << 25),
+			(h.v[3] >> 39) | (h.v[4] << 12)
+		};
+		for (int i = 0; i < 4; i++)
+			for (int j = 0; j < 8; j++)
+				s[8*i + j] = w[i] >> (8*j);
+	}
+
+	static bool FEIsZero (const FieldElement& f)
+	{
+		uint8_t s[32], r = 0;
+		FEToBytes (s, f);
+		for (int i = 0; i < 32; i++) r |= s[i];
+		return !r;
+	}
+
+	static bool FEIsNegative (const FieldElement& f)
+	{
+		uint8_t s[32];
+		FEToBytes (s, f);
+		return s[0] & 1;
+	}
+
+	static void FEPow22523 (FieldElement& h, const FieldElement& z) // z^(2^252-3)
+	{
+		FieldElement t0, t1, t2;
+		FESq (t0, z); // 2
+		FESqN (t1, t0, 2); // 8
+		FEMul (t1, z, t1); // 9
+		FEMul (t0, t0, t1); // 11
+		FESq (t0, t0); // 22
+		FEMul (t0, t1, t0); // 2^5-1
+		FESqN (t1, t0, 5);
+		FEMul (t0, t1, t0); // 2^10-1
+		FESqN (t1, t0, 10);
+		FEMul (t1, t1, t0); // 2^20-1
+		FESqN (t2, t1, 20);
+		FEMul (t1, t2, t1); // 2^40-1
+		FESqN (t1, t1, 10);
+		FEMul (t0, t1, t0); // 2^50-1
+		FESqN (t1, t0, 50);
+		FEMul (t1, t1, t0); // 2^100-1
+		FESqN (t2, t1, 100);
+		FEMul (t1, t2, t1); // 2^200-1
+		FESqN (t1, t1, 50);
+		FEMul (t0, t1, t0); // 2^250-1
+		FESqN (t0, t0, 2); // 2^252-4
+		FEMul (h, t0, z); // 2^252-3
+	}
+
+	// point in extended coordinates x = X/Z, y = Y/Z, x*y = T/Z
+	struct GroupElement
+	{
+		FieldElement X, Y, Z, T;
+	};
+
+	// prepared for addition
+	struct GroupElementCached
+	{
+		FieldElement YplusX, YminusX, Z, T2d;
+	};
+
+	static void BNFromLE (BIGNUM * bn, const uint8_t * buf, size_t len)
+	{
+		uint8_t buf1[64];
+		for (size_t i = 0; i < len; i++) buf1[i] = buf[len - 1 - i];
+		BN_bin2bn (buf1, len, bn);
+	}
+
+	static void BNToLE (const BIGNUM * bn, uint8_t * buf, size_t len)
+	{
+		bn2buf (bn, buf, len);
+		for (size_t i = 0; i < len/2; i++)
+		{
+			uint8_t tmp = buf[i];
+			buf[i] = buf[len - 1 - i];
+			buf[len - 1 - i] = tmp;
+		}
+	}
+
+	class Ed25519BatchContext
+	{
+		public:
+
+			Ed25519BatchContext ();
+			~Ed25519BatchContext ();
+
+			const BIGNUM * GetL () const { return l; };
+			const GroupElement& GetB () const { return B; };
+
+			bool DecodePoint (GroupElement& p, const uint8_t * s) const; // strict, rejects non-canonical encoding
+			void ToCached (GroupElementCached& c, const GroupElement& p) const;
+			void Add (GroupElement& r, const GroupElement& p, const GroupElementCached& q) const;
+			void Add (GroupElement& r, const GroupElement& p, const GroupElement& q) const;
+			void Double (GroupElement& r, const GroupElement& p) const;
+			void Negate (GroupElement& p) const;
+			void SetIdentity (GroupElement& p) const;
+			bool IsIdentity (const GroupElement& p) const;
+			bool IsTorsionFree (const GroupElement& p) const; // [l]p is identity, no small order component
+			bool IsTorsionFreeKey (const uint8_t * publicKey, const GroupElement& A) const; // cached
+			// r = sum(scalars[i]*points[i]), scalars are 32 bytes Little Endian less than 2^253
+			void MultiScalarMul (GroupElement& r, const std::vector<GroupElement>& points,
+				const std::vector<uint8_t>& scalars) const;
+
+		private:
+
+			FieldElement zero, one, d, d2, sqrtm1;
+			GroupElement B;
+			BIGNUM * l;
+			uint8_t lBytes[32]; // Little Endian
+			mutable std::mutex m_TorsionFreeKeysMutex;
+			mutable std::unordered_map<i2p::data::Tag<32>, bool> m_TorsionFreeKeys; // RouterInfo keys repeat
+	};
+
+	Ed25519BatchContext::Ed25519BatchContext ()
+	{
+		BN_CTX * ctx = BN_CTX_new ();
+		BIGNUM * q = BN_new (), * tmp = BN_new (), * bn = BN_new ();
+		BN_set_bit (q, 255); BN_sub_word (q, 19); // 2^255-19
+		l = BN_new ();
+		BN_set_bit (l, 252);
+		BN_dec2bn (&tmp, "27742317777372353535851937790883648493");
+		BN_add (l, l, tmp); // 2^252 + 27742317777372353535851937790883648493
+		BNToLE (l, lBytes, 32);
+		uint8_t buf[32];
+		memset (&zero, 0, sizeof (zero));
+		one = zero; one.v[0] = 1;
+		// d = -121665*inv(121666)
+		BN_set_word (tmp, 121666);
+		BN_mod_inverse (tmp, tmp, q, ctx);
+		BN_set_word (bn, 121665);
+		BN_sub (bn, q, bn);
+		BN_mod_mul (bn, bn, tmp, q, ctx);
+		BNToLE (bn, buf, 32); FEFromBytes (d, buf);
+		FEAdd (d2, d, d);
+		// sqrt(-1) = 2^((q-1)/4)
+		BN_copy (tmp, q); BN_sub_word (tmp, 1); BN_div_word (tmp, 4);
+		BN_set_word (bn, 2);
+		BN_mod_exp (bn, bn, tmp, q, ctx);
+		BNToLE (bn, buf, 32); FEFromBytes (sqrtm1, buf);
+		// base point y = 4*inv(5), x is positive
+		BN_set_word (bn, 5);
+		BN_mod_inverse (bn, bn, q, ctx);
+		BN_mul_word (bn, 4);
+		BN_mod (bn, bn, q, ctx);
+		BNToLE (bn, buf, 32);
+		DecodePoint (B, buf);
+		BN_free (q); BN_free (tmp); BN_free (bn);
+		BN_CTX_free (ctx);
+	}
+
+	Ed25519BatchContext::~Ed25519BatchContext ()
+	{
+		BN_free (l);
+	}
+
+	bool Ed25519BatchContext::DecodePoint (GroupElement& p, const uint8_t * s) const
+	{
+		FieldElement y, u, v, v3, x, vxx, check;
+		FEFromBytes (y, s);
+		uint8_t canonical[32];
+		FEToBytes (canonical, y);
+		canonical[31] |= s[31] & 0x80;
+		if (memcmp (canonical, s, 32)) return false; // y >= p
+		// x = u*v^3*(u*v^7)^((p-5)/8), u = y^2-1, v = d*y^2+1
+		FESq (u, y);
+		FEMul (v, u, d);
+		FESub (u, u, one);
+		FEAdd (v, v, one);
+		FESq (v3, v); FEMul (v3, v3, v);
+		FESq (x, v3); FEMul (x, x, v); FEMul (x, x, u);
+		FEPow22523 (x, x);
+		FEMul (x, x, v3); FEMul (x, x, u);
+		FESq (vxx, x); FEMul (vxx, vxx, v);
+		FESub (check, vxx, u);
+		if (!FEIsZero (check))
+		{
+			FEAdd (check, vxx, u);
+			if (!FEIsZero (check)) return false; // not on curve
+			FEMul (x, x, sqrtm1);
+		}
+		bool sign = s[31] & 0x80;
+		if (sign && FEIsZero (x)) return false;
+		if (FEIsNegative (x) != sign) FESub (x, zero, x);
+		p.X = x; p.Y = y; p.Z = one;
+		FEMul (p.T, x, y);
+		return true;
+	}
+
+	void Ed25519BatchContext::ToCached (GroupElementCached& c, const GroupElement& p) const
+	{
+		FEAdd (c.YplusX, p.Y, p.X);
+		FESub (c.YminusX, p.Y, p.X);
+		c.Z = p.Z;
+		FEMul (c.T2d, p.T, d2);
+	}
+
+	void Ed25519BatchContext::Add (GroupElement& r, const GroupElement& p, const GroupElementCached& q) const
+	{
+		// add-2008-hwcd-3, complete for a = -1
+		FieldElement a, b, c, zz, e, f, g, h;
+		FEAdd (a, p.Y, p.X); FEMul (a, a, q.YplusX);
+		FESub (b, p.Y, p.X); FEMul (b, b, q.YminusX);
+		FEMul (c, p.T, q.T2d);
+		FEMul (zz, p.Z, q.Z); FEAdd (zz, zz, zz);
+		FESub (e, a, b); FEAdd (h, a, b);
+		FEAdd (g, zz, c); FESub (f, zz, c);
+		FEMul (r.X, e, f); FEMul (r.Y, g, h);
+		FEMul (r.Z, g, f); FEMul (r.T, e, h);
+	}
+
+	void Ed25519BatchContext::Add (GroupElement& r, const GroupElement& p, const GroupElement& q) const
+	{
+		GroupElementCached c;
+		ToCached (c, q);
+		Add (r, p, c);
+	}
+
+	void Ed25519BatchContext::Double (GroupElement& r, const GroupElement& p) const
+	{
+		// dbl-2008-hwcd, all coordinates are negated that gives the same point
+		FieldElement a, b, c, e, f, g, h;
+		FESq (a, p.X); FESq (b, p.Y);
+		FESq (c, p.Z); FEAdd (c, c, c);
+		FEAdd (e, p.X, p.Y); FESq (e, e);
+		FEAdd (h, a, b); // -H
+		FESub (e, e, h); // E = 2*X*Y
+		FESub (g, b, a); // G
+		FESub (f, c, g); // -F
+		FEMul (r.X, e, f); FEMul (r.Y, h, g);
+		FEMul (r.Z, g, f); FEMul (r.T, e, h);
+	}
+
+	void Ed25519BatchContext::Negate (GroupElement& p) const
+	{
+		FESub (p.X, zero, p.X);
+		FESub (p.T, zero, p.T);
+	}
+
+	void Ed25519BatchContext::SetIdentity (GroupElement& p) const
+	{
+		p.X = zero; p.Y = one; p.Z = one; p.T = zero;
+	}
+
+	bool Ed25519BatchContext::IsIdentity (const GroupElement& p) const
+	{
+		FieldElement t;
+		FESub (t, p.Y, p.Z);
+		return FEIsZero (p.X) && FEIsZero (t);
+	}
+
+	bool Ed25519BatchContext::IsTorsionFree (const GroupElement& p) const
+	{
+		// [l]p by 4 bits fixed window
+		GroupElementCached table[15]; // [i+1]p
+		GroupElement q = p;
+		ToCached (table[0], p);
+		for (int i = 1; i < 15; i++)
+		{
+			Add (q, q, table[0]);
+			ToCached (table[i], q);
+		}
+		GroupElement r;
+		SetIdentity (r);
+		for (int i = 63; i >= 0; i--)
+		{
+			for (int j = 0; j < 4; j++) Double (r, r);
+			int digit = (lBytes[i >> 1] >> ((i & 1) << 2)) & 0x0F;
+			if (digit) Add (r, r, table[digit - 1]);
+		}
+		return IsIdentity (r);
+	}
+
+	bool Ed25519BatchContext::IsTorsionFreeKey (const uint8_t * publicKey, const GroupElement& A) const
+	{
+		i2p::data::Tag<32> key (publicKey);
+		{
+			std::lock_guard<std::mutex> l(m_TorsionFreeKeysMutex);
+			auto it = m_TorsionFreeKeys.find (key);
+			if (it != m_TorsionFreeKeys.end ()) return it->second;
+		}
+		bool isTorsionFree = IsTorsionFree (A);
+		std::lock_guard<std::mutex> l(m_TorsionFreeKeysMutex);
+		if (m_TorsionFreeKeys.size () >= ED25519_BATCH_KEYS_CACHE_SIZE)
+			m_TorsionFreeKeys.clear ();
+		m_TorsionFreeKeys.emplace (key, isTorsionFree);
+		return isTorsionFree;
+	}
+
+	static inline unsigned int GetScalarDigit (const uint8_t * scalar, int pos, int width)
+	{
+		int ind = pos >> 3;
+		uint32_t v = 0;
+		for (int i = 0; i < 3 && ind + i < 32; i++)
+			v |= (uint32_t)scalar[ind + i] << (8*i);
+		return (v >> (pos & 7)) & ((1 << width) - 1);
+	}
+
+	void Ed25519BatchContext::MultiScalarMul (GroupElement& r, const std::vector<GroupElement>& points,
+		const std::vector<uint8_t>& scalars) const
+	{
+		// Pippenger's bucket method
+		const int numBits = 253;
+		size_t n = points.size ();
+		int width = 1; size_t minCost = 0;
+		for (int c = 1; c <= 12; c++)
+		{
+			size_t cost = ((numBits + c - 1)/c)*(n + (2ULL << c));
+			if (!minCost || cost < minCost) { minCost = cost; width = c; }
+		}
+		std::vector<GroupElementCached> cached (n);
+		for (size_t i = 0; i < n; i++) ToCached (cached[i], points[i]);
+		size_t numBuckets = (1 << width) - 1;
+		std::vector<GroupElement> buckets (numBuckets);
+		std::vector<bool> isEmpty (numBuckets);
+		SetIdentity (r);
+		bool isFirst = true;
+		for (int w = (numBits + width - 1)/width - 1; w >= 0; w--)
+		{
+			if (!isFirst)
+				for (int i = 0; i < width; i++) Double (r, r);
+			std::fill (isEmpty.begin (), isEmpty.end (), true);
+			for (size_t i = 0; i < n; i++)
+			{
+				auto digit = GetScalarDigit (scalars.data () + 32*i, w*width, width);
+				if (!digit) continue;
+				if (isEmpty[digit - 1])
+				{
+					buckets[digit - 1] = points[i];
+					isEmpty[digit - 1] = false;
+				}
+				else
+					Add (buckets[digit - 1], buckets[digit - 1], cached[i]);
+			}
+			// sum(j*buckets[j-1]) as running sums
+			GroupElement sum, acc;
+			bool isSumEmpty = true, isAccEmpty = true;
+			for (size_t j = numBuckets; j > 0; j--)
+			{
+				if (!isEmpty[j - 1])
+				{
+					if (isSumEmpty) { sum = buckets[j - 1]; isSumEmpty = false; }
+					else Add (sum, sum, buckets[j - 1]);
+				}
+				if (!isSumEmpty)
+				{
+					if (isAccEmpty) { acc = sum; isAccEmpty = false; }
+					else Add (acc, acc, sum);
+				}
+			}
+			if (!isAccEmpty)
+			{
+				if (isFirst) r = acc;
+				else Add (r, r, acc);
+				isFirst = false;
+			}
+		}
+	}
+
+	static const Ed25519BatchContext& GetEd25519BatchContext ()
+	{
+		static Ed25519BatchContext ctx;
+		return ctx;
+	}
+
+	struct Ed25519BatchItem
+	{
+		size_t index;
+		GroupElement R, A; // negated
+		uint8_t s[32], h[32]; // Little Endian, less than l
+	};
+
+	static bool VerifyBatch (const Ed25519BatchContext& ctx, const Ed25519BatchItem * items, size_t n, BN_CTX * bnCtx)
+	{
+		// [8]([sum(z*s)]B + sum([z](-R)) + sum([z*h](-A))) must be identity for random 128 bits z
+		std::vector<GroupElement> points;
+		points.reserve (2*n + 1);
+		std::vector<uint8_t> scalars ((2*n + 1)*32, 0);
+		std::vector<uint8_t> z (16*n);
+		RAND_bytes (z.data (), z.size ());
+		BN_CTX_start (bnCtx);
+		BIGNUM * b = BN_CTX_get (bnCtx), * zi = BN_CTX_get (bnCtx), * t = BN_CTX_get (bnCtx);
+		BN_zero (b);
+		points.push_back (ctx.GetB ());
+		for (size_t i = 0; i < n; i++)
+		{
+			BNFromLE (zi, z.data () + 16*i, 16);
+			BNFromLE (t, items[i].s, 32);
+			BN_mul (t, t, zi, bnCtx);
+			BN_add (b, b, t);
+			points.push_back (items[i].R);
+			memcpy (scalars.data () + 32*points.size () - 32, z.data () + 16*i, 16);
+			BNFromLE (t, items[i].h, 32);
+			BN_mod_mul (t, t, zi, ctx.GetL (), bnCtx);
+			points.push_back (items[i].A);
+			BNToLE (t, scalars.data () + 32*points.size () - 32, 32);
+		}
+		BN_mod (b, b, ctx.GetL (), bnCtx);
+		BNToLE (b, scalars.data (), 32);
+		BN_CTX_end (bnCtx);
+		GroupElement r;
+		ctx.MultiScalarMul (r, points, scalars);
+		// cofactored, small order components of R don't depend on z
+		for (int i = 0; i < 3; i++) ctx.Double (r, r);
+		return ctx.IsIdentity (r);
+	}
+#endif
+
+	size_t Ed25519BatchVerifier::Add (const uint8_t * publicKey, const uint8_t * buf, size_t len, const uint8_t * signature)
+	{
+		Item item;
+		memcpy (item.publicKey, publicKey, EDDSA25519_PUBLIC_KEY_LENGTH);
+		memcpy (item.signature, signature, EDDSA25519_SIGNATURE_LENGTH);
+		item.buf = buf;
+		item.len = len;
+		m_Items.push_back (item);
+		return m_Items.size () - 1;
+	}
+
+	bool Ed25519BatchVerifier::VerifyItem (const Item& item) const
+	{
+		EDDSA25519Verifier verifier;
+		verifier.SetPublicKey (item.publicKey);
+		return verifier.Verify (item.buf, item.len, item.signature);
+	}
+
+	void Ed25519BatchVerifier::Verify (std::vector<bool>& results) const
+	{
+		results.assign (m_Items.size (), false);
+#if defined(__SIZEOF_INT128__)
+		if (m_Items.size () >= ED25519_BATCH_MIN_SIZE)
+		{
+			auto& ctx = GetEd25519BatchContext ();
+			BN_CTX * bnCtx = BN_CTX_new ();
+			BIGNUM * bn = BN_new ();
+			std::vector<Ed25519BatchItem> items;
+			items.reserve (m_Items.size ());
+			EVP_MD_CTX * mdCtx = EVP_MD_CTX_create ();
+			for (size_t i = 0; i < m_Items.size (); i++)
+			{
+				const auto& it = m_Items[i];
+				Ed25519BatchItem item;
+				item.index = i;
+				BNFromLE (bn, it.signature + 32, 32);
+				if (BN_cmp (bn, ctx.GetL ()) >= 0 || !ctx.DecodePoint (item.R, it.signature) ||
+					!ctx.DecodePoint (item.A, it.publicKey) || !ctx.IsTorsionFreeKey (it.publicKey, item.A))
+				{
+					// can't be verified in batch, let OpenSSL decide
+					// cofactored equation is weaker than individual for A with small order component
+					results[i] = VerifyItem (it);
+					continue;
+				}
+				memcpy (item.s, it.signature + 32, 32);
+				ctx.Negate (item.R); ctx.Negate (item.A);
+				// h = SHA512(R || A || M) mod l
+				uint8_t digest[64];
+				unsigned int dl = 64;
+				EVP_DigestInit_ex (mdCtx, EVP_sha512(), NULL);
+				EVP_DigestUpdate (mdCtx, it.signature, 32);
+				EVP_DigestUpdate (mdCtx, it.publicKey, EDDSA25519_PUBLIC_KEY_LENGTH);
+				EVP_DigestUpdate (mdCtx, it.buf, it.len);
+				EVP_DigestFinal_ex (mdCtx, digest, &dl);
+				BNFromLE (bn, digest, 64);
+				BN_mod (bn, bn, ctx.GetL (), bnCtx);
+				BNToLE (bn, item.h, 32);
+				items.push_back (item);
+			}
+			EVP_MD_CTX_destroy (mdCtx);
+			BN_free (bn);
+			// verify by chunks, split failed chunk in halves until bad signatures are found
+			std::vector<std::pair<size_t, size_t> > ranges; // offset, size
+			for (size_t offset = 0; offset < items.size (); offset += ED25519_BATCH_MAX_SIZE)
+				ranges.emplace_back (offset, std::min (ED25519_BATCH_MAX_SIZE, items.size () - offset));
+			while (!ranges.empty ())
+			{
+				auto range = ranges.back (); ranges.pop_back ();
+				if (range.second < ED25519_BATCH_MIN_SIZE)
+				{
+					for (size_t i = range.first; i < range.first + range.second; i++)
+						results[items[i].index] = VerifyItem (m_Items[items[i].index]);
+				}
+				else if (VerifyBatch (ctx, items.data () + range.first, range.second, bnCtx))
+				{
+					for (size_t i = range.first; i < range.first + range.second; i++)
+						results[items[i].index] = true;
+				}
+				else
+				{
+					size_t half = range.second/2;
+					ranges.emplace_back (range.first, half);
+					ranges.emplace_back (range.first + half, range.second - half);
+				}
+			}
+			BN_CTX_free (bnCtx);
+			return;
+		}
+#endif
+		for (size_t i = 0; i < m_Items.size (); i++)
+			results[i] = VerifyItem (m_Items[i]);
+	}
+}
+}
@@ -0,0 +1,58 @@
+/*
+* Copyright (c) 2013-2025, The PurpleI2P Project
+*
+* This file is part of Purple i2pd project and licensed under BSD3
+*
+* See full license text in LICENSE file at top of project tree
+*/
+
+#ifndef ED25519_BATCH_H__
+#define ED25519_BATCH_H__
+
+#include <inttypes.h>
+#include <vector>
+#include "Ed25519.h"
+
+namespace i2p
+{
+namespace crypto
+{
+	const size_t ED25519_BATCH_MIN_SIZE = 4; // smaller batches are verified one by one
+	const size_t ED25519_BATCH_MAX_SIZE = 256; // signatures per multi-scalar multiplication
+	const size_t ED25519_BATCH_KEYS_CACHE_SIZE = 8192; // public keys with known small order check result
+
+	// verifies many Ed25519 signatures at once as single randomized linear combination
+	// [8]([sum(z*s)]B - sum([z]R) - sum([z*h]A)) = 0 computed by one multi-scalar multiplication
+	// if batch fails it's split to find bad signatures, small parts are verified individually
+	// A with small order component is verified individually, the check is cached per key.
+	// Equation is cofactored, so R with small order component made by key owner might pass in batch
+	class Ed25519BatchVerifier
+	{
+		public:
+
+			// buf must stay valid until Verify, returns index of the signature in results
+			size_t Add (const uint8_t * publicKey, const uint8_t * buf, size_t len, const uint8_t * signature);
+			size_t GetSize () const { return m_Items.size (); };
+			void Verify (std::vector<bool>& results) const; // results[i] is true if i-th signature is valid
+			void Clear () { m_Items.clear (); };
+
+		private:
+
+			struct Item
+			{
+				uint8_t publicKey[EDDSA25519_PUBLIC_KEY_LENGTH];
+				uint8_t signature[EDDSA25519_SIGNATURE_LENGTH];
+				const uint8_t * buf;
+				size_t len;
+			};
+
+			bool VerifyItem (const Item& item) const;
+
+		private:
+
+			std::vector<Item> m_Items;
+	};
+}
+}
+
+#endif
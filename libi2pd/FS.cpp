@@ -279,6 +279,15 @@ namespace fs {
 		return fs_lib::remove(path);
 	}
 
+	bool Rename(const std::string & from, const std::string & to) {
+		try {
+			fs_lib::rename(from, to);
+		} catch (std::exception& ex) {
+			return false;
+		}
+		return true;
+	}
+
 	bool CreateDirectory (const std::string& path)
 	{
 		if (fs_lib::exists(path) && fs_lib::is_directory (fs_lib::status (path)))
@@ -346,6 +355,20 @@ namespace fs {
 		});
 	}
 
+	void HashedStorage::Traverse(char hashedDir, std::vector<std::string> & files) {
+		fs_lib::path p(root + i2p::fs::dirSep + prefix1 + hashedDir);
+		if (!fs_lib::is_directory(p))
+			return;
+		fs_lib::directory_iterator it(p);
+		fs_lib::directory_iterator end;
+
+		for ( ; it != end; it++) {
+			if (!fs_lib::is_regular_file( it->status() ))
+				continue;
+			files.push_back(it->path().string());
+		}
+	}
+
 	void HashedStorage::Iterate(FilenameVisitor v)
 	{
 		fs_lib::path p(root);
@@ -73,6 +73,8 @@ namespace fs {
 			void Remove(const std::string & ident);
 			/** find all files in storage and store list in provided vector */
 			void Traverse(std::vector<std::string> & files);
+			/** find all files in one hashed subdirectory and store list in provided vector */
+			void Traverse(char hashedDir, std::vector<std::string> & files);
 			/** visit every file in this storage with a visitor */
 			void Iterate(FilenameVisitor v);
 	};
@@ -138,6 +140,14 @@ namespace fs {
 	 */
 	bool Remove(const std::string & path);
 
+	/**
+	 * @brief Rename file replacing existing one
+	 * @param from Absolute path to file
+	 * @param to New absolute path
+	 * @return true on success, false otherwise
+	 */
+	bool Rename(const std::string & from, const std::string & to);
+
 	/**
 	 * @brief Check existence of file
 	 * @param path Absolute path to file
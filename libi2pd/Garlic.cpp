@@ -425,6 +425,194 @@ namespace garlic
 		return ret;
 	}
 
+	ECIESX25519TagsTable::ECIESX25519TagsTable ():
+		m_Shift (64), m_NumEntries (0), m_NumTags (0), m_NextTagsetID (1), m_LastTagsetID (0), m_LastTagset (nullptr)
+	{
+	}
+
+	void ECIESX25519TagsTable::Insert (uint64_t tag, int index, ReceiveRatchetTagSetPtr tagset)
+	{
+		if (!tagset) return;
+		if ((m_NumEntries + 1)*4 > m_Entries.size ()*3) // load factor 0.75
+			Rehash (m_NumTags + 1);
+		uint32_t tagsetID = RegisterTagset (tagset);
+		size_t mask = m_Entries.size () - 1;
+		for (size_t i = GetSlot (tag);; i = (i + 1) & mask)
+		{
+			auto& entry = m_Entries[i];
+			if (!entry.tagsetID)
+			{
+				entry = Entry{ tag, tagsetID, index };
+				m_NumEntries++;
+				break;
+			}
+			if (entry.tag == tag)
+			{
+				if (IsRegistered (entry.tagsetID)) return; // already exists
+				entry.tagsetID = tagsetID; entry.index = index; // replace stale
+				break;
+			}
+		}
+		m_Tagsets[tagsetID].numTags++;
+		m_NumTags++;
+	}
+
+	bool ECIESX25519TagsTable::Extract (uint64_t tag, ECIESX25519AEADRatchetIndexTagset& indexTagset)
+	{
+		if (!m_NumEntries) return false;
+		size_t mask = m_Entries.size () - 1;
+		for (size_t i = GetSlot (tag); m_Entries[i].tagsetID; i = (i + 1) & mask)
+		{
+			if (m_Entries[i].tag == tag)
+			{
+				auto it = m_Tagsets.find (m_Entries[i].tagsetID);
+				bool found = it != m_Tagsets.end ();
+				if (found)
+				{
+					indexTagset.index = m_Entries[i].index;
+					indexTagset.tagset = it->second.tagset;
+					it->second.numTags--;
+					m_NumTags--;
+				}
+				Remove (i);
+				return found;
+			}
+		}
+		return false;
+	}
+
+	size_t ECIESX25519TagsTable::CleanupExpired (uint64_t ts)
+	{
+		size_t numExpiredTags = 0;
+		for (auto it = m_Tagsets.begin (); it != m_Tagsets.end ();)
+		{
+			auto& tagset = it->second.tagset;
+			if (!it->second.numTags || tagset->IsExpired (ts) || tagset->IsSessionTerminated ())
+			{
+				// all tags of this tagset become stale
+				numExpiredTags += it->second.numTags;
+				m_NumTags -= it->second.numTags;
+				if (m_LastTagset == tagset.get ()) m_LastTagset = nullptr;
+				m_TagsetIDs.erase (tagset.get ());
+				it = m_Tagsets.erase (it);
+			}
+			else
+				++it;
+		}
+		numExpiredTags += Purge ();
+		if (m_Entries.size () > ECIESX25519_TAGS_TABLE_MIN_CAPACITY && m_NumTags*8 < m_Entries.size ())
+			Rehash (m_NumTags); // shrink
+		return numExpiredTags;
+	}
+
+	void ECIESX25519TagsTable::Clear ()
+	{
+		m_Entries.clear ();
+		m_Shift = 64;
+		m_NumEntries = 0; m_NumTags = 0;
+		m_Tagsets.clear ();
+		m_TagsetIDs.clear ();
+		m_LastTagset = nullptr;
+	}
+
+	uint32_t ECIESX25519TagsTable::RegisterTagset (ReceiveRatchetTagSetPtr tagset)
+	{
+		if (tagset.get () == m_LastTagset) return m_LastTagsetID;
+		auto it = m_TagsetIDs.find (tagset.get ());
+		if (it == m_TagsetIDs.end ())
+		{
+			// new ID, must never match stale slots
+			uint32_t tagsetID = m_NextTagsetID++;
+			if (!m_NextTagsetID) m_NextTagsetID = 1; // 0 means empty slot
+			m_Tagsets.emplace (tagsetID, RegisteredTagset{ tagset, 0 });
+			it = m_TagsetIDs.emplace (tagset.get (), tagsetID).first;
+		}
+		m_LastTagset = tagset.get ();
+		return m_LastTagsetID = it->second;
+	}
+
+	void ECIESX25519TagsTable::Place (const Entry& entry)
+	{
+		size_t mask = m_Entries.size () - 1;
+		size_t i = GetSlot (entry.tag);
+		while (m_Entries[i].tagsetID) i = (i + 1) & mask;
+		m_Entries[i] = entry;
+		m_NumEntries++;
+	}
+
+	void ECIESX25519TagsTable::Remove (size_t slot)
+	{
+		// backward shift, no tombstones
+		size_t mask = m_Entries.size () - 1;
+		for (size_t i = (slot + 1) & mask; m_Entries[i].tagsetID; i = (i + 1) & mask)
+		{
+			size_t home = GetSlot (m_Entries[i].tag);
+			if (((i - home) & mask) >= ((i - slot) & mask)) // slot is between home and i
+			{
+				m_Entries[slot] = m_Entries[i];
+				slot = i;
+			}
+		}
+		m_Entries[slot].tagsetID = 0;
+		m_NumEntries--;
+	}
+
+	size_t ECIESX25519TagsTable::Purge ()
+	{
+		if (!m_NumEntries) return 0;
+		size_t numExpiredTags = 0, mask = m_Entries.size () - 1, start = 0;
+		while (m_Entries[start].tagsetID) start++; // entries are never shifted over empty slot
+		for (size_t i = (start + 1) & mask, n = 0; n < mask;)
+		{
+			const auto& entry = m_Entries[i];
+			if (entry.tagsetID)
+			{
+				auto it = m_Tagsets.find (entry.tagsetID);
+				bool isStale = it == m_Tagsets.end ();
+				if (isStale || it->second.tagset->IsIndexExpired (entry.index))
+				{
+					if (!isStale)
+					{
+						it->second.tagset->DeleteSymmKey (entry.index);
+						it->second.numTags--;
+						m_NumTags--;
+						numExpiredTags++;
+					}
+					Remove (i);
+					continue; // next entry might be shifted to this slot
+				}
+			}
+			i = (i + 1) & mask; n++;
+		}
+		return numExpiredTags;
+	}
+
+	void ECIESX25519TagsTable::Rehash (size_t numTags)
+	{
+		size_t capacity = ECIESX25519_TAGS_TABLE_MIN_CAPACITY;
+		while (capacity*3 < numTags*8) capacity <<= 1; // load factor 0.375 after rehash
+		int shift = 64;
+		for (size_t c = capacity; c > 1; c >>= 1) shift--;
+		std::vector<Entry> entries (capacity, Entry{ 0, 0, 0 });
+		m_Entries.swap (entries);
+		m_Shift = shift;
+		m_NumEntries = 0;
+		for (const auto& it: entries)
+		{
+			if (!it.tagsetID) continue;
+			auto tagset = m_Tagsets.find (it.tagsetID);
+			if (tagset == m_Tagsets.end ()) continue; // stale
+			if (tagset->second.tagset->IsIndexExpired (it.index))
+			{
+				tagset->second.tagset->DeleteSymmKey (it.index);
+				tagset->second.numTags--;
+				m_NumTags--;
+				continue;
+			}
+			Place (it);
+		}
+	}
+
 	GarlicDestination::GarlicDestination (): m_NumTags (32), // 32 tags by default
 		m_PayloadBuffer (nullptr), m_LastIncomingSessionTimestamp (0), 
 		m_NumRatchetInboundTags (0) // 0 means standard
@@ -450,7 +638,7 @@ namespace garlic
 			it.second->SetOwner (nullptr);
 		}
 		m_ECIESx25519Sessions.clear ();
-		m_ECIESx25519Tags.clear ();
+		m_ECIESx25519Tags.Clear ();
 	}
 	void GarlicDestination::AddSessionKey (const uint8_t * key, const uint8_t * tag)
 	{
@@ -471,7 +659,7 @@ namespace garlic
 	void GarlicDestination::AddECIESx25519Key (const uint8_t * key, uint64_t tag)
 	{
 		auto tagset = std::make_shared<SymmetricKeyTagSet>(this, key);
-		m_ECIESx25519Tags.emplace (tag, ECIESX25519AEADRatchetIndexTagset{0, tagset});
+		m_ECIESx25519Tags.Insert (tag, 0, tagset);
 	}
 
 	bool GarlicDestination::SubmitSessionKey (const uint8_t * key, const uint8_t * tag)
@@ -561,12 +749,11 @@ namespace garlic
 	{
 		uint64_t tag;
 		memcpy (&tag, buf, 8);
-		auto it = m_ECIESx25519Tags.find (tag);
-		if (it != m_ECIESx25519Tags.end ())
+		ECIESX25519AEADRatchetIndexTagset indexTagset;
+		if (m_ECIESx25519Tags.Extract (tag, indexTagset))
 		{
-			if (!it->second.tagset || !it->second.tagset->HandleNextMessage (buf, len, it->second.index))
+			if (!indexTagset.tagset || !indexTagset.tagset->HandleNextMessage (buf, len, indexTagset.index))
 				LogPrint (eLogError, "Garlic: Can't handle ECIES-X25519-AEAD-Ratchet message");
-			m_ECIESx25519Tags.erase (it);
 			return true;
 		}
 		return false;
@@ -856,26 +1043,7 @@ namespace garlic
 				++it;
 		}
 
-		numExpiredTags = 0;
-		for (auto it = m_ECIESx25519Tags.begin (); it != m_ECIESx25519Tags.end ();)
-		{
-			if (it->second.tagset->IsExpired (ts) || it->second.tagset->IsIndexExpired (it->second.index))
-			{
-				it->second.tagset->DeleteSymmKey (it->second.index);
-				it = m_ECIESx25519Tags.erase (it);
-				numExpiredTags++;
-			}
-			else
-			{
-				if (it->second.tagset->IsSessionTerminated ())
-				{
-					it = m_ECIESx25519Tags.erase (it);
-					numExpiredTags++;
-				}
-				else
-					++it;
-			}
-		}
+		numExpiredTags = m_ECIESx25519Tags.CleanupExpired (ts);
 		if (numExpiredTags > 0)
 			LogPrint (eLogDebug, "Garlic: ", numExpiredTags, " ECIESx25519 tags expired for ", GetIdentHash().ToBase64 ());
 	}
@@ -1069,7 +1237,7 @@ namespace garlic
 		auto index = tagset->GetNextIndex ();
 		uint64_t tag = tagset->GetNextSessionTag ();
 		if (tag)
-			m_ECIESx25519Tags.emplace (tag, ECIESX25519AEADRatchetIndexTagset{index, tagset});
+			m_ECIESx25519Tags.Insert (tag, index, tagset);
 		return tag;
 	}
 
@@ -11,6 +11,7 @@
 
 #include <inttypes.h>
 #include <unordered_map>
+#include <vector>
 #include <list>
 #include <string>
 #include <thread>
@@ -53,6 +54,7 @@ namespace garlic
 	const int LEASESET_CONFIRMATION_TIMEOUT = 4000; // in milliseconds
 	const int ROUTING_PATH_EXPIRATION_TIMEOUT = 120; // in seconds
 	const int INCOMING_SESSIONS_MINIMAL_INTERVAL = 200; // in milliseconds
+	const size_t ECIESX25519_TAGS_TABLE_MIN_CAPACITY = 64; // power of 2
 
 	struct SessionTag: public i2p::data::Tag<32>
 	{
@@ -234,6 +236,61 @@ namespace garlic
 		ReceiveRatchetTagSetPtr tagset; // null if used
 	};
 
+	/**
+	 * Incoming ECIESx25519 session tags, open addressing with linear probing.
+	 * Slot keeps tag, index and tagset ID only, tagsets are registered once with their number of tags.
+	 * Expired tagset is dropped from registry and its tags become stale at once,
+	 * stale slots are reclaimed on lookup, insert of the same tag, rehash or cleanup
+	 */
+	class ECIESX25519TagsTable
+	{
+		struct Entry
+		{
+			uint64_t tag;
+			uint32_t tagsetID; // 0 if slot is empty
+			int index;
+		};
+
+		struct RegisteredTagset
+		{
+			ReceiveRatchetTagSetPtr tagset;
+			size_t numTags;
+		};
+
+		public:
+
+			ECIESX25519TagsTable ();
+
+			void Insert (uint64_t tag, int index, ReceiveRatchetTagSetPtr tagset); // existing tag is not replaced
+			bool Extract (uint64_t tag, ECIESX25519AEADRatchetIndexTagset& indexTagset); // find and remove
+			size_t CleanupExpired (uint64_t ts); // returns number of expired tags
+			void Clear ();
+
+			size_t GetNumTags () const { return m_NumTags; };
+			size_t GetCapacity () const { return m_Entries.size (); };
+			size_t GetNumTagsets () const { return m_Tagsets.size (); };
+
+		private:
+
+			size_t GetSlot (uint64_t tag) const { return (tag*0x9E3779B97F4A7C15ULL) >> m_Shift; }; // Fibonacci hashing
+			bool IsRegistered (uint32_t tagsetID) const { return m_Tagsets.count (tagsetID); };
+			uint32_t RegisterTagset (ReceiveRatchetTagSetPtr tagset);
+			void Place (const Entry& entry); // to empty slot
+			void Remove (size_t slot);
+			size_t Purge (); // stale and expired by index, returns number of expired tags
+			void Rehash (size_t numTags);
+
+		private:
+
+			std::vector<Entry> m_Entries; // power of 2 slots
+			int m_Shift; // 64 - log2 (number of slots)
+			size_t m_NumEntries, m_NumTags; // occupied slots including stale, tags of registered tagsets
+			std::unordered_map<uint32_t, RegisteredTagset> m_Tagsets; // tagset ID -> tagset
+			std::unordered_map<const ReceiveRatchetTagSet *, uint32_t> m_TagsetIDs;
+			uint32_t m_NextTagsetID, m_LastTagsetID;
+			const ReceiveRatchetTagSet * m_LastTagset; // last inserted
+	};
+
 	class GarlicDestination: public i2p::data::LocalDestination
 	{
 		public:
@@ -312,7 +369,7 @@ namespace garlic
 			// incoming
 			int m_NumRatchetInboundTags;
 			std::unordered_map<SessionTag, std::shared_ptr<AESDecryption>, std::hash<i2p::data::Tag<32> > > m_Tags;
-			std::unordered_map<uint64_t, ECIESX25519AEADRatchetIndexTagset> m_ECIESx25519Tags; // session tag -> session
+			ECIESX25519TagsTable m_ECIESx25519Tags; // session tag -> session
 			// DeliveryStatus
 			std::mutex m_DeliveryStatusSessionsMutex;
 			std::unordered_map<uint32_t, GarlicRoutingSessionPtr> m_DeliveryStatusSessions; // msgID -> session
@@ -324,7 +381,7 @@ namespace garlic
 
 			// for HTTP only
 			size_t GetNumIncomingTags () const { return m_Tags.size (); }
-			size_t GetNumIncomingECIESx25519Tags () const { return m_ECIESx25519Tags.size (); }
+			size_t GetNumIncomingECIESx25519Tags () const { return m_ECIESx25519Tags.GetNumTags (); }
 			const decltype(m_Sessions)& GetSessions () const { return m_Sessions; };
 			const decltype(m_ECIESx25519Sessions)& GetECIESx25519Sessions () const { return m_ECIESx25519Sessions; }
 	};
@@ -23,17 +23,17 @@ namespace i2p
 {
 	std::shared_ptr<I2NPMessage> NewI2NPMessage ()
 	{
-		return std::make_shared<I2NPMessageBuffer<I2NP_MAX_MESSAGE_SIZE> >();
+		return NewI2NPMessageBuffer<I2NP_MAX_MESSAGE_SIZE> ();
 	}
 
 	std::shared_ptr<I2NPMessage> NewI2NPShortMessage ()
 	{
-		return std::make_shared<I2NPMessageBuffer<I2NP_MAX_SHORT_MESSAGE_SIZE> >();
+		return NewI2NPMessageBuffer<I2NP_MAX_SHORT_MESSAGE_SIZE> ();
 	}
 
 	std::shared_ptr<I2NPMessage> NewI2NPMediumMessage ()
 	{
-		return std::make_shared<I2NPMessageBuffer<I2NP_MAX_MEDIUM_MESSAGE_SIZE> >();
+		return NewI2NPMessageBuffer<I2NP_MAX_MEDIUM_MESSAGE_SIZE> ();
 	}
 
 	std::shared_ptr<I2NPMessage> NewI2NPTunnelMessage (bool endpoint)
@@ -514,7 +514,12 @@ namespace i2p
 				}
 				case eI2NPTunnelTest:
 					if (msg->from && msg->from->GetTunnelPool ())
-						msg->from->GetTunnelPool ()->ProcessTunnelTest (msg);
+					{
+						if (i2p::tunnel::tunnels.IsDataThread ())
+							i2p::tunnel::tunnels.PostTunnelData (msg); // process in tunnels thread
+						else
+							msg->from->GetTunnelPool ()->ProcessTunnelTest (msg);
+					}
 				break;
 				case eI2NPVariableTunnelBuild:
 				case eI2NPTunnelBuild:
@@ -17,6 +17,7 @@
 #include <functional>
 #include "Crypto.h"
 #include "I2PEndian.h"
+#include "util.h"
 #include "Identity.h"
 #include "RouterInfo.h"
 #include "LeaseSet.h"
@@ -282,6 +283,12 @@ namespace tunnel
 		uint8_t m_Buffer[sz + 32]; // 16 alignment + 16 padding
 	};
 
+	template<int sz>
+	std::shared_ptr<I2NPMessageBuffer<sz> > NewI2NPMessageBuffer () // from slab of its size
+	{
+		return std::allocate_shared<I2NPMessageBuffer<sz> >(i2p::util::SlabAllocator<I2NPMessageBuffer<sz> >());
+	}
+
 	std::shared_ptr<I2NPMessage> NewI2NPMessage ();
 	std::shared_ptr<I2NPMessage> NewI2NPShortMessage ();
 	std::shared_ptr<I2NPMessage> NewI2NPMediumMessage ();
@@ -1,11 +1,12 @@
 /*
-* Copyright (c) 2013-2022, The PurpleI2P Project
+* Copyright (c) 2013-2026, The PurpleI2P Project
 *
 * This file is part of Purple i2pd project and licensed under BSD3
 *
 * See full license text in LICENSE file at top of project tree
 */
 
+#include <stdio.h>
 #include "Log.h"
 #include "util.h"
 
@@ -66,10 +67,176 @@ namespace log {
 	}
 #endif
 
+	struct LogRecordHeader
+	{
+		uint32_t size; // including header, aligned to 8, 0 means rest of buffer is skipped
+		uint16_t length; // of arguments
+		uint8_t level;
+		uint64_t seqn;
+		int64_t timestamp;
+	};
+
+	/**
+	 * @brief Ring of binary records, written by one thread, read by log thread only
+	 */
+	class LogThreadBuffer
+	{
+		public:
+
+			LogThreadBuffer (): m_Buffer (new uint8_t[LOG_THREAD_BUFFER_SIZE]),
+				m_Head (0), m_Tail (0), m_Reserved (0), m_IsReserved (false), m_IsFinished (false),
+				m_Tid (std::this_thread::get_id ()) {};
+			~LogThreadBuffer () { delete[] m_Buffer; };
+
+			std::thread::id GetTid () const { return m_Tid; };
+			bool IsFinished () const { return m_IsFinished; };
+			void SetFinished () { m_IsFinished = true; };
+			bool IsEmpty () const { return m_Head.load (std::memory_order_acquire) == m_Tail.load (std::memory_order_acquire); };
+
+			// writer
+			uint8_t * Reserve (size_t len)
+			{
+				if (m_IsReserved) return nullptr; // LogPrint called while arguments are being written
+				auto tail = m_Tail.load (std::memory_order_relaxed);
+				auto offset = tail & (LOG_THREAD_BUFFER_SIZE - 1);
+				auto contiguous = LOG_THREAD_BUFFER_SIZE - offset;
+				size_t skip = contiguous < len ? contiguous : 0;
+				if (tail + skip + len - m_Head.load (std::memory_order_acquire) > LOG_THREAD_BUFFER_SIZE)
+					return nullptr; // full
+				if (skip)
+				{
+					// not visible to reader until tail moves
+					reinterpret_cast<LogRecordHeader *>(m_Buffer + offset)->size = 0;
+					offset = 0;
+				}
+				m_Reserved = tail + skip;
+				m_IsReserved = true;
+				return m_Buffer + offset;
+			}
+
+			void Commit (size_t len)
+			{
+				m_IsReserved = false;
+				m_Tail.store (m_Reserved + len, std::memory_order_release);
+			}
+
+			void Cancel () { m_IsReserved = false; };
+
+			// reader
+			template<typename Handler>
+			void Read (Handler handler)
+			{
+				auto head = m_Head.load (std::memory_order_relaxed);
+				auto tail = m_Tail.load (std::memory_order_acquire);
+				while (head < tail)
+				{
+					auto offset = head & (LOG_THREAD_BUFFER_SIZE - 1);
+					auto header = reinterpret_cast<const LogRecordHeader *>(m_Buffer + offset);
+					if (!header->size)
+						head += LOG_THREAD_BUFFER_SIZE - offset;
+					else
+					{
+						handler (*header, m_Buffer + offset + sizeof (LogRecordHeader));
+						head += header->size;
+					}
+				}
+				m_Head.store (head, std::memory_order_release);
+			}
+
+		private:
+
+			uint8_t * m_Buffer;
+			alignas(64) std::atomic<size_t> m_Head; // total bytes read
+			alignas(64) std::atomic<size_t> m_Tail; // total bytes written
+			size_t m_Reserved; // position of reserved record
+			bool m_IsReserved;
+			std::atomic<bool> m_IsFinished; // thread has exited
+			std::thread::id m_Tid;
+	};
+
+	struct LogThreadBufferHolder
+	{
+		std::shared_ptr<LogThreadBuffer> buffer;
+		bool isDisabled = false; // thread is exiting
+
+		~LogThreadBufferHolder ()
+		{
+			isDisabled = true;
+			if (buffer) buffer->SetFinished ();
+		}
+	};
+	static thread_local LogThreadBufferHolder g_ThreadBuffer;
+
+	static void DecodeRecord (std::stringstream& s, const uint8_t * buf, size_t len)
+	{
+		size_t offset = 0;
+		while (offset < len)
+		{
+			auto type = buf[offset]; offset++;
+			switch (type)
+			{
+				case eLogArgInt:
+				{
+					int64_t v; memcpy (&v, buf + offset, 8); offset += 8;
+					s << v;
+					break;
+				}
+				case eLogArgUInt:
+				{
+					uint64_t v; memcpy (&v, buf + offset, 8); offset += 8;
+					s << v;
+					break;
+				}
+				case eLogArgDouble:
+				{
+					double v; memcpy (&v, buf + offset, 8); offset += 8;
+					s << v;
+					break;
+				}
+				case eLogArgChar:
+					s << (char)buf[offset]; offset++;
+				break;
+				case eLogArgString:
+				{
+					uint32_t l; memcpy (&l, buf + offset, 4); offset += 4;
+					s.write ((const char *)buf + offset, l); offset += l;
+					break;
+				}
+				default:
+					return;
+			}
+		}
+	}
+
+	static void WriteJsonString (std::ostream& s, std::string_view str)
+	{
+		for (auto c: str)
+		{
+			switch (c)
+			{
+				case '"': s << "\\\""; break;
+				case '\\': s << "\\\\"; break;
+				case '\n': s << "\\n"; break;
+				case '\r': s << "\\r"; break;
+				case '\t': s << "\\t"; break;
+				default:
+					if ((unsigned char)c < 0x20)
+					{
+						char esc[8];
+						snprintf (esc, sizeof (esc), "\\u%04x", (unsigned int)c);
+						s << esc;
+					}
+					else
+						s << c;
+			}
+		}
+	}
+
 	Log::Log():
-	m_Destination(eLogStdout), m_MinLevel(eLogInfo),
-	m_LogStream (nullptr), m_Logfile(""), m_HasColors(true), m_TimeFormat("%H:%M:%S"),
-	m_IsRunning (false), m_Thread (nullptr)
+	m_Destination(eLogStdout), m_MinLevel(eLogInfo), m_Format (eLogFormatText),
+	m_LogStream (nullptr), m_Logfile(""), m_NextSeqn (0), m_IsNotifyPending (false),
+	m_HasColors(true), m_TimeFormat("%H:%M:%S"), m_IsRunning (false), m_Thread (nullptr),
+	m_RateLimit (0), m_LastRepeatedMsgsCleanupTime (0), m_NextProcessedSeqn (0), m_MissingSeqn (-1)
 	{
 	}
 
@@ -89,6 +256,14 @@ namespace log {
 
 	void Log::Stop ()
 	{
+		m_IsRunning = false;
+		Notify ();
+		if (m_Thread)
+		{
+			m_Thread->join ();
+			delete m_Thread;
+			m_Thread = nullptr;
+		}
 		switch (m_Destination)
 		{
 #ifndef _WIN32
@@ -104,14 +279,6 @@ namespace log {
 				/* do nothing */
 				break;
 		}
-		m_IsRunning = false;
-		m_Queue.WakeUp ();
-		if (m_Thread)
-		{
-			m_Thread->join ();
-			delete m_Thread;
-			m_Thread = nullptr;
-		}
 	}
 
 	std::string str_tolower(std::string s) {
@@ -147,41 +314,139 @@ namespace log {
 		return m_LastDateTime;
 	}
 
+	void Log::SetLogFormat (const std::string& format)
+	{
+		auto f = str_tolower (format);
+		if (f == "json")
+			m_Format = eLogFormatJson;
+		else
+		{
+			if (f != "text")
+				LogPrint(eLogWarning, "Log: Unknown log format ", format, ", text is used");
+			m_Format = eLogFormatText;
+		}
+	}
+
+	void Log::Process (const LogMsg& msg)
+	{
+		if (m_RateLimit && IsSuppressed (msg)) return;
+		Write (msg);
+	}
+
 	/**
 	 * @note This function better to be run in separate thread due to disk i/o.
 	 * Unfortunately, with current startup process with late fork() this
 	 * will give us nothing but pain. Maybe later. See in NetDb as example.
 	 */
-	void Log::Process(std::shared_ptr<LogMsg> msg)
+	void Log::Write (const LogMsg& msg)
 	{
-		if (!msg) return;
 		std::hash<std::thread::id> hasher;
 		unsigned short short_tid;
-		short_tid = (short) (hasher(msg->tid) % 1000);
+		short_tid = (short) (hasher(msg.tid) % 1000);
 		switch (m_Destination) {
 #ifndef _WIN32
 			case eLogSyslog:
-				syslog(GetSyslogPrio(msg->level), "[%03u] %s", short_tid, msg->text.c_str());
+				syslog(GetSyslogPrio(msg.level), "[%03u] %s", short_tid, msg.text.c_str());
 				break;
 #endif
 			case eLogFile:
 			case eLogStream:
 				if (m_LogStream)
-					*m_LogStream << TimeAsString(msg->timestamp)
-						<< "@" << short_tid
-						<< "/" << g_LogLevelStr[msg->level]
-						<< " - " << msg->text << std::endl;
+				{
+					if (m_Format == eLogFormatJson)
+						WriteJson (*m_LogStream, msg, short_tid);
+					else
+						*m_LogStream << TimeAsString(msg.timestamp)
+							<< "@" << short_tid
+							<< "/" << g_LogLevelStr[msg.level]
+							<< " - " << msg.text << "\n";
+				}
 				break;
 			case eLogStdout:
 			default:
-				std::cout << TimeAsString(msg->timestamp)
-					<< "@" << short_tid
-					<< "/" << LogMsgColors[msg->level] << g_LogLevelStr[msg->level] << LogMsgColors[eNumLogLevels]
-					<< " - " << msg->text << std::endl;
+				if (m_Format == eLogFormatJson)
+					WriteJson (std::cout, msg, short_tid);
+				else
+					std::cout << TimeAsString(msg.timestamp)
+						<< "@" << short_tid
+						<< "/" << LogMsgColors[msg.level] << g_LogLevelStr[msg.level] << LogMsgColors[eNumLogLevels]
+						<< " - " << msg.text << "\n";
 				break;
 		} // switch
 	}
 
+	void Log::WriteJson (std::ostream& s, const LogMsg& msg, unsigned short shortTid)
+	{
+		s << "{\"ts\":" << (int64_t)msg.timestamp << ",\"time\":\"" << TimeAsString(msg.timestamp)
+		  << "\",\"thread\":" << shortTid << ",\"level\":\"" << g_LogLevelStr[msg.level] << "\"";
+		std::string_view text (msg.text);
+		// messages start with "Module: " by convention
+		auto pos = text.find (": ");
+		if (pos != std::string_view::npos && pos > 0 && pos < 32 && text.substr (0, pos).find (' ') == std::string_view::npos)
+		{
+			s << ",\"module\":\"";
+			WriteJsonString (s, text.substr (0, pos));
+			s << "\"";
+			text.remove_prefix (pos + 2);
+		}
+		s << ",\"msg\":\"";
+		WriteJsonString (s, text);
+		s << "\"}\n";
+	}
+
+	bool Log::IsSuppressed (const LogMsg& msg)
+	{
+		auto key = std::hash<std::string>()(msg.text) ^ msg.level;
+		auto& repeated = m_RepeatedMsgs[key];
+		if (msg.timestamp >= repeated.windowStart + LOG_RATE_LIMIT_INTERVAL)
+		{
+			WriteSuppressed (repeated, msg.timestamp);
+			repeated.windowStart = msg.timestamp;
+			repeated.count = 0;
+		}
+		if (repeated.count < m_RateLimit)
+		{
+			repeated.count++;
+			return false;
+		}
+		if (!repeated.numSuppressed)
+		{
+			repeated.level = msg.level;
+			repeated.tid = msg.tid;
+			repeated.text = msg.text;
+		}
+		repeated.numSuppressed++;
+		return true;
+	}
+
+	void Log::WriteSuppressed (RepeatedMsg& repeated, std::time_t ts)
+	{
+		if (!repeated.numSuppressed) return;
+		std::stringstream s;
+		s << "Log: Suppressed " << repeated.numSuppressed << " repeated messages: " << repeated.text;
+		LogMsg msg (repeated.level, ts, s.str ());
+		msg.tid = repeated.tid;
+		Write (msg);
+		repeated.numSuppressed = 0;
+		repeated.text.clear ();
+	}
+
+	void Log::CleanupRepeatedMsgs (std::time_t ts)
+	{
+		if (ts < m_LastRepeatedMsgsCleanupTime + LOG_RATE_LIMIT_INTERVAL) return;
+		for (auto it = m_RepeatedMsgs.begin (); it != m_RepeatedMsgs.end ();)
+		{
+			if (ts >= it->second.windowStart + LOG_RATE_LIMIT_INTERVAL)
+			{
+				WriteSuppressed (it->second, ts);
+				it = m_RepeatedMsgs.erase (it);
+			}
+			else
+				it++;
+		}
+		m_LastRepeatedMsgsCleanupTime = ts;
+	}
+
 	void Log::Run ()
 	{
 		i2p::util::SetThreadName("Logging");
@@ -189,18 +454,140 @@ namespace log {
 		Reopen ();
 		while (m_IsRunning)
 		{
-			std::shared_ptr<LogMsg> msg;
-			while ((msg = m_Queue.Get ()))
-				Process (msg);
-			if (m_LogStream) m_LogStream->flush();
-			if (m_IsRunning)
-				m_Queue.Wait ();
+			{
+				std::unique_lock<std::mutex> l(m_WaitMutex);
+				m_NonEmpty.wait_for (l, std::chrono::milliseconds (LOG_FLUSH_INTERVAL),
+					[this]{ return m_IsNotifyPending.load () || !m_IsRunning; });
+			}
+			Flush (false);
 		}
+		Flush (true); // records written before stop
+	}
+
+	void Log::Notify ()
+	{
+		std::unique_lock<std::mutex> l(m_WaitMutex);
+		m_NonEmpty.notify_one ();
+	}
+
+	void Log::Flush (bool all)
+	{
+		m_IsNotifyPending = false; // before reading, new records will notify again
+		std::vector<LogMsg> msgs;
+		msgs.swap (m_Delayed);
+		{
+			std::unique_lock<std::mutex> l(m_QueueMutex);
+			for (auto& it: m_Queue)
+				msgs.push_back (std::move (*it));
+			m_Queue.clear ();
+		}
+		std::vector<std::shared_ptr<LogThreadBuffer> > buffers;
+		{
+			std::unique_lock<std::mutex> l(m_ThreadBuffersMutex);
+			buffers = m_ThreadBuffers;
+		}
+		bool isOrdered = true;
+		for (auto& buffer: buffers)
+		{
+			if (!msgs.empty ()) isOrdered = false; // merge of different threads or delayed
+			buffer->Read ([&msgs, &buffer, this](const LogRecordHeader& header, const uint8_t * buf)
+				{
+					m_FormatStream.str (""); m_FormatStream.clear ();
+					DecodeRecord (m_FormatStream, buf, header.length);
+					msgs.emplace_back ((LogLevel)header.level, header.timestamp, m_FormatStream.str ());
+					msgs.back ().tid = buffer->GetTid ();
+					msgs.back ().seqn = header.seqn;
+				});
+		}
+		if (!isOrdered)
+			std::stable_sort (msgs.begin (), msgs.end (),
+				[](const LogMsg& m1, const LogMsg& m2) { return m1.seqn < m2.seqn; });
+		// seqn is taken before record is published, every taken seqn is published,
+		// so a gap means lower message is not visible to us yet
+		bool isDelayed = false;
+		for (auto& it: msgs)
+		{
+			if (!all && !isDelayed && it.seqn > m_NextProcessedSeqn && m_NextProcessedSeqn != m_MissingSeqn)
+			{
+				m_MissingSeqn = m_NextProcessedSeqn; // wait for it until next flush only
+				isDelayed = true;
+			}
+			if (isDelayed)
+				m_Delayed.push_back (std::move (it)); // next time
+			else
+			{
+				if (it.seqn >= m_NextProcessedSeqn) m_NextProcessedSeqn = it.seqn + 1;
+				Process (it);
+			}
+		}
+		if (m_RateLimit) CleanupRepeatedMsgs (std::time (nullptr));
+		if (m_LogStream)
+			m_LogStream->flush();
+		else if (m_Destination == eLogStdout)
+			std::cout.flush ();
+		// drop buffers of exited threads
+		std::unique_lock<std::mutex> l(m_ThreadBuffersMutex);
+		m_ThreadBuffers.erase (std::remove_if (m_ThreadBuffers.begin (), m_ThreadBuffers.end (),
+			[](const std::shared_ptr<LogThreadBuffer>& buffer) { return buffer->IsFinished () && buffer->IsEmpty (); }),
+			m_ThreadBuffers.end ());
 	}
 
 	void Log::Append(std::shared_ptr<i2p::log::LogMsg> & msg)
 	{
-		m_Queue.Put(msg);
+		msg->seqn = m_NextSeqn.fetch_add (1, std::memory_order_relaxed);
+		{
+			std::unique_lock<std::mutex> l(m_QueueMutex);
+			m_Queue.push_back (msg);
+		}
+		if (!m_IsNotifyPending.exchange (true)) Notify ();
+	}
+
+	LogThreadBuffer * Log::GetThreadBuffer ()
+	{
+		if (g_ThreadBuffer.isDisabled) return nullptr;
+		if (!g_ThreadBuffer.buffer)
+		{
+			g_ThreadBuffer.buffer = std::make_shared<LogThreadBuffer>();
+			std::unique_lock<std::mutex> l(m_ThreadBuffersMutex);
+			m_ThreadBuffers.push_back (g_ThreadBuffer.buffer);
+		}
+		return g_ThreadBuffer.buffer.get ();
+	}
+
+	bool Log::BeginRecord (LogRecordWriter& record)
+	{
+		if (!m_IsRunning) return false;
+		auto buffer = GetThreadBuffer ();
+		if (!buffer) return false;
+		auto buf = buffer->Reserve (LOG_MAX_RECORD_SIZE);
+		if (!buf)
+		{
+			// full or nested
+			if (!m_IsNotifyPending.exchange (true)) Notify ();
+			return false;
+		}
+		record.Reset (buffer, buf + sizeof (LogRecordHeader), LOG_MAX_RECORD_SIZE - sizeof (LogRecordHeader));
+		return true;
+	}
+
+	bool Log::CommitRecord (LogRecordWriter& record, LogLevel level)
+	{
+		auto buffer = record.GetOwner ();
+		if (record.IsOverflow ())
+		{
+			buffer->Cancel ();
+			return false;
+		}
+		auto header = reinterpret_cast<LogRecordHeader *>(record.GetBuffer () - sizeof (LogRecordHeader));
+		header->length = record.GetLength ();
+		header->size = (sizeof (LogRecordHeader) + header->length + 7) & ~7;
+		header->level = level;
+		header->seqn = m_NextSeqn.fetch_add (1, std::memory_order_relaxed);
+		header->timestamp = std::time (nullptr);
+		buffer->Commit (header->size);
+		if (!m_IsNotifyPending.load (std::memory_order_relaxed) && !m_IsNotifyPending.exchange (true))
+			Notify ();
+		return true;
 	}
 
 	void Log::SendTo (const std::string& path)
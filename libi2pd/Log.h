@@ -1,5 +1,5 @@
 /*
-* Copyright (c) 2013-2024, The PurpleI2P Project
+* Copyright (c) 2013-2026, The PurpleI2P Project
 *
 * This file is part of Purple i2pd project and licensed under BSD3
 *
@@ -11,6 +11,9 @@
 
 #include <ctime>
 #include <string>
+#include <string.h>
+#include <string_view>
+#include <type_traits>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -18,7 +21,12 @@
 #include <memory>
 #include <thread>
 #include <functional>
-#include "Queue.h"
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <list>
+#include <vector>
+#include <unordered_map>
 
 #ifndef _WIN32
 #include <syslog.h>
@@ -44,26 +52,123 @@ enum LogType {
 #endif
 };
 
+enum LogFormat
+{
+	eLogFormatText = 0,
+	eLogFormatJson
+};
+
+#ifndef LOG_MAX_LEVEL
+#define LOG_MAX_LEVEL eLogDebug // messages with higher level are compiled out
+#endif
+
 namespace i2p {
 namespace log {
 
+	const size_t LOG_THREAD_BUFFER_SIZE = 64*1024; // per thread, power of 2
+	const size_t LOG_MAX_RECORD_SIZE = 2048; // longer messages are formatted by caller
+	const int LOG_FLUSH_INTERVAL = 100; // in milliseconds
+	const int LOG_RATE_LIMIT_INTERVAL = 1; // in seconds
+
 	struct LogMsg; /* forward declaration */
+	class LogThreadBuffer;
+
+	enum LogArgType
+	{
+		eLogArgInt = 0,
+		eLogArgUInt,
+		eLogArgDouble,
+		eLogArgChar,
+		eLogArgString
+	};
+
+	/**
+	 * @brief Binary record of LogPrint arguments
+	 *
+	 * Written by calling thread to its own buffer,
+	 * formatted to text later by log thread
+	 */
+	class LogRecordWriter
+	{
+		public:
+
+			LogRecordWriter (): m_Owner (nullptr), m_Buf (nullptr), m_Len (0), m_Offset (0) {};
+
+			void Reset (LogThreadBuffer * owner, uint8_t * buf, size_t len) { m_Owner = owner; m_Buf = buf; m_Len = len; m_Offset = 0; };
+			LogThreadBuffer * GetOwner () const { return m_Owner; };
+			uint8_t * GetBuffer () const { return m_Buf; };
+			size_t GetLength () const { return m_Offset; };
+			bool IsOverflow () const { return m_Offset > m_Len; };
+
+			void PutInt (int64_t v) { Put (eLogArgInt, &v, 8); };
+			void PutUInt (uint64_t v) { Put (eLogArgUInt, &v, 8); };
+			void PutDouble (double v) { Put (eLogArgDouble, &v, 8); };
+			void PutChar (char c) { Put (eLogArgChar, &c, 1); };
+			void PutString (const char * s, size_t len)
+			{
+				if (m_Offset + 5 + len > m_Len) { m_Offset = m_Len + 1; return; }
+				m_Buf[m_Offset] = eLogArgString;
+				uint32_t l = len;
+				memcpy (m_Buf + m_Offset + 1, &l, 4);
+				memcpy (m_Buf + m_Offset + 5, s, len);
+				m_Offset += 5 + len;
+			}
+
+		private:
+
+			void Put (LogArgType type, const void * v, size_t len)
+			{
+				if (m_Offset + 1 + len > m_Len) { m_Offset = m_Len + 1; return; }
+				m_Buf[m_Offset] = type;
+				memcpy (m_Buf + m_Offset + 1, v, len);
+				m_Offset += 1 + len;
+			}
+
+		private:
+
+			LogThreadBuffer * m_Owner;
+			uint8_t * m_Buf;
+			size_t m_Len, m_Offset; // offset > len means overflow
+	};
 
 	class Log
 	{
+		struct RepeatedMsg
+		{
+			std::time_t windowStart = 0;
+			int count = 0, numSuppressed = 0;
+			LogLevel level = eLogNone;
+			std::thread::id tid;
+			std::string text; // of first suppressed
+		};
+
 		private:
 
 			enum LogType m_Destination;
 			enum LogLevel m_MinLevel;
+			enum LogFormat m_Format;
 			std::shared_ptr<std::ostream> m_LogStream;
 			std::string m_Logfile;
 			std::time_t m_LastTimestamp;
 			char m_LastDateTime[64];
-			i2p::util::Queue<std::shared_ptr<LogMsg> > m_Queue;
+			std::mutex m_QueueMutex;
+			std::list<std::shared_ptr<LogMsg> > m_Queue; // formatted by caller
+			std::mutex m_ThreadBuffersMutex;
+			std::vector<std::shared_ptr<LogThreadBuffer> > m_ThreadBuffers;
+			std::atomic<uint64_t> m_NextSeqn;
+			std::atomic<bool> m_IsNotifyPending;
+			std::mutex m_WaitMutex;
+			std::condition_variable m_NonEmpty;
 			bool m_HasColors;
 			std::string m_TimeFormat;
 			volatile bool m_IsRunning;
 			std::thread * m_Thread;
+			int m_RateLimit; // max same messages per LOG_RATE_LIMIT_INTERVAL, 0 means unlimited
+			std::unordered_map<size_t, RepeatedMsg> m_RepeatedMsgs; // hash of level and text -> msg
+			std::time_t m_LastRepeatedMsgsCleanupTime;
+			std::stringstream m_FormatStream; // used by log thread only
+			std::vector<LogMsg> m_Delayed; // might be preceded by messages not read yet
+			uint64_t m_NextProcessedSeqn, m_MissingSeqn; // used by log thread only
 
 		private:
 
@@ -72,7 +177,15 @@ namespace log {
 			const Log& operator=(const Log&);
 
 			void Run ();
-			void Process (std::shared_ptr<LogMsg> msg);
+			void Notify ();
+			void Flush (bool all);
+			void Process (const LogMsg& msg);
+			void Write (const LogMsg& msg);
+			void WriteJson (std::ostream& s, const LogMsg& msg, unsigned short shortTid);
+			bool IsSuppressed (const LogMsg& msg);
+			void WriteSuppressed (RepeatedMsg& repeated, std::time_t ts);
+			void CleanupRepeatedMsgs (std::time_t ts);
+			LogThreadBuffer * GetThreadBuffer ();
 
 			/**
 			 * @brief Makes formatted string from unix timestamp
@@ -117,6 +230,18 @@ namespace log {
 			 */
 			void SetTimeFormat (std::string format) { m_TimeFormat = format; };
 
+			/**
+			 * @brief Sets output format of messages
+			 * @param format "text" or "json" (one JSON object per line)
+			 */
+			void SetLogFormat (const std::string& format);
+
+			/**
+			 * @brief Limits number of same messages
+			 * @param limit Max same messages per second, 0 means unlimited
+			 */
+			void SetRateLimit (int limit) { m_RateLimit = limit > 0 ? limit : 0; };
+
 	#ifndef _WIN32
 			/**
 			 * @brief Sets log destination to syslog
@@ -127,11 +252,23 @@ namespace log {
 	#endif
 
 			/**
-			 * @brief Format log message and write to output stream/syslog
-			 * @param msg Pointer to processed message
+			 * @brief Put already formatted message to queue
+			 * @param msg Pointer to message
 			 */
 			void Append(std::shared_ptr<i2p::log::LogMsg> &);
 
+			/**
+			 * @brief Reserve space for binary record in calling thread's buffer
+			 * @return false if record can't be written, message must be formatted and appended then
+			 */
+			bool BeginRecord (LogRecordWriter& record);
+
+			/**
+			 * @brief Publish record to log thread
+			 * @return false if arguments didn't fit, record is discarded
+			 */
+			bool CommitRecord (LogRecordWriter& record, LogLevel level);
+
 			/** @brief Reopen log file */
 			void Reopen();
 	};
@@ -148,6 +285,7 @@ namespace log {
 		std::string text;    /**< message text as single string */
 		LogLevel level;      /**< message level */
 		std::thread::id tid; /**< id of thread that generated message */
+		uint64_t seqn = 0;   /**< order of messages from different threads */
 
 		LogMsg (LogLevel lvl, std::time_t ts, std::string&& txt): timestamp(ts), text(std::move(txt)), level(lvl) {}
 	};
@@ -162,7 +300,7 @@ namespace log {
 
 inline bool CheckLogLevel (LogLevel level) noexcept
 {
-	return level <= i2p::log::Logger().GetLogLevel ();
+	return level <= LOG_MAX_LEVEL && level <= i2p::log::Logger().GetLogLevel ();
 }	
 
 /** internal usage only -- folding args array to single string */
@@ -172,6 +310,46 @@ void LogPrint (std::stringstream& s, TValue&& arg) noexcept
 	s << std::forward<TValue>(arg);
 }
 
+namespace i2p {
+namespace log {
+
+	/** internal usage only -- write argument to binary record, same output as stream */
+	template<typename TValue>
+	void LogRecordArg (LogRecordWriter& record, const TValue& arg)
+	{
+		typedef std::decay_t<TValue> T;
+		if constexpr (std::is_same_v<T, char> || std::is_same_v<T, signed char> || std::is_same_v<T, unsigned char>)
+			record.PutChar (arg);
+		else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+			record.PutInt (arg);
+		else if constexpr (std::is_integral_v<T>) // bool included
+			record.PutUInt (arg);
+		else if constexpr (std::is_floating_point_v<T>)
+			record.PutDouble (arg);
+		else if constexpr (std::is_same_v<std::remove_cv_t<std::remove_extent_t<TValue> >, char> && std::is_array_v<TValue>) // string literal
+			record.PutString (arg, strlen (arg));
+		else if constexpr (std::is_same_v<T, const char *> || std::is_same_v<T, char *>)
+		{
+			if (arg) record.PutString (arg, strlen (arg));
+		}
+		else if constexpr (std::is_convertible_v<const T&, std::string_view>)
+		{
+			std::string_view v (arg);
+			record.PutString (v.data (), v.size ());
+		}
+		else
+		{
+			// other types are formatted by caller
+			static thread_local std::stringstream s;
+			s.str (""); s.clear ();
+			s << arg;
+			auto str = s.str ();
+			record.PutString (str.data (), str.size ());
+		}
+	}
+} // log
+} // i2p
+
 /**
  * @brief Create log message and send it to queue
  * @param level Message level (eLogError, eLogInfo, ...)
@@ -182,6 +360,13 @@ void LogPrint (LogLevel level, TArgs&&... args) noexcept
 {
 	if (!CheckLogLevel (level)) return; 
 
+	// binary record, formatted by log thread
+	i2p::log::LogRecordWriter record;
+	if (i2p::log::Logger().BeginRecord (record))
+	{
+		(i2p::log::LogRecordArg (record, args), ...);
+		if (i2p::log::Logger().CommitRecord (record, level)) return;
+	}
 	// fold message to single string
 	std::stringstream ss;
 	(LogPrint (ss, std::forward<TArgs>(args)), ...);
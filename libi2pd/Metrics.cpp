@@ -0,0 +1,194 @@
+/*
+* Copyright (c) 2013-2025, The PurpleI2P Project
+*
+* This file is part of Purple i2pd project and licensed under BSD3
+*
+* See full license text in LICENSE file at top of project tree
+*/
+
+#include <algorithm>
+#include "Log.h"
+#include "Metrics.h"
+
+namespace i2p
+{
+namespace metrics
+{
+	Registry& GetRegistry ()
+	{
+		static Registry registry;
+		return registry;
+	}
+
+	static std::atomic<int> g_NextShardIndex{0};
+
+	int GetShardIndex ()
+	{
+		static thread_local int index = g_NextShardIndex.fetch_add (1, std::memory_order_relaxed) & (METRICS_NUM_SHARDS - 1);
+		return index;
+	}
+
+	static void WriteSample (std::stringstream& s, const std::string& name, const std::string& labels, int64_t value)
+	{
+		s << METRICS_PREFIX << name;
+		if (!labels.empty ()) s << "{" << labels << "}";
+		s << " " << value << "\n";
+	}
+
+	uint64_t Counter::GetValue () const
+	{
+		uint64_t value = 0;
+		for (const auto& it: m_Shards)
+			value += it.value.load (std::memory_order_relaxed);
+		return value;
+	}
+
+	void Counter::Write (std::stringstream& s, const std::string& name, const std::string& labels) const
+	{
+		WriteSample (s, name, labels, GetValue ());
+	}
+
+	void Gauge::Write (std::stringstream& s, const std::string& name, const std::string& labels) const
+	{
+		WriteSample (s, name, labels, GetValue ());
+	}
+
+	Histogram::Histogram (const std::vector<uint64_t>& buckets): m_Buckets (buckets)
+	{
+		for (auto& it: m_Shards)
+		{
+			it.counts.reset (new std::atomic<uint64_t>[m_Buckets.size () + 1]);
+			for (size_t i = 0; i <= m_Buckets.size (); i++)
+				it.counts[i].store (0, std::memory_order_relaxed);
+		}
+	}
+
+	void Histogram::Observe (uint64_t value)
+	{
+		size_t bucket = std::lower_bound (m_Buckets.begin (), m_Buckets.end (), value) - m_Buckets.begin (); // le
+		auto& shard = m_Shards[GetShardIndex ()];
+		shard.counts[bucket].fetch_add (1, std::memory_order_relaxed);
+		shard.sum.fetch_add (value, std::memory_order_relaxed);
+	}
+
+	uint64_t Histogram::GetCount () const
+	{
+		uint64_t count = 0;
+		for (const auto& it: m_Shards)
+			for (size_t i = 0; i <= m_Buckets.size (); i++)
+				count += it.counts[i].load (std::memory_order_relaxed);
+		return count;
+	}
+
+	void Histogram::Write (std::stringstream& s, const std::string& name, const std::string& labels) const
+	{
+		std::string prefix = labels.empty () ? "" : labels + ",";
+		uint64_t count = 0, sum = 0;
+		for (size_t i = 0; i <= m_Buckets.size (); i++)
+		{
+			for (const auto& it: m_Shards)
+				count += it.counts[i].load (std::memory_order_relaxed);
+			s << METRICS_PREFIX << name << "_bucket{" << prefix << "le=\"";
+			if (i < m_Buckets.size ())
+				s << m_Buckets[i];
+			else
+				s << "+Inf";
+			s << "\"} " << count << "\n"; // cumulative
+		}
+		for (const auto& it: m_Shards)
+			sum += it.sum.load (std::memory_order_relaxed);
+		WriteSample (s, name + "_sum", labels, sum);
+		WriteSample (s, name + "_count", labels, count);
+	}
+
+	void CallbackMetric::Write (std::stringstream& s, const std::string& name, const std::string& labels) const
+	{
+		if (m_Callback)
+			WriteSample (s, name, labels, m_Callback ());
+	}
+
+	template<typename M, typename... Args>
+	M& Registry::GetMetric (const std::string& name, const std::string& help, MetricType type,
+		const std::string& labels, Args&&... args)
+	{
+		std::unique_lock<std::mutex> l(m_FamiliesMutex);
+		auto& family = m_Families[name];
+		if (family.metrics.empty ())
+		{
+			family.type = type;
+			family.help = help;
+		}
+		if (family.type == type)
+		{
+			auto& metric = family.metrics[labels];
+			if (!metric)
+			{
+				metric.reset (new M (std::forward<Args>(args)...));
+				return static_cast<M&>(*metric);
+			}
+			auto m = dynamic_cast<M *>(metric.get ());
+			if (m) return *m;
+		}
+		LogPrint (eLogError, "Metrics: ", name, " is already registered with different type");
+		// keep caller working, but don't expose it
+		static std::vector<std::unique_ptr<Metric> > orphans;
+		orphans.emplace_back (new M (std::forward<Args>(args)...));
+		return static_cast<M&>(*orphans.back ());
+	}
+
+	Counter& Registry::GetCounter (const std::string& name, const std::string& help, const std::string& labels)
+	{
+		return GetMetric<Counter> (name, help, eMetricTypeCounter, labels);
+	}
+
+	Gauge& Registry::GetGauge (const std::string& name, const std::string& help, const std::string& labels)
+	{
+		return GetMetric<Gauge> (name, help, eMetricTypeGauge, labels);
+	}
+
+	Histogram& Registry::GetHistogram (const std::string& name, const std::string& help,
+		const std::vector<uint64_t>& buckets, const std::string& labels)
+	{
+		return GetMetric<Histogram> (name, help, eMetricTypeHistogram, labels, buckets);
+	}
+
+	void Registry::SetCallback (const std::string& name, const std::string& help, MetricType type,
+		CallbackMetric::Callback callback, const std::string& labels)
+	{
+		if (type == eMetricTypeHistogram) return; // counters and gauges only
+		std::unique_lock<std::mutex> l(m_FamiliesMutex);
+		auto& family = m_Families[name];
+		if (family.metrics.empty ())
+		{
+			family.type = type;
+			family.help = help;
+		}
+		else if (family.type != type)
+		{
+			LogPrint (eLogError, "Metrics: ", name, " is already registered with different type");
+			return;
+		}
+		family.metrics[labels].reset (new CallbackMetric (callback));
+	}
+
+	void Registry::WritePrometheusText (std::stringstream& s) const
+	{
+		std::unique_lock<std::mutex> l(m_FamiliesMutex);
+		for (const auto& it: m_Families)
+		{
+			if (it.second.metrics.empty ()) continue;
+			s << "# HELP " << METRICS_PREFIX << it.first << " " << it.second.help << "\n";
+			s << "# TYPE " << METRICS_PREFIX << it.first << " ";
+			switch (it.second.type)
+			{
+				case eMetricTypeCounter: s << "counter"; break;
+				case eMetricTypeGauge: s << "gauge"; break;
+				case eMetricTypeHistogram: s << "histogram"; break;
+			}
+			s << "\n";
+			for (const auto& it1: it.second.metrics)
+				it1.second->Write (s, it.first, it1.first);
+		}
+	}
+}
+}
@@ -0,0 +1,161 @@
+/*
+* Copyright (c) 2013-2025, The PurpleI2P Project
+*
+* This file is part of Purple i2pd project and licensed under BSD3
+*
+* See full license text in LICENSE file at top of project tree
+*/
+
+#ifndef METRICS_H__
+#define METRICS_H__
+
+#include <inttypes.h>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <functional>
+#include <map>
+#include <vector>
+#include <string>
+#include <sstream>
+
+namespace i2p
+{
+namespace metrics
+{
+	const int METRICS_NUM_SHARDS = 16; // power of 2
+	const char METRICS_PREFIX[] = "i2pd_";
+
+	// latency buckets
+	const std::vector<uint64_t> METRICS_MICROSECONDS_BUCKETS = { 50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000 };
+	const std::vector<uint64_t> METRICS_MILLISECONDS_BUCKETS = { 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000 };
+
+	int GetShardIndex (); // assigned to calling thread once
+
+	enum MetricType
+	{
+		eMetricTypeCounter = 0,
+		eMetricTypeGauge,
+		eMetricTypeHistogram
+	};
+
+	class Metric
+	{
+		public:
+
+			virtual ~Metric () {};
+			virtual void Write (std::stringstream& s, const std::string& name, const std::string& labels) const = 0;
+	};
+
+	class Counter: public Metric
+	{
+		struct alignas(64) Shard
+		{
+			std::atomic<uint64_t> value{0};
+		};
+
+		public:
+
+			void Inc (uint64_t n = 1) { m_Shards[GetShardIndex ()].value.fetch_add (n, std::memory_order_relaxed); };
+			uint64_t GetValue () const;
+
+			void Write (std::stringstream& s, const std::string& name, const std::string& labels) const override;
+
+		private:
+
+			Shard m_Shards[METRICS_NUM_SHARDS];
+	};
+
+	class Gauge: public Metric
+	{
+		public:
+
+			void Set (int64_t value) { m_Value.store (value, std::memory_order_relaxed); };
+			void Add (int64_t n) { m_Value.fetch_add (n, std::memory_order_relaxed); };
+			int64_t GetValue () const { return m_Value.load (std::memory_order_relaxed); };
+
+			void Write (std::stringstream& s, const std::string& name, const std::string& labels) const override;
+
+		private:
+
+			std::atomic<int64_t> m_Value{0};
+	};
+
+	class Histogram: public Metric
+	{
+		struct alignas(64) Shard
+		{
+			std::unique_ptr<std::atomic<uint64_t>[]> counts; // per bucket, last is +Inf
+			std::atomic<uint64_t> sum{0};
+		};
+
+		public:
+
+			Histogram (const std::vector<uint64_t>& buckets); // upper bounds, ascending
+
+			void Observe (uint64_t value);
+			uint64_t GetCount () const;
+
+			void Write (std::stringstream& s, const std::string& name, const std::string& labels) const override;
+
+		private:
+
+			std::vector<uint64_t> m_Buckets;
+			Shard m_Shards[METRICS_NUM_SHARDS];
+	};
+
+	// value is taken from existing stats when exposed
+	class CallbackMetric: public Metric
+	{
+		public:
+
+			typedef std::function<int64_t ()> Callback;
+
+			CallbackMetric (Callback callback): m_Callback (callback) {};
+
+			void Write (std::stringstream& s, const std::string& name, const std::string& labels) const override;
+
+		private:
+
+			Callback m_Callback;
+	};
+
+	class Registry
+	{
+		struct Family
+		{
+			MetricType type;
+			std::string help;
+			std::map<std::string, std::unique_ptr<Metric> > metrics; // labels -> metric
+		};
+
+		public:
+
+			// returned references remain valid, same name and labels return same metric
+			Counter& GetCounter (const std::string& name, const std::string& help, const std::string& labels = "");
+			Gauge& GetGauge (const std::string& name, const std::string& help, const std::string& labels = "");
+			Histogram& GetHistogram (const std::string& name, const std::string& help,
+				const std::vector<uint64_t>& buckets, const std::string& labels = "");
+			// replaces previous callback with same name and labels
+			void SetCallback (const std::string& name, const std::string& help, MetricType type,
+				CallbackMetric::Callback callback, const std::string& labels = "");
+
+			void WritePrometheusText (std::stringstream& s) const;
+
+		private:
+
+			template<typename M, typename... Args>
+			M& GetMetric (const std::string& name, const std::string& help, MetricType type,
+				const std::string& labels, Args&&... args);
+
+		private:
+
+			mutable std::mutex m_FamiliesMutex;
+			std::map<std::string, Family> m_Families; // name -> metrics
+	};
+
+	Registry& GetRegistry (); // safe to use from static initialization
+}
+}
+
+#endif
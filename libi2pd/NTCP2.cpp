@@ -22,6 +22,8 @@
 #include "HTTP.h"
 #include "util.h"
 #include "Socks5.h"
+#include "Config.h"
+#include "Metrics.h"
 #include "NTCP2.h"
 
 #if defined(__linux__) && !defined(_NETINET_IN_H)
@@ -32,6 +34,12 @@ namespace i2p
 {
 namespace transport
 {
+	static auto& g_DroppedExpiredMessagesMetric = i2p::metrics::GetRegistry ().GetCounter ("transport_dropped_messages_total",
+		"I2NP messages dropped by transport sessions", "transport=\"ntcp2\",reason=\"expired\"");
+	static auto& g_DroppedSemiFullMessagesMetric = i2p::metrics::GetRegistry ().GetCounter ("transport_dropped_messages_total",
+		"I2NP messages dropped by transport sessions", "transport=\"ntcp2\",reason=\"queue_full\"");
+	static auto& g_DroppedTooLongMessagesMetric = i2p::metrics::GetRegistry ().GetCounter ("transport_dropped_messages_total",
+		"I2NP messages dropped by transport sessions", "transport=\"ntcp2\",reason=\"too_long\"");
 	NTCP2Establisher::NTCP2Establisher ():
 		m_SessionConfirmedBuffer (nullptr)
 	{
@@ -348,7 +356,7 @@ namespace transport
 	NTCP2Session::NTCP2Session (NTCP2Server& server, std::shared_ptr<const i2p::data::RouterInfo> in_RemoteRouter,
 		std::shared_ptr<const i2p::data::RouterInfo::Address> addr):
 		TransportSession (in_RemoteRouter, NTCP2_ESTABLISH_TIMEOUT),
-		m_Server (server), m_Socket (m_Server.GetService ()),
+		m_Server (server), m_SessionsService (server.GetNextSessionsService ()), m_Socket (GetService ()),
 		m_IsEstablished (false), m_IsTerminated (false),
 		m_Establisher (new NTCP2Establisher),
 		m_SendKey (nullptr), m_ReceiveKey (nullptr),
@@ -357,9 +365,9 @@ namespace transport
 #else
 		m_SendSipKey (nullptr), m_ReceiveSipKey (nullptr),
 #endif
-		m_NextReceivedLen (0), m_NextReceivedBuffer (nullptr), m_NextSendBuffer (nullptr),
-		m_NextReceivedBufferSize (0), m_ReceiveSequenceNumber (0), m_SendSequenceNumber (0),
-		m_IsSending (false), m_IsReceiving (false), m_NextPaddingSize (16)
+		m_NextReceivedLen (0), m_NextReceivedBuffer (nullptr), m_NextReceivedBufferSize (0),
+		m_SegmentSize (NTCP2_DEFAULT_SEGMENT_SIZE), m_ReceiveSequenceNumber (0), m_SendSequenceNumber (0),
+		m_IsSending (false), m_IsReceiving (false), m_IsRouterInfoPending (false), m_NextPaddingSize (16)
 	{
 		if (in_RemoteRouter) // Alice
 		{
@@ -380,7 +388,6 @@ namespace transport
 	NTCP2Session::~NTCP2Session ()
 	{
 		delete[] m_NextReceivedBuffer;
-		delete[] m_NextSendBuffer;
 #if OPENSSL_SIPHASH
 		if (m_SendMDCtx) EVP_MD_CTX_destroy (m_SendMDCtx);
 		if (m_ReceiveMDCtx) EVP_MD_CTX_destroy (m_ReceiveMDCtx);
@@ -431,14 +438,47 @@ namespace transport
 
 	void NTCP2Session::Done ()
 	{
-		boost::asio::post (m_Server.GetService (), std::bind (&NTCP2Session::Terminate, shared_from_this ()));
+		boost::asio::post (GetService (), std::bind (&NTCP2Session::Terminate, shared_from_this ()));
+	}
+
+	boost::asio::io_context& NTCP2Session::GetService ()
+	{
+		return m_SessionsService ? m_SessionsService->GetService () : m_Server.GetService ();
+	}
+
+	std::mt19937& NTCP2Session::GetRng ()
+	{
+		return m_SessionsService ? m_SessionsService->GetRng () : m_Server.GetRng ();
+	}
+
+	void NTCP2Session::AEADChaCha20Poly1305Encrypt (const std::vector<std::pair<uint8_t *, size_t> >& bufs,
+		const uint8_t * key, const uint8_t * nonce, uint8_t * mac)
+	{
+		if (m_SessionsService)
+			m_SessionsService->GetEncryptor ().Encrypt (bufs, key, nonce, mac);
+		else
+			m_Server.AEADChaCha20Poly1305Encrypt (bufs, key, nonce, mac);
+	}
+
+	bool NTCP2Session::AEADChaCha20Poly1305Decrypt (const uint8_t * msg, size_t msgLen, const uint8_t * ad, size_t adLen,
+		const uint8_t * key, const uint8_t * nonce, uint8_t * buf, size_t len)
+	{
+		if (m_SessionsService)
+			return m_SessionsService->GetDecryptor ().Decrypt (msg, msgLen, ad, adLen, key, nonce, buf, len);
+		return m_Server.AEADChaCha20Poly1305Decrypt (msg, msgLen, ad, adLen, key, nonce, buf, len);
 	}
 
 	void NTCP2Session::Established ()
 	{
 		m_IsEstablished = true;
 		m_Establisher.reset (nullptr);
-		SetTerminationTimeout (NTCP2_TERMINATION_TIMEOUT + m_Server.GetRng ()() % NTCP2_TERMINATION_TIMEOUT_VARIANCE);
+#ifdef __linux__
+		int mss = 0;
+		socklen_t mssLen = sizeof (mss);
+		if (!getsockopt (m_Socket.native_handle (), IPPROTO_TCP, TCP_MAXSEG, &mss, &mssLen) && mss > 0)
+			m_SegmentSize = mss;
+#endif
+		SetTerminationTimeout (NTCP2_TERMINATION_TIMEOUT + GetRng ()() % NTCP2_TERMINATION_TIMEOUT_VARIANCE);
 		SendQueue ();
 		transports.PeerConnected (shared_from_this ());
 	}
@@ -494,7 +534,7 @@ namespace transport
 		if (!m_Establisher->CreateSessionRequestMessage (m_Server.GetRng ()))
 		{
 			LogPrint (eLogWarning, "NTCP2: Send SessionRequest KDF failed");
-			boost::asio::post (m_Server.GetService (), std::bind (&NTCP2Session::Terminate, shared_from_this ()));
+			boost::asio::post (GetService (), std::bind (&NTCP2Session::Terminate, shared_from_this ()));
 			return;
 		}	
 		// send message
@@ -548,7 +588,7 @@ namespace transport
 			{
 				// we don't care about padding, send SessionCreated and close session
 				SendSessionCreated ();
-				boost::asio::post (m_Server.GetService (), std::bind (&NTCP2Session::Terminate, shared_from_this ()));
+				boost::asio::post (GetService (), std::bind (&NTCP2Session::Terminate, shared_from_this ()));
 			}
 			else if (paddingLen > 0)
 			{
@@ -560,7 +600,7 @@ namespace transport
 				else
 				{
 					LogPrint (eLogWarning, "NTCP2: SessionRequest padding length ", (int)paddingLen, " is too long");
-					boost::asio::post (m_Server.GetService (), std::bind (&NTCP2Session::Terminate, shared_from_this ()));
+					boost::asio::post (GetService (), std::bind (&NTCP2Session::Terminate, shared_from_this ()));
 				}
 			}
 			else
@@ -592,7 +632,7 @@ namespace transport
 		if (!m_Establisher->CreateSessionCreatedMessage (m_Server.GetRng ()))
 		{
 			LogPrint (eLogWarning, "NTCP2: Send SessionCreated KDF failed");
-			boost::asio::post (m_Server.GetService (), std::bind (&NTCP2Session::Terminate, shared_from_this ()));
+			boost::asio::post (GetService (), std::bind (&NTCP2Session::Terminate, shared_from_this ()));
 			return;
 		}	
 		// send message
@@ -635,7 +675,7 @@ namespace transport
 				else
 				{
 					LogPrint (eLogWarning, "NTCP2: SessionCreated padding length ", (int)paddingLen, " is too long");
-					boost::asio::post (m_Server.GetService (), std::bind (&NTCP2Session::Terminate, shared_from_this ()));
+					boost::asio::post (GetService (), std::bind (&NTCP2Session::Terminate, shared_from_this ()));
 				}
 			}
 			else
@@ -645,7 +685,7 @@ namespace transport
 		{
 			if (GetRemoteIdentity ())
 				i2p::data::netdb.SetUnreachable (GetRemoteIdentity ()->GetIdentHash (), true);  // assume wrong s key
-			boost::asio::post (m_Server.GetService (), std::bind (&NTCP2Session::Terminate, shared_from_this ()));
+			boost::asio::post (GetService (), std::bind (&NTCP2Session::Terminate, shared_from_this ()));
 		}	
 	}	
 		
@@ -671,13 +711,13 @@ namespace transport
 	{
 		if (!m_Establisher->CreateSessionConfirmedMessagePart1 ()) 
 		{
-			boost::asio::post (m_Server.GetService (), std::bind (&NTCP2Session::Terminate, shared_from_this ()));
+			boost::asio::post (GetService (), std::bind (&NTCP2Session::Terminate, shared_from_this ()));
 			return;
 		}	
 		if (!m_Establisher->CreateSessionConfirmedMessagePart2 ())
 		{
 			LogPrint (eLogWarning, "NTCP2: Send SessionConfirmed Part2 KDF failed");
-			boost::asio::post (m_Server.GetService (), std::bind (&NTCP2Session::Terminate, shared_from_this ()));
+			boost::asio::post (GetService (), std::bind (&NTCP2Session::Terminate, shared_from_this ()));
 			return;
 		}	
 		// send message
@@ -764,27 +804,27 @@ namespace transport
 				if ((*buf)[0] != eNTCP2BlkRouterInfo)
 				{
 					LogPrint (eLogWarning, "NTCP2: Unexpected block ", (int)(*buf)[0], " in SessionConfirmed");
-					boost::asio::post (m_Server.GetService (), std::bind (&NTCP2Session::Terminate, shared_from_this ()));
+					boost::asio::post (GetService (), std::bind (&NTCP2Session::Terminate, shared_from_this ()));
 					return;
 				}
 				auto size = bufbe16toh (buf->data () + 1);
 				if (size > buf->size () - 3 || size > i2p::data::MAX_RI_BUFFER_SIZE + 1)
 				{
 					LogPrint (eLogError, "NTCP2: Unexpected RouterInfo size ", size, " in SessionConfirmed");
-					boost::asio::post (m_Server.GetService (), std::bind (&NTCP2Session::Terminate, shared_from_this ()));
+					boost::asio::post (GetService (), std::bind (&NTCP2Session::Terminate, shared_from_this ()));
 					return;
 				}
-				boost::asio::post (m_Server.GetService (), 
+				boost::asio::post (GetService (), 
 					[s = shared_from_this (), buf, size] ()
 					{
 						s->EstablishSessionAfterSessionConfirmed (buf, size);
 					});
 			}
 			else
-				boost::asio::post (m_Server.GetService (), std::bind (&NTCP2Session::Terminate, shared_from_this ()));
+				boost::asio::post (GetService (), std::bind (&NTCP2Session::Terminate, shared_from_this ()));
 		}
 		else
-			boost::asio::post (m_Server.GetService (), std::bind (&NTCP2Session::Terminate, shared_from_this ()));	
+			boost::asio::post (GetService (), std::bind (&NTCP2Session::Terminate, shared_from_this ()));	
 	}	
 
 	void NTCP2Session::EstablishSessionAfterSessionConfirmed (std::shared_ptr<std::vector<uint8_t> > buf, size_t size)
@@ -1009,7 +1049,7 @@ namespace transport
 			i2p::transport::transports.UpdateReceivedBytes (bytes_transferred + 2);
 			uint8_t nonce[12];
 			CreateNonce (m_ReceiveSequenceNumber, nonce); m_ReceiveSequenceNumber++;
-			if (m_Server.AEADChaCha20Poly1305Decrypt (m_NextReceivedBuffer, m_NextReceivedLen-16, nullptr, 0, m_ReceiveKey, nonce, m_NextReceivedBuffer, m_NextReceivedLen))
+			if (AEADChaCha20Poly1305Decrypt (m_NextReceivedBuffer, m_NextReceivedLen-16, nullptr, 0, m_ReceiveKey, nonce, m_NextReceivedBuffer, m_NextReceivedLen))
 			{
 				LogPrint (eLogDebug, "NTCP2: Received message decrypted");
 				ProcessNextFrame (m_NextReceivedBuffer, m_NextReceivedLen-16);
@@ -1132,21 +1172,34 @@ namespace transport
 		LogPrint (eLogDebug, "NTCP2: Sent length ", frameLen);
 	}
 
-	void NTCP2Session::SendI2NPMsgs (std::vector<std::shared_ptr<I2NPMessage> >& msgs)
+	bool NTCP2Session::EncryptNextFrame (const std::vector<std::pair<uint8_t *, size_t> >& bufs, size_t payloadLen, uint8_t * mac, uint8_t * lengthBuf)
+	{
+		if (payloadLen > NTCP2_UNENCRYPTED_FRAME_MAX_SIZE)
+		{
+			LogPrint (eLogError, "NTCP2: Frame to send is too long ", payloadLen);
+			return false;
+		}
+		uint8_t nonce[12];
+		CreateNonce (m_SendSequenceNumber, nonce); m_SendSequenceNumber++;
+		AEADChaCha20Poly1305Encrypt (bufs, m_SendKey, nonce, mac); // encrypt buffers in place
+		SetNextSentFrameLength (payloadLen + 16, lengthBuf);
+		return true;
+	}
+
+	void NTCP2Session::SendI2NPMsgs (std::vector<std::shared_ptr<I2NPMessage> >& msgs, bool fillSegments)
 	{
 		if (msgs.empty () || IsTerminated ()) return;
 
 		size_t totalLen = 0;
 		std::vector<std::pair<uint8_t *, size_t> > encryptBufs;
 		std::vector<boost::asio::const_buffer> bufs;
-		std::shared_ptr<I2NPMessage> first;
-		uint8_t * macBuf = nullptr;
+		encryptBufs.reserve (msgs.size () + 1); bufs.reserve (msgs.size () + 1);
 		for (auto& it: msgs)
 		{
 			it->ToNTCP2 ();
 			auto buf = it->GetNTCP2Header ();
 			auto len = it->GetNTCP2Length ();
-			// block header
+			// block header in reserved bytes before NTCP2 header
 			buf -= 3;
 			buf[0] = eNTCP2BlkI2NPMessage; // blk
 			htobe16buf (buf + 1, len); // size
@@ -1157,49 +1210,30 @@ namespace transport
 			{
 				// allocate two bytes for length
 				buf -= 2; len += 2;
-				first = it;
 			}
-			if (&it == &msgs.back () && it->len + 16 < it->maxLen) // last message
-			{
-				// if it's long enough we add padding and MAC to it
-				// create padding block
-				auto paddingLen = CreatePaddingBlock (totalLen, buf + len, it->maxLen - it->len - 16);
-				if (paddingLen)
-				{
-					encryptBufs.push_back ( {buf + len, paddingLen} );
-					len += paddingLen;
-					totalLen += paddingLen;
-				}
-				macBuf = buf + len;
-				// allocate 16 bytes for MAC
-				len += 16;
-			}
-
 			bufs.push_back (boost::asio::buffer (buf, len));
 		}
-
-		if (!macBuf) // last block was not enough for MAC
-		{
-			// allocate send buffer
-			m_NextSendBuffer = new uint8_t[287]; // can be any size > 16, we just allocate 287 frequently
-			// create padding block
-			auto paddingLen = CreatePaddingBlock (totalLen, m_NextSendBuffer, 287 - 16);
-			// and padding block to encrypt and send
-			if (paddingLen)
-				encryptBufs.push_back ( {m_NextSendBuffer, paddingLen} );
-			bufs.push_back (boost::asio::buffer (m_NextSendBuffer, paddingLen + 16));
-			macBuf = m_NextSendBuffer + paddingLen;
-			totalLen += paddingLen;
-		}
-		if (totalLen > NTCP2_UNENCRYPTED_FRAME_MAX_SIZE)
-		{
-			LogPrint (eLogError, "NTCP2: Frame to send is too long ", totalLen);
+		// padding and MAC go to the end of last message if there is enough space
+		// otherwise to next send buffer, padding fills last TCP segment if requested
+		auto& last = msgs.back ();
+		size_t tailLen = last->maxLen - last->len;
+		uint8_t * tail = last->buf + last->len;
+		bool isLastMsgTail = tailLen > 16 && (!fillSegments || tailLen >= m_SegmentSize + 3 + 16);
+		if (!isLastMsgTail)
+		{
+			tail = m_NextSendBuffer;
+			tailLen = NTCP2_NEXT_SEND_BUFFER_SIZE;
+		}
+		auto paddingLen = CreatePaddingBlock (totalLen, tail, tailLen - 16, fillSegments);
+		if (paddingLen)
+			encryptBufs.push_back ( {tail, paddingLen} );
+		if (isLastMsgTail)
+			bufs.back () = boost::asio::buffer (bufs.back ().data (), bufs.back ().size () + paddingLen + 16);
+		else
+			bufs.push_back (boost::asio::buffer (tail, paddingLen + 16));
+		totalLen += paddingLen;
+		if (!EncryptNextFrame (encryptBufs, totalLen, tail + paddingLen, msgs.front ()->GetNTCP2Header () - 5)) // frame length right before first block
 			return;
-		}	
-		uint8_t nonce[12];
-		CreateNonce (m_SendSequenceNumber, nonce); m_SendSequenceNumber++;
-		m_Server.AEADChaCha20Poly1305Encrypt (encryptBufs, m_SendKey, nonce, macBuf); // encrypt buffers
-		SetNextSentFrameLength (totalLen + 16, first->GetNTCP2Header () - 5); // frame length right before first block
 
 		// send buffers
 		m_IsSending = true;
@@ -1213,34 +1247,15 @@ namespace transport
 		// msgs get destroyed here
 	}
 
-	void NTCP2Session::EncryptAndSendNextBuffer (size_t payloadLen)
+	void NTCP2Session::HandleRouterInfoSent (const boost::system::error_code& ecode, std::size_t bytes_transferred, std::shared_ptr<i2p::data::RouterInfo::Buffer> riBuffer)
 	{
-		if (IsTerminated ())
-		{
-			delete[] m_NextSendBuffer; m_NextSendBuffer = nullptr;
-			return;
-		}
-		if (payloadLen > NTCP2_UNENCRYPTED_FRAME_MAX_SIZE)
-		{
-			LogPrint (eLogError, "NTCP2: Buffer to send is too long ", payloadLen);
-			delete[] m_NextSendBuffer; m_NextSendBuffer = nullptr;
-			return;
-		}	
-		// encrypt
-		uint8_t nonce[12];
-		CreateNonce (m_SendSequenceNumber, nonce); m_SendSequenceNumber++;
-		m_Server.AEADChaCha20Poly1305Encrypt ({ {m_NextSendBuffer + 2, payloadLen} }, m_SendKey, nonce, m_NextSendBuffer + payloadLen + 2);
-		SetNextSentFrameLength (payloadLen + 16, m_NextSendBuffer);
-		// send
-		m_IsSending = true;
-		boost::asio::async_write (m_Socket, boost::asio::buffer (m_NextSendBuffer, payloadLen + 16 + 2), boost::asio::transfer_all (),
-			std::bind(&NTCP2Session::HandleNextFrameSent, shared_from_this (), std::placeholders::_1, std::placeholders::_2));
+		HandleNextFrameSent (ecode, bytes_transferred);
+		// riBuffer gets destroyed here
 	}
 
 	void NTCP2Session::HandleNextFrameSent (const boost::system::error_code& ecode, std::size_t bytes_transferred)
 	{
 		m_IsSending = false;
-		delete[] m_NextSendBuffer; m_NextSendBuffer = nullptr;
 
 		if (ecode)
 		{
@@ -1256,9 +1271,11 @@ namespace transport
 			if (GetLastActivityTimestamp () > m_NextRouterInfoResendTime)
 			{
 				m_NextRouterInfoResendTime += NTCP2_ROUTERINFO_RESEND_INTERVAL +
-					m_Server.GetRng ()() % NTCP2_ROUTERINFO_RESEND_INTERVAL_THRESHOLD;
-				SendRouterInfo ();
+					GetRng ()() % NTCP2_ROUTERINFO_RESEND_INTERVAL_THRESHOLD;
+				m_IsRouterInfoPending = true;
 			}
+			if (m_IsRouterInfoPending)
+				SendRouterInfo ();
 			else
 			{
 				SendQueue ();
@@ -1282,6 +1299,7 @@ namespace transport
 					// drop null or expired message
 					if (msg) msg->Drop ();
 					m_SendQueue.pop_front ();
+					g_DroppedExpiredMessagesMetric.Inc ();
 					continue;
 				}	
 				size_t len = msg->GetNTCP2Length ();
@@ -1297,12 +1315,13 @@ namespace transport
 				{
 					LogPrint (eLogError, "NTCP2: I2NP message of size ", len, " can't be sent. Dropped");
 					msg->Drop ();
+					g_DroppedTooLongMessagesMetric.Inc ();
 					m_SendQueue.pop_front ();
 				}
 				else
 					break;
 			}
-			SendI2NPMsgs (msgs);
+			SendI2NPMsgs (msgs, !m_SendQueue.empty ()); // bulk peer, more frames follow
 		}
 	}
 
@@ -1321,10 +1340,11 @@ namespace transport
 			other->SendI2NPMessages (msgs);
 	}	
 		
-	size_t NTCP2Session::CreatePaddingBlock (size_t msgLen, uint8_t * buf, size_t len)
+	size_t NTCP2Session::CreatePaddingBlock (size_t msgLen, uint8_t * buf, size_t len, bool fillSegment)
 	{
 		if (len < 3) return 0;
 		len -= 3;
+		size_t frameLen = msgLen + 3 + 16 + 2; // with padding block header, MAC and length
 		if (msgLen < 256) msgLen = 256; // for short message padding should not be always zero
 		size_t paddingSize = (msgLen*NTCP2_MAX_PADDING_RATIO)/100;
 		if (msgLen + paddingSize + 3 > NTCP2_UNENCRYPTED_FRAME_MAX_SIZE) 
@@ -1334,7 +1354,10 @@ namespace transport
 			paddingSize = l;
 		}	
 		if (paddingSize > len) paddingSize = len;
-		if (paddingSize)
+		size_t segmentPaddingSize = fillSegment ? (m_SegmentSize - frameLen % m_SegmentSize) % m_SegmentSize : 0;
+		if (fillSegment && segmentPaddingSize <= paddingSize)
+			paddingSize = segmentPaddingSize; // frame ends at TCP segment boundary
+		else if (paddingSize)
 		{
 			if (m_NextPaddingSize >= 16)
 			{
@@ -1351,25 +1374,38 @@ namespace transport
 
 	void NTCP2Session::SendRouterInfo ()
 	{
-		if (!IsEstablished ()) return;
-		auto riBuffer =  i2p::context.CopyRouterInfoBuffer ();
+		if (!IsEstablished () || IsTerminated ()) return;
+		if (m_IsSending)
+		{
+			// m_NextSendBuffer might hold tail of the frame in flight, send after it
+			m_IsRouterInfoPending = true;
+			return;
+		}
+		m_IsRouterInfoPending = false;
+		auto riBuffer = i2p::context.CopyRouterInfoBuffer (); // own copy, encrypted in place
 		auto riLen = riBuffer->GetBufferLen ();
-		size_t payloadLen = riLen + 3 + 1 + 7; // 3 bytes block header + 1 byte RI flag + 7 bytes DateTime
-		m_NextSendBuffer = new uint8_t[payloadLen + 16 + 2 + 64]; // up to 64 bytes padding
 		// DateTime	block
 		m_NextSendBuffer[2] = eNTCP2BlkDateTime;
 		htobe16buf (m_NextSendBuffer + 3, 4);
 		htobe32buf (m_NextSendBuffer + 5, (i2p::util::GetMillisecondsSinceEpoch () + 500)/1000);
-		// RouterInfo block
+		// RouterInfo block header, RouterInfo itself is sent from riBuffer
 		m_NextSendBuffer[9] = eNTCP2BlkRouterInfo;
 		htobe16buf (m_NextSendBuffer + 10, riLen + 1); // size
 		m_NextSendBuffer[12] = 0; // flag
-		memcpy (m_NextSendBuffer + 13, riBuffer->data (), riLen); // TODO: eliminate extra copy
-		// padding block
-		auto paddingSize = CreatePaddingBlock (payloadLen, m_NextSendBuffer + 2 + payloadLen, 64);
+		size_t payloadLen = riLen + 3 + 1 + 7; // 3 bytes block header + 1 byte RI flag + 7 bytes DateTime
+		// padding block after RouterInfo
+		uint8_t * tail = m_NextSendBuffer + 13;
+		auto paddingSize = CreatePaddingBlock (payloadLen, tail, 64);
 		payloadLen += paddingSize;
 		// encrypt and send
-		EncryptAndSendNextBuffer (payloadLen);
+		if (!EncryptNextFrame ({ {m_NextSendBuffer + 2, 11}, {riBuffer->data (), riLen}, {tail, paddingSize} },
+			payloadLen, tail + paddingSize, m_NextSendBuffer))
+			return;
+		m_IsSending = true;
+		std::vector<boost::asio::const_buffer> bufs{ boost::asio::buffer (m_NextSendBuffer, 13),
+			boost::asio::buffer (riBuffer->data (), riLen), boost::asio::buffer (tail, paddingSize + 16) };
+		boost::asio::async_write (m_Socket, bufs, boost::asio::transfer_all (),
+			std::bind(&NTCP2Session::HandleRouterInfoSent, shared_from_this (), std::placeholders::_1, std::placeholders::_2, riBuffer));
 	}
 
 	void NTCP2Session::SendTermination (NTCP2TerminationReason reason)
@@ -1381,27 +1417,31 @@ namespace transport
 			!m_SendSipKey
 #endif
 		) return;
-		m_NextSendBuffer = new uint8_t[49]; // 49 = 12 bytes message + 16 bytes MAC + 2 bytes size + up to 19 padding block
 		// termination block
-		m_NextSendBuffer[2] = eNTCP2BlkTermination;
-		m_NextSendBuffer[3] = 0; m_NextSendBuffer[4] = 9; // 9 bytes block size
-		htobe64buf (m_NextSendBuffer + 5, m_ReceiveSequenceNumber);
-		m_NextSendBuffer[13] = (uint8_t)reason;
+		m_TerminationBuffer[2] = eNTCP2BlkTermination;
+		m_TerminationBuffer[3] = 0; m_TerminationBuffer[4] = 9; // 9 bytes block size
+		htobe64buf (m_TerminationBuffer + 5, m_ReceiveSequenceNumber);
+		m_TerminationBuffer[13] = (uint8_t)reason;
 		// padding block
-		auto paddingSize = CreatePaddingBlock (12, m_NextSendBuffer + 14, 19);
+		auto payloadLen = CreatePaddingBlock (12, m_TerminationBuffer + 14, 19) + 12;
 		// encrypt and send
-		EncryptAndSendNextBuffer (paddingSize + 12);
+		if (IsTerminated () || !EncryptNextFrame ({ {m_TerminationBuffer + 2, payloadLen} }, payloadLen,
+			m_TerminationBuffer + payloadLen + 2, m_TerminationBuffer))
+			return;
+		m_IsSending = true;
+		boost::asio::async_write (m_Socket, boost::asio::buffer (m_TerminationBuffer, payloadLen + 16 + 2), boost::asio::transfer_all (),
+			std::bind(&NTCP2Session::HandleNextFrameSent, shared_from_this (), std::placeholders::_1, std::placeholders::_2));
 	}
 
 	void NTCP2Session::SendTerminationAndTerminate (NTCP2TerminationReason reason)
 	{
 		SendTermination (reason);
-		boost::asio::post (m_Server.GetService (), std::bind (&NTCP2Session::Terminate, shared_from_this ())); // let termination message go
+		boost::asio::post (GetService (), std::bind (&NTCP2Session::Terminate, shared_from_this ())); // let termination message go
 	}
 
 	void NTCP2Session::ReadSomethingAndTerminate ()
 	{
-		size_t len = m_Server.GetRng ()() % NTCP2_SESSION_REQUEST_MAX_SIZE;
+		size_t len = GetRng ()() % NTCP2_SESSION_REQUEST_MAX_SIZE;
 		if (len > 0 && m_Establisher)
 			boost::asio::async_read (m_Socket, boost::asio::buffer(m_Establisher->m_SessionRequestBuffer, len), boost::asio::transfer_all (),
 				[s = shared_from_this()](const boost::system::error_code& ecode, size_t bytes_transferred)
@@ -1409,7 +1449,7 @@ namespace transport
 					s->Terminate ();
 				});
 		else
-			boost::asio::post (m_Server.GetService (), std::bind (&NTCP2Session::Terminate, shared_from_this ()));
+			boost::asio::post (GetService (), std::bind (&NTCP2Session::Terminate, shared_from_this ()));
 	}	
 		
 	void NTCP2Session::SendI2NPMessages (std::list<std::shared_ptr<I2NPMessage> >& msgs)
@@ -1426,7 +1466,7 @@ namespace transport
 			m_IntermediateQueue.splice (m_IntermediateQueue.end (), msgs);
 		}
 		if (empty)
-			boost::asio::post (m_Server.GetService (), std::bind (&NTCP2Session::PostI2NPMessages, shared_from_this ()));
+			boost::asio::post (GetService (), std::bind (&NTCP2Session::PostI2NPMessages, shared_from_this ()));
 	}
 
 	void NTCP2Session::PostI2NPMessages ()
@@ -1442,7 +1482,10 @@ namespace transport
 		{	
 			for (auto it: msgs)
 				if (it->onDrop)
+				{
 					it->Drop (); // drop earlier because we can handle it
+					g_DroppedSemiFullMessagesMetric.Inc ();
+				}
 				else
 					m_SendQueue.push_back (std::move (it));
 		}	
@@ -1463,7 +1506,7 @@ namespace transport
 	void NTCP2Session::SendLocalRouterInfo (bool update)
 	{
 		if (update || !IsOutgoing ()) // we send it in SessionConfirmed for outgoing session
-			boost::asio::post (m_Server.GetService (), std::bind (&NTCP2Session::SendRouterInfo, shared_from_this ()));
+			boost::asio::post (GetService (), std::bind (&NTCP2Session::SendRouterInfo, shared_from_this ()));
 	}
 
 	i2p::data::RouterInfo::SupportedTransports NTCP2Session::GetTransportType () const
@@ -1472,9 +1515,14 @@ namespace transport
 		return i2p::util::net::IsYggdrasilAddress (m_RemoteEndpoint.address ()) ? i2p::data::RouterInfo::eNTCP2V6Mesh : i2p::data::RouterInfo::eNTCP2V6;
 	}	
 		
+	NTCP2SessionsService::NTCP2SessionsService (const std::string& name):
+		RunnableServiceWithWork (name), m_Rng(i2p::util::GetMonotonicMicroseconds ()%1000000LL)
+	{
+	}
+
 	NTCP2Server::NTCP2Server ():
 		RunnableServiceWithWork ("NTCP2"), m_TerminationTimer (GetService ()),
-		m_ProxyType(eNoProxy), m_Resolver(GetService ()),
+		m_NextSessionsService (0), m_ProxyType(eNoProxy), m_Resolver(GetService ()),
 		m_Rng(i2p::util::GetMonotonicMicroseconds ()%1000000LL)
 	{
 	}
@@ -1490,6 +1538,17 @@ namespace transport
 		if (!IsRunning ())
 		{
 			StartIOService ();
+			if (m_SessionsServices.empty ())
+			{
+				uint16_t numThreads; i2p::config::GetOption ("ntcp2.threads", numThreads);
+				if (numThreads > NTCP2_MAX_NUM_SESSIONS_THREADS) numThreads = NTCP2_MAX_NUM_SESSIONS_THREADS;
+				for (int i = 0; i < numThreads; i++)
+					m_SessionsServices.emplace_back (new NTCP2SessionsService ("NTCP2s" + std::to_string (i)));
+				if (numThreads)
+					LogPrint (eLogInfo, "NTCP2: Using ", numThreads, " sessions threads");
+			}
+			for (auto& it: m_SessionsServices)
+				it->Start ();
 			if(UsingProxy())
 			{
 				LogPrint(eLogInfo, "NTCP2: Using proxy to connect to peers");
@@ -1586,15 +1645,29 @@ namespace transport
 	void NTCP2Server::Stop ()
 	{
 		m_EstablisherService.Stop ();
+		for (auto& it: m_SessionsServices)
+			it->Stop ();
 		{
 			// we have to copy it because Terminate changes m_NTCP2Sessions
-			auto ntcpSessions = m_NTCP2Sessions;
+			decltype(m_NTCP2Sessions) ntcpSessions;
+			{
+				std::lock_guard<std::mutex> l(m_NTCP2SessionsMutex);
+				ntcpSessions = m_NTCP2Sessions;
+			}
 			for (auto& it: ntcpSessions)
 				it.second->Terminate ();
-			for (auto& it: m_PendingIncomingSessions)
+			decltype(m_PendingIncomingSessions) pendingSessions;
+			{
+				std::lock_guard<std::mutex> l(m_PendingIncomingSessionsMutex);
+				m_PendingIncomingSessions.swap (pendingSessions);
+			}
+			for (auto& it: pendingSessions)
 				it.second->Terminate ();
 		}
-		m_NTCP2Sessions.clear ();
+		{
+			std::lock_guard<std::mutex> l(m_NTCP2SessionsMutex);
+			m_NTCP2Sessions.clear ();
+		}
 
 		if (IsRunning ())
 		{
@@ -1608,7 +1681,10 @@ namespace transport
 	{
 		if (!session) return false;
 		if (incoming)
+		{
+			std::lock_guard<std::mutex> l(m_PendingIncomingSessionsMutex);
 			m_PendingIncomingSessions.erase (session->GetRemoteEndpoint ().address ());
+		}
 		if (!session->GetRemoteIdentity ())
 		{
 			LogPrint (eLogWarning, "NTCP2: Unknown identity for ", session->GetRemoteEndpoint ());
@@ -1616,25 +1692,36 @@ namespace transport
 			return false;
 		}
 		auto& ident = session->GetRemoteIdentity ()->GetIdentHash ();
-		auto it = m_NTCP2Sessions.find (ident);
-		if (it != m_NTCP2Sessions.end ())
+		std::shared_ptr<NTCP2Session> replaced;
 		{
-			LogPrint (eLogWarning, "NTCP2: Session with ", ident.ToBase64 (), " already exists. ", incoming ? "Replaced" : "Dropped");
-			if (incoming)
-			{
-				// replace by new session
-				auto s = it->second;
-				s->MoveSendQueue (session);
-				m_NTCP2Sessions.erase (it);
-				s->Terminate ();
-			}
-			else
+			std::lock_guard<std::mutex> l(m_NTCP2SessionsMutex);
+			auto it = m_NTCP2Sessions.find (ident);
+			if (it != m_NTCP2Sessions.end ())
 			{
-				session->Terminate ();
-				return false;
+				LogPrint (eLogWarning, "NTCP2: Session with ", ident.ToBase64 (), " already exists. ", incoming ? "Replaced" : "Dropped");
+				if (!incoming) replaced = session; // terminate outside of lock
+				else
+				{
+					// replace by new session
+					replaced = it->second;
+					m_NTCP2Sessions.erase (it);
+				}
 			}
+			if (replaced != session)
+				m_NTCP2Sessions.emplace (ident, session);
+		}
+		if (replaced == session)
+		{
+			session->Terminate ();
+			return false;
 		}
-		m_NTCP2Sessions.emplace (ident, session);
+		if (replaced)
+			// old session might run on another thread
+			boost::asio::post (replaced->GetService (), [replaced, session]()
+				{
+					replaced->MoveSendQueue (session);
+					replaced->Terminate ();
+				});
 		return true;
 	}
 
@@ -1642,6 +1729,7 @@ namespace transport
 	{
 		if (session && session->GetRemoteIdentity ())
 		{
+			std::lock_guard<std::mutex> l(m_NTCP2SessionsMutex);
 			auto it = m_NTCP2Sessions.find (session->GetRemoteIdentity ()->GetIdentHash ());
 			if (it != m_NTCP2Sessions.end () && it->second == session)
 				m_NTCP2Sessions.erase (it);
@@ -1650,6 +1738,7 @@ namespace transport
 
 	std::shared_ptr<NTCP2Session> NTCP2Server::FindNTCP2Session (const i2p::data::IdentHash& ident)
 	{
+		std::lock_guard<std::mutex> l(m_NTCP2SessionsMutex);
 		auto it = m_NTCP2Sessions.find (ident);
 		if (it != m_NTCP2Sessions.end ())
 			return it->second;
@@ -1665,11 +1754,11 @@ namespace transport
 		}
 		LogPrint (eLogDebug, "NTCP2: Connecting to ", conn->GetRemoteEndpoint (),
 			" (", i2p::data::GetIdentHashAbbreviation (conn->GetRemoteIdentity ()->GetIdentHash ()), ")");
-		boost::asio::post (GetService (), [this, conn]()
+		boost::asio::post (conn->GetService (), [this, conn]()
 			{
 				if (this->AddNTCP2Session (conn))
 				{
-					auto timer = std::make_shared<boost::asio::deadline_timer>(GetService ());
+					auto timer = std::make_shared<boost::asio::deadline_timer>(conn->GetService ());
 					auto timeout = NTCP2_CONNECT_TIMEOUT * 5;
 					conn->SetTerminationTimeout(timeout * 2);
 					timer->expires_from_now (boost::posix_time::seconds(timeout));
@@ -1737,10 +1826,15 @@ namespace transport
 				LogPrint (eLogDebug, "NTCP2: Connected from ", ep);
 				if (!i2p::transport::transports.IsInReservedRange(ep.address ()))
 				{
-					if (m_PendingIncomingSessions.emplace (ep.address (), conn).second)
+					bool isNew;
+					{
+						std::lock_guard<std::mutex> l(m_PendingIncomingSessionsMutex);
+						isNew = m_PendingIncomingSessions.emplace (ep.address (), conn).second;
+					}
+					if (isNew)
 					{
 						conn->SetRemoteEndpoint (ep);
-						conn->ServerLogin ();
+						boost::asio::post (conn->GetService (), std::bind (&NTCP2Session::ServerLogin, conn));
 						conn = nullptr;
 					}
 					else
@@ -1785,10 +1879,15 @@ namespace transport
 				if (!i2p::transport::transports.IsInReservedRange(ep.address ()) ||
 				    i2p::util::net::IsYggdrasilAddress (ep.address ()))
 				{
-					if (m_PendingIncomingSessions.emplace (ep.address (), conn).second)
+					bool isNew;
+					{
+						std::lock_guard<std::mutex> l(m_PendingIncomingSessionsMutex);
+						isNew = m_PendingIncomingSessions.emplace (ep.address (), conn).second;
+					}
+					if (isNew)
 					{
 						conn->SetRemoteEndpoint (ep);
-						conn->ServerLogin ();
+						boost::asio::post (conn->GetService (), std::bind (&NTCP2Session::ServerLogin, conn));
 						conn = nullptr;
 					}
 					else
@@ -1834,28 +1933,36 @@ namespace transport
 		if (ecode != boost::asio::error::operation_aborted)
 		{
 			auto ts = i2p::util::GetSecondsSinceEpoch ();
-			// established
-			for (auto& it: m_NTCP2Sessions)
-				if (it.second->IsTerminationTimeoutExpired (ts))
+			// established, sessions are processed by own threads
+			{
+				std::lock_guard<std::mutex> l(m_NTCP2SessionsMutex);
+				for (auto& it: m_NTCP2Sessions)
 				{
 					auto session = it.second;
-					LogPrint (eLogDebug, "NTCP2: No activity for ", session->GetTerminationTimeout (), " seconds");
-					session->TerminateByTimeout (); // it doesn't change m_NTCP2Session right a way
+					if (session->IsTerminationTimeoutExpired (ts))
+					{
+						LogPrint (eLogDebug, "NTCP2: No activity for ", session->GetTerminationTimeout (), " seconds");
+						boost::asio::post (session->GetService (), std::bind (&NTCP2Session::TerminateByTimeout, session));
+					}
+					else
+						boost::asio::post (session->GetService (), std::bind (&NTCP2Session::DeleteNextReceiveBuffer, session, ts));
 				}
-				else
-					it.second->DeleteNextReceiveBuffer (ts);
+			}
 			// pending
-			for (auto it = m_PendingIncomingSessions.begin (); it != m_PendingIncomingSessions.end ();)
 			{
-				if (it->second->IsEstablished () || it->second->IsTerminationTimeoutExpired (ts))
+				std::lock_guard<std::mutex> l(m_PendingIncomingSessionsMutex);
+				for (auto it = m_PendingIncomingSessions.begin (); it != m_PendingIncomingSessions.end ();)
 				{
-					it->second->Terminate ();
-					it = m_PendingIncomingSessions.erase (it); // established of expired
+					if (it->second->IsEstablished () || it->second->IsTerminationTimeoutExpired (ts))
+					{
+						it->second->Done ();
+						it = m_PendingIncomingSessions.erase (it); // established of expired
+					}
+					else if (it->second->IsTerminated ())
+						it = m_PendingIncomingSessions.erase (it); // already terminated
+					else
+						it++;
 				}
-				else if (it->second->IsTerminated ())
-					it = m_PendingIncomingSessions.erase (it); // already terminated
-				else
-					it++;
 			}
 			ScheduleTermination ();
 
@@ -1886,11 +1993,11 @@ namespace transport
 			LogPrint (eLogError, "NTCP2: Can't connect to unspecified address");
 			return;
 		}
-		boost::asio::post (GetService(), [this, conn]()
+		boost::asio::post (conn->GetService (), [this, conn]()
 		{
 			if (this->AddNTCP2Session (conn))
 			{
-				auto timer = std::make_shared<boost::asio::deadline_timer>(GetService());
+				auto timer = std::make_shared<boost::asio::deadline_timer>(conn->GetService ());
 				auto timeout = NTCP2_CONNECT_TIMEOUT * 5;
 				conn->SetTerminationTimeout(timeout * 2);
 				timer->expires_from_now (boost::posix_time::seconds(timeout));
@@ -2022,6 +2129,12 @@ namespace transport
 			m_Address4 = addr;
 	}
 
+	NTCP2SessionsService * NTCP2Server::GetNextSessionsService ()
+	{
+		if (m_SessionsServices.empty ()) return nullptr;
+		return m_SessionsServices[m_NextSessionsService.fetch_add (1, std::memory_order_relaxed) % m_SessionsServices.size ()].get ();
+	}
+
 	void NTCP2Server::AEADChaCha20Poly1305Encrypt (const std::vector<std::pair<uint8_t *, size_t> >& bufs, 
 		const uint8_t * key, const uint8_t * nonce, uint8_t * mac)
 	{
@@ -15,6 +15,8 @@
 #include <map>
 #include <array>
 #include <random>
+#include <mutex>
+#include <atomic>
 #include <openssl/bn.h>
 #include <openssl/evp.h>
 #include <boost/asio.hpp>
@@ -33,6 +35,9 @@ namespace transport
 	const size_t NTCP2_SESSION_REQUEST_MAX_SIZE = 287;
 	const size_t NTCP2_SESSION_CREATED_MAX_SIZE = 287;
 	const int NTCP2_MAX_PADDING_RATIO = 6; // in %
+	const size_t NTCP2_NEXT_SEND_BUFFER_SIZE = 1536; // padding up to TCP segment and MAC, or RouterInfo frame headers
+	const size_t NTCP2_TERMINATION_BUFFER_SIZE = 49; // 12 bytes block + 16 bytes MAC + 2 bytes size + up to 19 padding block
+	const size_t NTCP2_DEFAULT_SEGMENT_SIZE = 1448; // 1500 MTU - IPv4 and TCP headers with timestamps
 
 	const int NTCP2_CONNECT_TIMEOUT = 5; // 5 seconds
 	const int NTCP2_ESTABLISH_TIMEOUT = 10; // 10 seconds
@@ -46,6 +51,7 @@ namespace transport
 
 	const int NTCP2_CLOCK_SKEW = 60; // in seconds
 	const int NTCP2_MAX_OUTGOING_QUEUE_SIZE = 500; // how many messages we can queue up
+	const int NTCP2_MAX_NUM_SESSIONS_THREADS = 64;
 
 	enum NTCP2BlockType
 	{
@@ -127,6 +133,25 @@ namespace transport
 
 	};
 
+	class NTCP2SessionsService: public i2p::util::RunnableServiceWithWork // runs data phase of sessions pinned to it
+	{
+		public:
+
+			NTCP2SessionsService (const std::string& name);
+			auto& GetService () { return GetIOService (); };
+			void Start () { StartIOService (); };
+			void Stop () { StopIOService (); };
+			std::mt19937& GetRng () { return m_Rng; };
+			i2p::crypto::AEADChaCha20Poly1305Encryptor& GetEncryptor () { return m_Encryptor; };
+			i2p::crypto::AEADChaCha20Poly1305Decryptor& GetDecryptor () { return m_Decryptor; };
+
+		private:
+
+			std::mt19937 m_Rng;
+			i2p::crypto::AEADChaCha20Poly1305Encryptor m_Encryptor;
+			i2p::crypto::AEADChaCha20Poly1305Decryptor m_Decryptor;
+	};
+
 	class NTCP2Server;
 	class NTCP2Session: public TransportSession, public std::enable_shared_from_this<NTCP2Session>
 	{
@@ -141,6 +166,7 @@ namespace transport
 			void Close (); // for accept
 			void DeleteNextReceiveBuffer (uint64_t ts);
 
+			boost::asio::io_context& GetService ();
 			boost::asio::ip::tcp::socket& GetSocket () { return m_Socket; };
 			const boost::asio::ip::tcp::endpoint& GetRemoteEndpoint () { return m_RemoteEndpoint; };
 			void SetRemoteEndpoint (const boost::asio::ip::tcp::endpoint& ep) { m_RemoteEndpoint = ep; };
@@ -160,6 +186,12 @@ namespace transport
 
 			void Established ();
 
+			std::mt19937& GetRng ();
+			void AEADChaCha20Poly1305Encrypt (const std::vector<std::pair<uint8_t *, size_t> >& bufs,
+				const uint8_t * key, const uint8_t * nonce, uint8_t * mac);
+			bool AEADChaCha20Poly1305Decrypt (const uint8_t * msg, size_t msgLen, const uint8_t * ad, size_t adLen,
+				const uint8_t * key, const uint8_t * nonce, uint8_t * buf, size_t len);
+
 			void CreateNonce (uint64_t seqn, uint8_t * nonce);
 			void CreateNextReceivedBuffer (size_t size);
 			void KeyDerivationFunctionDataPhase ();
@@ -191,11 +223,12 @@ namespace transport
 			void ProcessNextFrame (const uint8_t * frame, size_t len);
 
 			void SetNextSentFrameLength (size_t frameLen, uint8_t * lengthBuf);
-			void SendI2NPMsgs (std::vector<std::shared_ptr<I2NPMessage> >& msgs);
+			bool EncryptNextFrame (const std::vector<std::pair<uint8_t *, size_t> >& bufs, size_t payloadLen, uint8_t * mac, uint8_t * lengthBuf);
+			void SendI2NPMsgs (std::vector<std::shared_ptr<I2NPMessage> >& msgs, bool fillSegments = false);
 			void HandleI2NPMsgsSent (const boost::system::error_code& ecode, std::size_t bytes_transferred, std::vector<std::shared_ptr<I2NPMessage> > msgs);
-			void EncryptAndSendNextBuffer (size_t payloadLen);
+			void HandleRouterInfoSent (const boost::system::error_code& ecode, std::size_t bytes_transferred, std::shared_ptr<i2p::data::RouterInfo::Buffer> riBuffer);
 			void HandleNextFrameSent (const boost::system::error_code& ecode, std::size_t bytes_transferred);
-			size_t CreatePaddingBlock (size_t msgLen, uint8_t * buf, size_t len);
+			size_t CreatePaddingBlock (size_t msgLen, uint8_t * buf, size_t len, bool fillSegment = false);
 			void SendQueue ();
 			void SendRouterInfo ();
 			void SendTermination (NTCP2TerminationReason reason);
@@ -206,6 +239,7 @@ namespace transport
 		private:
 
 			NTCP2Server& m_Server;
+			NTCP2SessionsService * m_SessionsService; // nullptr means NTCP2 thread
 			boost::asio::ip::tcp::socket m_Socket;
 			boost::asio::ip::tcp::endpoint m_RemoteEndpoint;
 			bool m_IsEstablished, m_IsTerminated;
@@ -220,8 +254,10 @@ namespace transport
 			const uint8_t * m_SendSipKey, * m_ReceiveSipKey;
 #endif
 			uint16_t m_NextReceivedLen;
-			uint8_t * m_NextReceivedBuffer, * m_NextSendBuffer;
+			uint8_t * m_NextReceivedBuffer;
 			size_t m_NextReceivedBufferSize;
+			uint8_t m_NextSendBuffer[NTCP2_NEXT_SEND_BUFFER_SIZE], m_TerminationBuffer[NTCP2_TERMINATION_BUFFER_SIZE]; // reused, one frame in flight
+			size_t m_SegmentSize; // TCP MSS
 			union
 			{
 				uint8_t buf[8];
@@ -231,7 +267,7 @@ namespace transport
 
 			i2p::I2NPMessagesHandler m_Handler;
 
-			bool m_IsSending, m_IsReceiving;
+			bool m_IsSending, m_IsReceiving, m_IsRouterInfoPending; // RouterInfo waits for frame in flight
 			std::list<std::shared_ptr<I2NPMessage> > m_SendQueue;
 			uint64_t m_NextRouterInfoResendTime; // seconds since epoch
 			
@@ -277,7 +313,8 @@ namespace transport
 				const uint8_t * key, const uint8_t * nonce, uint8_t * mac);
 			bool AEADChaCha20Poly1305Decrypt (const uint8_t * msg, size_t msgLen, const uint8_t * ad, size_t adLen,
 				const uint8_t * key, const uint8_t * nonce, uint8_t * buf, size_t len); 
-			
+			NTCP2SessionsService * GetNextSessionsService (); // round-robin, nullptr if no sessions threads
+
 
 			bool AddNTCP2Session (std::shared_ptr<NTCP2Session> session, bool incoming = false);
 			void RemoveNTCP2Session (std::shared_ptr<NTCP2Session> session);
@@ -306,9 +343,12 @@ namespace transport
 		private:
 
 			boost::asio::deadline_timer m_TerminationTimer;
+			std::vector<std::unique_ptr<NTCP2SessionsService> > m_SessionsServices; // must outlive sessions
+			std::atomic<size_t> m_NextSessionsService;
 			std::unique_ptr<boost::asio::ip::tcp::acceptor> m_NTCP2Acceptor, m_NTCP2V6Acceptor;
 			std::map<i2p::data::IdentHash, std::shared_ptr<NTCP2Session> > m_NTCP2Sessions;
 			std::map<boost::asio::ip::address, std::shared_ptr<NTCP2Session> > m_PendingIncomingSessions;
+			mutable std::mutex m_NTCP2SessionsMutex, m_PendingIncomingSessionsMutex;
 
 			ProxyType m_ProxyType;
 			std::string m_ProxyAddress, m_ProxyAuthorization;
@@ -326,6 +366,11 @@ namespace transport
 
 			// for HTTP/I2PControl
 			const decltype(m_NTCP2Sessions)& GetNTCP2Sessions () const { return m_NTCP2Sessions; };
+			size_t GetNumNTCP2Sessions () const
+			{
+				std::lock_guard<std::mutex> l(m_NTCP2SessionsMutex);
+				return m_NTCP2Sessions.size ();
+			};
 	};
 }
 }
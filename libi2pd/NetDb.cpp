@@ -9,7 +9,9 @@
 #include <string.h>
 #include <fstream>
 #include <vector>
+#include <deque>
 #include <map>
+#include <atomic>
 #include <boost/asio.hpp>
 #include <stdexcept>
 
@@ -26,6 +28,8 @@
 #include "Garlic.h"
 #include "ECIESX25519AEADRatchetSession.h"
 #include "Config.h"
+#include "Metrics.h"
+#include "Ed25519Batch.h"
 #include "NetDb.hpp"
 #include "util.h"
 
@@ -35,11 +39,46 @@ namespace i2p
 {
 namespace data
 {
+	static auto& g_StoreMsgsMetric = i2p::metrics::GetRegistry ().GetCounter ("netdb_messages_total",
+		"NetDb messages handled", "type=\"store\"");
+	static auto& g_LookupMsgsMetric = i2p::metrics::GetRegistry ().GetCounter ("netdb_messages_total",
+		"NetDb messages handled", "type=\"lookup\"");
+
+	bool RandomAccessRouters::Insert (std::shared_ptr<RouterInfo> r)
+	{
+		if (!r) return false;
+		if (!m_Indices.emplace (r->GetIdentHash (), m_Routers.size ()).second) return false;
+		m_Routers.push_back (r);
+		return true;
+	}
+
+	bool RandomAccessRouters::Remove (const IdentHash& ident)
+	{
+		auto it = m_Indices.find (ident);
+		if (it == m_Indices.end ()) return false;
+		size_t ind = it->second;
+		m_Indices.erase (it);
+		if (ind + 1 < m_Routers.size ())
+		{
+			// move last to the removed place
+			m_Routers[ind] = std::move (m_Routers.back ());
+			m_Indices[m_Routers[ind]->GetIdentHash ()] = ind;
+		}
+		m_Routers.pop_back ();
+		return true;
+	}
+
+	void RandomAccessRouters::Clear ()
+	{
+		m_Routers.clear ();
+		m_Indices.clear ();
+	}
+
 	NetDb netdb;
 
 	NetDb::NetDb (): m_IsRunning (false), m_Thread (nullptr), m_Reseeder (nullptr), 
-		m_Storage("netDb", "r", "routerInfo-", "dat"), m_PersistProfiles (true),
-		m_LastExploratorySelectionUpdateTime (0), m_Rng(i2p::util::GetMonotonicMicroseconds () % 1000000LL)
+		m_Storage("netDb", "r", "routerInfo-", "dat"), m_PersistProfiles (true), m_UseSnapshot (false),
+		m_LastSnapshotTime (0), m_LastExploratorySelectionUpdateTime (0), m_Rng(i2p::util::GetMonotonicMicroseconds () % 1000000LL)
 	{
 	}
 
@@ -55,6 +94,7 @@ namespace data
 		m_Storage.Init(i2p::data::GetBase64SubstitutionTable(), 64);
 		InitProfilesStorage ();
 		m_Families.LoadCertificates ();
+		i2p::config::GetOption("persist.netdbsnapshot", m_UseSnapshot);
 		Load ();
 
 		if (!m_Requests)
@@ -76,10 +116,10 @@ namespace data
 		{
 			// remove own router
 			m_Floodfills.Remove (it->second->GetIdentHash ());
-			m_RouterInfos.erase (it);
+			EraseRouterInfo (i2p::context.GetIdentHash ());
 		}
 		// insert own router
-		m_RouterInfos.emplace (i2p::context.GetIdentHash (), i2p::context.GetSharedRouterInfo ());
+		InsertRouterInfo (i2p::context.GetSharedRouterInfo ());
 		if (i2p::context.IsFloodfill ())
 			m_Floodfills.Insert (i2p::context.GetSharedRouterInfo ());
 
@@ -87,6 +127,20 @@ namespace data
 		
 		m_IsRunning = true;
 		m_Thread = new std::thread (std::bind (&NetDb::Run, this));
+		RegisterMetrics ();
+	}
+
+	void NetDb::RegisterMetrics ()
+	{
+		auto& registry = i2p::metrics::GetRegistry ();
+		registry.SetCallback ("netdb_routers", "Known routers", i2p::metrics::eMetricTypeGauge,
+			[this]() { return (int64_t)GetNumRouters (); });
+		registry.SetCallback ("netdb_floodfills", "Known floodfills", i2p::metrics::eMetricTypeGauge,
+			[this]() { return (int64_t)GetNumFloodfills (); });
+		registry.SetCallback ("netdb_leasesets", "Known LeaseSets", i2p::metrics::eMetricTypeGauge,
+			[this]() { return (int64_t)GetNumLeaseSets (); });
+		registry.SetCallback ("netdb_queue_size", "NetDb messages waiting for processing", i2p::metrics::eMetricTypeGauge,
+			[this]() { return (int64_t)m_Queue.GetSize (); });
 	}
 
 	void NetDb::Stop ()
@@ -98,8 +152,6 @@ namespace data
 			if (m_PersistProfiles)
 				SaveProfiles ();
 			DeleteObsoleteProfiles ();
-			m_RouterInfos.clear ();
-			m_Floodfills.Clear ();
 			if (m_Thread)
 			{
 				m_IsRunning = false;
@@ -108,6 +160,10 @@ namespace data
 				delete m_Thread;
 				m_Thread = 0;
 			}
+			if (m_UseSnapshot)
+				SaveSnapshot ();
+			ClearRouterInfos ();
+			m_Floodfills.Clear ();
 			m_LeaseSets.clear();
 		}
 		m_Requests = nullptr;
@@ -122,7 +178,7 @@ namespace data
 			lastObsoleteProfilesCleanup = lastProfilesCleanup, lastApplyingProfileUpdates = lastProfilesCleanup;
 		int16_t profilesCleanupVariance = 0, obsoleteProfilesCleanVariance = 0, applyingProfileUpdatesVariance = 0;
 
-		std::list<std::shared_ptr<const I2NPMessage> > msgs;
+		std::deque<std::shared_ptr<const I2NPMessage> > msgs;
 		while (m_IsRunning)
 		{
 			try
@@ -130,6 +186,7 @@ namespace data
 				if (m_Queue.Wait (1,0)) // 1 sec
 				{
 					m_Queue.GetWholeQueue (msgs);
+					VerifyRouterInfos (msgs);
 					while (!msgs.empty ())
 					{
 						auto msg = msgs.front (); msgs.pop_front ();
@@ -148,6 +205,7 @@ namespace data
 								//i2p::HandleI2NPMessage (msg);
 						}
 					}
+					m_VerifiedRouterInfos.clear ();
 				}
 				if (!m_IsRunning) break;
 				if (!i2p::transport::transports.IsOnline () || !i2p::transport::transports.IsRunning ()) 
@@ -243,7 +301,26 @@ namespace data
 		return updated;
 	}
 
-	std::shared_ptr<const RouterInfo> NetDb::AddRouterInfo (const IdentHash& ident, const uint8_t * buf, int len, bool& updated)
+	void NetDb::AddRouterInfos (const std::vector<std::vector<uint8_t> >& routerInfos)
+	{
+		std::vector<std::pair<const uint8_t *, size_t> > buffers;
+		buffers.reserve (routerInfos.size ());
+		for (const auto& it: routerInfos)
+			buffers.emplace_back (it.data (), it.size ());
+		std::vector<bool> verified;
+		RouterInfo::VerifySignatures (buffers, verified);
+		for (size_t i = 0; i < buffers.size (); i++)
+		{
+			IdentityEx identity;
+			if (identity.FromBuffer (buffers[i].first, buffers[i].second))
+			{
+				bool updated;
+				AddRouterInfo (identity.GetIdentHash (), buffers[i].first, buffers[i].second, updated, verified[i]);
+			}
+		}
+	}
+
+	std::shared_ptr<const RouterInfo> NetDb::AddRouterInfo (const IdentHash& ident, const uint8_t * buf, int len, bool& updated, bool isVerified)
 	{
 		updated = true;
 		auto r = FindRouter (ident);
@@ -254,17 +331,18 @@ namespace data
 				bool wasFloodfill = r->IsFloodfill ();
 				{
 					std::lock_guard<std::mutex> l(m_RouterInfosMutex);
-					if (!r->Update (buf, len))
+					if (!r->Update (buf, len, isVerified))
 					{
 						updated = false;
 						m_Requests->RequestComplete (ident, r);
 						return r;
 					}
+					UpdateRandomRouters (r);
 					if (r->IsUnreachable () ||
 					    i2p::util::GetMillisecondsSinceEpoch () + NETDB_EXPIRATION_TIMEOUT_THRESHOLD*1000LL < r->GetTimestamp ())
 					{
 						// delete router as invalid or from future after update
-						m_RouterInfos.erase (ident);
+						EraseRouterInfo (ident);
 						if (wasFloodfill)
 						{
 							std::lock_guard<std::mutex> l(m_FloodfillsMutex);
@@ -302,7 +380,7 @@ namespace data
 		}
 		else
 		{
-			r = std::make_shared<RouterInfo> (buf, len);
+			r = std::make_shared<RouterInfo> (buf, len, isVerified);
 			bool isValid = !r->IsUnreachable () && r->HasValidAddresses () && (!r->IsFloodfill () || !r->GetProfile ()->IsUnreachable ());
 			if (isValid)
 			{
@@ -316,7 +394,7 @@ namespace data
 				bool inserted = false;
 				{
 					std::lock_guard<std::mutex> l(m_RouterInfosMutex);
-					inserted = m_RouterInfos.insert ({r->GetIdentHash (), r}).second;
+					inserted = InsertRouterInfo (r);
 				}
 				if (inserted)
 				{
@@ -418,6 +496,37 @@ namespace data
 		return false;
 	}
 
+	bool NetDb::InsertRouterInfo (std::shared_ptr<RouterInfo> r)
+	{
+		if (!m_RouterInfos.emplace (r->GetIdentHash (), r).second) return false;
+		m_RandomRouters.Insert (r);
+		if (r->GetCaps () & RouterInfo::eHighBandwidth)
+			m_HighBandwidthRandomRouters.Insert (r);
+		return true;
+	}
+
+	void NetDb::EraseRouterInfo (const IdentHash& ident)
+	{
+		m_RouterInfos.erase (ident);
+		m_RandomRouters.Remove (ident);
+		m_HighBandwidthRandomRouters.Remove (ident);
+	}
+
+	void NetDb::UpdateRandomRouters (std::shared_ptr<RouterInfo> r)
+	{
+		if (r->GetCaps () & RouterInfo::eHighBandwidth)
+			m_HighBandwidthRandomRouters.Insert (r); // does nothing if already there
+		else
+			m_HighBandwidthRandomRouters.Remove (r->GetIdentHash ());
+	}
+
+	void NetDb::ClearRouterInfos ()
+	{
+		m_RouterInfos.clear ();
+		m_RandomRouters.Clear ();
+		m_HighBandwidthRandomRouters.Clear ();
+	}
+
 	std::shared_ptr<RouterInfo> NetDb::FindRouter (const IdentHash& ident) const
 	{
 		std::lock_guard<std::mutex> l(m_RouterInfosMutex);
@@ -519,25 +628,50 @@ namespace data
 		i2p::transport::transports.SendMessages(ih, std::move (requests));
 	}
 
-	bool NetDb::LoadRouterInfo (const std::string& path, uint64_t ts)
+	static int GetNumLoadThreads ()
+	{
+		int numThreads = std::thread::hardware_concurrency ();
+		if (numThreads < 2) numThreads = 2; // disk reads overlap parsing even on single core
+		if (numThreads > NETDB_MAX_LOAD_THREADS) numThreads = NETDB_MAX_LOAD_THREADS;
+		return numThreads;
+	}
+
+	static NetDbSnapshotEntry CreateSnapshotEntry (const RouterInfo& r)
+	{
+		NetDbSnapshotEntry entry;
+		entry.ident = r.GetIdentHash ();
+		entry.timestamp = r.GetTimestamp ();
+		entry.caps = r.GetCaps ();
+		entry.transports = r.GetCompatibleTransports (false);
+		entry.version = r.GetVersion ();
+		entry.buf = nullptr; entry.len = 0;
+		return entry;
+	}
+
+	static std::shared_ptr<RouterInfo::Buffer> LoadRouterInfoBuffer (const std::string& path)
+	{
+		std::ifstream f(path, std::ifstream::binary);
+		if (!f.is_open ()) return nullptr;
+		auto buffer = netdb.NewRouterInfoBuffer ();
+		f.read ((char *)buffer->data (), buffer->size ());
+		size_t len = f.gcount ();
+		if (!len) return nullptr;
+		buffer->SetBufferLen (len);
+		return buffer;
+	}
+
+	std::shared_ptr<RouterInfo> NetDb::LoadRouterInfo (const std::string& path, uint64_t ts)
 	{
 		auto r = std::make_shared<RouterInfo>(path);
 		if (r->GetRouterIdentity () && !r->IsUnreachable () && r->HasValidAddresses () &&
 			ts < r->GetTimestamp () + 24*60*60*NETDB_MAX_OFFLINE_EXPIRATION_TIMEOUT*1000LL) // too old
 		{
 			r->DeleteBuffer ();
-			if (m_RouterInfos.emplace (r->GetIdentHash (), r).second)
-			{
-				if (r->IsFloodfill () && r->IsEligibleFloodfill ())
-					m_Floodfills.Insert (r);
-			}
-		}
-		else
-		{
-			LogPrint(eLogWarning, "NetDb: RI from ", path, " is invalid or too old. Delete");
-			i2p::fs::Remove(path);
+			return r;
 		}
-		return true;
+		LogPrint(eLogWarning, "NetDb: RI from ", path, " is invalid or too old. Delete");
+		i2p::fs::Remove(path);
+		return nullptr;
 	}
 
 	void NetDb::VisitLeaseSets(LeaseSetVisitor v)
@@ -571,24 +705,21 @@ namespace data
 		while(n > 0)
 		{
 			std::lock_guard<std::mutex> lock(m_RouterInfosMutex);
-			uint32_t idx = m_Rng () % m_RouterInfos.size ();
-			uint32_t i = 0;
-			for (const auto & it : m_RouterInfos) {
-				if(i >= idx) // are we at the random start point?
+			size_t count = m_RandomRouters.GetSize ();
+			if (!count) break;
+			for (size_t i = m_Rng () % count; i < count; i++)
+			{
+				const auto& r = m_RandomRouters.Get (i);
+				// check if we want this one
+				if(filter(r))
 				{
-					// yes, check if we want this one
-					if(filter(it.second))
-					{
-						// we have a match
-						--n;
-						found.push_back(it.second);
-						// reset max iterations per cycle
-						iters = max_iters_per_cyle;
-						break;
-					}
+					// we have a match
+					--n;
+					found.push_back(r);
+					// reset max iterations per cycle
+					iters = max_iters_per_cyle;
+					break;
 				}
-				else // not there yet
-					++i;
 			}
 			// we have enough
 			if(n == 0) break;
@@ -612,16 +743,139 @@ namespace data
 	void NetDb::Load ()
 	{
 		// make sure we cleanup netDb from previous attempts
-		m_RouterInfos.clear ();
+		ClearRouterInfos ();
 		m_Floodfills.Clear ();
 
+		uint64_t startTime = i2p::util::GetMonotonicMilliseconds ();
+		if (m_UseSnapshot && LoadSnapshot ())
+		{
+			LogPrint (eLogInfo, "NetDb: ", m_RouterInfos.size(), " routers loaded (", m_Floodfills.GetSize (), " floodfils) from snapshot in ",
+				i2p::util::GetMonotonicMilliseconds () - startTime, " ms");
+			m_LastSnapshotTime = i2p::util::GetSecondsSinceEpoch ();
+			return;
+		}
 		uint64_t ts = i2p::util::GetMillisecondsSinceEpoch();
-		std::vector<std::string> files;
-		m_Storage.Traverse(files);
-		for (const auto& path : files)
-			LoadRouterInfo (path, ts);
+		// read and parse hashed subdirectories in parallel
+		const char * hashedDirs = i2p::data::GetBase64SubstitutionTable ();
+		const int numHashedDirs = 64;
+		int numThreads = GetNumLoadThreads ();
+		std::atomic<int> nextDir (0);
+		std::vector<std::future<std::vector<std::shared_ptr<RouterInfo> > > > loaders;
+		for (int i = 0; i < numThreads; i++)
+			loaders.push_back (std::async (std::launch::async,
+				[this, hashedDirs, ts, &nextDir]()
+				{
+					std::vector<std::shared_ptr<RouterInfo> > loaded;
+					std::vector<std::string> files;
+					int dir;
+					while ((dir = nextDir++) < numHashedDirs)
+					{
+						files.clear ();
+						m_Storage.Traverse (hashedDirs[dir], files);
+						for (const auto& path : files)
+						{
+							auto r = LoadRouterInfo (path, ts);
+							if (r) loaded.push_back (r);
+						}
+					}
+					return loaded;
+				}));
+		// merge
+		for (auto& it: loaders)
+		{
+			auto loaded = it.get ();
+			for (auto& r: loaded)
+				if (InsertRouterInfo (r) && r->IsFloodfill () && r->IsEligibleFloodfill ())
+					m_Floodfills.Insert (r);
+		}
 
-		LogPrint (eLogInfo, "NetDb: ", m_RouterInfos.size(), " routers loaded (", m_Floodfills.GetSize (), " floodfils)");
+		LogPrint (eLogInfo, "NetDb: ", m_RouterInfos.size(), " routers loaded (", m_Floodfills.GetSize (), " floodfils) in ",
+			i2p::util::GetMonotonicMilliseconds () - startTime, " ms using ", numThreads, " threads");
+	}
+
+	bool NetDb::LoadSnapshot ()
+	{
+		NetDbSnapshot snapshot;
+		if (!snapshot.Open (i2p::fs::DataDirPath (NETDB_SNAPSHOT_FILE))) return false;
+		// RouterInfo files might be written or deleted after snapshot, files are the source of truth
+		std::vector<std::string> paths;
+		m_Storage.Traverse (paths);
+		std::unordered_map<std::string, bool> files; // path -> changed after snapshot
+		files.reserve (paths.size ());
+		size_t numChanged = 0;
+		for (auto& path: paths)
+		{
+			// directory's mtime doesn't change if file is overwritten, check file itself
+			bool changed = i2p::fs::GetLastUpdateTime (path) >= snapshot.GetCreationTime ();
+			if (changed) numChanged++;
+			files.emplace (std::move (path), changed);
+		}
+		// parse mapped RouterInfos in parallel, signatures were checked before RouterInfos were saved
+		uint64_t ts = i2p::util::GetMillisecondsSinceEpoch();
+		size_t numEntries = snapshot.GetNumEntries ();
+		std::atomic<size_t> nextEntry (0);
+		std::vector<std::future<std::pair<std::vector<std::shared_ptr<RouterInfo> >, std::vector<IdentHash> > > > loaders;
+		int numThreads = GetNumLoadThreads ();
+		for (int i = 0; i < numThreads; i++)
+			loaders.push_back (std::async (std::launch::async,
+				[this, &snapshot, &files, numEntries, ts, &nextEntry]()
+				{
+					std::vector<std::shared_ptr<RouterInfo> > loaded;
+					std::vector<IdentHash> expired;
+					NetDbSnapshotEntry entry;
+					size_t first;
+					while ((first = nextEntry.fetch_add (NETDB_SNAPSHOT_LOAD_CHUNK_SIZE)) < numEntries)
+					{
+						size_t last = std::min (first + NETDB_SNAPSHOT_LOAD_CHUNK_SIZE, numEntries);
+						for (size_t i = first; i < last; i++)
+						{
+							if (!snapshot.GetEntry (i, entry)) continue;
+							auto it = files.find (m_Storage.Path (entry.ident.ToBase64 ()));
+							if (it == files.end () || it->second) continue; // deleted or loaded from file
+							// index tells if RouterInfo is obsolete without parsing
+							if (!entry.transports || ts > entry.timestamp + 24*60*60*NETDB_MAX_OFFLINE_EXPIRATION_TIMEOUT*1000LL)
+							{
+								expired.push_back (entry.ident);
+								continue;
+							}
+							auto r = std::make_shared<RouterInfo>(entry.buf, entry.len, true);
+							if (r->GetRouterIdentity () && r->GetIdentHash () == entry.ident &&
+								!r->IsUnreachable () && r->HasValidAddresses ())
+							{
+								r->SetUpdated (false); // file exists already
+								r->DeleteBuffer (); // loaded from file if requested
+								loaded.push_back (r);
+							}
+							else
+								expired.push_back (entry.ident);
+						}
+					}
+					return std::make_pair (std::move (loaded), std::move (expired));
+				}));
+		// merge
+		for (auto& it: loaders)
+		{
+			auto [loaded, expired] = it.get ();
+			for (auto& r: loaded)
+				if (InsertRouterInfo (r) && r->IsFloodfill () && r->IsEligibleFloodfill ())
+					m_Floodfills.Insert (r);
+			for (const auto& ident: expired)
+			{
+				LogPrint (eLogWarning, "NetDb: RI ", ident.ToBase64 (), " from snapshot is invalid or too old. Delete");
+				m_Storage.Remove (ident.ToBase64 ());
+			}
+		}
+		// files written after snapshot
+		for (const auto& [path, changed]: files)
+		{
+			if (!changed) continue;
+			auto r = LoadRouterInfo (path, ts);
+			if (r && InsertRouterInfo (r) && r->IsFloodfill () && r->IsEligibleFloodfill ())
+				m_Floodfills.Insert (r);
+		}
+		if (numChanged)
+			LogPrint (eLogInfo, "NetDb: ", numChanged, " routers changed after snapshot loaded from files");
+		return true;
 	}
 
 	void NetDb::SaveUpdated ()
@@ -655,6 +909,8 @@ namespace data
 			
 		std::list<std::pair<std::string, std::shared_ptr<RouterInfo::Buffer> > > saveToDisk;
 		std::list<std::string> removeFromDisk;	
+		bool saveSnapshot = m_UseSnapshot && ts/1000 >= m_LastSnapshotTime + NETDB_SNAPSHOT_INTERVAL;
+		std::vector<std::pair<NetDbSnapshotEntry, std::shared_ptr<RouterInfo::Buffer> > > snapshot;
 			
 		auto own = i2p::context.GetSharedRouterInfo ();
 		for (auto [ident, r]: m_RouterInfos)
@@ -678,7 +934,11 @@ namespace data
 					if (!i2p::transport::transports.IsConnected (ident))
 						r->ScheduleBufferToDelete ();
 					if (buffer)
+					{	
 						saveToDisk.emplace_back(ident.ToBase64 (), buffer);
+						if (saveSnapshot)
+							snapshot.emplace_back (CreateSnapshotEntry (*r), buffer);
+					}	
 				}
 				r->SetUpdated (false);
 				updatedCount++;
@@ -728,12 +988,15 @@ namespace data
 				deletedCount++;
 				if (total - deletedCount < NETDB_MIN_ROUTERS) checkForExpiration = false;
 			}
+			else if (saveSnapshot)
+				snapshot.emplace_back (CreateSnapshotEntry (*r), nullptr); // from file
 		} // m_RouterInfos iteration
 
-		if (!saveToDisk.empty () || !removeFromDisk.empty ())
+		if (saveSnapshot) m_LastSnapshotTime = ts/1000;
+		if (!saveToDisk.empty () || !removeFromDisk.empty () || !snapshot.empty ())
 		{
 			m_PersistingRouters = std::async (std::launch::async, &NetDb::PersistRouters,
-				this, std::move (saveToDisk), std::move (removeFromDisk));
+				this, std::move (saveToDisk), std::move (removeFromDisk), std::move (snapshot));
 		}	
 			
 		m_RouterInfoBuffersPool.CleanUpMt ();
@@ -752,7 +1015,11 @@ namespace data
 				for (auto it = m_RouterInfos.begin (); it != m_RouterInfos.end ();)
 				{
 					if (!it->second || it->second->IsUnreachable ())
+					{
+						m_RandomRouters.Remove (it->first);
+						m_HighBandwidthRandomRouters.Remove (it->first);
 						it = m_RouterInfos.erase (it);
+					}
 					else
 					{
 						it->second->DropProfile ();
@@ -772,13 +1039,57 @@ namespace data
 	}
 
 	void NetDb::PersistRouters (std::list<std::pair<std::string, std::shared_ptr<RouterInfo::Buffer> > >&& update, 
-		std::list<std::string>&& remove)
+		std::list<std::string>&& remove, 
+		std::vector<std::pair<NetDbSnapshotEntry, std::shared_ptr<RouterInfo::Buffer> > >&& snapshot)
 	{
 		for (auto it: update)
 			RouterInfo::SaveToFile (m_Storage.Path(it.first), it.second);
 		for (auto it: remove)
 			m_Storage.Remove (it);
+		if (!snapshot.empty ())
+		{
+			// written after files, so snapshot is never older than netDb
+			std::vector<NetDbSnapshotEntry> entries;
+			entries.reserve (snapshot.size ());
+			for (auto& [entry, buffer]: snapshot)
+			{
+				if (!buffer)
+					buffer = LoadRouterInfoBuffer (m_Storage.Path (entry.ident.ToBase64 ()));
+				if (!buffer) continue;
+				entry.buf = buffer->data ();
+				entry.len = buffer->GetBufferLen ();
+				entries.push_back (entry);
+			}
+			if (WriteNetDbSnapshot (i2p::fs::DataDirPath (NETDB_SNAPSHOT_FILE), entries))
+				LogPrint (eLogInfo, "NetDb: Snapshot of ", entries.size (), " routers saved");
+		}
 	}	
+
+	void NetDb::SaveSnapshot ()
+	{
+		if (m_PersistingRouters.valid ())
+			m_PersistingRouters.get ();
+		std::list<std::pair<std::string, std::shared_ptr<RouterInfo::Buffer> > > saveToDisk;
+		std::vector<std::pair<NetDbSnapshotEntry, std::shared_ptr<RouterInfo::Buffer> > > snapshot;
+		auto own = i2p::context.GetSharedRouterInfo ();
+		{
+			std::lock_guard<std::mutex> l(m_RouterInfosMutex);
+			snapshot.reserve (m_RouterInfos.size ());
+			for (auto& [ident, r]: m_RouterInfos)
+			{
+				if (!r || r == own || r->IsUnreachable ()) continue;
+				std::shared_ptr<RouterInfo::Buffer> buffer;
+				if (r->IsUpdated () && r->GetBuffer ())
+				{
+					// not saved to file yet
+					buffer = r->CopyBuffer ();
+					if (buffer) saveToDisk.emplace_back (ident.ToBase64 (), buffer);
+				}
+				snapshot.emplace_back (CreateSnapshotEntry (*r), buffer);
+			}
+		}
+		PersistRouters (std::move (saveToDisk), {}, std::move (snapshot));
+	}
 	
 	void NetDb::RequestDestination (const IdentHash& destination, RequestedDestination::RequestComplete requestComplete, bool direct)
 	{
@@ -802,8 +1113,50 @@ namespace data
 		}
 	}
 
+	void NetDb::VerifyRouterInfos (const std::deque<std::shared_ptr<const I2NPMessage> >& msgs)
+	{
+		m_VerifiedRouterInfos.clear ();
+		if (msgs.size () < i2p::crypto::ED25519_BATCH_MIN_SIZE) return;
+		// uncompress RouterInfos from DatabaseStore messages and verify their signatures at once
+		std::vector<std::pair<const I2NPMessage *, std::vector<uint8_t> > > routerInfos;
+		for (const auto& msg: msgs)
+		{
+			if (!msg || msg->GetTypeID () != eI2NPDatabaseStore) continue;
+			const uint8_t * buf = msg->GetPayload ();
+			size_t len = msg->GetSize ();
+			if (len < DATABASE_STORE_HEADER_SIZE || buf[DATABASE_STORE_TYPE_OFFSET]) continue; // RouterInfo only
+			size_t offset = DATABASE_STORE_HEADER_SIZE;
+			if (bufbe32toh (buf + DATABASE_STORE_REPLY_TOKEN_OFFSET)) offset += 36; // tunnelID + reply ident
+			if (len < offset + 2) continue;
+			size_t size = bufbe16toh (buf + offset);
+			offset += 2;
+			if (size > MAX_RI_BUFFER_SIZE || size > len - offset) continue;
+			std::vector<uint8_t> uncompressed (MAX_RI_BUFFER_SIZE);
+			size_t uncompressedSize = m_Inflator.Inflate (buf + offset, size, uncompressed.data (), MAX_RI_BUFFER_SIZE);
+			if (!uncompressedSize || uncompressedSize >= MAX_RI_BUFFER_SIZE) continue;
+			uncompressed.resize (uncompressedSize);
+			// signature is verified by RouterInfo's own key, it must be the key of stored ident
+			IdentityEx identity;
+			if (!identity.FromBuffer (uncompressed.data (), uncompressedSize) ||
+				identity.GetIdentHash () != IdentHash (buf + DATABASE_STORE_KEY_OFFSET)) continue;
+			routerInfos.emplace_back (msg.get (), std::move (uncompressed));
+		}
+		if (routerInfos.size () < i2p::crypto::ED25519_BATCH_MIN_SIZE) return;
+		std::vector<std::pair<const uint8_t *, size_t> > buffers;
+		buffers.reserve (routerInfos.size ());
+		for (const auto& it: routerInfos)
+			buffers.emplace_back (it.second.data (), it.second.size ());
+		std::vector<bool> verified;
+		RouterInfo::VerifySignatures (buffers, verified);
+		for (size_t i = 0; i < routerInfos.size (); i++)
+			if (verified[i])
+				m_VerifiedRouterInfos.emplace (routerInfos[i].first, std::move (routerInfos[i].second));
+		LogPrint (eLogDebug, "NetDb: ", m_VerifiedRouterInfos.size (), " of ", routerInfos.size (), " RouterInfos verified in batch");
+	}
+
 	void NetDb::HandleDatabaseStoreMsg (std::shared_ptr<const I2NPMessage> m)
 	{
+		g_StoreMsgsMetric.Inc ();
 		const uint8_t * buf = m->GetPayload ();
 		size_t len = m->GetSize ();
 		if (len < DATABASE_STORE_HEADER_SIZE)
@@ -908,14 +1261,24 @@ namespace data
 				LogPrint (eLogError, "NetDb: Invalid RouterInfo length ", (int)size);
 				return;
 			}
-			uint8_t uncompressed[MAX_RI_BUFFER_SIZE];
-			size_t uncompressedSize = m_Inflator.Inflate (buf + offset, size, uncompressed, MAX_RI_BUFFER_SIZE);
-			if (uncompressedSize && uncompressedSize < MAX_RI_BUFFER_SIZE)
-				updated = AddRouterInfo (ident, uncompressed, uncompressedSize);
+			auto it = m_VerifiedRouterInfos.find (m.get ());
+			if (it != m_VerifiedRouterInfos.end ())
+			{
+				// uncompressed and signature verified already
+				bool isUpdated;
+				updated = AddRouterInfo (ident, it->second.data (), it->second.size (), isUpdated, true) && isUpdated;
+			}
 			else
 			{
-				LogPrint (eLogInfo, "NetDb: Decompression failed ", uncompressedSize);
-				return;
+				uint8_t uncompressed[MAX_RI_BUFFER_SIZE];
+				size_t uncompressedSize = m_Inflator.Inflate (buf + offset, size, uncompressed, MAX_RI_BUFFER_SIZE);
+				if (uncompressedSize && uncompressedSize < MAX_RI_BUFFER_SIZE)
+					updated = AddRouterInfo (ident, uncompressed, uncompressedSize);
+				else
+				{
+					LogPrint (eLogInfo, "NetDb: Decompression failed ", uncompressedSize);
+					return;
+				}
 			}
 		}
 
@@ -944,6 +1307,7 @@ namespace data
 	
 	void NetDb::HandleDatabaseLookupMsg (std::shared_ptr<const I2NPMessage> msg)
 	{
+		g_LookupMsgsMetric.Inc ();
 		const uint8_t * buf = msg->GetPayload ();
 		IdentHash ident (buf);
 		if (ident.IsZero ())
@@ -1193,7 +1557,7 @@ namespace data
 	{
 		bool checkIsReal = i2p::tunnel::tunnels.GetPreciseTunnelCreationSuccessRate () < NETDB_TUNNEL_CREATION_RATE_THRESHOLD && // too low rate
 			context.GetUptime () > NETDB_CHECK_FOR_EXPIRATION_UPTIME; // after 10 minutes uptime
-		return GetRandomRouter (
+		return GetRandomRouter (m_HighBandwidthRandomRouters,
 			[compatibleWith, reverse, endpoint, checkIsReal](std::shared_ptr<const RouterInfo> router)->bool
 			{
 				return !router->IsHidden () && router != compatibleWith &&
@@ -1209,61 +1573,29 @@ namespace data
 	}
 
 	template<typename Filter>
-	std::shared_ptr<const RouterInfo> NetDb::GetRandomRouter (Filter filter) const
+	std::shared_ptr<const RouterInfo> NetDb::GetRandomRouter (const RandomAccessRouters& routers, Filter filter) const
 	{
-		if (m_RouterInfos.empty())
+		if (routers.IsEmpty ())
 			return nullptr;
-		uint16_t inds[3];
+		uint32_t inds[NETDB_MAX_RANDOM_ROUTER_ATTEMPTS + 1];
 		RAND_bytes ((uint8_t *)inds, sizeof (inds));
 		std::lock_guard<std::mutex> l(m_RouterInfosMutex);
-		auto count = m_RouterInfos.size ();
+		auto count = routers.GetSize ();
 		if(count == 0) return nullptr;
-		inds[0] %= count;
-		auto it = m_RouterInfos.begin ();
-		std::advance (it, inds[0]);
-		// try random router
-		if (it != m_RouterInfos.end () && !it->second->IsUnreachable () && filter (it->second))
-			return it->second;
-		// try some routers around
-		auto it1 = m_RouterInfos.begin ();
-		if (inds[0])
-		{
-			// before
-			inds[1] %= inds[0];
-			std::advance (it1, (inds[1] + inds[0])/2);
-		}
-		else
-			it1 = it;
-		auto it2 = it;
-		if (inds[0] < m_RouterInfos.size () - 1)
-		{
-			// after
-			inds[2] %= (m_RouterInfos.size () - 1 - inds[0]); inds[2] /= 2;
-			std::advance (it2, inds[2]);
-		}
-		// it1 - from, it2 - to
-		it = it1;
-		while (it != it2 && it != m_RouterInfos.end ())
-		{
-			if (!it->second->IsUnreachable () && filter (it->second))
-				return it->second;
-			it++;
-		}
-		// still not found, try from the beginning
-		it = m_RouterInfos.begin ();
-		while (it != it1 && it != m_RouterInfos.end ())
+		// try random routers
+		for (int i = 0; i < NETDB_MAX_RANDOM_ROUTER_ATTEMPTS; i++)
 		{
-			if (!it->second->IsUnreachable () && filter (it->second))
-				return it->second;
-			it++;
+			const auto& r = routers.Get (inds[i] % count);
+			if (!r->IsUnreachable () && filter (r))
+				return r;
 		}
-		// still not found, try to the beginning
-		it = it2;
-		while (it != m_RouterInfos.end ())
+		// try all routers starting from random position
+		size_t start = inds[NETDB_MAX_RANDOM_ROUTER_ATTEMPTS] % count;
+		for (size_t i = 0; i < count; i++)
 		{
-			if (!it->second->IsUnreachable () && filter (it->second))
-				return it->second;
-			it++;
+			const auto& r = routers.Get ((start + i) % count);
+			if (!r->IsUnreachable () && filter (r))
+				return r;
 		}
 		return nullptr; // seems we have too few routers
 	}
@@ -12,6 +12,7 @@
 #include <inttypes.h>
 #include <unordered_set>
 #include <unordered_map>
+#include <deque>
 #include <string>
 #include <thread>
 #include <mutex>
@@ -33,6 +34,7 @@
 #include "version.h"
 #include "util.h"
 #include "KadDHT.h"
+#include "NetDbSnapshot.h"
 
 namespace i2p
 {
@@ -59,6 +61,9 @@ namespace data
 	const int NETDB_EXPLORATORY_SELECTION_UPDATE_INTERVAL = 82; // in seconds. for floodfill
 	const int NETDB_NEXT_DAY_ROUTER_INFO_THRESHOLD = 45; // in minutes
 	const int NETDB_NEXT_DAY_LEASESET_THRESHOLD = 10; // in minutes
+	const int NETDB_MAX_RANDOM_ROUTER_ATTEMPTS = 8; // random picks before sequential search
+	const int NETDB_MAX_LOAD_THREADS = 8; // reading and parsing stored RouterInfos at startup
+	const size_t NETDB_SNAPSHOT_LOAD_CHUNK_SIZE = 256; // RouterInfos parsed by one thread at once
 
 	/** function for visiting a leaseset stored in a floodfill */
 	typedef std::function<void(const IdentHash, std::shared_ptr<LeaseSet>)> LeaseSetVisitor;
@@ -69,6 +74,23 @@ namespace data
 	/** function for visiting a router info and determining if we want to use it */
 	typedef std::function<bool(std::shared_ptr<const i2p::data::RouterInfo>)> RouterInfoFilter;
 
+	class RandomAccessRouters // dense array with swap-remove for O(1) random selection
+	{
+		public:
+
+			bool Insert (std::shared_ptr<RouterInfo> r);
+			bool Remove (const IdentHash& ident);
+			void Clear ();
+			size_t GetSize () const { return m_Routers.size (); };
+			bool IsEmpty () const { return m_Routers.empty (); };
+			const std::shared_ptr<RouterInfo>& Get (size_t ind) const { return m_Routers[ind]; };
+
+		private:
+
+			std::vector<std::shared_ptr<RouterInfo> > m_Routers;
+			std::unordered_map<IdentHash, size_t> m_Indices; // ident -> position in m_Routers
+	};
+
 	class NetDb
 	{
 		public:
@@ -81,6 +103,7 @@ namespace data
 
 			std::shared_ptr<const RouterInfo> AddRouterInfo (const uint8_t * buf, int len);
 			bool AddRouterInfo (const IdentHash& ident, const uint8_t * buf, int len);
+			void AddRouterInfos (const std::vector<std::vector<uint8_t> >& routerInfos); // signatures are verified in batch
 			bool AddLeaseSet (const IdentHash& ident, const uint8_t * buf, int len);
 			bool AddLeaseSet2 (const IdentHash& ident, const uint8_t * buf, int len, uint8_t storeType);
 			std::shared_ptr<RouterInfo> FindRouter (const IdentHash& ident) const;
@@ -122,7 +145,7 @@ namespace data
 			/** visit N random router that match using filter, then visit them with a visitor, return number of RouterInfos that were visited */
 			size_t VisitRandomRouterInfos(RouterInfoFilter f, RouterInfoVisitor v, size_t n);
 
-			void ClearRouterInfos () { m_RouterInfos.clear (); };
+			void ClearRouterInfos ();
 			template<typename... TArgs>
 			std::shared_ptr<RouterInfo::Buffer> NewRouterInfoBuffer (TArgs&&... args) 
 			{ 
@@ -144,24 +167,36 @@ namespace data
 		private:
 
 			void Load ();
-			bool LoadRouterInfo (const std::string& path, uint64_t ts);
+			std::shared_ptr<RouterInfo> LoadRouterInfo (const std::string& path, uint64_t ts); // thread-safe, doesn't insert
+			bool LoadSnapshot ();
 			void SaveUpdated ();
+			void SaveSnapshot (); // with updated routers, on shutdown
 			void PersistRouters (std::list<std::pair<std::string, std::shared_ptr<RouterInfo::Buffer> > >&& update, 
-				std::list<std::string>&& remove);
+				std::list<std::string>&& remove, 
+				std::vector<std::pair<NetDbSnapshotEntry, std::shared_ptr<RouterInfo::Buffer> > >&& snapshot); // null buffer means from file
 			void Run (); 
 			void Flood (const IdentHash& ident, std::shared_ptr<I2NPMessage> floodMsg, bool andNextDay = false);
 			void ManageRouterInfos ();
 			void ManageLeaseSets ();
 			void ManageRequests ();
+			void RegisterMetrics ();
 
 			void ReseedFromFloodfill(const RouterInfo & ri, int numRouters = 40, int numFloodfills = 20);
 
 			std::shared_ptr<const RouterInfo> AddRouterInfo (const uint8_t * buf, int len, bool& updated);
-			std::shared_ptr<const RouterInfo> AddRouterInfo (const IdentHash& ident, const uint8_t * buf, int len, bool& updated);
+			std::shared_ptr<const RouterInfo> AddRouterInfo (const IdentHash& ident, const uint8_t * buf, int len, bool& updated, bool isVerified = false);
 
+			// m_RouterInfos and random selection buckets, called with m_RouterInfosMutex locked or from single thread
+			bool InsertRouterInfo (std::shared_ptr<RouterInfo> r);
+			void EraseRouterInfo (const IdentHash& ident);
+			void UpdateRandomRouters (std::shared_ptr<RouterInfo> r); // after caps change
+
+			template<typename Filter>
+			std::shared_ptr<const RouterInfo> GetRandomRouter (Filter filter) const { return GetRandomRouter (m_RandomRouters, filter); }
 			template<typename Filter>
-			std::shared_ptr<const RouterInfo> GetRandomRouter (Filter filter) const;
+			std::shared_ptr<const RouterInfo> GetRandomRouter (const RandomAccessRouters& routers, Filter filter) const;
 
+			void VerifyRouterInfos (const std::deque<std::shared_ptr<const I2NPMessage> >& msgs); // of DatabaseStore
 			void HandleDatabaseStoreMsg (std::shared_ptr<const I2NPMessage> msg);
 			void HandleDatabaseLookupMsg (std::shared_ptr<const I2NPMessage> msg);
 			void HandleNTCP2RouterInfoMsg (std::shared_ptr<const I2NPMessage> m);
@@ -172,6 +207,7 @@ namespace data
 			std::unordered_map<IdentHash, std::shared_ptr<LeaseSet> > m_LeaseSets;
 			mutable std::mutex m_RouterInfosMutex;
 			std::unordered_map<IdentHash, std::shared_ptr<RouterInfo> > m_RouterInfos;
+			RandomAccessRouters m_RandomRouters, m_HighBandwidthRandomRouters; // same as m_RouterInfos, with 'X', 'O' or 'P' caps
 			mutable std::mutex m_FloodfillsMutex;
 			DHTTable m_Floodfills;
 
@@ -180,13 +216,15 @@ namespace data
 			i2p::util::Queue<std::shared_ptr<const I2NPMessage> > m_Queue; // of I2NPDatabaseStoreMsg
 
 			GzipInflator m_Inflator;
+			std::unordered_map<const I2NPMessage *, std::vector<uint8_t> > m_VerifiedRouterInfos; // uncompressed, from current batch of messages
 			Reseeder * m_Reseeder;
 			Families m_Families;
 			i2p::fs::HashedStorage m_Storage;
 
 			std::shared_ptr<NetDbRequests> m_Requests;
 
-			bool m_PersistProfiles;
+			bool m_PersistProfiles, m_UseSnapshot;
+			uint64_t m_LastSnapshotTime; // in seconds
 			std::future<void> m_SavingProfiles, m_DeletingProfiles, m_ApplyingProfileUpdates, m_PersistingRouters;
 
 			std::vector<std::shared_ptr<const RouterInfo> > m_ExploratorySelection;
@@ -0,0 +1,140 @@
+/*
+* Copyright (c) 2013-2025, The PurpleI2P Project
+*
+* This file is part of Purple i2pd project and licensed under BSD3
+*
+* See full license text in LICENSE file at top of project tree
+*/
+
+#include <string.h>
+#include <fstream>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include "I2PEndian.h"
+#include "FS.h"
+#include "Log.h"
+#include "Timestamp.h"
+#include "NetDbSnapshot.h"
+
+namespace i2p
+{
+namespace data
+{
+	bool WriteNetDbSnapshot (const std::string& path, const std::vector<NetDbSnapshotEntry>& entries)
+	{
+		auto tmpPath = path + ".tmp";
+		std::ofstream f(tmpPath, std::ofstream::binary | std::ofstream::trunc);
+		if (!f.is_open ())
+		{
+			LogPrint (eLogError, "NetDbSnapshot: Can't open file ", tmpPath);
+			return false;
+		}
+		uint8_t header[NETDB_SNAPSHOT_HEADER_SIZE];
+		memset (header, 0, NETDB_SNAPSHOT_HEADER_SIZE);
+		memcpy (header, NETDB_SNAPSHOT_MAGIC, 8);
+		htobe16buf (header + 8, NETDB_SNAPSHOT_VERSION);
+		htobe16buf (header + 10, NETDB_SNAPSHOT_INDEX_ENTRY_SIZE);
+		htobe32buf (header + 12, entries.size ());
+		htobe64buf (header + 16, i2p::util::GetSecondsSinceEpoch ());
+		f.write ((const char *)header, NETDB_SNAPSHOT_HEADER_SIZE);
+		// index
+		uint64_t offset = NETDB_SNAPSHOT_HEADER_SIZE + entries.size ()*NETDB_SNAPSHOT_INDEX_ENTRY_SIZE;
+		uint8_t indexEntry[NETDB_SNAPSHOT_INDEX_ENTRY_SIZE];
+		for (const auto& it: entries)
+		{
+			memset (indexEntry, 0, NETDB_SNAPSHOT_INDEX_ENTRY_SIZE);
+			memcpy (indexEntry, it.ident, 32);
+			htobe64buf (indexEntry + 32, it.timestamp);
+			htobe64buf (indexEntry + 40, offset);
+			htobe16buf (indexEntry + 48, it.len);
+			indexEntry[50] = it.caps;
+			indexEntry[51] = it.transports;
+			htobe32buf (indexEntry + 52, it.version);
+			f.write ((const char *)indexEntry, NETDB_SNAPSHOT_INDEX_ENTRY_SIZE);
+			offset += it.len;
+		}
+		// RouterInfos
+		for (const auto& it: entries)
+			f.write ((const char *)it.buf, it.len);
+		f.close ();
+		if (!f || !i2p::fs::Rename (tmpPath, path))
+		{
+			LogPrint (eLogError, "NetDbSnapshot: Can't write ", path);
+			i2p::fs::Remove (tmpPath);
+			return false;
+		}
+		return true;
+	}
+
+	NetDbSnapshot::NetDbSnapshot (): m_Data (nullptr), m_Size (0), m_NumEntries (0), m_CreationTime (0)
+	{
+	}
+
+	NetDbSnapshot::~NetDbSnapshot ()
+	{
+		Close ();
+	}
+
+	bool NetDbSnapshot::Open (const std::string& path)
+	{
+		Close ();
+		if (!i2p::fs::Exists (path)) return false;
+		try
+		{
+			m_File.reset (new boost::interprocess::file_mapping (path.c_str (), boost::interprocess::read_only));
+			m_Region.reset (new boost::interprocess::mapped_region (*m_File, boost::interprocess::read_only));
+		}
+		catch (std::exception& ex)
+		{
+			LogPrint (eLogError, "NetDbSnapshot: Can't map ", path, ": ", ex.what ());
+			Close ();
+			return false;
+		}
+		auto data = (const uint8_t *)m_Region->get_address ();
+		size_t size = m_Region->get_size ();
+		if (size < NETDB_SNAPSHOT_HEADER_SIZE || memcmp (data, NETDB_SNAPSHOT_MAGIC, 8) ||
+			bufbe16toh (data + 8) != NETDB_SNAPSHOT_VERSION || bufbe16toh (data + 10) != NETDB_SNAPSHOT_INDEX_ENTRY_SIZE)
+		{
+			LogPrint (eLogWarning, "NetDbSnapshot: Unknown format of ", path);
+			Close ();
+			return false;
+		}
+		size_t numEntries = bufbe32toh (data + 12);
+		if (NETDB_SNAPSHOT_HEADER_SIZE + numEntries*NETDB_SNAPSHOT_INDEX_ENTRY_SIZE > size)
+		{
+			LogPrint (eLogWarning, "NetDbSnapshot: ", path, " is truncated");
+			Close ();
+			return false;
+		}
+		m_Data = data; m_Size = size;
+		m_NumEntries = numEntries;
+		m_CreationTime = bufbe64toh (data + 16);
+		return true;
+	}
+
+	void NetDbSnapshot::Close ()
+	{
+		m_Data = nullptr; m_Size = 0;
+		m_NumEntries = 0; m_CreationTime = 0;
+		m_Region = nullptr;
+		m_File = nullptr;
+	}
+
+	bool NetDbSnapshot::GetEntry (size_t i, NetDbSnapshotEntry& entry) const
+	{
+		if (i >= m_NumEntries) return false;
+		const uint8_t * indexEntry = m_Data + NETDB_SNAPSHOT_HEADER_SIZE + i*NETDB_SNAPSHOT_INDEX_ENTRY_SIZE;
+		uint64_t offset = bufbe64toh (indexEntry + 40);
+		size_t len = bufbe16toh (indexEntry + 48);
+		if (offset > m_Size || len > m_Size - offset) return false;
+		entry.ident = IdentHash (indexEntry);
+		entry.timestamp = bufbe64toh (indexEntry + 32);
+		entry.caps = indexEntry[50];
+		entry.transports = indexEntry[51];
+		entry.version = bufbe32toh (indexEntry + 52);
+		entry.buf = m_Data + offset;
+		entry.len = len;
+		return true;
+	}
+}
+}
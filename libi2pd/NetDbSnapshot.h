@@ -0,0 +1,79 @@
+/*
+* Copyright (c) 2013-2025, The PurpleI2P Project
+*
+* This file is part of Purple i2pd project and licensed under BSD3
+*
+* See full license text in LICENSE file at top of project tree
+*/
+
+#ifndef NETDB_SNAPSHOT_H__
+#define NETDB_SNAPSHOT_H__
+
+#include <inttypes.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include "Identity.h"
+
+namespace boost
+{
+namespace interprocess
+{
+	class file_mapping;
+	class mapped_region;
+}
+}
+
+namespace i2p
+{
+namespace data
+{
+	const char NETDB_SNAPSHOT_FILE[] = "netDb.snapshot";
+	const char NETDB_SNAPSHOT_MAGIC[] = "i2pdnetd"; // 8 bytes
+	const uint16_t NETDB_SNAPSHOT_VERSION = 1;
+	const size_t NETDB_SNAPSHOT_HEADER_SIZE = 32; // magic 8, version 2, index entry size 2, num entries 4, creation time 8, reserved 8
+	// ident 32, timestamp 8, offset 8, length 2, caps 1, transports 1, version 4, reserved 8
+	const size_t NETDB_SNAPSHOT_INDEX_ENTRY_SIZE = 64;
+	const int NETDB_SNAPSHOT_INTERVAL = 30*60; // in seconds
+
+	struct NetDbSnapshotEntry
+	{
+		IdentHash ident;
+		uint64_t timestamp; // published, in milliseconds
+		uint8_t caps, transports; // RouterInfo's caps and supported transports
+		int version;
+		const uint8_t * buf; // RouterInfo
+		size_t len;
+	};
+
+	// single file of all RouterInfos, index is followed by RouterInfos
+	// written to temporary file and renamed, mapped to memory for reading
+	bool WriteNetDbSnapshot (const std::string& path, const std::vector<NetDbSnapshotEntry>& entries);
+
+	class NetDbSnapshot
+	{
+		public:
+
+			NetDbSnapshot ();
+			~NetDbSnapshot ();
+
+			bool Open (const std::string& path); // false if doesn't exist or malformed
+			void Close ();
+			bool IsOpen () const { return m_Data; };
+
+			uint64_t GetCreationTime () const { return m_CreationTime; }; // in seconds
+			size_t GetNumEntries () const { return m_NumEntries; };
+			bool GetEntry (size_t i, NetDbSnapshotEntry& entry) const; // buf points to mapped file
+
+		private:
+
+			std::unique_ptr<boost::interprocess::file_mapping> m_File;
+			std::unique_ptr<boost::interprocess::mapped_region> m_Region;
+			const uint8_t * m_Data;
+			size_t m_Size, m_NumEntries;
+			uint64_t m_CreationTime;
+	};
+}
+}
+
+#endif
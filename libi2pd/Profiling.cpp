@@ -6,14 +6,17 @@
 * See full license text in LICENSE file at top of project tree
 */
 
-#include <sys/stat.h>
+#include <string.h>
 #include <unordered_map>
+#include <array>
 #include <list>
+#include <fstream>
 #include <thread>
 #include <iomanip>
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/ini_parser.hpp>
 #include "Base.h"
+#include "I2PEndian.h"
 #include "FS.h"
 #include "Log.h"
 #include "Timestamp.h"
@@ -24,7 +27,11 @@ namespace i2p
 {
 namespace data
 {
-	static i2p::fs::HashedStorage g_ProfilesStorage("peerProfiles", "p", "profile-", "txt");
+	typedef std::array<uint8_t, PEER_PROFILE_RECORD_SIZE> ProfileRecord;
+	static i2p::fs::HashedStorage g_ProfilesStorage("peerProfiles", "p", "profile-", "txt"); // legacy, import only
+	static std::string g_ProfilesFile;
+	static std::unordered_map<i2p::data::IdentHash, ProfileRecord> g_StoredProfiles;
+	static std::mutex g_StoredProfilesMutex, g_ProfilesFileMutex;
 	static std::unordered_map<i2p::data::IdentHash, std::shared_ptr<RouterProfile> > g_Profiles;
 	static std::mutex g_ProfilesMutex;
 	static std::list<std::pair<i2p::data::IdentHash, std::function<void (std::shared_ptr<RouterProfile>)> > > g_PostponedUpdates;
@@ -45,52 +52,62 @@ namespace data
 		m_IsUpdated = true;
 	}
 
-	void RouterProfile::Save (const IdentHash& identHash)
+	void RouterProfile::ToBuffer (uint8_t * buf) const
 	{
-		// fill sections
-		boost::property_tree::ptree participation;
-		participation.put (PEER_PROFILE_PARTICIPATION_AGREED, m_NumTunnelsAgreed);
-		participation.put (PEER_PROFILE_PARTICIPATION_DECLINED, m_NumTunnelsDeclined);
-		participation.put (PEER_PROFILE_PARTICIPATION_NON_REPLIED, m_NumTunnelsNonReplied);
-		boost::property_tree::ptree usage;
-		usage.put (PEER_PROFILE_USAGE_TAKEN, m_NumTimesTaken);
-		usage.put (PEER_PROFILE_USAGE_REJECTED, m_NumTimesRejected);
-		usage.put (PEER_PROFILE_USAGE_CONNECTED, m_HasConnected);
-		if (m_IsDuplicated)
-			usage.put (PEER_PROFILE_USAGE_DUPLICATED, true);
-		// fill property tree
-		boost::property_tree::ptree pt;
-		pt.put (PEER_PROFILE_LAST_UPDATE_TIMESTAMP, m_LastUpdateTime);
-		if (m_LastUnreachableTime)
-			pt.put (PEER_PROFILE_LAST_UNREACHABLE_TIME, m_LastUnreachableTime);
-		pt.put_child (PEER_PROFILE_SECTION_PARTICIPATION, participation);
-		pt.put_child (PEER_PROFILE_SECTION_USAGE, usage);
-
-		// save to file
-		std::string ident = identHash.ToBase64 ();
-		std::string path = g_ProfilesStorage.Path(ident);
-
-		try {
-			boost::property_tree::write_ini (path, pt);
-		} catch (std::exception& ex) {
-			/* boost exception verbose enough */
-			LogPrint (eLogError, "Profiling: ", ex.what ());
+		memset (buf, 0, PEER_PROFILE_RECORD_SIZE - 32);
+		htobe64buf (buf, m_LastUpdateTime);
+		htobe64buf (buf + 8, m_LastUnreachableTime);
+		htobe32buf (buf + 16, m_NumTunnelsAgreed);
+		htobe32buf (buf + 20, m_NumTunnelsDeclined);
+		htobe32buf (buf + 24, m_NumTunnelsNonReplied);
+		htobe32buf (buf + 28, m_NumTimesTaken);
+		htobe32buf (buf + 32, m_NumTimesRejected);
+		uint8_t flags = 0;
+		if (m_HasConnected) flags |= PEER_PROFILE_FLAG_CONNECTED;
+		if (m_IsDuplicated) flags |= PEER_PROFILE_FLAG_DUPLICATED;
+		buf[36] = flags;
+	}
+
+	void RouterProfile::FromBuffer (const uint8_t * buf)
+	{
+		m_LastUpdateTime = bufbe64toh (buf);
+		if (i2p::util::GetSecondsSinceEpoch () - m_LastUpdateTime < PEER_PROFILE_EXPIRATION_TIMEOUT)
+		{
+			m_LastUnreachableTime = bufbe64toh (buf + 8);
+			m_NumTunnelsAgreed = bufbe32toh (buf + 16);
+			m_NumTunnelsDeclined = bufbe32toh (buf + 20);
+			m_NumTunnelsNonReplied = bufbe32toh (buf + 24);
+			m_NumTimesTaken = bufbe32toh (buf + 28);
+			m_NumTimesRejected = bufbe32toh (buf + 32);
+			m_HasConnected = buf[36] & PEER_PROFILE_FLAG_CONNECTED;
+			m_IsDuplicated = buf[36] & PEER_PROFILE_FLAG_DUPLICATED;
 		}
+		else
+			*this = RouterProfile ();
+	}
+
+	void RouterProfile::Save (const IdentHash& identHash)
+	{
+		ProfileRecord record;
+		memcpy (record.data (), identHash, 32);
+		ToBuffer (record.data () + 32);
+		std::lock_guard<std::mutex> l(g_StoredProfilesMutex);
+		g_StoredProfiles[identHash] = record;
 	}
 
 	void RouterProfile::Load (const IdentHash& identHash)
 	{
 		m_IsUpdated = false;
-		std::string ident = identHash.ToBase64 ();
-		std::string path = g_ProfilesStorage.Path(ident);
-		boost::property_tree::ptree pt;
-
-		if (!i2p::fs::Exists(path))
-		{
-			LogPrint(eLogWarning, "Profiling: No profile yet for ", ident);
-			return;
-		}
+		std::lock_guard<std::mutex> l(g_StoredProfilesMutex);
+		auto it = g_StoredProfiles.find (identHash);
+		if (it != g_StoredProfiles.end ())
+			FromBuffer (it->second.data () + 32);
+	}
 
+	bool RouterProfile::LoadIni (const std::string& path)
+	{
+		m_IsUpdated = false;
+		boost::property_tree::ptree pt;
 		try
 		{
 			boost::property_tree::read_ini (path, pt);
@@ -98,7 +115,7 @@ namespace data
 		{
 			/* boost exception verbose enough */
 			LogPrint (eLogError, "Profiling: ", ex.what ());
-			return;
+			return false;
 		}
 
 		try
@@ -131,7 +148,7 @@ namespace data
 				}
 				catch (boost::property_tree::ptree_bad_path& ex)
 				{
-					LogPrint (eLogWarning, "Profiling: Missing section ", PEER_PROFILE_SECTION_PARTICIPATION, " in profile for ", ident);
+					LogPrint (eLogWarning, "Profiling: Missing section ", PEER_PROFILE_SECTION_PARTICIPATION, " in profile ", path);
 				}
 				try
 				{
@@ -144,7 +161,7 @@ namespace data
 				}
 				catch (boost::property_tree::ptree_bad_path& ex)
 				{
-					LogPrint (eLogWarning, "Profiling: Missing section ", PEER_PROFILE_SECTION_USAGE, " in profile for ", ident);
+					LogPrint (eLogWarning, "Profiling: Missing section ", PEER_PROFILE_SECTION_USAGE, " in profile ", path);
 				}
 			}
 			else
@@ -152,8 +169,10 @@ namespace data
 		}
 		catch (std::exception& ex)
 		{
-			LogPrint (eLogError, "Profiling: Can't read profile ", ident, " :", ex.what ());
+			LogPrint (eLogError, "Profiling: Can't read profile ", path, " :", ex.what ());
+			return false;
 		}
+		return true;
 	}
 
 	void RouterProfile::TunnelBuildResponse (uint8_t ret)
@@ -288,18 +307,116 @@ namespace data
 		return false;
 	}	
 		
+	static bool ReadProfilesFile ()
+	{
+		std::ifstream f(g_ProfilesFile, std::ifstream::binary);
+		if (!f.is_open ()) return false;
+		uint8_t header[PEER_PROFILES_FILE_HEADER_SIZE];
+		f.read ((char *)header, PEER_PROFILES_FILE_HEADER_SIZE);
+		if (!f || memcmp (header, PEER_PROFILES_FILE_MAGIC, 8) || bufbe16toh (header + 8) != PEER_PROFILE_RECORD_SIZE)
+		{
+			LogPrint (eLogError, "Profiling: Invalid profiles file ", g_ProfilesFile);
+			return false;
+		}
+		size_t num = bufbe32toh (header + 12);
+		std::unordered_map<i2p::data::IdentHash, ProfileRecord> profiles;
+		profiles.reserve (num);
+		ProfileRecord record;
+		for (size_t i = 0; i < num; i++)
+		{
+			f.read ((char *)record.data (), PEER_PROFILE_RECORD_SIZE);
+			if (!f)
+			{
+				LogPrint (eLogWarning, "Profiling: Profiles file ", g_ProfilesFile, " is truncated after ", i, " records");
+				break;
+			}
+			profiles.emplace (i2p::data::IdentHash (record.data ()), record);
+		}
+		std::lock_guard<std::mutex> l(g_StoredProfilesMutex);
+		g_StoredProfiles.swap (profiles);
+		return true;
+	}
+
+	static void WriteProfilesFile ()
+	{
+		std::vector<ProfileRecord> records;
+		{
+			std::lock_guard<std::mutex> l(g_StoredProfilesMutex);
+			records.reserve (g_StoredProfiles.size ());
+			for (const auto& it: g_StoredProfiles)
+				records.push_back (it.second);
+		}
+		std::lock_guard<std::mutex> l(g_ProfilesFileMutex);
+		// write to temporary file first and replace, file is always consistent
+		auto tmpFile = g_ProfilesFile + ".tmp";
+		std::ofstream f(tmpFile, std::ofstream::binary | std::ofstream::trunc);
+		if (!f.is_open ())
+		{
+			LogPrint (eLogError, "Profiling: Can't open file ", tmpFile);
+			return;
+		}
+		uint8_t header[PEER_PROFILES_FILE_HEADER_SIZE];
+		memset (header, 0, PEER_PROFILES_FILE_HEADER_SIZE);
+		memcpy (header, PEER_PROFILES_FILE_MAGIC, 8);
+		htobe16buf (header + 8, PEER_PROFILE_RECORD_SIZE);
+		htobe32buf (header + 12, records.size ());
+		f.write ((const char *)header, PEER_PROFILES_FILE_HEADER_SIZE);
+		if (!records.empty ())
+			f.write ((const char *)records.data (), records.size ()*PEER_PROFILE_RECORD_SIZE);
+		f.close ();
+		if (!f || !i2p::fs::Rename (tmpFile, g_ProfilesFile))
+		{
+			LogPrint (eLogError, "Profiling: Can't write profiles to ", g_ProfilesFile);
+			i2p::fs::Remove (tmpFile);
+		}
+	}
+
+	static void ImportProfiles ()
+	{
+		std::vector<std::string> files;
+		g_ProfilesStorage.Traverse (files);
+		if (files.empty ()) return;
+		size_t num = 0;
+		for (const auto& path: files)
+		{
+			// profile-<ident>.txt
+			auto name = path.substr (path.find_last_of ("/\\") + 1);
+			if (name.length () > 12 && !name.compare (0, 8, "profile-"))
+			{
+				i2p::data::IdentHash ident;
+				if (ident.FromBase64 (name.substr (8, name.length () - 12)) == 32)
+				{
+					RouterProfile profile;
+					if (profile.LoadIni (path) && profile.IsUseful ())
+					{
+						profile.Save (ident);
+						num++;
+					}
+				}
+			}
+			i2p::fs::Remove (path);
+		}
+		WriteProfilesFile ();
+		LogPrint (eLogInfo, "Profiling: ", num, " of ", files.size (), " profiles imported to ", g_ProfilesFile);
+	}
+
 	void InitProfilesStorage ()
 	{
-		g_ProfilesStorage.SetPlace(i2p::fs::GetDataDir());
-		g_ProfilesStorage.Init(i2p::data::GetBase64SubstitutionTable(), 64);
+		g_ProfilesFile = i2p::fs::DataDirPath (PEER_PROFILES_FILE);
+		if (ReadProfilesFile ())
+			LogPrint (eLogInfo, "Profiling: ", g_StoredProfiles.size (), " profiles loaded");
+		g_ProfilesStorage.SetPlace (i2p::fs::GetDataDir ());
+		if (i2p::fs::Exists (g_ProfilesStorage.GetRoot ()))
+			ImportProfiles ();
 	}
-		
+
 	static void SaveProfilesToDisk (std::list<std::pair<i2p::data::IdentHash, std::shared_ptr<RouterProfile> > >&& profiles)
 	{
 		for (auto& it: profiles)
 			if (it.second) it.second->Save (it.first);
-	}	
-		
+		WriteProfilesFile ();
+	}
+
 	std::future<void> PersistProfiles ()
 	{
 		auto ts = i2p::util::GetSecondsSinceEpoch ();
@@ -336,30 +453,33 @@ namespace data
 		for (auto& it: tmp)
 			if (it.second->IsUseful() && (it.second->IsUpdated () || ts - it.second->GetLastUpdateTime () < PEER_PROFILE_EXPIRATION_TIMEOUT))
 				it.second->Save (it.first);
+		WriteProfilesFile ();
 	}
 
-	static void DeleteFilesFromDisk ()
+	static void DeleteExpiredRecords ()
 	{
-		std::vector<std::string> files;
-		g_ProfilesStorage.Traverse(files);
-		
-		struct stat st;
-		std::time_t now = std::time(nullptr);
-		for (const auto& path: files) 
+		size_t num = 0;
 		{
-			if (stat(path.c_str(), &st) != 0) 
-			{	
-				LogPrint(eLogWarning, "Profiling: Can't stat(): ", path);
-				continue;
-			}
-			if (now - st.st_mtime >= PEER_PROFILE_EXPIRATION_TIMEOUT) 
+			auto ts = i2p::util::GetSecondsSinceEpoch ();
+			std::lock_guard<std::mutex> l(g_StoredProfilesMutex);
+			for (auto it = g_StoredProfiles.begin (); it != g_StoredProfiles.end ();)
 			{
-				LogPrint(eLogDebug, "Profiling: Removing expired peer profile: ", path);
-				i2p::fs::Remove(path);
+				if (ts - bufbe64toh (it->second.data () + 32) >= PEER_PROFILE_EXPIRATION_TIMEOUT)
+				{
+					it = g_StoredProfiles.erase (it);
+					num++;
+				}
+				else
+					it++;
 			}
 		}
-	}	
-		
+		if (num)
+		{
+			LogPrint (eLogDebug, "Profiling: Removing ", num, " expired peer profiles");
+			WriteProfilesFile ();
+		}
+	}
+
 	std::future<void> DeleteObsoleteProfiles ()
 	{
 		{
@@ -374,7 +494,7 @@ namespace data
 			}
 		}
 
-		return std::async (std::launch::async, DeleteFilesFromDisk);
+		return std::async (std::launch::async, DeleteExpiredRecords);
 	}
 
 	bool UpdateRouterProfile (const IdentHash& identHash, std::function<void (std::shared_ptr<RouterProfile>)> update)
@@ -10,6 +10,7 @@
 #define PROFILING_H__
 
 #include <memory>
+#include <string>
 #include <future>
 #include <functional>
 #include <boost/asio.hpp>
@@ -47,6 +48,15 @@ namespace data
 	const int PEER_PROFILE_ALWAYS_DECLINING_NUM = 5; // num declines in row to consider always declined
 	const int PEER_PROFILE_APPLY_POSTPONED_TIMEOUT = 2100; // in milliseconds	
 	const int PEER_PROFILE_APPLY_POSTPONED_TIMEOUT_VARIANCE = 500; // in milliseconds	
+
+	// profiles store, single file of fixed size records
+	const char PEER_PROFILES_FILE[] = "peerProfiles.dat";
+	const char PEER_PROFILES_FILE_MAGIC[] = "i2pdprof"; // 8 bytes
+	const size_t PEER_PROFILES_FILE_HEADER_SIZE = 16; // magic 8, record size 2, reserved 2, num records 4
+	// ident 32, last update 8, last unreachable 8, agreed 4, declined 4, non replied 4, taken 4, rejected 4, flags 1, reserved 11
+	const size_t PEER_PROFILE_RECORD_SIZE = 80;
+	const uint8_t PEER_PROFILE_FLAG_CONNECTED = 0x01;
+	const uint8_t PEER_PROFILE_FLAG_DUPLICATED = 0x02;
 	
 	class RouterProfile
 	{
@@ -54,8 +64,9 @@ namespace data
 
 			RouterProfile ();
 
-			void Save (const IdentHash& identHash);
-			void Load (const IdentHash& identHash);
+			void Save (const IdentHash& identHash); // to profiles store
+			void Load (const IdentHash& identHash); // from profiles store
+			bool LoadIni (const std::string& path); // legacy per-peer file, for import only
 
 			bool IsBad ();
 			bool IsUnreachable ();
@@ -87,6 +98,8 @@ namespace data
 		private:
 
 			void UpdateTime ();
+			void ToBuffer (uint8_t * buf) const; // record without ident
+			void FromBuffer (const uint8_t * buf);
 
 			bool IsAlwaysDeclining () const { return !m_NumTunnelsAgreed && m_NumTunnelsDeclined >= 5; };
 			bool IsLowPartcipationRate () const;
@@ -1,5 +1,5 @@
 /*
-* Copyright (c) 2013-2024, The PurpleI2P Project
+* Copyright (c) 2013-2025, The PurpleI2P Project
 *
 * This file is part of Purple i2pd project and licensed under BSD3
 *
@@ -9,9 +9,12 @@
 #ifndef QUEUE_H__
 #define QUEUE_H__
 
+#include <inttypes.h>
 #include <list>
+#include <atomic>
 #include <mutex>
 #include <thread>
+#include <chrono>
 #include <condition_variable>
 #include <functional>
 #include <utility>
@@ -20,121 +23,293 @@ namespace i2p
 {
 namespace util
 {
+	const size_t QUEUE_SEGMENT_SIZE = 256; // elements per segment
+	const int QUEUE_NUM_SPINS = 64; // before park consumer
+
+	/**
+	 * Lock-free multi-producer/single-consumer queue.
+	 * Elements are stored in linked segments of QUEUE_SEGMENT_SIZE slots, producer reserves slot by atomic increment of tail,
+	 * segments are allocated on demand once per QUEUE_SEGMENT_SIZE elements, queue size is not limited.
+	 * Consumed segments are deleted or reused when no producer might access them, one spare segment is kept.
+	 * All Get*, Wait*, IsEmpty and Peek must be called from the same consumer thread. Put from any thread
+	 */
 	template<typename Element>
 	class Queue
 	{
+		struct Segment
+		{
+			struct Slot
+			{
+				std::atomic<bool> isReady{false};
+				Element element;
+			};
+			Slot slots[QUEUE_SEGMENT_SIZE];
+			std::atomic<Segment *> next{nullptr};
+			uint64_t first = 0; // ticket of first slot, set before segment is published
+		};
+
 		public:
 
+			Queue (): m_Tail (0), m_NumPushing (0), m_Head (0), m_SpareSegment (nullptr), m_IsWaiting (false), m_IsWakeUp (false)
+			{
+				auto segment = new Segment ();
+				m_HeadSegment.store (segment);
+				m_TailSegment.store (segment);
+			}
+			Queue (const Queue&) = delete;
+			Queue& operator= (const Queue&) = delete;
+
+			~Queue ()
+			{
+				while (Pop ()) ; // release remaining elements
+				auto segment = m_HeadSegment.load ();
+				while (segment)
+				{
+					auto next = segment->next.load ();
+					delete segment;
+					segment = next;
+				}
+				for (auto it: m_RetiredSegments)
+					delete it;
+				delete m_SpareSegment.load ();
+			}
+
 			void Put (Element e)
 			{
-				std::unique_lock<std::mutex> l(m_QueueMutex);
-				m_Queue.push_back (std::move(e));
-				m_NonEmpty.notify_one ();
+				Push (std::move (e));
+				Notify ();
 			}
 
 			void Put (std::list<Element>& list)
 			{
 				if (!list.empty ())
 				{
-					std::unique_lock<std::mutex> l(m_QueueMutex);
-					m_Queue.splice (m_Queue.end (), list); 
-					m_NonEmpty.notify_one ();
-				}	
-			}		
-		
+					for (auto& it: list)
+						Push (std::move (it));
+					list.clear ();
+					Notify ();
+				}
+			}
+
 			Element GetNext ()
 			{
-				std::unique_lock<std::mutex> l(m_QueueMutex);
-				auto el = GetNonThreadSafe ();
+				auto el = Pop ();
 				if (!el)
 				{
-					m_NonEmpty.wait (l);
-					el = GetNonThreadSafe ();
+					Wait ();
+					el = Pop ();
 				}
 				return el;
 			}
 
 			Element GetNextWithTimeout (int usec)
 			{
-				std::unique_lock<std::mutex> l(m_QueueMutex);
-				auto el = GetNonThreadSafe ();
+				auto el = Pop ();
 				if (!el)
 				{
-					m_NonEmpty.wait_for (l, std::chrono::milliseconds (usec));
-					el = GetNonThreadSafe ();
+					Wait (0, usec);
+					el = Pop ();
 				}
 				return el;
 			}
 
 			void Wait ()
 			{
-				std::unique_lock<std::mutex> l(m_QueueMutex);
-				m_NonEmpty.wait (l);
+				if (Spin ()) return;
+				ReclaimSegments ();
+				std::unique_lock<std::mutex> l(m_WaitMutex);
+				StartWaiting ();
+				m_NonEmpty.wait (l, [this]{ return m_IsWakeUp || !IsEmpty (); });
+				StopWaiting ();
 			}
 
-			bool Wait (int sec, int usec)
+			bool Wait (int sec, int usec) // returns false if timeout
 			{
-				std::unique_lock<std::mutex> l(m_QueueMutex);
-				return m_NonEmpty.wait_for (l, std::chrono::seconds (sec) + std::chrono::milliseconds (usec)) != std::cv_status::timeout;
+				if (Spin ()) return true;
+				ReclaimSegments ();
+				std::unique_lock<std::mutex> l(m_WaitMutex);
+				StartWaiting ();
+				bool ret = m_NonEmpty.wait_for (l, std::chrono::seconds (sec) + std::chrono::milliseconds (usec),
+					[this]{ return m_IsWakeUp || !IsEmpty (); });
+				StopWaiting ();
+				return ret;
 			}
 
-			bool IsEmpty ()
+			bool IsEmpty () const
 			{
-				std::unique_lock<std::mutex> l(m_QueueMutex);
-				return m_Queue.empty ();
+				return !GetReadySlot ();
 			}
 
-			int GetSize () const
+			int GetSize () const // approximate, can be called from any thread
 			{
-				std::unique_lock<std::mutex> l(m_QueueMutex);
-				return m_Queue.size ();
+				return m_Tail.load (std::memory_order_relaxed) - m_Head.load (std::memory_order_relaxed);
 			}
 
-			void WakeUp () { m_NonEmpty.notify_all (); };
+			void WakeUp ()
+			{
+				std::unique_lock<std::mutex> l(m_WaitMutex);
+				m_IsWakeUp = true;
+				m_NonEmpty.notify_all ();
+			}
 
 			Element Get ()
 			{
-				std::unique_lock<std::mutex> l(m_QueueMutex);
-				return GetNonThreadSafe ();
+				return Pop ();
 			}
 
 			Element Peek ()
 			{
-				std::unique_lock<std::mutex> l(m_QueueMutex);
-				return GetNonThreadSafe (true);
+				auto slot = GetReadySlot ();
+				return slot ? slot->element : nullptr;
+			}
+
+			template<typename Container>
+			void GetWholeQueue (Container& queue)
+			{
+				queue.clear ();
+				while (auto slot = GetReadySlot ())
+					queue.push_back (PopSlot (slot));
+			}
+
+		private:
+
+			void Push (Element&& e)
+			{
+				m_NumPushing.fetch_add (1); // seq_cst, segments we see are not deleted until we finish
+				auto ticket = m_Tail.fetch_add (1);
+				auto& slot = FindSegment (ticket)->slots[ticket % QUEUE_SEGMENT_SIZE];
+				slot.element = std::move (e);
+				slot.isReady.store (true); // seq_cst, must be visible before m_IsWaiting check in Notify
+				m_NumPushing.fetch_sub (1, std::memory_order_release);
 			}
 
-			void GetWholeQueue (std::list<Element>& queue)
+			Segment * FindSegment (uint64_t ticket)
 			{
-				if (!queue.empty ())
-				{	
-					std::list<Element> newQueue;
-					queue.swap (newQueue);
-				}	
+				auto first = ticket - ticket % QUEUE_SEGMENT_SIZE;
+				auto segment = m_TailSegment.load ();
+				if (segment->first > first)
+					segment = m_HeadSegment.load (); // other producers are ahead, consumer can't pass our ticket
+				while (segment->first < first)
 				{
-					std::unique_lock<std::mutex> l(m_QueueMutex);
-					m_Queue.swap (queue);
+					auto next = segment->next.load (std::memory_order_acquire);
+					if (!next)
+					{
+						// allocate next segment, the first producer who gets there wins
+						auto newSegment = m_SpareSegment.exchange (nullptr);
+						if (!newSegment) newSegment = new Segment ();
+						newSegment->first = segment->first + QUEUE_SEGMENT_SIZE;
+						newSegment->next.store (nullptr, std::memory_order_relaxed);
+						if (segment->next.compare_exchange_strong (next, newSegment, std::memory_order_acq_rel))
+							next = newSegment;
+						else
+							delete m_SpareSegment.exchange (newSegment); // never published
+					}
+					segment = next;
 				}
-			}		
+				// move tail forward only
+				auto tail = m_TailSegment.load ();
+				while (tail->first < segment->first && !m_TailSegment.compare_exchange_weak (tail, segment)) ;
+				return segment;
+			}
 
-		private:
-		
-			Element GetNonThreadSafe (bool peek = false)
+			typename Segment::Slot * GetReadySlot () const
+			{
+				auto head = m_Head.load (std::memory_order_relaxed);
+				auto segment = m_HeadSegment.load (std::memory_order_relaxed);
+				if (head >= segment->first + QUEUE_SEGMENT_SIZE)
+				{
+					segment = segment->next.load (std::memory_order_acquire);
+					if (!segment) return nullptr; // not allocated yet
+				}
+				auto& slot = segment->slots[head % QUEUE_SEGMENT_SIZE];
+				return slot.isReady.load () ? &slot : nullptr;
+			}
+
+			Element PopSlot (typename Segment::Slot * slot)
 			{
-				if (!m_Queue.empty ())
+				auto head = m_Head.load (std::memory_order_relaxed);
+				auto segment = m_HeadSegment.load (std::memory_order_relaxed);
+				if (head >= segment->first + QUEUE_SEGMENT_SIZE)
 				{
-					auto el = m_Queue.front ();
-					if (!peek)
-						m_Queue.pop_front ();
-					return el;
+					// first slot of next segment, all slots of current one are consumed
+					m_HeadSegment.store (segment->next.load (std::memory_order_acquire));
+					m_RetiredSegments.push_back (segment);
+					ReclaimSegments ();
 				}
-				return nullptr;
+				Element el = std::move (slot->element);
+				slot->element = Element ();
+				slot->isReady.store (false, std::memory_order_relaxed);
+				m_Head.store (head + 1, std::memory_order_release);
+				return el;
+			}
+
+			Element Pop ()
+			{
+				auto slot = GetReadySlot ();
+				return slot ? PopSlot (slot) : nullptr;
+			}
+
+			void ReclaimSegments ()
+			{
+				if (m_RetiredSegments.empty ()) return;
+				// segments older than tail are not reachable for producers started after this point
+				auto tailFirst = m_TailSegment.load ()->first;
+				if (m_NumPushing.load ()) return; // active producers might still access them
+				for (auto it = m_RetiredSegments.begin (); it != m_RetiredSegments.end ();)
+				{
+					if ((*it)->first < tailFirst)
+					{
+						delete m_SpareSegment.exchange (*it);
+						it = m_RetiredSegments.erase (it);
+					}
+					else
+						it++;
+				}
+			}
+
+			bool Spin () const
+			{
+				for (int i = 0; i < QUEUE_NUM_SPINS; i++)
+				{
+					if (!IsEmpty ()) return true;
+					std::this_thread::yield ();
+				}
+				return false;
+			}
+
+			void Notify ()
+			{
+				if (m_IsWaiting.load ())
+				{
+					std::unique_lock<std::mutex> l(m_WaitMutex);
+					m_NonEmpty.notify_one ();
+				}
+			}
+
+			void StartWaiting ()
+			{
+				m_IsWaiting.store (true); // seq_cst, before checking slots
+			}
+
+			void StopWaiting ()
+			{
+				m_IsWaiting.store (false, std::memory_order_relaxed);
+				m_IsWakeUp = false;
 			}
 
 		private:
 
-			std::list<Element> m_Queue;
-			mutable std::mutex m_QueueMutex;
+			alignas(64) std::atomic<uint64_t> m_Tail; // next ticket for producers
+			std::atomic<int> m_NumPushing; // producers in Push
+			std::atomic<Segment *> m_TailSegment; // latest allocated segment, moves forward only
+			alignas(64) std::atomic<uint64_t> m_Head; // next ticket for consumer
+			std::atomic<Segment *> m_HeadSegment; // changed by consumer only
+			std::list<Segment *> m_RetiredSegments; // consumed, but might be still accessed by producers
+			std::atomic<Segment *> m_SpareSegment;
+			// park consumer
+			std::atomic<bool> m_IsWaiting;
+			bool m_IsWakeUp; // protected by m_WaitMutex
+			std::mutex m_WaitMutex;
 			std::condition_variable m_NonEmpty;
 	};
 }
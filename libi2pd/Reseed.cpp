@@ -296,6 +296,7 @@ namespace data
 	int Reseeder::ProcessZIPStream (std::istream& s, uint64_t contentLength)
 	{
 		int numFiles = 0;
+		std::vector<std::vector<uint8_t> > routerInfos; // added to netdb together to verify signatures in batch
 		size_t contentPos = s.tellg ();
 		while (!s.eof ())
 		{
@@ -327,6 +328,7 @@ namespace data
 				if ( fileNameLength >= 255 ) {
 					// too big
 					LogPrint(eLogError, "Reseed: SU3 fileNameLength too large: ", fileNameLength);
+					i2p::data::netdb.AddRouterInfos (routerInfos);
 					return numFiles;
 				}
 				s.read ((char *)&extraFieldLength, 2);
@@ -342,6 +344,7 @@ namespace data
 					if (!FindZipDataDescriptor (s))
 					{
 						LogPrint (eLogError, "Reseed: SU3 archive data descriptor not found");
+						i2p::data::netdb.AddRouterInfos (routerInfos);
 						return numFiles;
 					}
 					s.read ((char *)&crc_32, 4);
@@ -380,7 +383,7 @@ namespace data
 						uncompressedSize -= inflator.avail_out;
 						if (crc32 (0, uncompressed, uncompressedSize) == crc_32)
 						{
-							i2p::data::netdb.AddRouterInfo (uncompressed, uncompressedSize);
+							routerInfos.emplace_back (uncompressed, uncompressed + uncompressedSize);
 							numFiles++;
 						}
 						else
@@ -393,7 +396,7 @@ namespace data
 				}
 				else // no compression
 				{
-					i2p::data::netdb.AddRouterInfo (compressed, compressedSize);
+					routerInfos.emplace_back (compressed, compressed + compressedSize);
 					numFiles++;
 				}
 				delete[] compressed;
@@ -410,6 +413,7 @@ namespace data
 			if (end - contentPos >= contentLength)
 				break; // we are beyond contentLength
 		}
+		i2p::data::netdb.AddRouterInfos (routerInfos);
 		if (numFiles) // check if routers are not outdated
 		{
 			auto ts = i2p::util::GetMillisecondsSinceEpoch ();
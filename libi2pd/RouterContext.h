@@ -148,8 +148,12 @@ namespace garlic
 			void SetErrorV6 (RouterError error) { m_ErrorV6 = error; };
 			int GetNetID () const { return m_NetID; };
 			void SetNetID (int netID) { m_NetID = netID; };
-			bool DecryptTunnelBuildRecord (const uint8_t * encrypted, uint8_t * data);
-			bool DecryptTunnelShortRequestRecord (const uint8_t * encrypted, uint8_t * data);
+			// noiseState and decryptor are per thread, decryptor from CreateTunnelDecryptor
+			bool DecryptTunnelBuildRecord (const uint8_t * encrypted, uint8_t * data,
+				i2p::crypto::NoiseSymmetricState& noiseState, i2p::crypto::CryptoKeyDecryptor& decryptor) const;
+			bool DecryptTunnelShortRequestRecord (const uint8_t * encrypted, uint8_t * data,
+				i2p::crypto::NoiseSymmetricState& noiseState, i2p::crypto::CryptoKeyDecryptor& decryptor) const;
+			std::shared_ptr<i2p::crypto::CryptoKeyDecryptor> CreateTunnelDecryptor () const { return m_Keys.CreateDecryptor (nullptr); };
 
 			void UpdatePort (int port); // called from Daemon
 			void UpdateAddress (const boost::asio::ip::address& host); // called from SSU2 or Daemon
@@ -182,7 +186,6 @@ namespace garlic
 			void SetHidden(bool hide) { m_IsHiddenMode = hide; };
 			bool IsHidden() const { return m_IsHiddenMode; };
 			bool IsLimitedConnectivity () const { return m_Status == eRouterStatusProxy || m_Status == eRouterStatusStan; };
-			i2p::crypto::NoiseSymmetricState& GetCurrentNoiseState () { return m_CurrentNoiseState; };
 
 			void UpdateNTCP2V6Address (const boost::asio::ip::address& host); // called from Daemon. TODO: remove
 			void UpdateStats ();
@@ -224,7 +227,8 @@ namespace garlic
 			uint16_t SelectRandomPort () const;
 			void PublishNTCP2Address (std::shared_ptr<i2p::data::RouterInfo::Address> address, int port, bool publish) const;
 
-			bool DecryptECIESTunnelBuildRecord (const uint8_t * encrypted, uint8_t * data, size_t clearTextSize);
+			bool DecryptECIESTunnelBuildRecord (const uint8_t * encrypted, uint8_t * data, size_t clearTextSize,
+				i2p::crypto::NoiseSymmetricState& noiseState, i2p::crypto::CryptoKeyDecryptor& decryptor) const;
 			void PostGarlicMessage (std::shared_ptr<I2NPMessage> msg);
 			void PostDeliveryStatusMessage (std::shared_ptr<I2NPMessage> msg);
 
@@ -245,7 +249,7 @@ namespace garlic
 
 			i2p::data::LocalRouterInfo m_RouterInfo;
 			i2p::data::PrivateKeys m_Keys;
-			std::shared_ptr<i2p::crypto::CryptoKeyDecryptor> m_Decryptor, m_TunnelDecryptor;
+			std::shared_ptr<i2p::crypto::CryptoKeyDecryptor> m_Decryptor;
 			std::shared_ptr<i2p::garlic::RouterIncomingRatchetSession> m_ECIESSession;
 			uint64_t m_LastUpdateTime; // in seconds
 			bool m_AcceptsTunnels, m_IsFloodfill;
@@ -260,7 +264,7 @@ namespace garlic
 			std::unique_ptr<SSU2PrivateKeys> m_SSU2Keys;
 			std::unique_ptr<i2p::crypto::X25519Keys> m_NTCP2StaticKeys, m_SSU2StaticKeys;
 			// for ECIESx25519
-			i2p::crypto::NoiseSymmetricState m_InitialNoiseState, m_CurrentNoiseState;
+			i2p::crypto::NoiseSymmetricState m_InitialNoiseState;
 			// publish
 			std::unique_ptr<RouterService> m_Service;
 			std::unique_ptr<boost::asio::deadline_timer> m_PublishTimer, m_CongestionUpdateTimer, m_CleanupTimer;
@@ -26,6 +26,7 @@
 #include "NetDb.hpp"
 #include "RouterContext.h"
 #include "CryptoKey.h"
+#include "Ed25519Batch.h"
 #include "RouterInfo.h"
 
 namespace i2p
@@ -55,7 +56,7 @@ namespace data
 		ReadFromFile (fullPath);
 	}
 
-	RouterInfo::RouterInfo (std::shared_ptr<Buffer>&& buf, size_t len):
+	RouterInfo::RouterInfo (std::shared_ptr<Buffer>&& buf, size_t len, bool isVerified):
 		m_FamilyID (0), m_IsUpdated (true), m_IsUnreachable (false), m_IsFloodfill (false),
 		m_IsBufferScheduledToDelete (false), m_SupportedTransports (0), m_ReachableTransports (0), m_PublishedTransports (0),
 		m_Caps (0), m_Version (0), m_Congestion (eLowCongestion)
@@ -65,7 +66,7 @@ namespace data
 			m_Addresses = AddressesPtr(new Addresses ()); // create empty list
 			m_Buffer = buf;
 			if (m_Buffer) m_Buffer->SetBufferLen (len);
-			ReadFromBuffer (true);
+			ReadFromBuffer (!isVerified);
 		}
 		else
 		{
@@ -75,8 +76,8 @@ namespace data
 		}
 	}
 
-	RouterInfo::RouterInfo (const uint8_t * buf, size_t len):
-		RouterInfo (netdb.NewRouterInfoBuffer (buf, len), len)
+	RouterInfo::RouterInfo (const uint8_t * buf, size_t len, bool isVerified):
+		RouterInfo (netdb.NewRouterInfoBuffer (buf, len), len, isVerified)
 	{
 	}
 
@@ -84,7 +85,7 @@ namespace data
 	{
 	}
 
-	bool RouterInfo::Update (const uint8_t * buf, size_t len)
+	bool RouterInfo::Update (const uint8_t * buf, size_t len, bool isVerified)
 	{
 		if (len > MAX_RI_BUFFER_SIZE)
 		{
@@ -93,7 +94,7 @@ namespace data
 		}
 		// verify signature since we have identity already
 		int l = len - m_RouterIdentity->GetSignatureLen ();
-		if (m_RouterIdentity->Verify (buf, l, buf + l))
+		if (isVerified || m_RouterIdentity->Verify (buf, l, buf + l))
 		{
 			// clean up
 			m_IsUpdated = true;
@@ -634,6 +635,31 @@ namespace data
 		return SaveToFile (fullPath, m_Buffer);
 	}
 
+	void RouterInfo::VerifySignatures (const std::vector<std::pair<const uint8_t *, size_t> >& buffers, std::vector<bool>& verified)
+	{
+		verified.assign (buffers.size (), false);
+		i2p::crypto::Ed25519BatchVerifier batch;
+		std::vector<size_t> indices; // in buffers
+		for (size_t i = 0; i < buffers.size (); i++)
+		{
+			auto buf = buffers[i].first;
+			auto len = buffers[i].second;
+			if (len > MAX_RI_BUFFER_SIZE) continue;
+			IdentityEx identity;
+			size_t identityLen = identity.FromBuffer (buf, len);
+			if (!identityLen || identity.GetSigningKeyType () != SIGNING_KEY_TYPE_EDDSA_SHA512_ED25519) continue;
+			size_t signatureLen = identity.GetSignatureLen ();
+			if (identityLen + signatureLen >= len) continue;
+			size_t l = len - signatureLen;
+			batch.Add (identity.GetSigningPublicKeyBuffer (), buf, l, buf + l);
+			indices.push_back (i);
+		}
+		std::vector<bool> results;
+		batch.Verify (results);
+		for (size_t i = 0; i < indices.size (); i++)
+			verified[indices[i]] = results[i];
+	}
+
 	std::string_view RouterInfo::ExtractString (const uint8_t * buf, size_t len) const
 	{
 		uint8_t l = buf[0];
@@ -212,8 +212,8 @@ namespace data
 			RouterInfo (const std::string& fullPath);
 			RouterInfo (const RouterInfo& ) = delete;
 			RouterInfo& operator=(const RouterInfo& ) = delete;
-			RouterInfo (std::shared_ptr<Buffer>&& buf, size_t len);
-			RouterInfo (const uint8_t * buf, size_t len);
+			RouterInfo (std::shared_ptr<Buffer>&& buf, size_t len, bool isVerified = false);
+			RouterInfo (const uint8_t * buf, size_t len, bool isVerified = false); // isVerified means signature was checked already
 			virtual ~RouterInfo ();
 
 			std::shared_ptr<const IdentityEx> GetRouterIdentity () const { return m_RouterIdentity; };
@@ -303,12 +303,14 @@ namespace data
 			void SetUpdated (bool updated) { m_IsUpdated = updated; };
 			bool SaveToFile (const std::string& fullPath);
 			static bool SaveToFile (const std::string& fullPath, std::shared_ptr<Buffer> buf);
+			// batch verification of EdDSA signed RouterInfos, verified[i] is false for other signature types
+			static void VerifySignatures (const std::vector<std::pair<const uint8_t *, size_t> >& buffers, std::vector<bool>& verified);
 		
 			std::shared_ptr<RouterProfile> GetProfile () const;
 			void DropProfile () { m_Profile = nullptr; };
 			bool HasProfile () const { return (bool)m_Profile; }; 
 
-			bool Update (const uint8_t * buf, size_t len);
+			bool Update (const uint8_t * buf, size_t len, bool isVerified = false);
 			bool IsNewer (const uint8_t * buf, size_t len) const;
 
 			/** return true if we are in a router family and the signature is valid */
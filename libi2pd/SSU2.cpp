@@ -7,26 +7,51 @@
 */
 
 #include <random>
+#if defined(__linux__)
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+#endif
 #include "Log.h"
 #include "RouterContext.h"
 #include "Transports.h"
 #include "NetDb.hpp"
 #include "Config.h"
+#include "Metrics.h"
 #include "SSU2.h"
 
 namespace i2p
 {
 namespace transport
 {
+	static auto& g_ReceivedPacketsMetric = i2p::metrics::GetRegistry ().GetCounter ("ssu2_received_packets_total",
+		"SSU2 packets received");
+	static auto& g_DroppedShortPacketsMetric = i2p::metrics::GetRegistry ().GetCounter ("ssu2_dropped_packets_total",
+		"SSU2 packets dropped before processing", "reason=\"short\"");
+	static auto& g_DroppedQueueFullPacketsMetric = i2p::metrics::GetRegistry ().GetCounter ("ssu2_dropped_packets_total",
+		"SSU2 packets dropped before processing", "reason=\"queue_full\"");
+
 	SSU2Server::SSU2Server ():
 		RunnableServiceWithWork ("SSU2"), m_ReceiveService ("SSU2r"),
-		m_SocketV4 (m_ReceiveService.GetService ()), m_SocketV6 (m_ReceiveService.GetService ()),
-		m_AddressV4 (boost::asio::ip::address_v4()), m_AddressV6 (boost::asio::ip::address_v6()),
+		m_SocketV4 (m_ReceiveService.GetService ()), m_SocketV6 (m_ReceiveService.GetService ()), m_NumReceiveThreads (1),
+		m_AddressV4 (boost::asio::ip::address_v4()), m_AddressV6 (boost::asio::ip::address_v6()), m_NumSessions (0),
 		m_TerminationTimer (GetService ()), m_CleanupTimer (GetService ()), m_ResendTimer (GetService ()),
 		m_IntroducersUpdateTimer (GetService ()), m_IntroducersUpdateTimerV6 (GetService ()),
 		m_IsPublished (true), m_IsSyncClockFromPeers (true), m_PendingTimeOffset (0),
 		m_Rng(i2p::util::GetMonotonicMicroseconds ()%1000000LL), m_IsForcedFirewalled4 (false),
-		m_IsForcedFirewalled6 (false), m_IsThroughProxy (false)
+		m_IsForcedFirewalled6 (false), m_CongestionControlType (eSSU2CongestionControlDefault), m_IsThroughProxy (false)
+#if defined(__linux__)
+		, m_IsBatchedIO (true), m_IsSendBatchFlushPending (false), m_IsGSO (false), m_IsGRO (false)
+#endif
 	{
 	}
 
@@ -37,6 +62,37 @@ namespace transport
 			StartIOService ();
 			i2p::config::GetOption ("ssu2.published", m_IsPublished);
 			i2p::config::GetOption("nettime.frompeers", m_IsSyncClockFromPeers);
+			uint16_t numDataThreads; i2p::config::GetOption ("ssu2.datathreads", numDataThreads);
+			if (numDataThreads > SSU2_MAX_NUM_DATA_THREADS) numDataThreads = SSU2_MAX_NUM_DATA_THREADS;
+			for (int i = 0; i < numDataThreads; i++)
+			{
+				m_DataShards.emplace_back (new DataShard ("SSU2d" + std::to_string (i)));
+				m_DataShards.back ()->Start ();
+			}
+			if (numDataThreads)
+				LogPrint (eLogInfo, "SSU2: Using ", numDataThreads, " data decryption threads");
+			std::string congestionControl; i2p::config::GetOption ("ssu2.congestioncontrol", congestionControl);
+			if (congestionControl == "cubic")
+				m_CongestionControlType = eSSU2CongestionControlCubic;
+			else if (congestionControl == "bbr")
+				m_CongestionControlType = eSSU2CongestionControlBBR;
+			else
+			{
+				if (!congestionControl.empty () && congestionControl != "default")
+					LogPrint (eLogWarning, "SSU2: Unknown congestion control ", congestionControl, ". Using default");
+				m_CongestionControlType = eSSU2CongestionControlDefault;
+			}
+			uint16_t numReceiveThreads; i2p::config::GetOption ("ssu2.receivethreads", numReceiveThreads);
+#if defined(SO_REUSEPORT)
+			m_NumReceiveThreads = (numReceiveThreads > 1 && !m_IsThroughProxy) ? numReceiveThreads : 1;
+#else
+			if (numReceiveThreads > 1)
+				LogPrint (eLogWarning, "SSU2: SO_REUSEPORT is not supported, single receive thread is used");
+#endif
+#if defined(__linux__)
+			bool gso; i2p::config::GetOption ("ssu2.gso", gso);
+			m_IsGSO = gso; m_IsGRO = gso; // until rejected by kernel
+#endif
 			bool found = false;
 			auto addresses = i2p::context.GetRouterInfo ().GetAddresses ();
 			if (!addresses) return;
@@ -86,8 +142,9 @@ namespace transport
 							boost::asio::post (m_ReceiveService.GetService (),
 								[this]()
 								{
-									Receive (m_SocketV4);
+									Receive (m_SocketV4, m_ReceiveService);
 								});
+							OpenReusePortSockets (boost::asio::ip::udp::endpoint (m_AddressV4, port));
 							ScheduleIntroducersUpdateTimer (); // wait for 30 seconds and decide if we need introducers
 						}
 						if (address->IsV6 ())
@@ -99,8 +156,9 @@ namespace transport
 							boost::asio::post (m_ReceiveService.GetService (),
 								[this]()
 								{
-									Receive (m_SocketV6);
+									Receive (m_SocketV6, m_ReceiveService);
 								});
+							OpenReusePortSockets (boost::asio::ip::udp::endpoint (m_AddressV6, port));
 							ScheduleIntroducersUpdateTimerV6 (); // wait for 30 seconds and decide if we need introducers
 						}
 					}
@@ -113,6 +171,8 @@ namespace transport
 				if (m_IsThroughProxy)
 					ConnectToProxy ();
 				m_ReceiveService.Start ();
+				for (auto& it: m_ReusePortReceivers)
+					it->service.Start ();
 			}
 			ScheduleTermination ();
 			ScheduleCleanup ();
@@ -142,6 +202,11 @@ namespace transport
 			m_ReceiveService.Stop ();
 		m_SocketV4.close ();
 		m_SocketV6.close ();
+		for (auto& it: m_ReusePortReceivers)
+		{
+			it->service.Stop ();
+			it->socket.close ();
+		}
 
 		if (m_UDPAssociateSocket)
 		{
@@ -149,9 +214,13 @@ namespace transport
 			m_UDPAssociateSocket.reset (nullptr);
 		}
 
+		for (auto& it: m_DataShards)
+			it->Stop ();
 		StopIOService ();
+		m_DataShards.clear ();
 
 		m_Sessions.clear ();
+		m_NumSessions = 0;
 		m_SessionsByRouterHash.clear ();
 		m_PendingOutgoingSessions.clear ();
 		m_Relays.clear ();
@@ -161,8 +230,17 @@ namespace transport
 		m_ConnectedRecently.clear ();
 		m_RequestedPeerTests.clear ();
 
-		m_PacketsPool.ReleaseMt (m_ReceivedPacketsQueue);
-		m_ReceivedPacketsQueue.clear ();
+		m_ReceiveService.ReleasePackets ();
+		for (auto& it: m_ReusePortReceivers)
+			it->service.ReleasePackets ();
+		m_ReusePortReceivers.clear ();
+#if defined(__linux__)
+		m_PacketsPool.ReleaseMt (m_SendBatchV4);
+		m_SendBatchV4.clear ();
+		m_PacketsPool.ReleaseMt (m_SendBatchV6);
+		m_SendBatchV6.clear ();
+		m_IsSendBatchFlushPending = false;
+#endif
 	}
 
 	void SSU2Server::SetLocalAddress (const boost::asio::ip::address& localAddress)
@@ -283,11 +361,25 @@ namespace transport
 	boost::asio::ip::udp::socket& SSU2Server::OpenSocket (const boost::asio::ip::udp::endpoint& localEndpoint)
 	{
 		boost::asio::ip::udp::socket& socket = localEndpoint.address ().is_v6 () ? m_SocketV6 : m_SocketV4;
+		OpenSocket (localEndpoint, socket);
+		return socket;
+	}
+
+	void SSU2Server::OpenSocket (const boost::asio::ip::udp::endpoint& localEndpoint, boost::asio::ip::udp::socket& socket)
+	{
 		try
 		{
 			if (socket.is_open ())
 				socket.close ();
 			socket.open (localEndpoint.protocol ());
+#if defined(SO_REUSEPORT)
+			if (m_NumReceiveThreads > 1)
+			{
+				int enable = 1;
+				if (setsockopt (socket.native_handle (), SOL_SOCKET, SO_REUSEPORT, &enable, sizeof (enable)) < 0)
+					LogPrint (eLogError, "SSU2: Can't set SO_REUSEPORT: ", strerror (errno));
+			}
+#endif
 			if (localEndpoint.address ().is_v6 ())
 #if !defined(__HAIKU__)					
 				socket.set_option (boost::asio::ip::v6_only (true));
@@ -324,12 +416,32 @@ namespace transport
 			}
 
 			socket.non_blocking (true);
+#if defined(__linux__)
+			if (m_IsGSO)
+			{
+				int segmentSize = 0; socklen_t optlen = sizeof (segmentSize);
+				if (getsockopt (socket.native_handle (), SOL_UDP, UDP_SEGMENT, &segmentSize, &optlen) < 0)
+				{
+					LogPrint (eLogWarning, "SSU2: UDP GSO is not supported: ", strerror (errno));
+					m_IsGSO = false;
+				}
+			}
+			if (m_IsGRO)
+			{
+				int enable = 1;
+				if (setsockopt (socket.native_handle (), SOL_UDP, UDP_GRO, &enable, sizeof (enable)) < 0)
+				{
+					LogPrint (eLogWarning, "SSU2: UDP GRO is not supported: ", strerror (errno));
+					m_IsGRO = false;
+				}
+			}
+#endif
 		}
 		catch (std::exception& ex )
 		{
 			LogPrint (eLogCritical, "SSU2: Failed to open socket on ", localEndpoint.address (), ": ", ex.what());
 			ThrowFatal ("Unable to start SSU2 transport on ", localEndpoint.address (), ": ", ex.what ());
-			return socket;
+			return;
 		}
 		try
 		{
@@ -341,18 +453,44 @@ namespace transport
 			LogPrint (eLogWarning, "SSU2: Failed to bind to ", localEndpoint, ": ", ex.what(), ". Actual endpoint is ", socket.local_endpoint ());
 			// we can continue without binding being firewalled
 		}
-		return socket;
 	}
 
-	void SSU2Server::Receive (boost::asio::ip::udp::socket& socket)
+	void SSU2Server::OpenReusePortSockets (const boost::asio::ip::udp::endpoint& localEndpoint)
+	{
+#if defined(SO_REUSEPORT)
+		for (int i = 1; i < m_NumReceiveThreads; i++)
+		{
+			auto receiver = std::make_unique<ReusePortReceiver> ((localEndpoint.address ().is_v6 () ? "SSU2r6-" : "SSU2r4-") + std::to_string (i));
+			OpenSocket (localEndpoint, receiver->socket);
+			auto r = receiver.get ();
+			boost::asio::post (r->service.GetService (),
+				[this, r]()
+				{
+					Receive (r->socket, r->service);
+				});
+			m_ReusePortReceivers.push_back (std::move (receiver));
+		}
+#endif
+	}
+
+	void SSU2Server::Receive (boost::asio::ip::udp::socket& socket, ReceiveService& receiver)
 	{
-		Packet * packet = m_PacketsPool.AcquireMt ();
+#if defined(__linux__)
+		if (m_IsBatchedIO)
+		{
+			socket.async_wait (boost::asio::socket_base::wait_read,
+				std::bind (&SSU2Server::HandleReadyToReceive, this, std::placeholders::_1, std::ref (socket), std::ref (receiver)));
+			return;
+		}
+#endif
+		Packet * packet = receiver.packetsPool.AcquireMt ();
 		socket.async_receive_from (boost::asio::buffer (packet->buf, SSU2_MAX_PACKET_SIZE), packet->from,
-			std::bind (&SSU2Server::HandleReceivedFrom, this, std::placeholders::_1, std::placeholders::_2, packet, std::ref (socket)));
+			std::bind (&SSU2Server::HandleReceivedFrom, this, std::placeholders::_1, std::placeholders::_2, packet,
+				std::ref (socket), std::ref (receiver)));
 	}
 
 	void SSU2Server::HandleReceivedFrom (const boost::system::error_code& ecode, size_t bytes_transferred,
-		Packet * packet, boost::asio::ip::udp::socket& socket)
+		Packet * packet, boost::asio::ip::udp::socket& socket, ReceiveService& receiver)
 	{
 		if (!ecode
 			|| ecode == boost::asio::error::connection_refused
@@ -374,8 +512,9 @@ namespace transport
 			if (bytes_transferred < SSU2_MIN_RECEIVED_PACKET_SIZE)
 			{
 				// drop too short packets
-				m_PacketsPool.ReleaseMt (packet);
-				Receive (socket);
+				g_DroppedShortPacketsMetric.Inc ();
+				receiver.packetsPool.ReleaseMt (packet);
+				Receive (socket, receiver);
 				return;
 			}	
 			packet->len = bytes_transferred;
@@ -388,7 +527,7 @@ namespace transport
 				packets.push_back (packet);
 				while (moreBytes && packets.size () < SSU2_MAX_NUM_PACKETS_PER_BATCH)
 				{	
-					packet = m_PacketsPool.AcquireMt ();
+					packet = receiver.packetsPool.AcquireMt ();
 					packet->len = socket.receive_from (boost::asio::buffer (packet->buf, SSU2_MAX_PACKET_SIZE), packet->from, 0, ec);
 					if (!ec)
 					{
@@ -396,103 +535,347 @@ namespace transport
 						if (packet->len >= SSU2_MIN_RECEIVED_PACKET_SIZE)
 							packets.push_back (packet);
 						else // drop too short packets
-							m_PacketsPool.ReleaseMt (packet);
+						{
+							g_DroppedShortPacketsMetric.Inc ();
+							receiver.packetsPool.ReleaseMt (packet);
+						}
 						moreBytes = socket.available(ec);
 						if (ec) break;
 					}
 					else
 					{
 						LogPrint (eLogError, "SSU2: receive_from error: code ", ec.value(), ": ", ec.message ());
-						m_PacketsPool.ReleaseMt (packet);
+						receiver.packetsPool.ReleaseMt (packet);
 						break;
 					}
 				}
-				InsertToReceivedPacketsQueue (packets);
+				InsertToReceivedPacketsQueue (packets, receiver);
 			}
 			else
-				InsertToReceivedPacketsQueue (packet); 
-			Receive (socket);
+				InsertToReceivedPacketsQueue (packet, receiver);
+			Receive (socket, receiver);
 		}
 		else
 		{
-			m_PacketsPool.ReleaseMt (packet);
-			if (ecode != boost::asio::error::operation_aborted)
+			receiver.packetsPool.ReleaseMt (packet);
+			HandleReceiveError (ecode, socket, receiver);
+		}
+	}
+
+	void SSU2Server::HandleReceiveError (const boost::system::error_code& ecode, boost::asio::ip::udp::socket& socket, ReceiveService& receiver)
+	{
+		if (ecode != boost::asio::error::operation_aborted)
+		{
+			LogPrint (eLogError, "SSU2: Receive error: code ", ecode.value(), ": ", ecode.message ());
+			if (m_IsThroughProxy)
 			{
-				LogPrint (eLogError, "SSU2: Receive error: code ", ecode.value(), ": ", ecode.message ());
-				if (m_IsThroughProxy)
+				m_UDPAssociateSocket.reset (nullptr);
+				m_ProxyRelayEndpoint.reset (nullptr);
+				m_SocketV4.close ();
+				ConnectToProxy ();
+			}
+			else
+			{
+				auto ep = socket.local_endpoint ();
+				LogPrint (eLogCritical, "SSU2: Reopening socket in HandleReceivedFrom: code ", ecode.value(), ": ", ecode.message ());
+				OpenSocket (ep, socket);
+				Receive (socket, receiver);
+			}
+		}
+	}
+
+#if defined(__linux__)
+	void SSU2Server::HandleReadyToReceive (const boost::system::error_code& ecode, boost::asio::ip::udp::socket& socket, ReceiveService& receiver)
+	{
+		if (ecode)
+		{
+			HandleReceiveError (ecode, socket, receiver);
+			return;
+		}
+		std::list<Packet *> received;
+		int num = 0;
+		size_t numBytes = m_IsGRO ? ReceiveCoalesced (socket, receiver, received, num) : ReceiveBatch (socket, receiver, received, num);
+		if (num > 0)
+		{
+			i2p::transport::transports.UpdateReceivedBytes (numBytes);
+			InsertToReceivedPacketsQueue (received, receiver);
+			Receive (socket, receiver);
+		}
+		else
+		{
+			boost::system::error_code ec (num < 0 ? errno : EAGAIN, boost::asio::error::get_system_category ());
+			if (ec.value () == ENOSYS)
+			{
+				LogPrint (eLogWarning, "SSU2: recvmmsg is not supported, switch to regular receive");
+				m_IsBatchedIO = false;
+				Receive (socket, receiver);
+			}
+			else if (ec == boost::asio::error::would_block || ec == boost::asio::error::try_again
+				|| ec == boost::asio::error::interrupted
+				|| ec == boost::asio::error::connection_refused
+				|| ec == boost::asio::error::connection_reset
+				|| ec == boost::asio::error::network_reset
+				|| ec == boost::asio::error::network_unreachable
+				|| ec == boost::asio::error::host_unreachable)
+				// spurious wakeup or ICMP response, continue reading
+				Receive (socket, receiver);
+			else
+				HandleReceiveError (ec, socket, receiver);
+		}
+	}
+
+	size_t SSU2Server::ReceiveBatch (boost::asio::ip::udp::socket& socket, ReceiveService& receiver, std::list<Packet *>& received, int& num)
+	{
+		auto& packets = receiver.receiveBatch; // packets received by previous call are replaced by new ones
+		mmsghdr msgs[SSU2_MAX_NUM_PACKETS_PER_BATCH];
+		iovec iovs[SSU2_MAX_NUM_PACKETS_PER_BATCH];
+		memset (msgs, 0, sizeof (msgs));
+		for (size_t i = 0; i < SSU2_MAX_NUM_PACKETS_PER_BATCH; i++)
+		{
+			if (!packets[i]) packets[i] = receiver.packetsPool.AcquireMt ();
+			iovs[i].iov_base = packets[i]->buf;
+			iovs[i].iov_len = SSU2_MAX_PACKET_SIZE;
+			msgs[i].msg_hdr.msg_name = packets[i]->from.data ();
+			msgs[i].msg_hdr.msg_namelen = packets[i]->from.capacity ();
+			msgs[i].msg_hdr.msg_iov = iovs + i;
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+		num = recvmmsg (socket.native_handle (), msgs, SSU2_MAX_NUM_PACKETS_PER_BATCH, MSG_DONTWAIT, nullptr);
+		size_t numBytes = 0;
+		for (int i = 0; i < num; i++)
+		{
+			auto packet = packets[i];
+			packets[i] = nullptr;
+			packet->len = msgs[i].msg_len;
+			numBytes += packet->len;
+			if (packet->len >= SSU2_MIN_RECEIVED_PACKET_SIZE && msgs[i].msg_hdr.msg_namelen <= packet->from.capacity ())
+			{
+				packet->from.resize (msgs[i].msg_hdr.msg_namelen);
+				received.push_back (packet);
+			}
+			else // drop too short packets
+			{
+				g_DroppedShortPacketsMetric.Inc ();
+				receiver.packetsPool.ReleaseMt (packet);
+			}
+		}
+		return numBytes;
+	}
+
+	size_t SSU2Server::ReceiveCoalesced (boost::asio::ip::udp::socket& socket, ReceiveService& receiver, std::list<Packet *>& received, int& num)
+	{
+		auto& buffers = receiver.groBuffers;
+		if (!buffers) buffers.reset (new uint8_t[SSU2_NUM_GRO_BUFFERS*SSU2_GRO_BUFFER_SIZE]);
+		mmsghdr msgs[SSU2_NUM_GRO_BUFFERS];
+		iovec iovs[SSU2_NUM_GRO_BUFFERS];
+		boost::asio::ip::udp::endpoint from[SSU2_NUM_GRO_BUFFERS];
+		uint8_t controls[SSU2_NUM_GRO_BUFFERS][CMSG_SPACE(sizeof (int))];
+		memset (msgs, 0, sizeof (msgs));
+		for (size_t i = 0; i < SSU2_NUM_GRO_BUFFERS; i++)
+		{
+			iovs[i].iov_base = buffers.get () + i*SSU2_GRO_BUFFER_SIZE;
+			iovs[i].iov_len = SSU2_GRO_BUFFER_SIZE;
+			msgs[i].msg_hdr.msg_name = from[i].data ();
+			msgs[i].msg_hdr.msg_namelen = from[i].capacity ();
+			msgs[i].msg_hdr.msg_iov = iovs + i;
+			msgs[i].msg_hdr.msg_iovlen = 1;
+			msgs[i].msg_hdr.msg_control = controls[i];
+			msgs[i].msg_hdr.msg_controllen = sizeof (controls[i]);
+		}
+		num = recvmmsg (socket.native_handle (), msgs, SSU2_NUM_GRO_BUFFERS, MSG_DONTWAIT, nullptr);
+		size_t numBytes = 0;
+		for (int i = 0; i < num; i++)
+		{
+			size_t len = msgs[i].msg_len;
+			numBytes += len;
+			if (msgs[i].msg_hdr.msg_namelen > from[i].capacity ()) continue;
+			from[i].resize (msgs[i].msg_hdr.msg_namelen);
+			// coalesced datagrams have the same size except last one
+			size_t segmentSize = len;
+			for (auto cmsg = CMSG_FIRSTHDR (&msgs[i].msg_hdr); cmsg; cmsg = CMSG_NXTHDR (&msgs[i].msg_hdr, cmsg))
+				if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
 				{
-					m_UDPAssociateSocket.reset (nullptr);
-					m_ProxyRelayEndpoint.reset (nullptr);
-					m_SocketV4.close ();
-					ConnectToProxy ();
+					int size; memcpy (&size, CMSG_DATA (cmsg), sizeof (size));
+					if (size > 0) segmentSize = size;
+					break;
 				}
-				else
+			const uint8_t * buf = (const uint8_t *)iovs[i].iov_base;
+			for (size_t offset = 0; offset < len; offset += segmentSize)
+			{
+				size_t l = std::min (segmentSize, len - offset);
+				if (l < SSU2_MIN_RECEIVED_PACKET_SIZE || l > SSU2_MAX_PACKET_SIZE)
 				{
-					auto ep = socket.local_endpoint ();
-					LogPrint (eLogCritical, "SSU2: Reopening socket in HandleReceivedFrom: code ", ecode.value(), ": ", ecode.message ());
-					OpenSocket (ep);
-					Receive (socket);
+					g_DroppedShortPacketsMetric.Inc ();
+					continue; // drop
 				}
+				auto packet = receiver.packetsPool.AcquireMt ();
+				memcpy (packet->buf, buf + offset, l);
+				packet->len = l;
+				packet->from = from[i];
+				received.push_back (packet);
 			}
 		}
+		return numBytes;
 	}
+#endif
 
-	void SSU2Server::HandleReceivedPackets (std::list<Packet *>&& packets)
+	void SSU2Server::HandleReceivedPackets (std::list<Packet *>&& packets, ReceiveService& receiver)
 	{
 		if (packets.empty ()) return;
+		g_ReceivedPacketsMetric.Inc (packets.size ());
 		if (m_IsThroughProxy)
 			for (auto it: packets)
 				ProcessNextPacketFromProxy (it->buf, it->len);
+		else if (!m_DataShards.empty ())
+			DispatchToDataShards (packets, receiver);
 		else
 			for (auto it: packets)
 				ProcessNextPacket (it->buf, it->len, it->from);
-		m_PacketsPool.ReleaseMt (packets);
+		receiver.packetsPool.ReleaseMt (packets);
 		if (m_LastSession && m_LastSession->GetState () != eSSU2SessionStateTerminated)
 			m_LastSession->FlushData ();
 	}
 
-	void SSU2Server::InsertToReceivedPacketsQueue (Packet * packet)
+	void SSU2Server::InsertToReceivedPacketsQueue (Packet * packet, ReceiveService& receiver)
 	{
 		if (!packet) return;
 		bool empty = false;
 		{
-			std::lock_guard<std::mutex> l(m_ReceivedPacketsQueueMutex);
-			empty = m_ReceivedPacketsQueue.empty ();
-			m_ReceivedPacketsQueue.push_back (packet);
+			std::lock_guard<std::mutex> l(receiver.receivedPacketsQueueMutex);
+			empty = receiver.receivedPacketsQueue.empty ();
+			receiver.receivedPacketsQueue.push_back (packet);
 		}
 		if (empty)
-			boost::asio::post (GetService (), [this]() { HandleReceivedPacketsQueue (); });
+			boost::asio::post (GetService (), [this, &receiver]() { HandleReceivedPacketsQueue (receiver); });
 	}	
 
-	void SSU2Server::InsertToReceivedPacketsQueue (std::list<Packet *>& packets)
+	void SSU2Server::InsertToReceivedPacketsQueue (std::list<Packet *>& packets, ReceiveService& receiver)
 	{
 		if (packets.empty ()) return;
 		size_t queueSize = 0;
 		{
-			std::lock_guard<std::mutex> l(m_ReceivedPacketsQueueMutex);
-			queueSize = m_ReceivedPacketsQueue.size ();
+			std::lock_guard<std::mutex> l(receiver.receivedPacketsQueueMutex);
+			queueSize = receiver.receivedPacketsQueue.size ();
 			if (queueSize < SSU2_MAX_RECEIVED_QUEUE_SIZE)
-				m_ReceivedPacketsQueue.splice (m_ReceivedPacketsQueue.end (), packets);
+				receiver.receivedPacketsQueue.splice (receiver.receivedPacketsQueue.end (), packets);
 			else
 			{
 				LogPrint (eLogError, "SSU2: Received queue size ", queueSize, " exceeds max size", SSU2_MAX_RECEIVED_QUEUE_SIZE);
-				m_PacketsPool.ReleaseMt (packets);
+				g_DroppedQueueFullPacketsMetric.Inc (packets.size ());
+				receiver.packetsPool.ReleaseMt (packets);
 				queueSize = 0; // invoke processing just in case
 			}		
 		}
 		if (!queueSize)
-			boost::asio::post (GetService (), [this]() { HandleReceivedPacketsQueue (); });
+			boost::asio::post (GetService (), [this, &receiver]() { HandleReceivedPacketsQueue (receiver); });
 	}	
 		
-	void SSU2Server::HandleReceivedPacketsQueue ()
+	void SSU2Server::HandleReceivedPacketsQueue (ReceiveService& receiver)
 	{
 		std::list<Packet *> receivedPackets;
 		{
-			std::lock_guard<std::mutex> l(m_ReceivedPacketsQueueMutex);
-			m_ReceivedPacketsQueue.swap (receivedPackets);
+			std::lock_guard<std::mutex> l(receiver.receivedPacketsQueueMutex);
+			receiver.receivedPacketsQueue.swap (receivedPackets);
 		}
-		HandleReceivedPackets (std::move (receivedPackets));
+		HandleReceivedPackets (std::move (receivedPackets), receiver);
 	}	
+
+	void SSU2Server::DispatchToDataShards (std::list<Packet *>& packets, ReceiveService& receiver)
+	{
+		std::vector<std::list<DataPacket> > shardPackets (m_DataShards.size ());
+		for (auto it = packets.begin (); it != packets.end ();)
+		{
+			auto packet = *it;
+			uint64_t connID;
+			memcpy (&connID, packet->buf, 8);
+			connID ^= CreateHeaderMask (i2p::context.GetSSU2IntroKey (), packet->buf + (packet->len - 24));
+			auto it1 = m_Sessions.find (connID);
+			if (it1 != m_Sessions.end () && it1->second->IsEstablished ())
+			{
+				// same session always goes to the same shard, order is preserved
+				shardPackets[connID % m_DataShards.size ()].push_back ({ it1->second, packet, eSSU2DataNotData });
+				it = packets.erase (it);
+			}
+			else
+			{
+				ProcessNextPacket (packet->buf, packet->len, packet->from);
+				it++;
+			}
+		}
+		for (size_t i = 0; i < shardPackets.size (); i++)
+		{
+			if (shardPackets[i].empty ()) continue;
+			auto shard = m_DataShards[i].get ();
+			boost::asio::post (shard->GetService (),
+				[this, shard, &receiver, dataPackets = std::move (shardPackets[i])]() mutable
+				{
+					if (!shard->IsRunning ())
+					{
+						// drained by Stop
+						for (auto& it: dataPackets)
+							receiver.packetsPool.ReleaseMt (it.packet);
+						return;
+					}
+					for (auto& it: dataPackets)
+						it.result = it.session->DecryptData (it.packet->buf, it.packet->len, shard->GetDecryptor ());
+					boost::asio::post (GetService (),
+						[this, &receiver, dataPackets = std::move (dataPackets)]() mutable
+						{
+							HandleDecryptedDataPackets (dataPackets, receiver);
+						});
+				});
+		}
+	}
+
+	void SSU2Server::HandleDecryptedDataPackets (std::list<DataPacket>& dataPackets, ReceiveService& receiver)
+	{
+		std::vector<Packet *> packets;
+		packets.reserve (dataPackets.size ());
+		std::shared_ptr<SSU2Session> session;
+		for (auto& it: dataPackets)
+		{
+			if (it.session != session)
+			{
+				if (session) session->FlushData ();
+				session = it.session;
+			}
+			switch (it.result)
+			{
+				case eSSU2DataDecrypted:
+					if (session->GetState () == eSSU2SessionStateEstablished)
+						session->ProcessDecryptedData (it.packet->buf, it.packet->len, it.packet->from);
+					else if (session->GetState () == eSSU2SessionStateClosing)
+					{
+						session->ProcessDecryptedData (it.packet->buf, it.packet->len, it.packet->from); // we might receive termination block
+						if (session->GetState () == eSSU2SessionStateClosing)
+							session->RequestTermination (eSSU2TerminationReasonIdleTimeout); // send termination again
+					}
+				break;
+				case eSSU2DataNotData:
+					ProcessNextPacket (it.packet->buf, it.packet->len, it.packet->from); // packet is intact
+				break;
+				default:
+					LogPrint (eLogWarning, "SSU2: Data AEAD verification failed ");
+			}
+			packets.push_back (it.packet);
+		}
+		if (session) session->FlushData ();
+		receiver.packetsPool.ReleaseMt (packets);
+	}
+
+	void SSU2Server::ReceiveService::ReleasePackets ()
+	{
+		packetsPool.ReleaseMt (receivedPacketsQueue);
+		receivedPacketsQueue.clear ();
+#if defined(__linux__)
+		for (auto& it: receiveBatch)
+			if (it)
+			{
+				packetsPool.ReleaseMt (it);
+				it = nullptr;
+			}
+#endif
+	}
 		
 	bool SSU2Server::AddSession (std::shared_ptr<SSU2Session> session)
 	{
@@ -500,6 +883,7 @@ namespace transport
 		{
 			if (m_Sessions.emplace (session->GetConnID (), session).second)
 			{	
+				m_NumSessions.store (m_Sessions.size (), std::memory_order_relaxed);
 				if (session->GetState () != eSSU2SessionStatePeerTest)
 					AddSessionByRouterHash (session);
 				return true;
@@ -527,6 +911,7 @@ namespace transport
 			if (m_LastSession == it->second)
 				m_LastSession = nullptr;
 			m_Sessions.erase (it);
+			m_NumSessions.store (m_Sessions.size (), std::memory_order_relaxed);
 		}
 	}
 
@@ -789,6 +1174,9 @@ namespace transport
 			SendThroughProxy (header, headerLen, nullptr, 0, payload, payloadLen, to);
 			return;
 		}
+#if defined(__linux__)
+		if (AddToSendBatch (header, headerLen, nullptr, 0, payload, payloadLen, to)) return;
+#endif
 
 		std::vector<boost::asio::const_buffer> bufs
 		{
@@ -825,6 +1213,9 @@ namespace transport
 			SendThroughProxy (header, headerLen, headerX, headerXLen, payload, payloadLen, to);
 			return;
 		}
+#if defined(__linux__)
+		if (AddToSendBatch (header, headerLen, headerX, headerXLen, payload, payloadLen, to)) return;
+#endif
 
 		std::vector<boost::asio::const_buffer> bufs
 		{
@@ -854,6 +1245,142 @@ namespace transport
 		}
 	}
 
+#if defined(__linux__)
+	bool SSU2Server::AddToSendBatch (const uint8_t * header, size_t headerLen, const uint8_t * headerX, size_t headerXLen,
+		const uint8_t * payload, size_t payloadLen, const boost::asio::ip::udp::endpoint& to)
+	{
+		if (!m_IsBatchedIO || headerLen + headerXLen + payloadLen > SSU2_MAX_PACKET_SIZE) return false;
+		bool v6 = to.address ().is_v6 ();
+		if (!(v6 ? m_SocketV6 : m_SocketV4).is_open ()) return true; // drop
+		auto& batch = v6 ? m_SendBatchV6 : m_SendBatchV4;
+		// copy packet, since header and payload are in caller's stack
+		auto packet = m_PacketsPool.AcquireMt ();
+		memcpy (packet->buf, header, headerLen);
+		if (headerXLen) memcpy (packet->buf + headerLen, headerX, headerXLen);
+		memcpy (packet->buf + headerLen + headerXLen, payload, payloadLen);
+		packet->len = headerLen + headerXLen + payloadLen;
+		packet->from = to;
+		batch.push_back (packet);
+		if (batch.size () >= SSU2_MAX_NUM_PACKETS_PER_BATCH)
+			FlushSendBatch (batch, v6 ? m_SocketV6 : m_SocketV4);
+		else if (!m_IsSendBatchFlushPending)
+		{
+			// send all packets added by current handler at once
+			m_IsSendBatchFlushPending = true;
+			boost::asio::post (GetService (), [this]() { FlushSendBatches (); });
+		}
+		return true;
+	}
+
+	void SSU2Server::FlushSendBatches ()
+	{
+		m_IsSendBatchFlushPending = false;
+		FlushSendBatch (m_SendBatchV4, m_SocketV4);
+		FlushSendBatch (m_SendBatchV6, m_SocketV6);
+	}
+
+	void SSU2Server::FlushSendBatch (std::vector<Packet *>& batch, boost::asio::ip::udp::socket& socket)
+	{
+		if (batch.empty ()) return;
+		size_t num = batch.size (), numBytes = 0;
+		size_t first = 0; // first packet not sent yet
+		while (socket.is_open () && first < num)
+		{
+			// build messages, consecutive packets of the same size to the same endpoint are coalesced if GSO
+			mmsghdr msgs[SSU2_MAX_NUM_PACKETS_PER_BATCH];
+			iovec iovs[SSU2_MAX_NUM_PACKETS_PER_BATCH];
+			uint8_t controls[SSU2_MAX_NUM_PACKETS_PER_BATCH][CMSG_SPACE(sizeof (uint16_t))];
+			size_t msgFirst[SSU2_MAX_NUM_PACKETS_PER_BATCH + 1]; // first packet of message
+			bool gso = m_IsGSO;
+			size_t numMsgs = 0;
+			memset (msgs, 0, sizeof (msgs));
+			for (size_t i = first; i < num;)
+			{
+				auto segmentSize = batch[i]->len;
+				size_t n = 1, len = segmentSize;
+				if (gso)
+					while (i + n < num && n < SSU2_MAX_NUM_GSO_SEGMENTS && batch[i + n - 1]->len == segmentSize &&
+						batch[i + n]->len <= segmentSize && len + batch[i + n]->len <= SSU2_MAX_GSO_SIZE &&
+						batch[i + n]->from == batch[i]->from)
+					{
+						len += batch[i + n]->len; // last segment might be shorter
+						n++;
+					}
+				for (size_t j = i; j < i + n; j++)
+				{
+					iovs[j].iov_base = batch[j]->buf;
+					iovs[j].iov_len = batch[j]->len;
+				}
+				auto& hdr = msgs[numMsgs].msg_hdr;
+				hdr.msg_name = batch[i]->from.data ();
+				hdr.msg_namelen = batch[i]->from.size ();
+				hdr.msg_iov = iovs + i;
+				hdr.msg_iovlen = n;
+				if (n > 1)
+				{
+					hdr.msg_control = controls[numMsgs];
+					hdr.msg_controllen = sizeof (controls[numMsgs]);
+					auto cmsg = CMSG_FIRSTHDR (&hdr);
+					cmsg->cmsg_level = SOL_UDP;
+					cmsg->cmsg_type = UDP_SEGMENT;
+					cmsg->cmsg_len = CMSG_LEN(sizeof (uint16_t));
+					uint16_t size = segmentSize;
+					memcpy (CMSG_DATA (cmsg), &size, sizeof (size));
+				}
+				msgFirst[numMsgs++] = i;
+				i += n;
+			}
+			msgFirst[numMsgs] = num;
+			// send
+			size_t numSent = 0;
+			while (numSent < numMsgs)
+			{
+				int sent = sendmmsg (socket.native_handle (), msgs + numSent, numMsgs - numSent, 0);
+				if (sent > 0)
+				{
+					for (int i = 0; i < sent; i++)
+						numBytes += msgs[numSent + i].msg_len;
+					numSent += sent;
+				}
+				else if (sent < 0 && errno == EINTR)
+					continue;
+				else if (sent < 0 && errno == EIO && gso)
+				{
+					// device can't segment, resend the rest without coalescing
+					LogPrint (eLogWarning, "SSU2: UDP GSO is rejected by kernel, disabled");
+					m_IsGSO = false;
+					break;
+				}
+				else if (sent < 0 && errno == ENOSYS)
+				{
+					LogPrint (eLogWarning, "SSU2: sendmmsg is not supported, switch to regular send");
+					m_IsBatchedIO = false;
+					for (size_t i = msgFirst[numSent]; i < num; i++)
+					{
+						boost::system::error_code ec;
+						socket.send_to (boost::asio::buffer (batch[i]->buf, batch[i]->len), batch[i]->from, 0, ec);
+						if (!ec) numBytes += batch[i]->len;
+					}
+					numSent = numMsgs;
+				}
+				else
+				{
+					// first message failed, the rest is not sent. Drop it and continue
+					boost::system::error_code ec (sent < 0 ? errno : EAGAIN, boost::asio::error::get_system_category ());
+					LogPrint (ec == boost::asio::error::would_block ? eLogInfo : eLogError,
+						"SSU2: Send exception: ", ec.message (), " to ", batch[msgFirst[numSent]]->from);
+					numSent++;
+				}
+			}
+			first = msgFirst[numSent];
+		}
+		if (numBytes)
+			i2p::transport::transports.UpdateSentBytes (numBytes);
+		m_PacketsPool.ReleaseMt (batch);
+		batch.clear ();
+	}
+#endif
+
 	bool SSU2Server::CheckPendingOutgoingSession (const boost::asio::ip::udp::endpoint& ep, bool peerTest)
 	{
 		auto s = FindPendingOutgoingSession (ep);
@@ -1193,6 +1720,9 @@ namespace transport
 			}	
 			
 			m_PacketsPool.CleanUpMt ();
+			m_ReceiveService.packetsPool.CleanUpMt ();
+			for (auto& it: m_ReusePortReceivers)
+				it->service.packetsPool.CleanUpMt ();
 			m_SentPacketsPool.CleanUp ();
 			m_IncompleteMessagesPool.CleanUp ();
 			m_FragmentsPool.CleanUp ();
@@ -1732,7 +2262,7 @@ namespace transport
 							uint16_t port = bufbe16toh (m_UDPRequestHeader + 8);
 							m_ProxyRelayEndpoint.reset (new boost::asio::ip::udp::endpoint (boost::asio::ip::address_v4 (bytes), port));
 							m_SocketV4.open (boost::asio::ip::udp::v4 ());
-							Receive (m_SocketV4);
+							Receive (m_SocketV4, m_ReceiveService);
 							ReadUDPAssociateSocket ();
 						}
 						else
@@ -15,6 +15,7 @@
 #include <list>
 #include <array>
 #include <mutex>
+#include <atomic>
 #include <random>
 #include "util.h"
 #include "SSU2Session.h"
@@ -50,6 +51,11 @@ namespace transport
 	const int SSU2_MIN_HOLE_PUNCH_EXPIRATION = 30; // in seconds
 	const int SSU2_MAX_HOLE_PUNCH_EXPIRATION = 160; // in seconds
 	const size_t SSU2_MAX_NUM_PACKETS_PER_BATCH = 64;
+	const size_t SSU2_MAX_NUM_GSO_SEGMENTS = 64; // UDP_MAX_SEGMENTS
+	const size_t SSU2_MAX_GSO_SIZE = 65000; // max size of coalesced datagram
+	const size_t SSU2_GRO_BUFFER_SIZE = 65536;
+	const size_t SSU2_NUM_GRO_BUFFERS = 8;
+	const int SSU2_MAX_NUM_DATA_THREADS = 64;
 
 	class SSU2Server: private i2p::util::RunnableServiceWithWork
 	{
@@ -68,6 +74,53 @@ namespace transport
 				auto& GetService () { return GetIOService (); };
 				void Start () { StartIOService (); };
 				void Stop () { StopIOService (); };
+				void ReleasePackets ();
+
+				// received by this thread, handled by SSU2 thread
+				i2p::util::MemoryPoolMt<Packet> packetsPool;
+				std::list<Packet *> receivedPacketsQueue;
+				std::mutex receivedPacketsQueueMutex;
+#if defined(__linux__)
+				std::array<Packet *, SSU2_MAX_NUM_PACKETS_PER_BATCH> receiveBatch{}; // recvmmsg, this thread only
+				std::unique_ptr<uint8_t[]> groBuffers; // this thread only
+#endif
+		};
+
+		struct ReusePortReceiver // additional socket bound to the same port with own receive thread
+		{
+			ReceiveService service;
+			boost::asio::ip::udp::socket socket;
+
+			ReusePortReceiver (const std::string& name): service (name), socket (service.GetService ()) {};
+		};
+
+		class DataShard: public i2p::util::RunnableServiceWithWork // decrypts data packets of established sessions
+		{
+			public:
+
+				DataShard (const std::string& name): RunnableServiceWithWork (name) {};
+				auto& GetService () { return GetIOService (); };
+				void Start () { StartIOService (); };
+				void Stop ()
+				{
+					StopIOService ();
+					// run pending handlers in this thread, they release packets
+					GetIOService ().restart ();
+					GetIOService ().poll ();
+				}
+				using RunnableServiceWithWork::IsRunning;
+				i2p::crypto::AEADChaCha20Poly1305Decryptor& GetDecryptor () { return m_Decryptor; };
+
+			private:
+
+				i2p::crypto::AEADChaCha20Poly1305Decryptor m_Decryptor;
+		};
+
+		struct DataPacket
+		{
+			std::shared_ptr<SSU2Session> session;
+			Packet * packet;
+			SSU2DataDecryptionResult result;
 		};
 
 		public:
@@ -87,6 +140,7 @@ namespace transport
 			bool IsConnectedRecently (const boost::asio::ip::udp::endpoint& ep, bool max = true);
 			void AddConnectedRecently (const boost::asio::ip::udp::endpoint& ep, uint64_t ts);
 			std::mt19937& GetRng () { return m_Rng; }
+			SSU2CongestionControlType GetCongestionControlType () const { return m_CongestionControlType; };
 			bool AEADChaCha20Poly1305Encrypt (const uint8_t * msg, size_t msgLen, const uint8_t * ad, size_t adLen,
 				const uint8_t * key, const uint8_t * nonce, uint8_t * buf, size_t len); 
 			bool AEADChaCha20Poly1305Decrypt (const uint8_t * msg, size_t msgLen, const uint8_t * ad, size_t adLen,
@@ -141,14 +195,28 @@ namespace transport
 		private:
 
 			boost::asio::ip::udp::socket& OpenSocket (const boost::asio::ip::udp::endpoint& localEndpoint);
-			void Receive (boost::asio::ip::udp::socket& socket);
+			void OpenSocket (const boost::asio::ip::udp::endpoint& localEndpoint, boost::asio::ip::udp::socket& socket);
+			void OpenReusePortSockets (const boost::asio::ip::udp::endpoint& localEndpoint);
+			void Receive (boost::asio::ip::udp::socket& socket, ReceiveService& receiver);
 			void HandleReceivedFrom (const boost::system::error_code& ecode, size_t bytes_transferred,
-				Packet * packet, boost::asio::ip::udp::socket& socket);
-			void HandleReceivedPackets (std::list<Packet *>&& packets);
+				Packet * packet, boost::asio::ip::udp::socket& socket, ReceiveService& receiver);
+			void HandleReceiveError (const boost::system::error_code& ecode, boost::asio::ip::udp::socket& socket, ReceiveService& receiver);
+#if defined(__linux__)
+			void HandleReadyToReceive (const boost::system::error_code& ecode, boost::asio::ip::udp::socket& socket, ReceiveService& receiver); // recvmmsg
+			size_t ReceiveBatch (boost::asio::ip::udp::socket& socket, ReceiveService& receiver, std::list<Packet *>& received, int& num);
+			size_t ReceiveCoalesced (boost::asio::ip::udp::socket& socket, ReceiveService& receiver, std::list<Packet *>& received, int& num); // GRO
+			bool AddToSendBatch (const uint8_t * header, size_t headerLen, const uint8_t * headerX, size_t headerXLen,
+				const uint8_t * payload, size_t payloadLen, const boost::asio::ip::udp::endpoint& to); // false if not batched
+			void FlushSendBatch (std::vector<Packet *>& batch, boost::asio::ip::udp::socket& socket); // sendmmsg
+			void FlushSendBatches ();
+#endif
+			void HandleReceivedPackets (std::list<Packet *>&& packets, ReceiveService& receiver);
 			void ProcessNextPacket (uint8_t * buf, size_t len, const boost::asio::ip::udp::endpoint& senderEndpoint);
-			void InsertToReceivedPacketsQueue (Packet * packet);
-			void InsertToReceivedPacketsQueue (std::list<Packet *>& packets);
-			void HandleReceivedPacketsQueue ();
+			void InsertToReceivedPacketsQueue (Packet * packet, ReceiveService& receiver);
+			void InsertToReceivedPacketsQueue (std::list<Packet *>& packets, ReceiveService& receiver);
+			void HandleReceivedPacketsQueue (ReceiveService& receiver);
+			void DispatchToDataShards (std::list<Packet *>& packets, ReceiveService& receiver); // dispatched packets are removed
+			void HandleDecryptedDataPackets (std::list<DataPacket>& dataPackets, ReceiveService& receiver);
 		
 			void ScheduleTermination ();
 			void HandleTerminationTimer (const boost::system::error_code& ecode);
@@ -183,8 +251,12 @@ namespace transport
 
 			ReceiveService m_ReceiveService;
 			boost::asio::ip::udp::socket m_SocketV4, m_SocketV6;
+			int m_NumReceiveThreads; // per address, SO_REUSEPORT sockets if more than 1
+			std::list<std::unique_ptr<ReusePortReceiver> > m_ReusePortReceivers;
+			std::vector<std::unique_ptr<DataShard> > m_DataShards; // by connection ID
 			boost::asio::ip::address m_AddressV4, m_AddressV6;
 			std::unordered_map<uint64_t, std::shared_ptr<SSU2Session> > m_Sessions;
+			std::atomic<size_t> m_NumSessions; // for other threads
 			std::unordered_map<i2p::data::IdentHash, std::weak_ptr<SSU2Session> > m_SessionsByRouterHash;
 			mutable std::mutex m_SessionsByRouterHashMutex;
 			std::map<boost::asio::ip::udp::endpoint, std::shared_ptr<SSU2Session> > m_PendingOutgoingSessions;
@@ -193,7 +265,7 @@ namespace transport
 			std::unordered_map<uint32_t, std::weak_ptr<SSU2Session> > m_Relays; // we are introducer, relay tag -> session
 			std::unordered_map<uint32_t, std::pair <std::weak_ptr<SSU2Session>, uint64_t > > m_PeerTests; // nonce->(Alice, timestamp). We are Bob
 			std::list<std::pair<i2p::data::IdentHash, uint32_t> > m_Introducers, m_IntroducersV6; // introducers we are connected to
-			i2p::util::MemoryPoolMt<Packet> m_PacketsPool;
+			i2p::util::MemoryPoolMt<Packet> m_PacketsPool; // outgoing
 			i2p::util::MemoryPool<SSU2SentPacket> m_SentPacketsPool;
 			i2p::util::MemoryPool<SSU2IncompleteMessage> m_IncompleteMessagesPool;
 			i2p::util::MemoryPool<SSU2IncompleteMessage::Fragment> m_FragmentsPool;
@@ -208,12 +280,11 @@ namespace transport
 			std::map<boost::asio::ip::udp::endpoint, uint64_t> m_ConnectedRecently; // endpoint -> last activity time in seconds
 			mutable std::mutex m_ConnectedRecentlyMutex;
 			std::unordered_map<uint32_t, std::pair <std::weak_ptr<SSU2PeerTestSession>, uint64_t > > m_RequestedPeerTests; // nonce->(Alice, timestamp) 
-			std::list<Packet *> m_ReceivedPacketsQueue;
-			mutable std::mutex m_ReceivedPacketsQueueMutex;
 			i2p::crypto::AEADChaCha20Poly1305Encryptor m_Encryptor;
 			i2p::crypto::AEADChaCha20Poly1305Decryptor m_Decryptor;
 			i2p::crypto::ChaCha20Context m_ChaCha20;
 			bool m_IsForcedFirewalled4, m_IsForcedFirewalled6;
+			SSU2CongestionControlType m_CongestionControlType;
 		
 			// proxy
 			bool m_IsThroughProxy;
@@ -223,10 +294,19 @@ namespace transport
 			std::unique_ptr<boost::asio::ip::udp::endpoint> m_ProxyRelayEndpoint;
 			std::unique_ptr<boost::asio::deadline_timer> m_ProxyConnectRetryTimer;
 
+#if defined(__linux__)
+			// batched I/O
+			std::atomic<bool> m_IsBatchedIO; // recvmmsg/sendmmsg are available
+			std::vector<Packet *> m_SendBatchV4, m_SendBatchV6; // Packet::from is remote endpoint, SSU2 thread only
+			bool m_IsSendBatchFlushPending;
+			std::atomic<bool> m_IsGSO, m_IsGRO; // UDP segmentation offload
+#endif
+
 		public:
 
 			// for HTTP/I2PControl
 			const decltype(m_Sessions)& GetSSU2Sessions () const { return m_Sessions; };
+			size_t GetNumSSU2Sessions () const { return m_NumSessions.load (std::memory_order_relaxed); };
 	};
 }
 }
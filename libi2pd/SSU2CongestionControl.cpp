@@ -0,0 +1,164 @@
+/*
+* Copyright (c) 2013-2025, The PurpleI2P Project
+*
+* This file is part of Purple i2pd project and licensed under BSD3
+*
+* See full license text in LICENSE file at top of project tree
+*/
+
+#include <cmath>
+#include <algorithm>
+#include "Log.h"
+#include "SSU2Session.h"
+#include "SSU2CongestionControl.h"
+
+namespace i2p
+{
+namespace transport
+{
+	static uint64_t GetWindowPacingRate (double window, double rtt, double gain)
+	{
+		if (rtt <= 0) return 0; // no RTT sample yet
+		return std::round (gain*window*1000/rtt);
+	}
+
+	SSU2DefaultCongestionControl::SSU2DefaultCongestionControl (size_t maxPayloadSize):
+		SSU2CongestionControl (maxPayloadSize), m_Window (GetMinWindow ()), m_RTT (0), m_PacingRate (0)
+	{
+	}
+
+	void SSU2DefaultCongestionControl::OnAck (const SSU2AckSample& ack)
+	{
+		m_RTT = ack.rtt;
+		m_Window += ack.numAckedBytes;
+		if (m_Window > GetMaxWindow ()) m_Window = GetMaxWindow ();
+		m_PacingRate = GetWindowPacingRate (m_Window, m_RTT, SSU2_SLOW_START_PACING_GAIN);
+	}
+
+	void SSU2DefaultCongestionControl::OnLoss (size_t numLostBytes, size_t bytesInFlight, uint64_t ts)
+	{
+		m_Window >>= 1; // /2
+		if (m_Window < GetMinWindow ()) m_Window = GetMinWindow ();
+		m_PacingRate = GetWindowPacingRate (m_Window, m_RTT, SSU2_SLOW_START_PACING_GAIN);
+	}
+
+	void SSU2DefaultCongestionControl::OnPathChange ()
+	{
+		m_Window = GetMinWindow ();
+		m_PacingRate = GetWindowPacingRate (m_Window, m_RTT, SSU2_SLOW_START_PACING_GAIN);
+	}
+
+	SSU2CubicCongestionControl::SSU2CubicCongestionControl (size_t maxPayloadSize):
+		SSU2CongestionControl (maxPayloadSize)
+	{
+		OnPathChange ();
+	}
+
+	void SSU2CubicCongestionControl::OnAck (const SSU2AckSample& ack)
+	{
+		m_RTT = ack.rtt;
+		bool isSlowStart = m_Window < m_SlowStartThreshold;
+		if (isSlowStart)
+			m_Window += ack.numAckedBytes;
+		else
+		{
+			double window = m_Window/m_MaxPayloadSize, acked = (double)ack.numAckedBytes/m_MaxPayloadSize;
+			if (!m_EpochStart)
+			{
+				// first ACK after loss
+				m_EpochStart = ack.ts;
+				if (window < m_WMax)
+					m_K = std::cbrt ((m_WMax - window)/SSU2_CUBIC_C);
+				else
+				{
+					m_K = 0;
+					m_WMax = window;
+				}
+				m_WEst = window;
+			}
+			double t = (ack.ts - m_EpochStart + m_RTT)/1000.0; // in seconds, one RTT ahead
+			double target = SSU2_CUBIC_C*std::pow (t - m_K, 3) + m_WMax;
+			// TCP friendly region
+			m_WEst += 3*(1 - SSU2_CUBIC_BETA)/(1 + SSU2_CUBIC_BETA)*acked/window;
+			if (target < m_WEst) target = m_WEst;
+			if (target > window)
+				m_Window += (target - window)/window*acked*m_MaxPayloadSize;
+		}
+		if (m_Window > GetMaxWindow ()) m_Window = GetMaxWindow ();
+		m_PacingRate = GetWindowPacingRate (m_Window, m_RTT, isSlowStart ? SSU2_SLOW_START_PACING_GAIN : SSU2_PACING_GAIN);
+	}
+
+	void SSU2CubicCongestionControl::OnLoss (size_t numLostBytes, size_t bytesInFlight, uint64_t ts)
+	{
+		if (m_LastLossTime && ts < m_LastLossTime + m_RTT) return; // same loss event
+		m_LastLossTime = ts;
+		double window = m_Window/m_MaxPayloadSize;
+		// fast convergence, release bandwidth for new flows
+		m_WMax = window < m_WMax ? window*(1 + SSU2_CUBIC_BETA)/2 : window;
+		m_Window *= SSU2_CUBIC_BETA;
+		if (m_Window < GetMinWindow ()) m_Window = GetMinWindow ();
+		m_SlowStartThreshold = m_Window;
+		m_EpochStart = 0;
+		m_PacingRate = GetWindowPacingRate (m_Window, m_RTT, SSU2_PACING_GAIN);
+	}
+
+	void SSU2CubicCongestionControl::OnPathChange ()
+	{
+		m_Window = GetMinWindow ();
+		m_SlowStartThreshold = GetMaxWindow ();
+		m_WMax = 0; m_K = 0; m_WEst = 0;
+		m_EpochStart = 0; m_LastLossTime = 0;
+		m_RTT = 0; m_PacingRate = 0;
+	}
+
+	SSU2BBRCongestionControl::SSU2BBRCongestionControl (size_t maxPayloadSize):
+		SSU2CongestionControl (maxPayloadSize), m_Model (SSU2_INITIAL_RTO, GetMinWindow ()), m_PacingRate (0)
+	{
+	}
+
+	void SSU2BBRCongestionControl::OnPathChange ()
+	{
+		m_Model.Reset ();
+		m_Model.SetWindow (GetMinWindow ()); // payload size might be changed
+		m_PacingRate = 0;
+	}
+
+	void SSU2BBRCongestionControl::OnPacketSent (SSU2SentPacket * packet, size_t bytesInFlight, uint64_t ts)
+	{
+		m_Model.OnPacketSent (packet->deliveryState, bytesInFlight, ts);
+	}
+
+	void SSU2BBRCongestionControl::OnPacketAcked (const SSU2SentPacket * packet, uint64_t ts)
+	{
+		m_Model.OnPacketAcked (packet->deliveryState, packet->payloadSize, packet->sendTime, ts);
+	}
+
+	void SSU2BBRCongestionControl::OnAck (const SSU2AckSample& ack)
+	{
+		m_Model.OnAck (ack.ts, ack.rttSample, ack.numAckedBytes, ack.bytesInFlight, GetMinWindow (), GetMaxWindow ());
+		auto bandwidth = m_Model.GetBandwidth ();
+		if (bandwidth > 0)
+			m_PacingRate = std::round (m_Model.GetPacingGain ()*bandwidth*1000);
+		else // no delivery rate yet
+			m_PacingRate = GetWindowPacingRate (m_Model.GetWindow (), ack.rtt, m_Model.GetPacingGain ());
+	}
+
+	void SSU2BBRCongestionControl::OnLoss (size_t numLostBytes, size_t bytesInFlight, uint64_t ts)
+	{
+		m_Model.OnLoss (bytesInFlight, GetMinWindow ());
+	}
+
+	std::unique_ptr<SSU2CongestionControl> CreateSSU2CongestionControl (SSU2CongestionControlType type, size_t maxPayloadSize)
+	{
+		switch (type)
+		{
+			case eSSU2CongestionControlCubic:
+				return std::make_unique<SSU2CubicCongestionControl>(maxPayloadSize);
+			case eSSU2CongestionControlBBR:
+				return std::make_unique<SSU2BBRCongestionControl>(maxPayloadSize);
+			default:
+				return std::make_unique<SSU2DefaultCongestionControl>(maxPayloadSize);
+		}
+	}
+}
+}
@@ -0,0 +1,140 @@
+/*
+* Copyright (c) 2013-2025, The PurpleI2P Project
+*
+* This file is part of Purple i2pd project and licensed under BSD3
+*
+* See full license text in LICENSE file at top of project tree
+*/
+
+#ifndef SSU2_CONGESTION_CONTROL_H__
+#define SSU2_CONGESTION_CONTROL_H__
+
+#include <inttypes.h>
+#include <memory>
+#include "BBR.h"
+
+namespace i2p
+{
+namespace transport
+{
+	const size_t SSU2_MIN_WINDOW_SIZE = 16; // in packets
+	const size_t SSU2_MAX_WINDOW_SIZE = 256; // in packets
+	const double SSU2_PACING_GAIN = 1.25; // window per RTT
+	const double SSU2_SLOW_START_PACING_GAIN = 2.0; // window doubles every RTT
+	const uint64_t SSU2_PACING_QUANTUM = 1000; // sent at once if late, in microseconds
+	const double SSU2_CUBIC_C = 0.4; // in packets/seconds^3
+	const double SSU2_CUBIC_BETA = 0.7;
+
+	enum SSU2CongestionControlType
+	{
+		eSSU2CongestionControlDefault = 0, // window halved on resend
+		eSSU2CongestionControlCubic, // RFC 8312
+		eSSU2CongestionControlBBR // delivery rate and min RTT model
+	};
+
+	struct SSU2SentPacket;
+	struct SSU2AckSample
+	{
+		uint64_t ts; // in milliseconds
+		double rtt; // smoothed, in milliseconds
+		int rttSample; // negative if no sample
+		size_t numAckedBytes, bytesInFlight; // after acked packets are removed
+	};
+
+	// window in bytes and pacing rate for a session, all sizes are payload sizes
+	class SSU2CongestionControl
+	{
+		public:
+
+			SSU2CongestionControl (size_t maxPayloadSize): m_MaxPayloadSize (maxPayloadSize) {};
+			virtual ~SSU2CongestionControl () {};
+
+			void SetMaxPayloadSize (size_t maxPayloadSize) { m_MaxPayloadSize = maxPayloadSize; };
+			size_t GetMinWindow () const { return SSU2_MIN_WINDOW_SIZE*m_MaxPayloadSize; };
+			size_t GetMaxWindow () const { return SSU2_MAX_WINDOW_SIZE*m_MaxPayloadSize; };
+
+			virtual size_t GetWindow () const = 0; // in bytes
+			virtual uint64_t GetPacingRate () const = 0; // in bytes per second, 0 if not paced
+
+			virtual void OnPacketSent (SSU2SentPacket * packet, size_t bytesInFlight, uint64_t ts) {};
+			virtual void OnPacketAcked (const SSU2SentPacket * packet, uint64_t ts) {};
+			virtual void OnAck (const SSU2AckSample& ack) = 0; // after acked packets
+			virtual void OnLoss (size_t numLostBytes, size_t bytesInFlight, uint64_t ts) = 0; // packets resent after RTO
+			virtual void OnPathChange () = 0; // start from scratch
+
+		protected:
+
+			size_t m_MaxPayloadSize;
+	};
+
+	class SSU2DefaultCongestionControl: public SSU2CongestionControl
+	{
+		public:
+
+			SSU2DefaultCongestionControl (size_t maxPayloadSize);
+
+			size_t GetWindow () const override { return m_Window; };
+			uint64_t GetPacingRate () const override { return m_PacingRate; };
+
+			void OnAck (const SSU2AckSample& ack) override;
+			void OnLoss (size_t numLostBytes, size_t bytesInFlight, uint64_t ts) override;
+			void OnPathChange () override;
+
+		private:
+
+			size_t m_Window;
+			double m_RTT;
+			uint64_t m_PacingRate;
+	};
+
+	class SSU2CubicCongestionControl: public SSU2CongestionControl
+	{
+		public:
+
+			SSU2CubicCongestionControl (size_t maxPayloadSize);
+
+			size_t GetWindow () const override { return m_Window; };
+			uint64_t GetPacingRate () const override { return m_PacingRate; };
+
+			void OnAck (const SSU2AckSample& ack) override;
+			void OnLoss (size_t numLostBytes, size_t bytesInFlight, uint64_t ts) override;
+			void OnPathChange () override;
+
+		private:
+
+			double m_Window, m_SlowStartThreshold; // in bytes
+			double m_WMax, m_K, m_WEst; // in packets
+			uint64_t m_EpochStart, m_LastLossTime; // in milliseconds
+			double m_RTT;
+			uint64_t m_PacingRate;
+	};
+
+	class SSU2BBRCongestionControl: public SSU2CongestionControl
+	{
+		public:
+
+			SSU2BBRCongestionControl (size_t maxPayloadSize);
+
+			size_t GetWindow () const override { return m_Model.GetWindow (); };
+			uint64_t GetPacingRate () const override { return m_PacingRate; };
+
+			void OnPacketSent (SSU2SentPacket * packet, size_t bytesInFlight, uint64_t ts) override;
+			void OnPacketAcked (const SSU2SentPacket * packet, uint64_t ts) override;
+			void OnAck (const SSU2AckSample& ack) override;
+			void OnLoss (size_t numLostBytes, size_t bytesInFlight, uint64_t ts) override;
+			void OnPathChange () override;
+
+			double GetBandwidth () const { return m_Model.GetBandwidth (); }; // max delivery rate, bytes per millisecond
+			double GetMinRTT () const { return m_Model.GetMinRTT (); };
+
+		private:
+
+			i2p::util::BBRModel m_Model; // in bytes
+			uint64_t m_PacingRate;
+	};
+
+	std::unique_ptr<SSU2CongestionControl> CreateSSU2CongestionControl (SSU2CongestionControlType type, size_t maxPayloadSize);
+}
+}
+
+#endif
@@ -12,6 +12,7 @@
 #include "Transports.h"
 #include "Gzip.h"
 #include "NetDb.hpp"
+#include "Metrics.h"
 #include "SSU2.h"
 #include "SSU2Session.h"
 
@@ -19,6 +20,12 @@ namespace i2p
 {
 namespace transport
 {
+	static auto& g_DroppedExpiredMessagesMetric = i2p::metrics::GetRegistry ().GetCounter ("transport_dropped_messages_total",
+		"I2NP messages dropped by transport sessions", "transport=\"ssu2\",reason=\"expired\"");
+	static auto& g_DroppedSemiFullMessagesMetric = i2p::metrics::GetRegistry ().GetCounter ("transport_dropped_messages_total",
+		"I2NP messages dropped by transport sessions", "transport=\"ssu2\",reason=\"queue_full\"");
+	static auto& g_ResentPacketsMetric = i2p::metrics::GetRegistry ().GetCounter ("ssu2_resent_packets_total",
+		"SSU2 data packets resent");
 	void SSU2IncompleteMessage::AttachNextFragment (const uint8_t * fragment, size_t fragmentSize)
 	{
 		if (msg->len + fragmentSize > msg->maxLen)
@@ -79,6 +86,115 @@ namespace transport
 		lastFragmentInsertTime = i2p::util::GetSecondsSinceEpoch ();
 	}
 
+	SSU2ReceivedPacketsWindow::SSU2ReceivedPacketsWindow (size_t capacity):
+		m_Bits ((capacity + 63)/64, 0), m_First (0), m_Last (0), m_Size (0)
+	{
+	}
+
+	bool SSU2ReceivedPacketsWindow::Insert (uint32_t packetNum)
+	{
+		if (!m_Size)
+		{
+			m_First = packetNum;
+			m_Last = packetNum + 1;
+		}
+		else if (packetNum < m_First)
+		{
+			Grow (m_Last - packetNum);
+			m_First = packetNum;
+		}
+		else if (packetNum >= m_Last)
+		{
+			Grow (packetNum - m_First + 1);
+			m_Last = packetNum + 1;
+		}
+		else if (IsSet (packetNum))
+			return false; // duplicate
+		m_Bits[(packetNum >> 6) & (m_Bits.size () - 1)] |= 1ULL << (packetNum & 0x3F);
+		m_Size++;
+		return true;
+	}
+
+	bool SSU2ReceivedPacketsWindow::Contains (uint32_t packetNum) const
+	{
+		if (packetNum < m_First || packetNum >= m_Last) return false;
+		return IsSet (packetNum);
+	}
+
+	void SSU2ReceivedPacketsWindow::RemoveBefore (uint32_t packetNum)
+	{
+		if (!m_Size || packetNum <= m_First) return;
+		if (packetNum >= m_Last)
+		{
+			Clear ();
+			return;
+		}
+		for (uint32_t i = m_First; i < packetNum; i++)
+		{
+			auto& word = m_Bits[(i >> 6) & (m_Bits.size () - 1)];
+			if (!word)
+			{
+				i |= 0x3F; // skip empty word
+				continue;
+			}
+			uint64_t bit = 1ULL << (i & 0x3F);
+			if (word & bit)
+			{
+				word &= ~bit;
+				m_Size--;
+			}
+		}
+		m_First = GetNext (packetNum); // m_Last - 1 is still there
+	}
+
+	uint32_t SSU2ReceivedPacketsWindow::GetPrev (uint32_t packetNum) const
+	{
+		if (!m_Size) return 0;
+		if (packetNum > m_Last) packetNum = m_Last;
+		while (packetNum > m_First)
+		{
+			packetNum--;
+			if (!m_Bits[(packetNum >> 6) & (m_Bits.size () - 1)])
+				packetNum &= ~0x3F; // skip empty word
+			else if (IsSet (packetNum))
+				return packetNum;
+		}
+		return 0;
+	}
+
+	void SSU2ReceivedPacketsWindow::Clear ()
+	{
+		std::fill (m_Bits.begin (), m_Bits.end (), 0);
+		m_First = m_Last = 0;
+		m_Size = 0;
+	}
+
+	uint32_t SSU2ReceivedPacketsWindow::GetNext (uint32_t packetNum) const
+	{
+		while (packetNum < m_Last)
+		{
+			if (!m_Bits[(packetNum >> 6) & (m_Bits.size () - 1)])
+				packetNum = (packetNum | 0x3F) + 1; // skip empty word
+			else if (IsSet (packetNum))
+				return packetNum;
+			else
+				packetNum++;
+		}
+		return m_Last;
+	}
+
+	void SSU2ReceivedPacketsWindow::Grow (uint32_t span)
+	{
+		size_t capacity = GetCapacity ();
+		if (span <= capacity) return;
+		while (capacity < span) capacity <<= 1;
+		std::vector<uint64_t> bits (capacity/64, 0);
+		for (uint32_t packetNum = m_First; packetNum != m_Last; packetNum++)
+			if (IsSet (packetNum))
+				bits[(packetNum >> 6) & (bits.size () - 1)] |= 1ULL << (packetNum & 0x3F);
+		m_Bits.swap (bits);
+	}
+
 	SSU2Session::SSU2Session (SSU2Server& server, std::shared_ptr<const i2p::data::RouterInfo> in_RemoteRouter,
 		std::shared_ptr<const i2p::data::RouterInfo::Address> addr, bool noise):
 		TransportSession (in_RemoteRouter, SSU2_CONNECT_TIMEOUT),
@@ -88,12 +204,14 @@ namespace transport
 		m_IsDataReceived (false), m_RTT (SSU2_UNKNOWN_RTT),
 		m_MsgLocalExpirationTimeout (I2NP_MESSAGE_LOCAL_EXPIRATION_TIMEOUT_MAX),
 		m_MsgLocalSemiExpirationTimeout (I2NP_MESSAGE_LOCAL_EXPIRATION_TIMEOUT_MAX / 2),
-		m_WindowSize (SSU2_MIN_WINDOW_SIZE),
-		m_RTO (SSU2_INITIAL_RTO), m_RelayTag (0),m_ConnectTimer (server.GetService ()), 
+		m_RTO (SSU2_INITIAL_RTO), m_BytesInFlight (0), m_NextSendTime (0),
+		m_PacingTimer (server.GetService ()), m_IsPacingTimerScheduled (false),
+		m_RelayTag (0),m_ConnectTimer (server.GetService ()), 
 		m_TerminationReason (eSSU2TerminationReasonNormalClose),
 		m_MaxPayloadSize (SSU2_MIN_PACKET_SIZE - IPV6_HEADER_SIZE - UDP_HEADER_SIZE - 32), // min size
 		m_LastResendTime (0), m_LastResendAttemptTime (0), m_NumRanges (0)
 	{
+		m_CongestionControl = CreateSSU2CongestionControl (server.GetCongestionControlType (), m_MaxPayloadSize);
 		if (noise)	
 			m_NoiseState.reset (new i2p::crypto::NoiseSymmetricState);
 		if (in_RemoteRouter && m_Address)
@@ -119,6 +237,7 @@ namespace transport
 
 	SSU2Session::~SSU2Session ()
 	{
+		ClearSentPackets ();
 	}
 
 	void SSU2Session::Connect ()
@@ -177,7 +296,7 @@ namespace transport
 		RAND_bytes ((uint8_t *)&nonce, 4);
 		auto ts = i2p::util::GetMillisecondsSinceEpoch ();
 		// payload
-		auto packet = m_Server.GetSentPacketsPool ().AcquireShared ();
+		auto packet = m_Server.GetSentPacketsPool ().Acquire ();
 		uint8_t * payload = packet->payload;
 		payload[0] = eSSU2BlkRelayRequest;
 		payload[3] = 0; // flag
@@ -186,7 +305,11 @@ namespace transport
 		htobe32buf (payload + 12, ts/1000);
 		payload[16] = 2; // ver
 		size_t asz = CreateEndpoint (payload + 18, m_MaxPayloadSize - 18, boost::asio::ip::udp::endpoint (localAddress->host, localAddress->port));
-		if (!asz) return false;
+		if (!asz)
+		{
+			m_Server.GetSentPacketsPool ().Release (packet);
+			return false;
+		}
 		payload[17] = asz;
 		packet->payloadSize = asz + 18;
 		SignedData<128> s;
@@ -205,7 +328,7 @@ namespace transport
 		m_Server.AddSession (session);
 		int32_t packetNum = SendData (packet->payload, packet->payloadSize);
 		packet->sendTime = ts;
-		m_SentPackets.emplace (packetNum, packet);
+		AddSentPacket (packetNum, packet);
 		
 		return true;
 	}
@@ -258,16 +381,18 @@ namespace transport
 		m_Server.AddRequestedPeerTest (nonce, session, ts/1000);
 		m_Server.AddSession (session);
 		// peer test block
-		auto packet = m_Server.GetSentPacketsPool ().AcquireShared ();
+		auto packet = m_Server.GetSentPacketsPool ().Acquire ();
 		packet->payloadSize = CreatePeerTestBlock (packet->payload, m_MaxPayloadSize, nonce);
 		if (packet->payloadSize > 0)
 		{
 			packet->payloadSize += CreatePaddingBlock (packet->payload + packet->payloadSize, m_MaxPayloadSize - packet->payloadSize);
 			uint32_t packetNum = SendData (packet->payload, packet->payloadSize, SSU2_FLAG_IMMEDIATE_ACK_REQUESTED);
 			packet->sendTime = ts;
-			m_SentPackets.emplace (packetNum, packet);
+			AddSentPacket (packetNum, packet);
 			LogPrint (eLogDebug, "SSU2: PeerTest msg=1 sent to ", i2p::data::GetIdentHashAbbreviation (GetRemoteIdentity ()->GetIdentHash ()));
 		}
+		else
+			m_Server.GetSentPacketsPool ().Release (packet);
 	}
 
 	void SSU2Session::SendKeepAlive ()
@@ -286,6 +411,7 @@ namespace transport
 		{
 			m_State = eSSU2SessionStateTerminated;
 			m_ConnectTimer.cancel ();
+			m_PacingTimer.cancel ();
 			m_OnEstablished = nullptr;
 			if (m_RelayTag)
 				m_Server.RemoveRelay (m_RelayTag);
@@ -299,7 +425,7 @@ namespace transport
 				it->Drop ();
 			m_SendQueue.clear ();
 			SetSendQueueSize (0);
-			m_SentPackets.clear ();
+			ClearSentPackets ();
 			m_IncompleteMessages.clear ();
 			m_RelaySessions.clear ();
 			m_ReceivedI2NPMsgIDs.clear ();
@@ -418,7 +544,10 @@ namespace transport
 			for (auto it: msgs)
 			{
 				if (it->onDrop)
+				{
 					it->Drop (); // drop earlier because we can handle it
+					g_DroppedSemiFullMessagesMetric.Inc ();
+				}
 				else
 				{
 					it->SetEnqueueTime (mts);
@@ -457,15 +586,16 @@ namespace transport
 		
 	bool SSU2Session::SendQueue ()
 	{
-		if (!m_SendQueue.empty () && m_SentPackets.size () <= m_WindowSize && IsEstablished ())
+		if (m_SendQueue.empty () || !IsEstablished ()) return false;
+		uint64_t mts = i2p::util::GetMonotonicMicroseconds ();
+		if (IsSendAllowed (mts))
 		{
 			auto ts = i2p::util::GetMillisecondsSinceEpoch ();
-			uint64_t mts = i2p::util::GetMonotonicMicroseconds ();
-			auto packet = m_Server.GetSentPacketsPool ().AcquireShared ();
+			auto packet = m_Server.GetSentPacketsPool ().Acquire ();
 			size_t ackBlockSize = CreateAckBlock (packet->payload, m_MaxPayloadSize);
 			bool ackBlockSent = false;
 			packet->payloadSize += ackBlockSize;
-			while (!m_SendQueue.empty () && m_SentPackets.size () <= m_WindowSize)
+			while (!m_SendQueue.empty () && IsSendAllowed (mts))
 			{
 				auto msg = m_SendQueue.front ();
 				if (!msg || msg->IsExpired (ts) || msg->GetEnqueueTime() + I2NP_MESSAGE_LOCAL_EXPIRATION_TIMEOUT_TRANSIT < mts)
@@ -473,6 +603,7 @@ namespace transport
 					// drop null or expired message
 					if (msg) msg->Drop ();
 					m_SendQueue.pop_front ();
+					g_DroppedExpiredMessagesMetric.Inc ();
 					continue;
 				}
 				size_t len = msg->GetNTCP2Length () + 3;
@@ -490,7 +621,7 @@ namespace transport
 				else
 				{
 					// create new packet and copy ack block
-					auto newPacket = m_Server.GetSentPacketsPool ().AcquireShared ();
+					auto newPacket = m_Server.GetSentPacketsPool ().Acquire ();
 					memcpy (newPacket->payload, packet->payload, ackBlockSize);
 					newPacket->payloadSize = ackBlockSize;
 					// complete current packet
@@ -521,7 +652,7 @@ namespace transport
 					// send right a way
 					uint32_t packetNum = SendData (packet->payload, packet->payloadSize);
 					packet->sendTime = ts;
-					m_SentPackets.emplace (packetNum, packet);
+					AddSentPacket (packetNum, packet);
 					packet = newPacket; // just ack block
 				}
 			};
@@ -533,13 +664,71 @@ namespace transport
 					packet->payloadSize += CreatePaddingBlock (packet->payload + packet->payloadSize, m_MaxPayloadSize - packet->payloadSize);
 				uint32_t packetNum = SendData (packet->payload, packet->payloadSize, SSU2_FLAG_IMMEDIATE_ACK_REQUESTED);
 				packet->sendTime = ts;
-				m_SentPackets.emplace (packetNum, packet);
+				AddSentPacket (packetNum, packet);
 			}
+			else
+				m_Server.GetSentPacketsPool ().Release (packet);
+			if (!m_SendQueue.empty ()) SchedulePacingTimer (mts);
 			return ackBlockSent;
 		}
+		SchedulePacingTimer (mts);
 		return false;
 	}
 
+	void SSU2Session::AddSentPacket (uint32_t packetNum, SSU2SentPacket * packet)
+	{
+		if (!m_SentPackets.Insert (packetNum, packet))
+		{
+			LogPrint (eLogError, "SSU2: Packet ", packetNum, " was already sent");
+			m_Server.GetSentPacketsPool ().Release (packet);
+			return;
+		}
+		m_BytesInFlight += packet->payloadSize;
+		m_CongestionControl->OnPacketSent (packet, m_BytesInFlight, packet->sendTime);
+		auto pacingRate = m_CongestionControl->GetPacingRate ();
+		if (pacingRate)
+		{
+			uint64_t mts = i2p::util::GetMonotonicMicroseconds ();
+			if (m_NextSendTime < mts) m_NextSendTime = mts; // don't accumulate credit while idle
+			m_NextSendTime += packet->payloadSize*1000000LL/pacingRate;
+		}
+	}
+
+	void SSU2Session::ClearSentPackets ()
+	{
+		for (auto it: m_SentPackets)
+			m_Server.GetSentPacketsPool ().Release (it);
+		m_SentPackets.Clear ();
+		m_BytesInFlight = 0;
+	}
+
+	bool SSU2Session::IsSendAllowed (uint64_t mts) const
+	{
+		if (m_BytesInFlight >= m_CongestionControl->GetWindow ()) return false;
+		return !m_CongestionControl->GetPacingRate () || m_NextSendTime <= mts + SSU2_PACING_QUANTUM;
+	}
+
+	void SSU2Session::SchedulePacingTimer (uint64_t mts)
+	{
+		// only if window is open and we wait for pacing, otherwise next Ack triggers sending
+		if (m_IsPacingTimerScheduled || m_BytesInFlight >= m_CongestionControl->GetWindow () ||
+			m_NextSendTime <= mts + SSU2_PACING_QUANTUM) return;
+		m_IsPacingTimerScheduled = true;
+		m_PacingTimer.expires_from_now (boost::posix_time::microseconds(m_NextSendTime - mts));
+		m_PacingTimer.async_wait (std::bind (&SSU2Session::HandlePacingTimer,
+			shared_from_this (), std::placeholders::_1));
+	}
+
+	void SSU2Session::HandlePacingTimer (const boost::system::error_code& ecode)
+	{
+		m_IsPacingTimerScheduled = false;
+		if (ecode != boost::asio::error::operation_aborted && m_State != eSSU2SessionStateTerminated)
+		{
+			if (SendQueue ())
+				SetSendQueueSize (m_SendQueue.size ());
+		}
+	}
+
 	bool SSU2Session::SendFragmentedMessage (std::shared_ptr<I2NPMessage> msg)
 	{
 		if (!msg) return false;
@@ -549,7 +738,7 @@ namespace transport
 		uint32_t msgID;
 		memcpy (&msgID, msg->GetHeader () + I2NP_HEADER_MSGID_OFFSET, 4);
 		auto ts = i2p::util::GetMillisecondsSinceEpoch ();
-		auto packet = m_Server.GetSentPacketsPool ().AcquireShared ();
+		auto packet = m_Server.GetSentPacketsPool ().Acquire ();
 		if (extraSize >= 8)
 		{
 			packet->payloadSize = CreateAckBlock (packet->payload, extraSize);
@@ -558,8 +747,8 @@ namespace transport
 			{
 				uint32_t packetNum = SendData (packet->payload, packet->payloadSize);
 				packet->sendTime = ts;
-				m_SentPackets.emplace (packetNum, packet);
-				packet = m_Server.GetSentPacketsPool ().AcquireShared ();
+				AddSentPacket (packetNum, packet);
+				packet = m_Server.GetSentPacketsPool ().Acquire ();
 			}
 			else
 				extraSize -= packet->payloadSize;
@@ -567,17 +756,21 @@ namespace transport
 		size_t offset = extraSize > 0 ? (m_Server.GetRng ()() % extraSize) : 0;
 		if (offset + packet->payloadSize >= m_MaxPayloadSize) offset = 0;
 		auto size = CreateFirstFragmentBlock (packet->payload + packet->payloadSize, m_MaxPayloadSize - offset - packet->payloadSize, msg);
-		if (!size) return false;
+		if (!size)
+		{
+			m_Server.GetSentPacketsPool ().Release (packet);
+			return false;
+		}
 		extraSize -= offset;
 		packet->payloadSize += size;
 		uint32_t firstPacketNum = SendData (packet->payload, packet->payloadSize);
 		packet->sendTime = ts;
-		m_SentPackets.emplace (firstPacketNum, packet);
+		AddSentPacket (firstPacketNum, packet);
 		uint8_t fragmentNum = 0;
 		while (msg->offset < msg->len)
 		{
 			offset = extraSize > 0 ? (m_Server.GetRng ()() % extraSize) : 0;
-			packet = m_Server.GetSentPacketsPool ().AcquireShared ();
+			packet = m_Server.GetSentPacketsPool ().Acquire ();
 			packet->payloadSize = CreateFollowOnFragmentBlock (packet->payload, m_MaxPayloadSize - offset, msg, fragmentNum, msgID);
 			extraSize -= offset;
 			uint8_t flags = 0;
@@ -589,7 +782,7 @@ namespace transport
 			}
 			uint32_t followonPacketNum = SendData (packet->payload, packet->payloadSize, flags);
 			packet->sendTime = ts;
-			m_SentPackets.emplace (followonPacketNum, packet);
+			AddSentPacket (followonPacketNum, packet);
 		}
 		return ackBlockSent;
 	}
@@ -607,15 +800,20 @@ namespace transport
 			return 0;
 		}
 		// resend data packets
-		if (m_SentPackets.empty ()) return 0;
-		std::map<uint32_t, std::shared_ptr<SSU2SentPacket> > resentPackets;
-		for (auto it = m_SentPackets.begin (); it != m_SentPackets.end (); )
-			if (ts >= it->second->sendTime + (it->second->numResends + 1) * m_RTO)
+		if (m_SentPackets.IsEmpty ()) return 0;
+		std::vector<std::pair<uint32_t, SSU2SentPacket *> > resentPackets; // new packetNum -> packet
+		size_t numLostBytes = 0;
+		for (auto it = m_SentPackets.begin (); it != m_SentPackets.end (); ++it)
+		{
+			auto packet = *it;
+			if (ts >= packet->sendTime + (packet->numResends + 1) * m_RTO)
 			{
-				if (it->second->numResends > SSU2_MAX_NUM_RESENDS)
+				if (packet->numResends > SSU2_MAX_NUM_RESENDS)
 				{
-					LogPrint (eLogInfo, "SSU2: Packet was not Acked after ", it->second->numResends, " attempts. Terminate session");
-					m_SentPackets.clear ();
+					LogPrint (eLogInfo, "SSU2: Packet was not Acked after ", packet->numResends, " attempts. Terminate session");
+					for (auto& it1: resentPackets)
+						m_Server.GetSentPacketsPool ().Release (it1.second);
+					ClearSentPackets ();
 					m_SendQueue.clear ();
 					SetSendQueueSize (0);
 					RequestTermination (eSSU2TerminationReasonTimeout);
@@ -623,22 +821,23 @@ namespace transport
 				}
 				else
 				{
-					uint32_t packetNum = SendData (it->second->payload, it->second->payloadSize, 
-						it->second->numResends > 1 ? SSU2_FLAG_IMMEDIATE_ACK_REQUESTED : 0);
-					it->second->numResends++;
-					it->second->sendTime = ts;
-					resentPackets.emplace (packetNum, it->second);
-					it = m_SentPackets.erase (it);
+					uint32_t packetNum = SendData (packet->payload, packet->payloadSize, 
+						packet->numResends > 1 ? SSU2_FLAG_IMMEDIATE_ACK_REQUESTED : 0);
+					packet->numResends++;
+					packet->sendTime = ts;
+					numLostBytes += packet->payloadSize;
+					resentPackets.emplace_back (packetNum, packet); // still in flight
+					m_SentPackets.Remove (it.GetSeqn ());
 				}
 			}
-			else
-				it++;
+		}
 		if (!resentPackets.empty ())
 		{
 			m_LastResendTime = ts;
-			m_SentPackets.merge (resentPackets);
-			m_WindowSize >>= 1; // /2
-			if (m_WindowSize < SSU2_MIN_WINDOW_SIZE) m_WindowSize = SSU2_MIN_WINDOW_SIZE;
+			g_ResentPacketsMetric.Inc (resentPackets.size ());
+			for (auto& it: resentPackets)
+				m_SentPackets.Insert (it.first, it.second);
+			m_CongestionControl->OnLoss (numLostBytes, m_BytesInFlight, ts);
 			return resentPackets.size ();
 		}
 		return 0;
@@ -1498,12 +1697,7 @@ namespace transport
 				ResendHandshakePacket (); // assume we receive
 			return;
 		}
-		if (from != m_RemoteEndpoint && !i2p::transport::transports.IsInReservedRange (from.address ()) &&
-		    (!m_PathChallenge || from != m_PathChallenge->second)) // path challenge was not sent to this endpoint yet 
-		{
-			LogPrint (eLogInfo, "SSU2: Remote endpoint update ", m_RemoteEndpoint, "->", from);
-			SendPathChallenge (from);
-		}
+		CheckRemoteEndpoint (from);
 		if (len < 32)
 		{
 			LogPrint (eLogWarning, "SSU2: Data message too short ", len);
@@ -1511,17 +1705,58 @@ namespace transport
 		}
 		uint8_t payload[SSU2_MAX_PACKET_SIZE];
 		size_t payloadSize = len - 32;
-		uint32_t packetNum = be32toh (header.h.packetNum);
 		uint8_t nonce[12];
-		CreateNonce (packetNum, nonce);
+		CreateNonce (be32toh (header.h.packetNum), nonce);
 		if (!m_Server.AEADChaCha20Poly1305Decrypt (buf + 16, payloadSize, header.buf, 16,
 			m_KeyDataReceive, nonce, payload, payloadSize))
 		{
 			LogPrint (eLogWarning, "SSU2: Data AEAD verification failed ");
 			return;
 		}
+		HandleDataPayload (header, payload, payloadSize, len);
+	}
+
+	SSU2DataDecryptionResult SSU2Session::DecryptData (uint8_t * buf, size_t len, i2p::crypto::AEADChaCha20Poly1305Decryptor& decryptor) const
+	{
+		// keys don't change after establishment, ProcessData must handle packet if not data
+		if (len < 32) return eSSU2DataNotData;
+		Header header;
+		header.ll[0] = m_SourceConnID;
+		memcpy (header.buf + 8, buf + 8, 8);
+		header.ll[1] ^= CreateHeaderMask (m_KeyDataReceive + 32, buf + (len - 12));
+		if (header.h.type != eSSU2Data) return eSSU2DataNotData;
+		uint8_t nonce[12];
+		CreateNonce (be32toh (header.h.packetNum), nonce);
+		// payload is overwritten even if verification fails
+		if (!decryptor.Decrypt (buf + 16, len - 32, header.buf, 16, m_KeyDataReceive, nonce, buf + 16, len - 32))
+			return eSSU2DataAEADFailure;
+		memcpy (buf, header.buf, 16); // decrypted header
+		return eSSU2DataDecrypted;
+	}
+
+	void SSU2Session::ProcessDecryptedData (const uint8_t * buf, size_t len, const boost::asio::ip::udp::endpoint& from)
+	{
+		Header header;
+		memcpy (header.buf, buf, 16);
+		CheckRemoteEndpoint (from);
+		HandleDataPayload (header, buf + 16, len - 32, len);
+	}
+
+	void SSU2Session::CheckRemoteEndpoint (const boost::asio::ip::udp::endpoint& from)
+	{
+		if (from != m_RemoteEndpoint && !i2p::transport::transports.IsInReservedRange (from.address ()) &&
+		    (!m_PathChallenge || from != m_PathChallenge->second)) // path challenge was not sent to this endpoint yet 
+		{
+			LogPrint (eLogInfo, "SSU2: Remote endpoint update ", m_RemoteEndpoint, "->", from);
+			SendPathChallenge (from);
+		}
+	}
+
+	void SSU2Session::HandleDataPayload (const Header& header, const uint8_t * payload, size_t payloadSize, size_t len)
+	{
 		UpdateNumReceivedBytes (len);
 		if (header.h.flags[0] & SSU2_FLAG_IMMEDIATE_ACK_REQUESTED) m_IsDataReceived = true;
+		uint32_t packetNum = be32toh (header.h.packetNum);
 		if (!packetNum || UpdateReceivePacketNum (packetNum))
 			HandlePayload (payload, payloadSize);
 	}
@@ -1756,17 +1991,18 @@ namespace transport
 			Established ();
 			return;
 		}
-		if (m_SentPackets.empty ()) return;
+		if (m_SentPackets.IsEmpty ()) return;
 		if (len < 5) return;
+		SSU2AckSample ack{ i2p::util::GetMillisecondsSinceEpoch (), 0, -1, 0, 0 };
 		// acnt
 		uint32_t ackThrough = bufbe32toh (buf);
 		uint32_t firstPacketNum = ackThrough > buf[4] ? ackThrough - buf[4] : 0;
-		HandleAckRange (firstPacketNum, ackThrough, i2p::util::GetMillisecondsSinceEpoch ()); // acnt
+		HandleAckRange (firstPacketNum, ackThrough, ack, true); // acnt
 		// ranges
 		len -= 5;
-		if (!len || m_SentPackets.empty ()) return; // don't handle ranges if nothing to acknowledge
 		const uint8_t * ranges = buf + 5;
-		while (len > 0 && firstPacketNum && ackThrough - firstPacketNum < SSU2_MAX_NUM_ACK_PACKETS)
+		while (len > 0 && firstPacketNum && ackThrough - firstPacketNum < SSU2_MAX_NUM_ACK_PACKETS &&
+			!m_SentPackets.IsEmpty ()) // don't handle ranges if nothing to acknowledge
 		{
 			uint32_t lastPacketNum = firstPacketNum - 1;
 			if (*ranges > lastPacketNum) break;
@@ -1774,25 +2010,32 @@ namespace transport
 			if (*ranges > lastPacketNum + 1) break;
 			firstPacketNum = lastPacketNum - *ranges + 1; ranges++; // acks
 			len -= 2;
-			HandleAckRange (firstPacketNum, lastPacketNum, 0);
+			HandleAckRange (firstPacketNum, lastPacketNum, ack, false);
+		}
+		if (ack.numAckedBytes > 0)
+		{
+			ack.rtt = m_RTT != SSU2_UNKNOWN_RTT ? m_RTT : 0;
+			ack.bytesInFlight = m_BytesInFlight;
+			m_CongestionControl->OnAck (ack);
 		}
 	}
 
-	void SSU2Session::HandleAckRange (uint32_t firstPacketNum, uint32_t lastPacketNum, uint64_t ts)
+	void SSU2Session::HandleAckRange (uint32_t firstPacketNum, uint32_t lastPacketNum, SSU2AckSample& ack, bool updateRTT)
 	{
-		if (firstPacketNum > lastPacketNum) return;
-		auto it = m_SentPackets.begin ();
-		while (it != m_SentPackets.end () && it->first < firstPacketNum) it++; // find first acked packet
-		if (it == m_SentPackets.end () || it->first > lastPacketNum) return; // not found
-		auto it1 = it;
-		int numPackets = 0;
-		while (it1 != m_SentPackets.end () && it1->first <= lastPacketNum)
+		if (firstPacketNum > lastPacketNum || m_SentPackets.IsEmpty ()) return;
+		// only packet nums of the window, linear in range size
+		if (firstPacketNum < m_SentPackets.GetFirstSeqn ()) firstPacketNum = m_SentPackets.GetFirstSeqn ();
+		if (lastPacketNum > m_SentPackets.GetLastSeqn ()) lastPacketNum = m_SentPackets.GetLastSeqn ();
+		for (uint32_t packetNum = firstPacketNum; packetNum <= lastPacketNum; packetNum++)
 		{
-			if (ts && !it1->second->numResends)
+			auto packet = m_SentPackets.Remove (packetNum);
+			if (!packet) continue;
+			if (updateRTT && !packet->numResends)
 			{
-				if (ts > it1->second->sendTime)
+				if (ack.ts > packet->sendTime)
 				{
-					auto rtt = ts - it1->second->sendTime;
+					auto rtt = ack.ts - packet->sendTime;
+					ack.rttSample = rtt;
 					if (m_RTT != SSU2_UNKNOWN_RTT)
 						m_RTT = SSU2_RTT_EWMA_ALPHA * rtt + (1.0 - SSU2_RTT_EWMA_ALPHA) * m_RTT;
 					else
@@ -1805,16 +2048,12 @@ namespace transport
 					if (m_RTO < SSU2_MIN_RTO) m_RTO = SSU2_MIN_RTO;
 					if (m_RTO > SSU2_MAX_RTO) m_RTO = SSU2_MAX_RTO;
 				}
-				ts = 0; // update RTT one time per range
+				updateRTT = false; // update RTT one time per range
 			}
-			it1++;
-			numPackets++;
-		}
-		m_SentPackets.erase (it, it1);
-		if (numPackets > 0)
-		{
-			m_WindowSize += numPackets;
-			if (m_WindowSize > SSU2_MAX_WINDOW_SIZE) m_WindowSize = SSU2_MAX_WINDOW_SIZE;
+			m_CongestionControl->OnPacketAcked (packet, ack.ts);
+			ack.numAckedBytes += packet->payloadSize;
+			m_BytesInFlight = m_BytesInFlight > packet->payloadSize ? m_BytesInFlight - packet->payloadSize : 0;
+			m_Server.GetSentPacketsPool ().Release (packet);
 		}
 	}
 
@@ -1975,7 +2214,7 @@ namespace transport
 		{
 			LogPrint (eLogWarning, "SSU2: RelayRequest session with relay tag ", relayTag, " not found");
 			// send relay response back to Alice
-			auto packet = m_Server.GetSentPacketsPool ().AcquireShared ();
+			auto packet = m_Server.GetSentPacketsPool ().Acquire ();
 			packet->payloadSize = CreateAckBlock (packet->payload, m_MaxPayloadSize);
 			packet->payloadSize += CreateRelayResponseBlock (packet->payload + packet->payloadSize, m_MaxPayloadSize - packet->payloadSize,
 				eSSU2RelayResponseCodeBobRelayTagNotFound, nonce, 0, false);
@@ -1985,8 +2224,10 @@ namespace transport
 			{	
 				// sometimes Alice doesn't ack this RelayResponse in older versions
 				packet->sendTime = mts;
-				m_SentPackets.emplace (packetNum, packet);
+				AddSentPacket (packetNum, packet);
 			}	
+			else
+				m_Server.GetSentPacketsPool ().Release (packet);
 			return;
 		}
 		if (session->m_RelaySessions.emplace (nonce, std::make_pair (shared_from_this (), mts/1000)).second)
@@ -1996,7 +2237,7 @@ namespace transport
 			if (r && (r->IsUnreachable () || !i2p::data::netdb.PopulateRouterInfoBuffer (r))) r = nullptr;
 			if (!r) LogPrint (eLogWarning, "SSU2: RelayRequest Alice's router info not found");
 
-			auto packet = m_Server.GetSentPacketsPool ().AcquireShared ();
+			auto packet = m_Server.GetSentPacketsPool ().Acquire ();
 			packet->payloadSize = r ? CreateRouterInfoBlock (packet->payload, m_MaxPayloadSize - len - 32, r) : 0;
 			if (!packet->payloadSize && r)
 				session->SendFragmentedMessage (CreateDatabaseStoreMsg (r));
@@ -2006,7 +2247,7 @@ namespace transport
 			uint32_t packetNum = session->SendData (packet->payload, packet->payloadSize);
 			packet->sendTime = mts;
 			// Charlie always responds with RelayResponse
-			session->m_SentPackets.emplace (packetNum, packet);
+			session->AddSentPacket (packetNum, packet);
 		}
 		else
 			LogPrint (eLogInfo, "SSU2: Relay request nonce ", nonce, " already exists. Ignore");
@@ -2093,7 +2334,7 @@ namespace transport
 			code = eSSU2RelayResponseCodeCharlieAliceIsUnknown;
 		}
 		// send relay response to Bob
-		auto packet = m_Server.GetSentPacketsPool ().AcquireShared ();
+		auto packet = m_Server.GetSentPacketsPool ().Acquire ();
 		uint32_t nonce = bufbe32toh (buf + 33);
 		packet->payloadSize = CreateRelayResponseBlock (packet->payload, m_MaxPayloadSize,
 			code, nonce, m_Server.GetIncomingToken (ep), ep.address ().is_v4 ());
@@ -2106,6 +2347,7 @@ namespace transport
 			else
 			{
 				LogPrint (eLogInfo, "SSU2: Relay intro nonce ", nonce, " already exists. Ignore");
+				m_Server.GetSentPacketsPool ().Release (packet);
 				return;
 			}		
 		}	
@@ -2115,8 +2357,10 @@ namespace transport
 		{	
 			// sometimes Bob doesn't ack this RelayResponse in older versions
 			packet->sendTime = i2p::util::GetMillisecondsSinceEpoch ();
-			m_SentPackets.emplace (packetNum, packet);
+			AddSentPacket (packetNum, packet);
 		}	
+		else
+			m_Server.GetSentPacketsPool ().Release (packet);
 	}
 
 	void SSU2Session::HandleRelayResponse (const uint8_t * buf, size_t len)
@@ -2147,7 +2391,7 @@ namespace transport
 			if (relaySession && relaySession->IsEstablished ())
 			{
 				// we are Bob, message from Charlie
-				auto packet = m_Server.GetSentPacketsPool ().AcquireShared ();
+				auto packet = m_Server.GetSentPacketsPool ().Acquire ();
 				uint8_t * payload = packet->payload;
 				payload[0] = eSSU2BlkRelayResponse;
 				htobe16buf (payload + 1, len);
@@ -2159,8 +2403,10 @@ namespace transport
 				{	
 					// sometimes Alice doesn't ack this RelayResponse in older versions
 					packet->sendTime = i2p::util::GetMillisecondsSinceEpoch ();
-					relaySession->m_SentPackets.emplace (packetNum, packet);
+					relaySession->AddSentPacket (packetNum, packet);
 				}	
+				else
+					m_Server.GetSentPacketsPool ().Release (packet);
 			}
 			else
 			{
@@ -2235,7 +2481,7 @@ namespace transport
 				{
 					if (m_Server.AddPeerTest (nonce, shared_from_this (), ts/1000))
 					{	
-						auto packet = m_Server.GetSentPacketsPool ().AcquireShared ();
+						auto packet = m_Server.GetSentPacketsPool ().Acquire ();
 						// Alice's RouterInfo
 						auto r = i2p::data::netdb.FindRouter (GetRemoteIdentity ()->GetIdentHash ());
 						if (r && (r->IsUnreachable () || !i2p::data::netdb.PopulateRouterInfoBuffer (r))) r = nullptr;
@@ -2247,8 +2493,8 @@ namespace transport
 							// doesn't fit one message, send RouterInfo in separate message
 							uint32_t packetNum = session->SendData (packet->payload, packet->payloadSize, SSU2_FLAG_IMMEDIATE_ACK_REQUESTED);
 							packet->sendTime = ts;
-							session->m_SentPackets.emplace (packetNum, packet);
-							packet = m_Server.GetSentPacketsPool ().AcquireShared (); // new packet
+							session->AddSentPacket (packetNum, packet);
+							packet = m_Server.GetSentPacketsPool ().Acquire (); // new packet
 						}
 						// PeerTest to Charlie
 						packet->payloadSize += CreatePeerTestBlock (packet->payload + packet->payloadSize, m_MaxPayloadSize - packet->payloadSize, 2,
@@ -2256,7 +2502,7 @@ namespace transport
 						packet->payloadSize += CreatePaddingBlock (packet->payload + packet->payloadSize, m_MaxPayloadSize - packet->payloadSize);
 						uint32_t packetNum = session->SendData (packet->payload, packet->payloadSize, SSU2_FLAG_IMMEDIATE_ACK_REQUESTED);
 						packet->sendTime = ts;
-						session->m_SentPackets.emplace (packetNum, packet);
+						session->AddSentPacket (packetNum, packet);
 					}
 					else
 						LogPrint (eLogInfo, "SSU2: Peer test 1 nonce ", nonce, " already exists. Ignored");
@@ -2264,14 +2510,14 @@ namespace transport
 				else
 				{
 					// Charlie not found, send error back to Alice
-					auto packet = m_Server.GetSentPacketsPool ().AcquireShared ();
+					auto packet = m_Server.GetSentPacketsPool ().Acquire ();
 					uint8_t zeroHash[32] = {0};
 					packet->payloadSize = CreatePeerTestBlock (packet->payload, m_MaxPayloadSize, 4,
 						eSSU2PeerTestCodeBobNoCharlieAvailable, zeroHash, buf + offset, len - offset);
 					packet->payloadSize += CreatePaddingBlock (packet->payload + packet->payloadSize, m_MaxPayloadSize - packet->payloadSize);
 					uint32_t packetNum = SendData (packet->payload, packet->payloadSize);
 					packet->sendTime = ts;
-					m_SentPackets.emplace (packetNum, packet);
+					AddSentPacket (packetNum, packet);
 				}
 				break;
 			}
@@ -2340,13 +2586,13 @@ namespace transport
 				else
 					code = eSSU2PeerTestCodeCharlieAliceIsUnknown;
 				// send msg 3 back to Bob
-				auto packet = m_Server.GetSentPacketsPool ().AcquireShared ();
+				auto packet = m_Server.GetSentPacketsPool ().Acquire ();
 				packet->payloadSize = CreatePeerTestBlock (packet->payload, m_MaxPayloadSize, 3,
 					code, nullptr, newSignedData.data (), newSignedData.size ());
 				packet->payloadSize += CreatePaddingBlock (packet->payload + packet->payloadSize, m_MaxPayloadSize - packet->payloadSize);
 				uint32_t packetNum = SendData (packet->payload, packet->payloadSize);
 				packet->sendTime = ts;
-				m_SentPackets.emplace (packetNum, packet);
+				AddSentPacket (packetNum, packet);
 				break;
 			}
 			case 3: // Bob from Charlie
@@ -2354,7 +2600,7 @@ namespace transport
 				auto aliceSession = m_Server.GetPeerTest (nonce);
 				if (aliceSession && aliceSession->IsEstablished ())
 				{	
-					auto packet = m_Server.GetSentPacketsPool ().AcquireShared ();
+					auto packet = m_Server.GetSentPacketsPool ().Acquire ();
 					// Charlie's RouterInfo
 					auto r = i2p::data::netdb.FindRouter (GetRemoteIdentity ()->GetIdentHash ());
 					if (r && (r->IsUnreachable () || !i2p::data::netdb.PopulateRouterInfoBuffer (r))) r = nullptr;
@@ -2366,8 +2612,8 @@ namespace transport
 						// doesn't fit one message, send RouterInfo in separate message
 						uint32_t packetNum = aliceSession->SendData (packet->payload, packet->payloadSize);
 						packet->sendTime = ts;
-						aliceSession->m_SentPackets.emplace (packetNum, packet);
-						packet = m_Server.GetSentPacketsPool ().AcquireShared ();
+						aliceSession->AddSentPacket (packetNum, packet);
+						packet = m_Server.GetSentPacketsPool ().Acquire ();
 					}
 					// PeerTest to Alice
 					packet->payloadSize += CreatePeerTestBlock (packet->payload + packet->payloadSize, m_MaxPayloadSize, 4,
@@ -2376,7 +2622,7 @@ namespace transport
 						packet->payloadSize += CreatePaddingBlock (packet->payload + packet->payloadSize, m_MaxPayloadSize - packet->payloadSize);
 					uint32_t packetNum = aliceSession->SendData (packet->payload, packet->payloadSize);
 					packet->sendTime = ts;
-					aliceSession->m_SentPackets.emplace (packetNum, packet);
+					aliceSession->AddSentPacket (packetNum, packet);
 				}	
 				else
 					LogPrint (eLogDebug, "SSU2: Unknown peer test 3 nonce ", nonce);
@@ -2575,6 +2821,7 @@ namespace transport
 				if (mtu > (int)SSU2_MAX_PACKET_SIZE) mtu = SSU2_MAX_PACKET_SIZE;
 				if (mtu < (int)SSU2_MIN_PACKET_SIZE) mtu = SSU2_MIN_PACKET_SIZE;
 				m_MaxPayloadSize = mtu - (addr->IsV6 () ? IPV6_HEADER_SIZE: IPV4_HEADER_SIZE) - UDP_HEADER_SIZE - 32;
+				m_CongestionControl->SetMaxPayloadSize (m_MaxPayloadSize);
 				LogPrint (eLogDebug, "SSU2: Session MTU=", mtu, ", max payload size=", m_MaxPayloadSize);
 			}
 		}
@@ -2672,26 +2919,27 @@ namespace transport
 	{
 		if (len < 8) return 0;
 		buf[0] = eSSU2BlkAck;
-		uint32_t ackThrough = m_OutOfSequencePackets.empty () ? m_ReceivePacketNum : *m_OutOfSequencePackets.rbegin ();
+		uint32_t ackThrough = m_OutOfSequencePackets.IsEmpty () ? m_ReceivePacketNum : m_OutOfSequencePackets.GetLast ();
 		htobe32buf (buf + 3, ackThrough); // Ack Through
 		uint16_t acnt = 0;
 		if (ackThrough)
 		{
-			if (m_OutOfSequencePackets.empty ())
+			if (m_OutOfSequencePackets.IsEmpty ())
 			{	
 				acnt = std::min ((int)ackThrough, SSU2_MAX_NUM_ACNT); // no gaps
 				m_NumRanges = 0;
 			}	
 			else
 			{
-				auto it = m_OutOfSequencePackets.rbegin (); it++; // prev packet num
-				while (it != m_OutOfSequencePackets.rend () && *it == ackThrough - acnt	- 1)
+				// walk down from ackThrough, 0 means no more out of sequence packets
+				uint32_t it = m_OutOfSequencePackets.GetPrev (ackThrough); // prev packet num
+				while (it && it == ackThrough - acnt - 1)
 				{
 					acnt++;
 					if (acnt >= SSU2_MAX_NUM_ACK_PACKETS)
 						break;
 					else
-						it++;
+						it = m_OutOfSequencePackets.GetPrev (it);
 				}
 				// ranges
 				if (!m_NumRanges)
@@ -2722,14 +2970,13 @@ namespace transport
 						}
 					}
 					int numPackets = acnt + numRanges*SSU2_MAX_NUM_ACNT;
-					while (it != m_OutOfSequencePackets.rend () &&
-						numRanges < maxNumRanges && numPackets < SSU2_MAX_NUM_ACK_PACKETS)
+					while (it && numRanges < maxNumRanges && numPackets < SSU2_MAX_NUM_ACK_PACKETS)
 					{
-						if (lastNum - (*it) > SSU2_MAX_NUM_ACNT)
+						if (lastNum - it > SSU2_MAX_NUM_ACNT)
 						{
 							// NACKs only ranges
-							if (lastNum > (*it) + SSU2_MAX_NUM_ACNT*(maxNumRanges - numRanges)) break; // too many NACKs
-							while (lastNum - (*it) > SSU2_MAX_NUM_ACNT)
+							if (lastNum > it + SSU2_MAX_NUM_ACNT*(maxNumRanges - numRanges)) break; // too many NACKs
+							while (lastNum - it > SSU2_MAX_NUM_ACNT)
 							{
 								m_Ranges[numRanges*2] = SSU2_MAX_NUM_ACNT; m_Ranges[numRanges*2 + 1] = 0; // NACKs 255, Acks 0
 								lastNum -= SSU2_MAX_NUM_ACNT;
@@ -2738,14 +2985,14 @@ namespace transport
 							}
 						}
 						// NACKs and Acks ranges
-						m_Ranges[numRanges*2] = lastNum - (*it) - 1; // NACKs
+						m_Ranges[numRanges*2] = lastNum - it - 1; // NACKs
 						numPackets += m_Ranges[numRanges*2];
-						lastNum = *it; it++;
+						lastNum = it; it = m_OutOfSequencePackets.GetPrev (it);
 						int numAcks = 1;
-						while (it != m_OutOfSequencePackets.rend () && lastNum > 0 && *it == lastNum - 1)
+						while (it && lastNum > 0 && it == lastNum - 1)
 						{
 							numAcks++; lastNum--;
-							it++;
+							it = m_OutOfSequencePackets.GetPrev (it);
 						}
 						while (numAcks > SSU2_MAX_NUM_ACNT)
 						{
@@ -2762,11 +3009,10 @@ namespace transport
 						numPackets += numAcks;
 						numRanges++;
 					}
-					if (it == m_OutOfSequencePackets.rend () &&
-						numRanges < maxNumRanges && numPackets < SSU2_MAX_NUM_ACK_PACKETS)
+					if (!it && numRanges < maxNumRanges && numPackets < SSU2_MAX_NUM_ACK_PACKETS)
 					{
 						// add range between out-of-sequence and received
-						int nacks = *m_OutOfSequencePackets.begin () - m_ReceivePacketNum - 1;
+						int nacks = m_OutOfSequencePackets.GetFirst () - m_ReceivePacketNum - 1;
 						if (nacks > 0)
 						{
 							if (nacks > SSU2_MAX_NUM_ACNT) nacks = SSU2_MAX_NUM_ACNT;
@@ -2998,35 +3244,33 @@ namespace transport
 		if (packetNum <= m_ReceivePacketNum) return false; // duplicate
 		if (packetNum == m_ReceivePacketNum + 1)
 		{
-			if (!m_OutOfSequencePackets.empty ())
+			if (!m_OutOfSequencePackets.IsEmpty ())
 			{
-				auto it = m_OutOfSequencePackets.begin ();
-				if (*it == packetNum + 1)
+				if (m_OutOfSequencePackets.GetFirst () == packetNum + 1)
 				{
 					// first out of sequence packet is in sequence now
-					packetNum++; it++;
-					while (it != m_OutOfSequencePackets.end ())
-					{
-						if (*it == packetNum + 1)
-						{
-							packetNum++;
-							it++;
-						}
-						else // next out of sequence
-							break;
-					}
-					m_OutOfSequencePackets.erase (m_OutOfSequencePackets.begin (), it);
+					packetNum++;
+					while (m_OutOfSequencePackets.Contains (packetNum + 1)) packetNum++;
+					m_OutOfSequencePackets.RemoveBefore (packetNum + 1);
 				}
 				m_NumRanges = 0; // recalculate ranges when create next Ack
 			}
 			m_ReceivePacketNum = packetNum;
 		}
+		else if (packetNum > m_ReceivePacketNum + SSU2_MAX_OUT_OF_SEQUENCE_SPAN)
+		{
+			// too far ahead, like we've received all packets before
+			LogPrint (eLogWarning, "SSU2: Packet ", packetNum, " is too far ahead of last received ", m_ReceivePacketNum);
+			m_OutOfSequencePackets.Clear ();
+			m_ReceivePacketNum = packetNum;
+			m_NumRanges = 0;
+		}
 		else
 		{
-			if (m_NumRanges && (m_OutOfSequencePackets.empty () ||
-				packetNum != (*m_OutOfSequencePackets.rbegin ()) + 1))
+			if (m_NumRanges && (m_OutOfSequencePackets.IsEmpty () ||
+				packetNum != m_OutOfSequencePackets.GetLast () + 1))
 				m_NumRanges = 0; // reset ranges if received packet is not next
-			m_OutOfSequencePackets.insert (packetNum);
+			m_OutOfSequencePackets.Insert (packetNum);
 		}	
 		return true;
 	}
@@ -3089,7 +3333,7 @@ namespace transport
 	void SSU2Session::SendPathChallenge (const boost::asio::ip::udp::endpoint& to)
 	{
 		AdjustMaxPayloadSize (SSU2_MIN_PACKET_SIZE); // reduce to minimum 
-		m_WindowSize = SSU2_MIN_WINDOW_SIZE; // reduce window to minimum
+		m_CongestionControl->OnPathChange (); // reduce window to minimum
 		
 		uint8_t payload[SSU2_MAX_PACKET_SIZE];
 		size_t payloadSize = 0;
@@ -3147,14 +3391,14 @@ namespace transport
 					++it;
 			}
 		}
-		if (!m_OutOfSequencePackets.empty ())
+		if (!m_OutOfSequencePackets.IsEmpty ())
 		{
 			int ranges = 0;
-			while (ranges < 8 && !m_OutOfSequencePackets.empty () &&
-				(m_OutOfSequencePackets.size () > 2*SSU2_MAX_NUM_ACK_RANGES ||
-			    *m_OutOfSequencePackets.rbegin () > m_ReceivePacketNum + SSU2_MAX_NUM_ACK_PACKETS))
+			while (ranges < 8 && !m_OutOfSequencePackets.IsEmpty () &&
+				(m_OutOfSequencePackets.GetSize () > 2*SSU2_MAX_NUM_ACK_RANGES ||
+			    m_OutOfSequencePackets.GetLast () > m_ReceivePacketNum + SSU2_MAX_NUM_ACK_PACKETS))
 			{
-				uint32_t packet = *m_OutOfSequencePackets.begin ();
+				uint32_t packet = m_OutOfSequencePackets.GetFirst ();
 				if (packet > m_ReceivePacketNum + 1)
 				{
 					// like we've just received all packets before first
@@ -3169,11 +3413,11 @@ namespace transport
 					break;
 				}
 			}
-			if (m_OutOfSequencePackets.size () > 255*4)
+			if (m_OutOfSequencePackets.GetSize () > 255*4)
 			{
 				// seems we have a serious network issue
-				m_ReceivePacketNum = *m_OutOfSequencePackets.rbegin ();
-				m_OutOfSequencePackets.clear ();
+				m_ReceivePacketNum = m_OutOfSequencePackets.GetLast ();
+				m_OutOfSequencePackets.Clear ();
 			}
 		}
 
@@ -3202,7 +3446,7 @@ namespace transport
 			m_Handler.Flush ();
 			m_IsDataReceived = false;
 		}
-		else if (!sent && !m_SentPackets.empty ()) // if only acks received, nothing sent and we still have something to resend
+		else if (!sent && !m_SentPackets.IsEmpty ()) // if only acks received, nothing sent and we still have something to resend
 			Resend (i2p::util::GetMillisecondsSinceEpoch ()); // than right time to resend
 	}
 
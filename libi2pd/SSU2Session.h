@@ -13,6 +13,7 @@
 #include <functional>
 #include <map>
 #include <set>
+#include <vector>
 #include <list>
 #include <boost/asio.hpp>
 #include "version.h"
@@ -20,6 +21,7 @@
 #include "RouterInfo.h"
 #include "RouterContext.h"
 #include "TransportSession.h"
+#include "SSU2CongestionControl.h"
 
 namespace i2p
 {
@@ -43,8 +45,6 @@ namespace transport
 	const int SSU2_MAX_NUM_RECEIVED_I2NP_MSGIDS = 5000; // how many msgID we store for duplicates check
 	const int SSU2_RECEIVED_I2NP_MSGIDS_CLEANUP_TIMEOUT = 10; // in seconds
 	const int SSU2_DECAY_INTERVAL = 20; // in seconds
-	const size_t SSU2_MIN_WINDOW_SIZE = 16; // in packets
-	const size_t SSU2_MAX_WINDOW_SIZE = 256; // in packets
 	const size_t SSU2_MIN_RTO = 100; // in milliseconds
 	const size_t SSU2_INITIAL_RTO = 540; // in milliseconds
 	const size_t SSU2_MAX_RTO = 2500; // in milliseconds
@@ -56,6 +56,8 @@ namespace transport
 	const int SSU2_MAX_NUM_ACK_RANGES = 32; // to send
 	const uint8_t SSU2_MAX_NUM_FRAGMENTS = 64;
 	const int SSU2_SEND_DATETIME_NUM_PACKETS = 256;
+	const size_t SSU2_PACKETS_WINDOW_INITIAL_CAPACITY = 64; // must be power of 2
+	const size_t SSU2_MAX_OUT_OF_SEQUENCE_SPAN = 8192; // packet nums ahead of last received in sequence
 	const int SSU2_MIN_RELAY_RESPONSE_RESEND_VERSION = MAKE_VERSION_NUMBER(0, 9, 64); // 0.9.64
 
 	// flags
@@ -172,6 +174,13 @@ namespace transport
 		eSSU2TerminationReasonReplacedByNewSession = 22
 	};
 
+	enum SSU2DataDecryptionResult
+	{
+		eSSU2DataDecrypted = 0,
+		eSSU2DataNotData, // packet is not changed
+		eSSU2DataAEADFailure // packet is damaged
+	};
+
 	struct SSU2IncompleteMessage
 	{
 		struct Fragment
@@ -199,6 +208,39 @@ namespace transport
 		size_t payloadSize = 0;
 		uint64_t sendTime; // in milliseconds
 		int numResends = 0;
+		i2p::util::BBRDeliveryState deliveryState; // for delivery rate, set by congestion control
+	};
+
+	typedef i2p::util::SequenceWindow<SSU2SentPacket> SSU2SentPacketsWindow; // by packet num
+
+	class SSU2ReceivedPacketsWindow // bitmap of packet nums received out of sequence
+	{
+		public:
+
+			SSU2ReceivedPacketsWindow (size_t capacity = SSU2_PACKETS_WINDOW_INITIAL_CAPACITY*4); // in packets
+
+			bool Insert (uint32_t packetNum); // false if already there, packetNum must not be 0
+			bool Contains (uint32_t packetNum) const;
+			void RemoveBefore (uint32_t packetNum); // all less than packetNum
+			uint32_t GetFirst () const { return m_Size ? m_First : 0; };
+			uint32_t GetLast () const { return m_Size ? m_Last - 1 : 0; };
+			uint32_t GetPrev (uint32_t packetNum) const; // last present less than packetNum, 0 if none
+			size_t GetSize () const { return m_Size; };
+			bool IsEmpty () const { return !m_Size; };
+			size_t GetCapacity () const { return m_Bits.size ()*64; };
+			void Clear ();
+
+		private:
+
+			bool IsSet (uint32_t packetNum) const { return m_Bits[(packetNum >> 6) & (m_Bits.size () - 1)] & (1ULL << (packetNum & 0x3F)); };
+			uint32_t GetNext (uint32_t packetNum) const; // first present from packetNum or m_Last
+			void Grow (uint32_t span);
+
+		private:
+
+			std::vector<uint64_t> m_Bits;
+			uint32_t m_First, m_Last; // [m_First, m_Last), m_Last - 1 is always present
+			size_t m_Size;
 	};
 
 	// RouterInfo flags
@@ -266,6 +308,10 @@ namespace transport
 			uint32_t GetRelayTag () const override { return m_RelayTag; };
 			size_t Resend (uint64_t ts); // return number of resent packets
 			uint64_t GetLastResendTime () const { return m_LastResendTime; };
+			size_t GetCongestionWindow () const { return m_CongestionControl->GetWindow (); }; // in bytes
+			uint64_t GetPacingRate () const { return m_CongestionControl->GetPacingRate (); }; // in bytes per second
+			double GetRTT () const { return m_RTT; };
+			size_t GetBytesInFlight () const { return m_BytesInFlight; };
 			bool IsEstablished () const override { return m_State == eSSU2SessionStateEstablished; };
 			i2p::data::RouterInfo::SupportedTransports GetTransportType () const override;
 			uint64_t GetConnID () const { return m_SourceConnID; };
@@ -279,6 +325,8 @@ namespace transport
 			bool ProcessHolePunch (uint8_t * buf, size_t len);
 			virtual bool ProcessPeerTest (uint8_t * buf, size_t len);
 			void ProcessData (uint8_t * buf, size_t len, const boost::asio::ip::udp::endpoint& from);
+			SSU2DataDecryptionResult DecryptData (uint8_t * buf, size_t len, i2p::crypto::AEADChaCha20Poly1305Decryptor& decryptor) const; // in place, from any thread
+			void ProcessDecryptedData (const uint8_t * buf, size_t len, const boost::asio::ip::udp::endpoint& from); // after DecryptData
 
 		protected:
 
@@ -295,6 +343,8 @@ namespace transport
 
 			void SetAddress (std::shared_ptr<const i2p::data::RouterInfo::Address> addr) { m_Address = addr; }
 			void HandlePayload (const uint8_t * buf, size_t len);
+			void HandleDataPayload (const Header& header, const uint8_t * payload, size_t payloadSize, size_t len);
+			void CheckRemoteEndpoint (const boost::asio::ip::udp::endpoint& from);
 
 			size_t CreateAddressBlock (uint8_t * buf, size_t len, const boost::asio::ip::udp::endpoint& ep);
 			size_t CreatePaddingBlock (uint8_t * buf, size_t len, size_t minSize = 0);
@@ -332,7 +382,7 @@ namespace transport
 			void HandleDateTime (const uint8_t * buf, size_t len);
 			void HandleRouterInfo (const uint8_t * buf, size_t len);
 			void HandleAck (const uint8_t * buf, size_t len);
-			void HandleAckRange (uint32_t firstPacketNum, uint32_t lastPacketNum, uint64_t ts);
+			void HandleAckRange (uint32_t firstPacketNum, uint32_t lastPacketNum, SSU2AckSample& ack, bool updateRTT);
 			virtual void HandleAddress (const uint8_t * buf, size_t len);
 			size_t CreateEndpoint (uint8_t * buf, size_t len, const boost::asio::ip::udp::endpoint& ep);
 			std::shared_ptr<const i2p::data::RouterInfo::Address> FindLocalAddress () const;
@@ -361,6 +411,14 @@ namespace transport
 			size_t CreatePeerTestBlock (uint8_t * buf, size_t len, uint32_t nonce); // Alice
 			size_t CreateTerminationBlock (uint8_t * buf, size_t len);
 			
+		private:
+
+			void AddSentPacket (uint32_t packetNum, SSU2SentPacket * packet); // takes ownership
+			void ClearSentPackets ();
+			bool IsSendAllowed (uint64_t mts) const; // window and pacing
+			void SchedulePacingTimer (uint64_t mts);
+			void HandlePacingTimer (const boost::system::error_code& ecode);
+
 		private:
 
 			SSU2Server& m_Server;
@@ -376,8 +434,8 @@ namespace transport
 			SSU2SessionState m_State;
 			uint8_t m_KeyDataSend[64], m_KeyDataReceive[64];
 			uint32_t m_SendPacketNum, m_ReceivePacketNum, m_LastDatetimeSentPacketNum;
-			std::set<uint32_t> m_OutOfSequencePackets; // packet nums > receive packet num
-			std::map<uint32_t, std::shared_ptr<SSU2SentPacket> > m_SentPackets; // packetNum -> packet
+			SSU2ReceivedPacketsWindow m_OutOfSequencePackets; // packet nums > receive packet num
+			SSU2SentPacketsWindow m_SentPackets; // packetNum -> packet, from server's pool
 			std::unordered_map<uint32_t, std::shared_ptr<SSU2IncompleteMessage> > m_IncompleteMessages; // msgID -> I2NP
 			std::unordered_map<uint32_t, std::pair <std::shared_ptr<SSU2Session>, uint64_t > > m_RelaySessions; // nonce->(Alice, timestamp) for Bob or nonce->(Charlie, timestamp) for Alice
 			std::list<std::shared_ptr<I2NPMessage> > m_SendQueue;
@@ -388,7 +446,12 @@ namespace transport
 			double m_RTT;
 			int m_MsgLocalExpirationTimeout;
 			int m_MsgLocalSemiExpirationTimeout;
-			size_t m_WindowSize, m_RTO;
+			size_t m_RTO;
+			std::unique_ptr<SSU2CongestionControl> m_CongestionControl;
+			size_t m_BytesInFlight; // payload sizes of sent packets
+			uint64_t m_NextSendTime; // by pacing rate, in microseconds
+			boost::asio::deadline_timer m_PacingTimer;
+			bool m_IsPacingTimerScheduled;
 			uint32_t m_RelayTag; // between Bob and Charlie
 			OnEstablished m_OnEstablished; // callback from Established
 			boost::asio::deadline_timer m_ConnectTimer;
@@ -1,5 +1,5 @@
 /*
-* Copyright (c) 2013-2025, The PurpleI2P Project
+* Copyright (c) 2013-2026, The PurpleI2P Project
 *
 * This file is part of Purple i2pd project and licensed under BSD3
 *
@@ -13,12 +13,257 @@
 #include "Tunnel.h"
 #include "Timestamp.h"
 #include "Destination.h"
+#include "Metrics.h"
 #include "Streaming.h"
 
 namespace i2p
 {
 namespace stream
 {
+	static auto& g_StreamsMetric = i2p::metrics::GetRegistry ().GetGauge ("streaming_streams",
+		"Streams of all local destinations");
+	static auto& g_IncomingStreamsMetric = i2p::metrics::GetRegistry ().GetCounter ("streaming_created_streams_total",
+		"Streams created", "direction=\"incoming\"");
+	static auto& g_OutgoingStreamsMetric = i2p::metrics::GetRegistry ().GetCounter ("streaming_created_streams_total",
+		"Streams created", "direction=\"outgoing\"");
+	static auto& g_ResentPacketsMetric = i2p::metrics::GetRegistry ().GetCounter ("streaming_resent_packets_total",
+		"Streaming packets resent");
+	static auto& g_RTTMetric = i2p::metrics::GetRegistry ().GetHistogram ("streaming_rtt_milliseconds",
+		"Streaming RTT samples", i2p::metrics::METRICS_MILLISECONDS_BUCKETS);
+
+	DelayCongestionControl::DelayCongestionControl (int maxWindowSize, uint64_t minPacingTime):
+		CongestionControl (maxWindowSize, minPacingTime),
+		m_RTT{ INITIAL_RTT, INITIAL_RTT, INITIAL_RTT, INITIAL_RTT, 0 },
+		m_WindowSize (INITIAL_WINDOW_SIZE), m_LastWindowDropSize (0), m_WindowDropTargetSize (0),
+		m_WindowIncCounter (0), m_DropWindowDelaySequenceNumber (INITIAL_WINDOW_SIZE), m_IsWinDropped (true),
+		m_PacingTime (INITIAL_PACING_TIME), m_LastWindowIncTime (0)
+	{
+	}
+
+	void DelayCongestionControl::OnAck (const StreamRTT& rtt, const StreamAck& ack)
+	{
+		m_RTT = rtt;
+		int incCounter = 0;
+		if (m_WindowIncCounter < m_MaxWindowSize && !ack.isFirstACK && !m_IsWinDropped)
+			incCounter = ack.numAcked;
+		if (ack.rttSample >= 0)
+		{
+			if (ack.isBufferEmpty || rtt.fastRTT >= rtt.minRTT + rtt.jitter*3 || rtt.rtt >= rtt.minRTT + rtt.jitter*3 ||
+				rtt.slowRTT >= rtt.minRTT + rtt.jitter*3 || rtt.rtt > rtt.fastRTT)
+			{
+				incCounter = 0;
+				m_WindowIncCounter = 0;
+			}
+			m_WindowIncCounter = m_WindowIncCounter + incCounter;
+			if ((rtt.slowRTT > rtt.minRTT + rtt.jitter*6) && !m_IsWinDropped && !ack.isClientChoked) // Drop window if RTT grows too fast
+			{
+				LogPrint (eLogDebug, "Streaming: Congestion detected, reduce window size");
+				ProcessWindowDrop (ack.sequenceNumber);
+			}
+			UpdatePacingTime ();
+		}
+		if (m_IsWinDropped && ack.ackThrough > m_DropWindowDelaySequenceNumber)
+			m_IsWinDropped = false;
+		if (m_WindowDropTargetSize && ack.numInFlight <= m_WindowDropTargetSize)
+		{
+			m_WindowSize = m_WindowDropTargetSize;
+			m_WindowDropTargetSize = 0;
+		}
+	}
+
+	void DelayCongestionControl::OnSendTime (int numPackets, const StreamRTT& rtt, bool isBufferEmpty, uint64_t ts)
+	{
+		m_RTT = rtt;
+		if (m_WindowIncCounter && (m_WindowSize < m_MaxWindowSize || m_WindowDropTargetSize) && !isBufferEmpty && m_PacingTime > m_MinPacingTime)
+		{
+			float winSize = m_WindowSize;
+			if (m_WindowDropTargetSize)
+				winSize = m_WindowDropTargetSize;
+			float maxWinSize = m_MaxWindowSize;
+			if (m_LastWindowIncTime)
+				maxWinSize = (ts - m_LastWindowIncTime) / (rtt.rtt / MAX_WINDOW_SIZE_INC_PER_RTT) + winSize;
+			for (int i = 0; i < numPackets; i++)
+			{
+				if (m_WindowIncCounter)
+				{
+					if (m_WindowDropTargetSize)
+					{
+						if (m_LastWindowDropSize && (m_LastWindowDropSize >= m_WindowDropTargetSize))
+							m_WindowDropTargetSize += 1 - (1 / ((m_LastWindowDropSize + PREV_SPEED_KEEP_TIME_COEFF) / m_WindowDropTargetSize)); // some magic here
+						else if (m_LastWindowDropSize && (m_LastWindowDropSize < m_WindowDropTargetSize))
+							m_WindowDropTargetSize += (m_WindowDropTargetSize - (m_LastWindowDropSize - PREV_SPEED_KEEP_TIME_COEFF)) / m_WindowDropTargetSize; // some magic here
+						else
+							m_WindowDropTargetSize += (m_WindowDropTargetSize - (1 - PREV_SPEED_KEEP_TIME_COEFF)) / m_WindowDropTargetSize;
+						if (m_WindowDropTargetSize > m_MaxWindowSize) m_WindowDropTargetSize = m_MaxWindowSize;
+						m_WindowIncCounter--;
+						if (m_WindowDropTargetSize >= maxWinSize)
+						{
+							m_WindowDropTargetSize = maxWinSize;
+							break;
+						}
+					}
+					else
+					{
+						if (m_LastWindowDropSize && (m_LastWindowDropSize >= m_WindowSize))
+							m_WindowSize += 1 - (1 / ((m_LastWindowDropSize + PREV_SPEED_KEEP_TIME_COEFF) / m_WindowSize)); // some magic here
+						else if (m_LastWindowDropSize && (m_LastWindowDropSize < m_WindowSize))
+							m_WindowSize += (m_WindowSize - (m_LastWindowDropSize - PREV_SPEED_KEEP_TIME_COEFF)) / m_WindowSize; // some magic here
+						else
+							m_WindowSize += (m_WindowSize - (1 - PREV_SPEED_KEEP_TIME_COEFF)) / m_WindowSize;
+						if (m_WindowSize > m_MaxWindowSize) m_WindowSize = m_MaxWindowSize;
+						m_WindowIncCounter--;
+						if (m_WindowSize >= maxWinSize)
+						{
+							m_WindowSize = maxWinSize;
+							break;
+						}
+					}
+				}
+				else
+					break;
+			}
+			UpdatePacingTime ();
+		}
+		m_LastWindowIncTime = ts;
+	}
+
+	void DelayCongestionControl::OnLoss (uint32_t sequenceNumber, int numInFlight, uint64_t ts)
+	{
+		if (!m_IsWinDropped && LOSS_BASED_CONTROL_ENABLED)
+		{
+			LogPrint (eLogDebug, "Streaming: Packet loss, reduce window size");
+			if (m_WindowDropTargetSize)
+				m_LastWindowDropSize = m_WindowDropTargetSize;
+			else
+				m_LastWindowDropSize = m_WindowSize;
+			m_WindowDropTargetSize = m_LastWindowDropSize * 0.5; // -50% to drain queue
+			if (m_WindowDropTargetSize < MIN_WINDOW_SIZE)
+				m_WindowDropTargetSize = MIN_WINDOW_SIZE;
+			m_WindowIncCounter = 0; // disable window growth
+			m_DropWindowDelaySequenceNumber = sequenceNumber + int(m_WindowDropTargetSize);
+			m_IsWinDropped = true; // don't drop window twice
+			UpdatePacingTime ();
+		}
+	}
+
+	void DelayCongestionControl::OnTimeout ()
+	{
+		m_WindowDropTargetSize = INITIAL_WINDOW_SIZE;
+		m_LastWindowDropSize = 0;
+		m_WindowIncCounter = 0;
+		m_IsWinDropped = true;
+		m_DropWindowDelaySequenceNumber = 0;
+		UpdatePacingTime ();
+	}
+
+	void DelayCongestionControl::OnPathChange (uint32_t sequenceNumber, int numInFlight, bool isClientChoked)
+	{
+		if (!isClientChoked)
+		{
+			if (m_WindowSize > INITIAL_WINDOW_SIZE)
+				m_WindowDropTargetSize = (float)INITIAL_WINDOW_SIZE;
+			else
+				m_WindowSize = INITIAL_WINDOW_SIZE;
+		}
+		m_LastWindowDropSize = 0;
+		m_WindowIncCounter = 0; // disable window growth
+		m_DropWindowDelaySequenceNumber = sequenceNumber - numInFlight + INITIAL_WINDOW_SIZE;
+		m_IsWinDropped = true; // don't drop window twice
+		UpdatePacingTime ();
+	}
+
+	void DelayCongestionControl::OnChoke (uint32_t sequenceNumber)
+	{
+		m_WindowDropTargetSize = MIN_WINDOW_SIZE;
+		m_LastWindowDropSize = 0;
+		m_WindowIncCounter = 0;
+		m_IsWinDropped = false;
+		m_DropWindowDelaySequenceNumber = sequenceNumber;
+		UpdatePacingTime ();
+	}
+
+	void DelayCongestionControl::UpdatePacingTime ()
+	{
+		double rtt = m_RTT.minRTT + m_RTT.jitter*2;
+		if (m_WindowDropTargetSize)
+			m_PacingTime = std::round (rtt*1000/m_WindowDropTargetSize);
+		else
+			m_PacingTime = std::round (rtt*1000/m_WindowSize);
+		if (m_MinPacingTime && m_PacingTime < m_MinPacingTime)
+			m_PacingTime = m_MinPacingTime;
+	}
+
+	void DelayCongestionControl::ProcessWindowDrop (uint32_t sequenceNumber)
+	{
+		if (m_WindowDropTargetSize)
+			m_LastWindowDropSize = m_WindowDropTargetSize * ((m_RTT.minRTT + m_RTT.jitter*4) / m_RTT.fastRTT);
+		else
+			m_LastWindowDropSize = m_WindowSize * ((m_RTT.minRTT + m_RTT.jitter*4) / m_RTT.fastRTT);
+		m_WindowDropTargetSize = m_LastWindowDropSize * 0.5; // -50% to drain queue
+		if (m_WindowDropTargetSize < MIN_WINDOW_SIZE)
+			m_WindowDropTargetSize = MIN_WINDOW_SIZE;
+		m_WindowIncCounter = 0; // disable window growth
+		m_DropWindowDelaySequenceNumber = sequenceNumber + int(m_WindowDropTargetSize);
+		m_IsWinDropped = true; // don't drop window twice
+		UpdatePacingTime ();
+	}
+
+	BBRCongestionControl::BBRCongestionControl (int maxWindowSize, uint64_t minPacingTime):
+		CongestionControl (maxWindowSize, minPacingTime), m_Model (INITIAL_RTT, INITIAL_WINDOW_SIZE),
+		m_PacingTime (INITIAL_PACING_TIME)
+	{
+	}
+
+	void BBRCongestionControl::Reset ()
+	{
+		m_Model.Reset ();
+		m_PacingTime = INITIAL_PACING_TIME;
+	}
+
+	void BBRCongestionControl::OnPacketSent (Packet * packet, int numInFlight, uint64_t ts)
+	{
+		m_Model.OnPacketSent (packet->deliveryState, numInFlight, ts);
+	}
+
+	void BBRCongestionControl::OnPacketAcked (const Packet * packet, uint64_t ts)
+	{
+		m_Model.OnPacketAcked (packet->deliveryState, 1, packet->sendTime, ts);
+	}
+
+	void BBRCongestionControl::OnAck (const StreamRTT& rtt, const StreamAck& ack)
+	{
+		m_Model.OnAck (ack.ts, ack.rttSample, ack.numAcked, ack.numInFlight, MIN_WINDOW_SIZE, m_MaxWindowSize);
+		auto bandwidth = m_Model.GetBandwidth ();
+		if (bandwidth > 0)
+			m_PacingTime = std::round (1000/(m_Model.GetPacingGain ()*bandwidth));
+		else // no delivery rate yet
+			m_PacingTime = std::round (rtt.rtt*1000/(m_Model.GetPacingGain ()*m_Model.GetWindow ()));
+		if (m_MinPacingTime && m_PacingTime < m_MinPacingTime)
+			m_PacingTime = m_MinPacingTime;
+	}
+
+	void BBRCongestionControl::OnLoss (uint32_t sequenceNumber, int numInFlight, uint64_t ts)
+	{
+		m_Model.OnLoss (numInFlight, MIN_WINDOW_SIZE);
+	}
+
+	void BBRCongestionControl::OnChoke (uint32_t sequenceNumber)
+	{
+		m_Model.SetWindow (MIN_WINDOW_SIZE);
+	}
+
+	std::unique_ptr<CongestionControl> CreateCongestionControl (CongestionControlType type,
+		int maxWindowSize, uint64_t minPacingTime)
+	{
+		switch (type)
+		{
+			case eCongestionControlBBR:
+				return std::make_unique<BBRCongestionControl>(maxWindowSize, minPacingTime);
+			default:
+				return std::make_unique<DelayCongestionControl>(maxWindowSize, minPacingTime);
+		}
+	}
+
 	void SendBufferQueue::Add (std::shared_ptr<SendBuffer>&& buf)
 	{
 		if (buf)
@@ -89,27 +334,30 @@ namespace stream
 		m_LastConfirmedReceivedSequenceNumber (0), // for limit inbound speed
 		m_Status (eStreamStatusNew), m_IsIncoming (false), m_IsAckSendScheduled (false), m_IsNAcked (false), m_IsFirstACK (false), 
 		m_IsResendNeeded (false), m_IsFirstRttSample (false), m_IsSendTime (true), 
-		m_IsWinDropped (true), m_IsChoking2 (false), m_IsClientChoked (false), m_IsClientChoked2 (false),
+		m_IsChoking2 (false), m_IsClientChoked (false), m_IsClientChoked2 (false),
 		m_IsTimeOutResend (false), m_IsImmediateAckRequested (false), m_IsRemoteLeaseChangeInProgress (false), 
 		m_IsBufferEmpty (false), m_IsJavaClient (false), m_DontSign (local.GetOwner ()->IsStreamingDontSign ()), 
 		m_LocalDestination (local), m_RemoteLeaseSet (remote), m_ReceiveTimer (m_Service), 
 		m_SendTimer (m_Service), m_ResendTimer (m_Service), m_AckSendTimer (m_Service), m_NumSentBytes (0),
 		m_NumReceivedBytes (0), m_Port (port), m_RTT (INITIAL_RTT), m_MinRTT (INITIAL_RTT), 
-		m_SlowRTT (INITIAL_RTT), m_FastRTT (INITIAL_RTT), m_WindowSize (INITIAL_WINDOW_SIZE),
-		m_MaxWindowSize (local.GetOwner ()->GetStreamingMaxWindowSize ()), m_LastWindowDropSize (0), 
-		m_WindowDropTargetSize (0), m_WindowIncCounter (0), m_RTO (INITIAL_RTO),
+		m_SlowRTT (INITIAL_RTT), m_FastRTT (INITIAL_RTT),
+		m_MaxWindowSize (local.GetOwner ()->GetStreamingMaxWindowSize ()), m_RTO (INITIAL_RTO),
 		m_AckDelay (local.GetOwner ()->GetStreamingAckDelay ()), m_PrevRTTSample (INITIAL_RTT), 
-		m_Jitter (0), m_MinPacingTime (0), m_PacingTime (INITIAL_PACING_TIME), m_PacingTimeRem (0), 
+		m_Jitter (0), m_PacingTimeRem (0), 
 		m_LastSendTime (0), m_LastACKRecieveTime (0), m_ACKRecieveInterval (local.GetOwner ()->GetStreamingAckDelay ()), 
-		m_RemoteLeaseChangeTime (0), m_LastWindowIncTime (0), m_LastACKRequestTime (0), m_LastACKSendTime (0), 
+		m_RemoteLeaseChangeTime (0), m_LastACKRequestTime (0), m_LastACKSendTime (0), 
 		m_PacketACKInterval (1), m_PacketACKIntervalRem (0), // for limit inbound speed
 		m_NumResendAttempts (0), m_NumPacketsToSend (0), m_JitterAccum (0), m_JitterDiv (1), m_MTU (STREAMING_MTU)
 	{
 		RAND_bytes ((uint8_t *)&m_RecvStreamID, 4);
+		g_StreamsMetric.Add (1);
 		m_RemoteIdentity = remote->GetIdentity ();
+		uint64_t minPacingTime = 0;
 		auto outboundSpeed = local.GetOwner ()->GetStreamingOutboundSpeed ();
 		if (outboundSpeed)
-			m_MinPacingTime = (1000000LL*STREAMING_MTU)/outboundSpeed;
+			minPacingTime = (1000000LL*STREAMING_MTU)/outboundSpeed;
+		m_CongestionControl = CreateCongestionControl (local.GetOwner ()->GetStreamingCongestionControl (),
+			m_MaxWindowSize, minPacingTime);
 		
 		auto inboundSpeed = local.GetOwner ()->GetStreamingInboundSpeed (); // for limit inbound speed
 		if (inboundSpeed)
@@ -122,25 +370,28 @@ namespace stream
 		m_LastConfirmedReceivedSequenceNumber (0), // for limit inbound speed
 		m_Status (eStreamStatusNew), m_IsIncoming (true), m_IsAckSendScheduled (false), m_IsNAcked (false), m_IsFirstACK (false),  
 		m_IsResendNeeded (false), m_IsFirstRttSample (false), m_IsSendTime (true), 
-		m_IsWinDropped (true), m_IsChoking2 (false), m_IsClientChoked (false), m_IsClientChoked2 (false),
+		m_IsChoking2 (false), m_IsClientChoked (false), m_IsClientChoked2 (false),
 		m_IsTimeOutResend (false), m_IsImmediateAckRequested (false), m_IsRemoteLeaseChangeInProgress (false),
 		m_IsBufferEmpty (false), m_IsJavaClient (false), m_DontSign (local.GetOwner ()->IsStreamingDontSign ()),
 		m_LocalDestination (local),m_ReceiveTimer (m_Service), m_SendTimer (m_Service),
 		m_ResendTimer (m_Service), m_AckSendTimer (m_Service),m_NumSentBytes (0), m_NumReceivedBytes (0),
 		m_Port (0), m_RTT (INITIAL_RTT), m_MinRTT (INITIAL_RTT), m_SlowRTT (INITIAL_RTT), m_FastRTT (INITIAL_RTT),
-		m_WindowSize (INITIAL_WINDOW_SIZE), m_MaxWindowSize (local.GetOwner ()->GetStreamingMaxWindowSize ()), 
-		m_LastWindowDropSize  (0), m_WindowDropTargetSize (0), m_WindowIncCounter (0), m_RTO (INITIAL_RTO),
+		m_MaxWindowSize (local.GetOwner ()->GetStreamingMaxWindowSize ()), m_RTO (INITIAL_RTO),
 		m_AckDelay (local.GetOwner ()->GetStreamingAckDelay ()),m_PrevRTTSample (INITIAL_RTT), m_Jitter (0), 
-		m_MinPacingTime (0), m_PacingTime (INITIAL_PACING_TIME), m_PacingTimeRem (0), m_LastSendTime (0),
+		m_PacingTimeRem (0), m_LastSendTime (0),
 		m_LastACKRecieveTime (0), m_ACKRecieveInterval (local.GetOwner ()->GetStreamingAckDelay ()), 
-		m_RemoteLeaseChangeTime (0), m_LastWindowIncTime (0), m_LastACKRequestTime (0),
+		m_RemoteLeaseChangeTime (0), m_LastACKRequestTime (0),
 		m_LastACKSendTime (0), m_PacketACKInterval (1), m_PacketACKIntervalRem (0), // for limit inbound speed
 		m_NumResendAttempts (0), m_NumPacketsToSend (0), m_JitterAccum (0), m_JitterDiv (1), m_MTU (STREAMING_MTU)
 	{
 		RAND_bytes ((uint8_t *)&m_RecvStreamID, 4);
+		g_StreamsMetric.Add (1);
+		uint64_t minPacingTime = 0;
 		auto outboundSpeed = local.GetOwner ()->GetStreamingOutboundSpeed ();
 		if (outboundSpeed)
-			m_MinPacingTime = (1000000LL*STREAMING_MTU)/outboundSpeed;
+			minPacingTime = (1000000LL*STREAMING_MTU)/outboundSpeed;
+		m_CongestionControl = CreateCongestionControl (local.GetOwner ()->GetStreamingCongestionControl (),
+			m_MaxWindowSize, minPacingTime);
 		
 		auto inboundSpeed = local.GetOwner ()->GetStreamingInboundSpeed (); // for limit inbound speed
 		if (inboundSpeed)
@@ -149,6 +400,7 @@ namespace stream
 
 	Stream::~Stream ()
 	{
+		g_StreamsMetric.Add (-1);
 		CleanUp ();
 		LogPrint (eLogDebug, "Streaming: Stream deleted");
 	}
@@ -167,9 +419,9 @@ namespace stream
 
 	void Stream::CleanUp ()
 	{		
-		if (m_RoutingSession && !m_SentPackets.empty ()) // free up space in shared window
+		if (m_RoutingSession && !m_SentPackets.IsEmpty ()) // free up space in shared window
 		{
-			int numPackets = m_SentPackets.size ();
+			int numPackets = m_SentPackets.GetSize ();
 			int numSentPackets = m_RoutingSession->NumSentPackets ();
 			numSentPackets -= numPackets;
 			if (numSentPackets < 0) numSentPackets = 0;
@@ -184,15 +436,15 @@ namespace stream
 			m_LocalDestination.DeletePacket (packet);
 		}
 		
-		m_NACKedPackets.clear ();
+		m_NACKedPackets.Clear ();
 
 		for (auto it: m_SentPackets)
 			m_LocalDestination.DeletePacket (it);
-		m_SentPackets.clear ();
+		m_SentPackets.Clear ();
 
 		for (auto it: m_SavedPackets)
 			m_LocalDestination.DeletePacket (it);
-		m_SavedPackets.clear ();
+		m_SavedPackets.Clear ();
 	}
 
 	void Stream::HandleNextPacket (Packet * packet)
@@ -254,18 +506,10 @@ namespace stream
 			if (m_Status == eStreamStatusTerminated) return;
 			
 			// we should also try stored messages if any
-			for (auto it = m_SavedPackets.begin (); it != m_SavedPackets.end ();)
+			while (auto savedPacket = m_SavedPackets.Remove (m_LastReceivedSequenceNumber + 1))
 			{
-				if ((*it)->GetSeqn () == (uint32_t)(m_LastReceivedSequenceNumber + 1))
-				{
-					Packet * savedPacket = *it;
-					m_SavedPackets.erase (it++);
-
-					ProcessPacket (savedPacket);
-					if (m_Status == eStreamStatusTerminated) return;
-				}
-				else
-					break;
+				ProcessPacket (savedPacket);
+				if (m_Status == eStreamStatusTerminated) return;
 			}
 
 			// schedule ack for last message
@@ -312,12 +556,12 @@ namespace stream
 					m_LocalDestination.DeletePacket (packet);
 					m_IsChoking2 = true;
 				}
-				else if (m_SavedPackets.empty () && (receivedSeqn - m_LastReceivedSequenceNumber) >= 256)
+				else if (m_SavedPackets.IsEmpty () && (receivedSeqn - m_LastReceivedSequenceNumber) >= 256)
 				{
 					m_LocalDestination.DeletePacket (packet);
 					m_IsChoking2 = true;
 				}
-				else if (!m_SavedPackets.empty ())
+				else if (!m_SavedPackets.IsEmpty ())
 				{
 					uint8_t numNacks = 0;
 					auto lastSavedSeq = 0;
@@ -362,7 +606,7 @@ namespace stream
 
 	void Stream::SavePacket (Packet * packet)
 	{
-		if (!m_SavedPackets.insert (packet).second)
+		if (!m_SavedPackets.Insert (packet->GetSeqn (), packet))
 			m_LocalDestination.DeletePacket (packet);
 	}
 
@@ -444,17 +688,14 @@ namespace stream
 						{
 							LogPrint (eLogDebug, "Streaming: limit window size for java client");
 							m_MaxWindowSize = 64;
+							m_CongestionControl->SetMaxWindowSize (m_MaxWindowSize);
 							m_IsJavaClient = true;
 							if (m_RoutingSession) m_RoutingSession->SetIsWithJava (true);
 						}
-						m_WindowDropTargetSize = MIN_WINDOW_SIZE;
-						m_LastWindowDropSize = 0;
-						m_WindowIncCounter = 0;
 						m_IsClientChoked = true;
-						m_IsWinDropped = false;
 						m_DropWindowDelaySequenceNumber = m_SequenceNumber-1;
 						m_IsFirstRttSample = true;
-						UpdatePacingTime ();
+						m_CongestionControl->OnChoke (m_DropWindowDelaySequenceNumber);
 					}
 				}
 			}
@@ -668,42 +909,37 @@ namespace stream
 		bool acknowledged = false;
 		auto ts = i2p::util::GetMillisecondsSinceEpoch ();
 		uint32_t ackThrough = packet->GetAckThrough ();
-		m_NACKedPackets.clear ();
+		m_NACKedPackets.Clear ();
 		if (ackThrough > m_SequenceNumber)
 		{
 			LogPrint (eLogError, "Streaming: Unexpected ackThrough=", ackThrough, " > seqn=", m_SequenceNumber);
 			return;
 		}
 		int rttSample = INT_MAX;
-		int incCounter = 0;
 		int ackPacketsCounter = 0;
 		m_IsNAcked = false;
 		m_IsResendNeeded = false;
 		int nackCount = packet->GetNACKCount ();
+		for (int i = 0; i < nackCount; i++)
+		{
+			auto seqn = packet->GetNACK (i);
+			if (seqn > ackThrough) continue;
+			auto nackedPacket = m_SentPackets.Find (seqn);
+			if (nackedPacket)
+			{
+				LogPrint (eLogDebug, "Streaming: Packet ", seqn, " NACK");
+				m_NACKedPackets.Insert (seqn, nackedPacket);
+				m_IsNAcked = true;
+			}
+		}
 		for (auto it = m_SentPackets.begin (); it != m_SentPackets.end ();)
 		{
-			auto seqn = (*it)->GetSeqn ();
+			auto sentPacket = *it;
+			auto seqn = sentPacket->GetSeqn ();
 			if (seqn <= ackThrough)
 			{
-				if (nackCount > 0)
-				{
-					bool nacked = false;
-					for (int i = 0; i < nackCount; i++)
-						if (seqn == packet->GetNACK (i))
-						{
-							m_NACKedPackets.insert (*it);
-							m_IsNAcked = true;
-							nacked = true;
-							break;
-						}
-					if (nacked)
-					{
-						LogPrint (eLogDebug, "Streaming: Packet ", seqn, " NACK");
-						++it;
-						continue;
-					}
-				}
-				auto sentPacket = *it;
+				++it;
+				if (m_NACKedPackets.Find (seqn)) continue;
 				int64_t rtt = (int64_t)ts - (int64_t)sentPacket->sendTime;
 				if (rtt < 0)
 					LogPrint (eLogError, "Streaming: Packet ", seqn, "sent from the future, sendTime=", sentPacket->sendTime);
@@ -715,12 +951,11 @@ namespace stream
 				else if (!sentPacket->resent && seqn > m_TunnelsChangeSequenceNumber && rtt >= 0)
 					rttSample = std::min (rttSample, (int)rtt);
 				LogPrint (eLogDebug, "Streaming: Packet ", seqn, " acknowledged rtt=", rtt, " sentTime=", sentPacket->sendTime);
-				m_SentPackets.erase (it++);
+				m_CongestionControl->OnPacketAcked (sentPacket, ts);
+				m_SentPackets.Remove (seqn);
 				m_LocalDestination.DeletePacket (sentPacket);
 				acknowledged = true;
 				ackPacketsCounter++;
-				if (m_WindowIncCounter < m_MaxWindowSize && !m_IsFirstACK && !m_IsWinDropped)
-					incCounter++;
 			}
 			else
 				break;
@@ -734,8 +969,12 @@ namespace stream
 				m_ACKRecieveInterval = interval;
 		}
 		m_LastACKRecieveTime = ts;
+		bool isWinDropped = m_CongestionControl->IsWindowDropped ();
+		StreamAck ack{ ts, rttSample != INT_MAX ? rttSample : -1, ackPacketsCounter, (int)m_SentPackets.GetSize (),
+			ackThrough, m_SequenceNumber, m_IsFirstACK, m_IsBufferEmpty, m_IsClientChoked };
 		if (rttSample != INT_MAX)
 		{
+			g_RTTMetric.Observe (rttSample);
 			if (m_IsFirstRttSample && !m_IsFirstACK)
 			{
 				m_RTT = rttSample;
@@ -753,7 +992,7 @@ namespace stream
 			{
 				m_RTT = (m_PrevRTTSample + rttSample) / 2;
 			}
-			if (!m_IsWinDropped) 
+			if (!isWinDropped) 
 			{
 				m_SlowRTT = SLOWRTT_EWMA_ALPHA * m_RTT + (1.0 - SLOWRTT_EWMA_ALPHA) * m_SlowRTT;
 				m_FastRTT = RTT_EWMA_ALPHA * m_RTT + (1.0 - RTT_EWMA_ALPHA) * m_FastRTT;
@@ -777,20 +1016,6 @@ namespace stream
 					m_SlowRTT = m_MinRTT + m_Jitter;
 				}
 			}
-			if (m_IsBufferEmpty || m_FastRTT >= m_MinRTT + m_Jitter*3 || m_RTT >= m_MinRTT + m_Jitter*3 || m_SlowRTT >= m_MinRTT + m_Jitter*3 || m_RTT > m_FastRTT)
-			{
-				incCounter = 0;
-				m_WindowIncCounter = 0;
-			}
-			m_WindowIncCounter = m_WindowIncCounter + incCounter;
-			//
-			// delay-based CC
-			if ((m_SlowRTT > m_MinRTT + m_Jitter*6) && !m_IsWinDropped && !m_IsClientChoked) // Drop window if RTT grows too fast
-			{
-				LogPrint (eLogDebug, "Streaming: Congestion detected, reduce window size");
-				ProcessWindowDrop ();
-			}
-			UpdatePacingTime ();
 			m_PrevRTTSample = rttSample;
 			
 			bool wasInitial = m_RTO == INITIAL_RTO;
@@ -799,30 +1024,25 @@ namespace stream
 			if (wasInitial)
 				ScheduleResend ();
 		}
-		if (m_IsClientChoked && (ackThrough >= m_DropWindowDelaySequenceNumber || m_SentPackets.empty ()))
+		m_CongestionControl->OnAck (GetRTTEstimate (), ack);
+		if (!isWinDropped && m_CongestionControl->IsWindowDropped ())
+			m_IsFirstACK = true; // ignore first RTT sample
+		else if (isWinDropped && !m_CongestionControl->IsWindowDropped ())
+			m_IsFirstRttSample = true;
+		if (m_IsClientChoked && (ackThrough >= m_DropWindowDelaySequenceNumber || m_SentPackets.IsEmpty ()))
 			m_IsClientChoked = false;
-		if (m_IsClientChoked2 && (ackThrough >= m_DropWindowDelaySequenceNumber || m_SentPackets.empty ()))
+		if (m_IsClientChoked2 && (ackThrough >= m_DropWindowDelaySequenceNumber || m_SentPackets.IsEmpty ()))
 			m_IsClientChoked2 = false;
-		if (m_IsWinDropped && ackThrough > m_DropWindowDelaySequenceNumber)
-		{
-			m_IsFirstRttSample = true;
-			m_IsWinDropped = false;
-		}
-		if (m_WindowDropTargetSize && int(m_SentPackets.size ()) <= m_WindowDropTargetSize)
-		{
-			m_WindowSize = m_WindowDropTargetSize;
-			m_WindowDropTargetSize = 0;
-		}
 		if (acknowledged || m_IsNAcked)
 		{
 			ScheduleResend ();
 		}
-		if (m_SendBuffer.IsEmpty () && m_SentPackets.size () > 0) // tail loss
+		if (m_SendBuffer.IsEmpty () && !m_SentPackets.IsEmpty ()) // tail loss
 		{
 			m_IsResendNeeded = true;
 			m_RTO = std::max (MIN_RTO, (int)(m_RTT * 1.5 + m_Jitter + m_ACKRecieveInterval)); // to prevent spurious retransmit
 		}
-		if (m_SentPackets.empty () && m_SendBuffer.IsEmpty ())
+		if (m_SentPackets.IsEmpty () && m_SendBuffer.IsEmpty ())
 		{
 			m_ResendTimer.cancel ();
 			m_SendTimer.cancel ();
@@ -925,7 +1145,7 @@ namespace stream
 		if (m_RemoteLeaseSet) // don't scheudle send for first SYN for incoming stream
 			ScheduleSend ();
 		auto ts = i2p::util::GetMillisecondsSinceEpoch ();
-		int numMsgs = m_WindowSize - m_SentPackets.size ();
+		int numMsgs = m_CongestionControl->GetWindowSize () - m_SentPackets.GetSize ();
 		if (numMsgs <= 0 || !m_IsSendTime) // window is full
 		{
 			m_LastSendTime = ts;
@@ -944,7 +1164,11 @@ namespace stream
 		if (m_RoutingSession)
 		{
 			m_IsJavaClient = m_RoutingSession->IsWithJava ();
-			if (m_IsJavaClient) m_MaxWindowSize = 64;
+			if (m_IsJavaClient && m_MaxWindowSize != 64)
+			{
+				m_MaxWindowSize = 64;
+				m_CongestionControl->SetMaxWindowSize (m_MaxWindowSize);
+			}
 			int numSentPackets = m_RoutingSession->NumSentPackets ();
 			int numPacketsToSend = m_MaxWindowSize - numSentPackets;
 			if (numPacketsToSend <= 0) // shared window is full
@@ -1080,17 +1304,18 @@ namespace stream
 		int numPackets = packets.size ();
 		if (packets.size () > 0)
 		{
-			if (m_SavedPackets.empty ()) // no NACKS
+			if (m_SavedPackets.IsEmpty ()) // no NACKS
 			{
 				m_IsAckSendScheduled = false;
 				m_AckSendTimer.cancel ();
 			}
-			bool isEmpty = m_SentPackets.empty ();
+			bool isEmpty = m_SentPackets.IsEmpty ();
 //			auto ts = i2p::util::GetMillisecondsSinceEpoch ();
 			for (auto& it: packets)
 			{
 				it->sendTime = ts;
-				m_SentPackets.insert (it);
+				m_CongestionControl->OnPacketSent (it, m_SentPackets.GetSize (), ts);
+				m_SentPackets.Insert (it->GetSeqn (), it);
 			}
 			SendPackets (packets);
 			m_LastSendTime = ts;
@@ -1131,7 +1356,7 @@ namespace stream
 		}
 		if (numPackets == 0) return;
 		// for limit inbound speed
-		if (!m_SavedPackets.empty ())
+		if (!m_SavedPackets.IsEmpty ())
 		{
 			for (auto it: m_SavedPackets)
 			{
@@ -1317,7 +1542,7 @@ namespace stream
 				Terminate ();
 			break;
 			case eStreamStatusClosing:
-				if (m_SentPackets.empty () && m_SendBuffer.IsEmpty ()) // nothing to send
+				if (m_SentPackets.IsEmpty () && m_SendBuffer.IsEmpty ()) // nothing to send
 				{
 					m_Status = eStreamStatusClosed;
 					SendClose();
@@ -1406,6 +1631,89 @@ namespace stream
 		return pos;
 	}
 
+	void Stream::AsyncReceivePayload (size_t maxLen, ReceivePayloadHandler handler, int timeout)
+	{
+		boost::asio::post (m_Service, [s = shared_from_this (), maxLen, handler, timeout](void)
+		{
+			if (!s->m_ReceiveQueue.empty () || s->m_Status == eStreamStatusReset)
+				s->HandleReceivePayloadTimer (boost::asio::error::make_error_code (boost::asio::error::operation_aborted), maxLen, handler, 0);
+			else
+			{
+				int t = (timeout > MAX_RECEIVE_TIMEOUT) ? MAX_RECEIVE_TIMEOUT : timeout;
+				s->m_ReceiveTimer.expires_from_now (boost::posix_time::seconds(t));
+				int left = timeout - t;
+				s->m_ReceiveTimer.async_wait (
+					[s, maxLen, handler, left](const boost::system::error_code & ec)
+					{
+						s->HandleReceivePayloadTimer (ec, maxLen, handler, left);
+					});
+			}
+		});
+	}
+
+	void Stream::HandleReceivePayloadTimer (const boost::system::error_code& ecode, size_t maxLen, ReceivePayloadHandler handler, int remainingTimeout)
+	{
+		auto payload = ReadPayload (maxLen);
+		if (payload)
+			handler (boost::system::error_code (), payload);
+		else if (ecode == boost::asio::error::operation_aborted)
+		{
+			// timeout not expired
+			if (m_Status == eStreamStatusReset)
+				handler (boost::asio::error::make_error_code (boost::asio::error::connection_reset), nullptr);
+			else
+				handler (boost::asio::error::make_error_code (boost::asio::error::operation_aborted), nullptr);
+		}
+		else
+		{
+			// timeout expired
+			if (remainingTimeout <= 0)
+				handler (boost::asio::error::make_error_code (boost::asio::error::timed_out), nullptr);
+			else
+			{
+				// itermediate interrupt
+				SendUpdatedLeaseSet (); // send our leaseset if applicable
+				AsyncReceivePayload (maxLen, handler, remainingTimeout);
+			}
+		}
+	}
+
+	std::shared_ptr<ReceivedPayload> Stream::ReadPayload (size_t maxLen)
+	{
+		if (m_ReceiveQueue.empty ()) return nullptr;
+		auto payload = std::make_shared<ReceivedPayload> ();
+		payload->stream = shared_from_this ();
+		while (!m_ReceiveQueue.empty ())
+		{
+			Packet * packet = m_ReceiveQueue.front ();
+			size_t l = packet->GetLength ();
+			if (payload->size && payload->size + l > maxLen) break; // whole packets only
+			if (l)
+			{
+				payload->buffers.push_back (boost::asio::const_buffer (packet->GetBuffer (), l));
+				payload->size += l;
+			}
+			payload->packets.push_back (packet);
+			m_ReceiveQueue.pop ();
+		}
+		return payload;
+	}
+
+	void Stream::ReleasePackets (std::vector<Packet *>&& packets)
+	{
+		boost::asio::post (m_Service, [s = shared_from_this (), packets = std::move (packets)](void)
+		{
+			for (auto it: packets)
+				s->m_LocalDestination.DeletePacket (it);
+		});
+	}
+
+	ReceivedPayload::~ReceivedPayload ()
+	{
+		if (stream && !packets.empty ())
+			stream->ReleasePackets (std::move (packets));
+	}
+
 	bool Stream::SendPacket (Packet * packet)
 	{
 		if (packet)
@@ -1417,8 +1725,8 @@ namespace stream
 			}
 			if (!packet->sendTime) packet->sendTime = i2p::util::GetMillisecondsSinceEpoch ();
 			SendPackets (std::vector<Packet *> { packet });
-			bool isEmpty = m_SentPackets.empty ();
-			m_SentPackets.insert (packet);
+			bool isEmpty = m_SentPackets.IsEmpty ();
+			m_SentPackets.Insert (packet->GetSeqn (), packet);
 			if (isEmpty)
 				ScheduleResend ();
 			return true;
@@ -1573,7 +1881,8 @@ namespace stream
 		{
 			m_SendTimer.cancel ();
 			uint64_t interval = SEND_INTERVAL + m_LocalDestination.GetRandom () % SEND_INTERVAL_VARIANCE;
-			if (interval < m_PacingTime) interval = m_PacingTime;
+			auto pacingTime = m_CongestionControl->GetPacingTime ();
+			if (interval < pacingTime) interval = pacingTime;
 			m_SendTimer.expires_from_now (boost::posix_time::microseconds(interval));
 			m_SendTimer.async_wait (std::bind (&Stream::HandleSendTimer,
 				shared_from_this (), std::placeholders::_1));
@@ -1585,11 +1894,12 @@ namespace stream
 		if (ecode != boost::asio::error::operation_aborted)
 		{
 			auto ts = i2p::util::GetMillisecondsSinceEpoch ();
-			if (m_LastSendTime && ts*1000 > m_LastSendTime*1000 + m_PacingTime)
+			auto pacingTime = m_CongestionControl->GetPacingTime ();
+			if (m_LastSendTime && ts*1000 > m_LastSendTime*1000 + pacingTime)
 			{
-				if (m_PacingTime)
+				if (pacingTime)
 				{	
-					auto numPackets = std::lldiv (m_PacingTimeRem + ts*1000 - m_LastSendTime*1000, m_PacingTime);
+					auto numPackets = std::lldiv (m_PacingTimeRem + ts*1000 - m_LastSendTime*1000, pacingTime);
 					m_NumPacketsToSend = numPackets.quot;
 					m_PacingTimeRem = numPackets.rem;
 				}	
@@ -1599,60 +1909,10 @@ namespace stream
 					m_NumPacketsToSend = 1; m_PacingTimeRem = 0;
 				}	
 				m_IsSendTime = true;
-				if (m_WindowIncCounter && (m_WindowSize < m_MaxWindowSize || m_WindowDropTargetSize) && !m_SendBuffer.IsEmpty () && m_PacingTime > m_MinPacingTime)
-				{
-					float winSize = m_WindowSize;
-					if (m_WindowDropTargetSize)
-						winSize = m_WindowDropTargetSize;
-					float maxWinSize = m_MaxWindowSize;
-					if (m_LastWindowIncTime)
-						maxWinSize = (ts - m_LastWindowIncTime) / (m_RTT / MAX_WINDOW_SIZE_INC_PER_RTT) + winSize;
-					for (int i = 0; i < m_NumPacketsToSend; i++)
-					{
-						if (m_WindowIncCounter)
-						{
-							if (m_WindowDropTargetSize)
-							{
-								if (m_LastWindowDropSize && (m_LastWindowDropSize >= m_WindowDropTargetSize))
-									m_WindowDropTargetSize += 1 - (1 / ((m_LastWindowDropSize + PREV_SPEED_KEEP_TIME_COEFF) / m_WindowDropTargetSize)); // some magic here
-								else if (m_LastWindowDropSize && (m_LastWindowDropSize < m_WindowDropTargetSize))
-									m_WindowDropTargetSize += (m_WindowDropTargetSize - (m_LastWindowDropSize - PREV_SPEED_KEEP_TIME_COEFF)) / m_WindowDropTargetSize; // some magic here
-								else
-									m_WindowDropTargetSize += (m_WindowDropTargetSize - (1 - PREV_SPEED_KEEP_TIME_COEFF)) / m_WindowDropTargetSize;
-								if (m_WindowDropTargetSize > m_MaxWindowSize) m_WindowDropTargetSize = m_MaxWindowSize;
-								m_WindowIncCounter--;
-								if (m_WindowDropTargetSize >= maxWinSize)
-								{
-									m_WindowDropTargetSize = maxWinSize;
-									break;
-								}
-							}
-							else
-							{
-								if (m_LastWindowDropSize && (m_LastWindowDropSize >= m_WindowSize))
-									m_WindowSize += 1 - (1 / ((m_LastWindowDropSize + PREV_SPEED_KEEP_TIME_COEFF) / m_WindowSize)); // some magic here
-								else if (m_LastWindowDropSize && (m_LastWindowDropSize < m_WindowSize))
-									m_WindowSize += (m_WindowSize - (m_LastWindowDropSize - PREV_SPEED_KEEP_TIME_COEFF)) / m_WindowSize; // some magic here
-								else
-									m_WindowSize += (m_WindowSize - (1 - PREV_SPEED_KEEP_TIME_COEFF)) / m_WindowSize;
-								if (m_WindowSize > m_MaxWindowSize) m_WindowSize = m_MaxWindowSize;
-								m_WindowIncCounter--;
-								if (m_WindowSize >= maxWinSize)
-								{
-									m_WindowSize = maxWinSize;
-									break;
-								}
-							}
-						}
-						else
-							break;
-					}
-					UpdatePacingTime ();
-				}
-				m_LastWindowIncTime = ts;
+				m_CongestionControl->OnSendTime (m_NumPacketsToSend, GetRTTEstimate (), m_SendBuffer.IsEmpty (), ts);
 				if (m_IsNAcked || m_IsResendNeeded || m_IsClientChoked || m_IsClientChoked2) // resend packets
 					ResendPacket ();
-				else if (m_WindowSize > int(m_SentPackets.size ())) // send packets
+				else if (m_CongestionControl->GetWindowSize () > int(m_SentPackets.GetSize ())) // send packets
 					SendBuffer ();
 			}
 			else // pass
@@ -1720,6 +1980,7 @@ namespace stream
 					else
 						it->resent = false;
 					it->sendTime = ts;
+					m_CongestionControl->OnPacketSent (it, m_SentPackets.GetSize (), ts);
 					packets.push_back (it);
 					if ((int)packets.size () >= m_NumPacketsToSend) break;
 				}
@@ -1736,6 +1997,7 @@ namespace stream
 					else
 						it->resent = false;
 					it->sendTime = ts;
+					m_CongestionControl->OnPacketSent (it, m_SentPackets.GetSize (), ts);
 					packets.push_back (it);
 					if (m_IsClientChoked2 && it->GetSeqn () == m_DropWindowDelaySequenceNumber)
 						m_IsClientChoked2 = false;
@@ -1747,41 +2009,29 @@ namespace stream
 		// select tunnels if necessary and send
 		if (packets.size () > 0 && m_IsSendTime)
 		{
+			g_ResentPacketsMetric.Inc (packets.size ());
 			if (m_IsNAcked) m_NumResendAttempts = 1;
 			else if (m_IsTimeOutResend) m_NumResendAttempts++;
 			if (m_NumResendAttempts == 1 && m_RTO != INITIAL_RTO)
 			{
 				// loss-based CC
-				if (!m_IsWinDropped && LOSS_BASED_CONTROL_ENABLED && !m_IsClientChoked)
+				if (!m_IsClientChoked)
 				{
-					LogPrint (eLogDebug, "Streaming: Packet loss, reduce window size");
-					if (m_WindowDropTargetSize)
-						m_LastWindowDropSize = m_WindowDropTargetSize;
-					else
-						m_LastWindowDropSize = m_WindowSize;
-					m_WindowDropTargetSize = m_LastWindowDropSize * 0.5; // -50% to drain queue
-					if (m_WindowDropTargetSize < MIN_WINDOW_SIZE)
-						m_WindowDropTargetSize = MIN_WINDOW_SIZE;
-					m_WindowIncCounter = 0; // disable window growth
-					m_DropWindowDelaySequenceNumber = m_SequenceNumber + int(m_WindowDropTargetSize);
-					m_IsFirstACK = true; // ignore first RTT sample
-					m_IsWinDropped = true; // don't drop window twice
-					UpdatePacingTime ();
+					bool isWinDropped = m_CongestionControl->IsWindowDropped ();
+					m_CongestionControl->OnLoss (m_SequenceNumber, m_SentPackets.GetSize (), ts);
+					if (!isWinDropped && m_CongestionControl->IsWindowDropped ())
+						m_IsFirstACK = true; // ignore first RTT sample
 				}
 			}
 			else if (m_IsTimeOutResend)
 			{
 				m_RTO = INITIAL_RTO; // drop RTO to initial upon tunnels pair change
-				m_WindowDropTargetSize = INITIAL_WINDOW_SIZE;
-				m_LastWindowDropSize = 0;
-				m_WindowIncCounter = 0;
-				m_IsWinDropped = true;
 				m_IsFirstRttSample = true;
 				m_DropWindowDelaySequenceNumber = 0;
 				m_IsFirstACK = true;
 				m_LastACKRecieveTime = 0;
 				m_ACKRecieveInterval = m_AckDelay;
-				UpdatePacingTime ();
+				m_CongestionControl->OnTimeout ();
 				if (m_RoutingSession) m_RoutingSession->SetSharedRoutingPath (nullptr);
 				if (m_NumResendAttempts & 1)
 				{
@@ -1982,53 +2232,13 @@ namespace stream
 			m_RoutingSession->SetSharedRoutingPath (nullptr); // TODO: count failures
 	}	
 
-	void Stream::UpdatePacingTime ()
-	{
-		double rtt = m_MinRTT + m_Jitter*2;
-		if (m_WindowDropTargetSize)
-			m_PacingTime = std::round (rtt*1000/m_WindowDropTargetSize);
-		else
-			m_PacingTime = std::round (rtt*1000/m_WindowSize);
-		if (m_MinPacingTime && m_PacingTime < m_MinPacingTime)
-			m_PacingTime = m_MinPacingTime;
-	}	
-
-	void Stream::ProcessWindowDrop ()
-	{
-		if (m_WindowDropTargetSize)
-			m_LastWindowDropSize = m_WindowDropTargetSize * ((m_MinRTT + m_Jitter*4) / m_FastRTT);
-		else
-			m_LastWindowDropSize = m_WindowSize * ((m_MinRTT + m_Jitter*4) / m_FastRTT);
-		m_WindowDropTargetSize = m_LastWindowDropSize * 0.5; // -50% to drain queue
-		if (m_WindowDropTargetSize < MIN_WINDOW_SIZE)
-			m_WindowDropTargetSize = MIN_WINDOW_SIZE;
-		m_WindowIncCounter = 0; // disable window growth
-		m_DropWindowDelaySequenceNumber = m_SequenceNumber + int(m_WindowDropTargetSize);
-		m_IsFirstACK = true; // ignore first RTT sample
-		m_IsWinDropped = true; // don't drop window twice
-		UpdatePacingTime ();
-	}
-
 	void Stream::ResetWindowSize ()
 	{
 		m_RTO = INITIAL_RTO;
-		if (!m_IsClientChoked)
-		{
-			if (m_WindowSize > INITIAL_WINDOW_SIZE)
-			{
-				m_WindowDropTargetSize = (float)INITIAL_WINDOW_SIZE;
-				m_IsWinDropped = true;
-			}
-			else
-				m_WindowSize = INITIAL_WINDOW_SIZE;
-		}
-		m_LastWindowDropSize = 0;
 		m_IsFirstRttSample = true;
 		m_IsFirstACK = true;
-		m_WindowIncCounter = 0; // disable window growth
-		m_DropWindowDelaySequenceNumber = m_SequenceNumber - int(m_SentPackets.size ()) + INITIAL_WINDOW_SIZE;
-		m_IsWinDropped = true; // don't drop window twice
-		UpdatePacingTime ();
+		m_DropWindowDelaySequenceNumber = m_SequenceNumber - int(m_SentPackets.GetSize ()) + INITIAL_WINDOW_SIZE;
+		m_CongestionControl->OnPathChange (m_SequenceNumber, m_SentPackets.GetSize (), m_IsClientChoked);
 	}
 
 	void Stream::CancelRemoteLeaseChange ()
@@ -2214,6 +2424,7 @@ namespace stream
 	std::shared_ptr<Stream> StreamingDestination::CreateNewOutgoingStream (std::shared_ptr<const i2p::data::LeaseSet> remote, int port)
 	{
 		auto s = std::make_shared<Stream> (m_Owner->GetService (), *this, remote, port);
+		g_OutgoingStreamsMetric.Inc ();
 		std::unique_lock<std::mutex> l(m_StreamsMutex);
 		m_Streams.emplace (s->GetRecvStreamID (), s);
 		return s;
@@ -2228,6 +2439,7 @@ namespace stream
 	std::shared_ptr<Stream> StreamingDestination::CreateNewIncomingStream (uint32_t receiveStreamID)
 	{
 		auto s = std::make_shared<Stream> (m_Owner->GetService (), *this);
+		g_IncomingStreamsMetric.Inc ();
 		std::unique_lock<std::mutex> l(m_StreamsMutex);
 		m_Streams.emplace (s->GetRecvStreamID (), s);
 		m_IncomingStreams.emplace (receiveStreamID, s);
@@ -1,5 +1,5 @@
 /*
-* Copyright (c) 2013-2025, The PurpleI2P Project
+* Copyright (c) 2013-2026, The PurpleI2P Project
 *
 * This file is part of Purple i2pd project and licensed under BSD3
 *
@@ -12,6 +12,7 @@
 #include <inttypes.h>
 #include <string>
 #include <unordered_map>
+#include <vector>
 #include <set>
 #include <queue>
 #include <functional>
@@ -25,6 +26,7 @@
 #include "LeaseSet.h"
 #include "I2NPProtocol.h"
 #include "Garlic.h"
+#include "BBR.h"
 #include "Tunnel.h"
 #include "util.h" // MemoryPool
 #include "ECIESX25519AEADRatchetSession.h"
@@ -92,6 +94,7 @@ namespace stream
 		uint64_t sendTime;
 		bool resent;
 		i2p::garlic::ECIESX25519AEADRatchetSession * from;
+		i2p::util::BBRDeliveryState deliveryState; // for delivery rate, set by congestion control
 
 		Packet (): len (0), offset (0), sendTime (0), resent (false), from (nullptr) {};
 		uint8_t * GetBuffer () { return buf + offset; };
@@ -115,14 +118,121 @@ namespace stream
 		bool IsEcho () const { return GetFlags () & PACKET_FLAG_ECHO; };
 	};
 
-	struct PacketCmp
+	typedef i2p::util::SequenceWindow<Packet> PacketWindow; // by sequence number
+
+	enum CongestionControlType
 	{
-		bool operator() (const Packet * p1, const Packet * p2) const
-		{
-			return p1->GetSeqn () < p2->GetSeqn ();
-		};
+		eCongestionControlDelay = 0, // window drop on RTT growth
+		eCongestionControlBBR // delivery rate and min RTT model
+	};
+
+	struct StreamRTT // estimated by stream, in milliseconds
+	{
+		double rtt, minRTT, slowRTT, fastRTT, jitter;
+	};
+
+	struct StreamAck
+	{
+		uint64_t ts; // in milliseconds
+		int rttSample; // negative if no sample
+		int numAcked, numInFlight; // in packets
+		uint32_t ackThrough, sequenceNumber;
+		bool isFirstACK, isBufferEmpty, isClientChoked;
+	};
+
+	class CongestionControl
+	{
+		public:
+
+			CongestionControl (int maxWindowSize, uint64_t minPacingTime):
+				m_MaxWindowSize (maxWindowSize), m_MinPacingTime (minPacingTime) {};
+			virtual ~CongestionControl () {};
+
+			void SetMaxWindowSize (int maxWindowSize) { m_MaxWindowSize = maxWindowSize; };
+			virtual float GetWindowSize () const = 0; // in packets
+			virtual uint64_t GetPacingTime () const = 0; // between packets, in microseconds
+			virtual bool IsWindowDropped () const { return false; }; // RTT samples don't reflect the path yet
+
+			virtual void OnPacketSent (Packet * packet, int numInFlight, uint64_t ts) {};
+			virtual void OnPacketAcked (const Packet * packet, uint64_t ts) {};
+			virtual void OnAck (const StreamRTT& rtt, const StreamAck& ack) = 0; // after acked packets
+			virtual void OnSendTime (int numPackets, const StreamRTT& rtt, bool isBufferEmpty, uint64_t ts) {};
+			virtual void OnLoss (uint32_t sequenceNumber, int numInFlight, uint64_t ts) {}; // NACK
+			virtual void OnTimeout () = 0; // no ACKs in RTO, tunnels are being changed
+			virtual void OnPathChange (uint32_t sequenceNumber, int numInFlight, bool isClientChoked) = 0; // another remote lease
+			virtual void OnChoke (uint32_t sequenceNumber) = 0; // remote is overloaded
+
+		protected:
+
+			int m_MaxWindowSize;
+			uint64_t m_MinPacingTime;
+	};
+
+	class DelayCongestionControl: public CongestionControl
+	{
+		public:
+
+			DelayCongestionControl (int maxWindowSize, uint64_t minPacingTime);
+
+			float GetWindowSize () const override { return m_WindowSize; };
+			uint64_t GetPacingTime () const override { return m_PacingTime; };
+			bool IsWindowDropped () const override { return m_IsWinDropped; };
+
+			void OnAck (const StreamRTT& rtt, const StreamAck& ack) override;
+			void OnSendTime (int numPackets, const StreamRTT& rtt, bool isBufferEmpty, uint64_t ts) override;
+			void OnLoss (uint32_t sequenceNumber, int numInFlight, uint64_t ts) override;
+			void OnTimeout () override;
+			void OnPathChange (uint32_t sequenceNumber, int numInFlight, bool isClientChoked) override;
+			void OnChoke (uint32_t sequenceNumber) override;
+
+		private:
+
+			void UpdatePacingTime ();
+			void ProcessWindowDrop (uint32_t sequenceNumber);
+
+		private:
+
+			StreamRTT m_RTT; // last known
+			float m_WindowSize, m_LastWindowDropSize, m_WindowDropTargetSize;
+			int m_WindowIncCounter;
+			uint32_t m_DropWindowDelaySequenceNumber;
+			bool m_IsWinDropped;
+			uint64_t m_PacingTime, m_LastWindowIncTime;
+	};
+
+	class BBRCongestionControl: public CongestionControl
+	{
+		public:
+
+			BBRCongestionControl (int maxWindowSize, uint64_t minPacingTime);
+
+			float GetWindowSize () const override { return m_Model.GetWindow (); };
+			uint64_t GetPacingTime () const override { return m_PacingTime; };
+
+			void OnPacketSent (Packet * packet, int numInFlight, uint64_t ts) override;
+			void OnPacketAcked (const Packet * packet, uint64_t ts) override;
+			void OnAck (const StreamRTT& rtt, const StreamAck& ack) override;
+			void OnLoss (uint32_t sequenceNumber, int numInFlight, uint64_t ts) override;
+			void OnTimeout () override { Reset (); };
+			void OnPathChange (uint32_t sequenceNumber, int numInFlight, bool isClientChoked) override { Reset (); };
+			void OnChoke (uint32_t sequenceNumber) override;
+
+			double GetBandwidth () const { return m_Model.GetBandwidth (); }; // max delivery rate, packets per millisecond
+			double GetMinRTT () const { return m_Model.GetMinRTT (); };
+
+		private:
+
+			void Reset ();
+
+		private:
+
+			i2p::util::BBRModel m_Model; // in packets
+			uint64_t m_PacingTime;
 	};
 
+	std::unique_ptr<CongestionControl> CreateCongestionControl (CongestionControlType type,
+		int maxWindowSize, uint64_t minPacingTime);
+
 	typedef std::function<void (const boost::system::error_code& ecode)> SendHandler;
 	struct SendBuffer
 	{
@@ -170,6 +280,18 @@ namespace stream
 			size_t m_Size;
 	};
 
+	class Stream;
+	struct ReceivedPayload // in-order packets taken from receive queue, written to socket without copy
+	{
+		std::shared_ptr<Stream> stream; // packets are returned to it on destruction
+		std::vector<Packet *> packets;
+		std::vector<boost::asio::const_buffer> buffers; // payloads
+		size_t size = 0;
+
+		~ReceivedPayload ();
+	};
+	typedef std::function<void (const boost::system::error_code& ecode, std::shared_ptr<ReceivedPayload> payload)> ReceivePayloadHandler;
+
 	enum StreamStatus
 	{
 		eStreamStatusNew = 0,
@@ -211,6 +333,9 @@ namespace stream
 			void AsyncReceive (const Buffer& buffer, ReceiveHandler handler, int timeout = 0);
 			size_t ReadSome (uint8_t * buf, size_t len) { return ConcatenatePackets (buf, len); };
 			size_t Receive (uint8_t * buf, size_t len, int timeout);
+			void AsyncReceivePayload (size_t maxLen, ReceivePayloadHandler handler, int timeout = 0);
+			std::shared_ptr<ReceivedPayload> ReadPayload (size_t maxLen); // nullptr if nothing received
+			void ReleasePackets (std::vector<Packet *>&& packets); // can be called from any thread
 
 			void AsyncClose() { boost::asio::post(m_Service, std::bind(&Stream::Close, shared_from_this())); };
 
@@ -220,10 +345,10 @@ namespace stream
 
 			size_t GetNumSentBytes () const { return m_NumSentBytes; };
 			size_t GetNumReceivedBytes () const { return m_NumReceivedBytes; };
-			size_t GetSendQueueSize () const { return m_SentPackets.size (); };
+			size_t GetSendQueueSize () const { return m_SentPackets.GetSize (); };
 			size_t GetReceiveQueueSize () const { return m_ReceiveQueue.size (); };
 			size_t GetSendBufferSize () const { return m_SendBuffer.GetSize (); };
-			int GetWindowSize () const { return m_WindowSize; };
+			int GetWindowSize () const { return m_CongestionControl->GetWindowSize (); };
 			int GetRTT () const { return m_RTT; };
 
 			void Terminate (bool deleteFromDestination = true);
@@ -249,6 +374,7 @@ namespace stream
 
 			template<typename Buffer, typename ReceiveHandler>
 			void HandleReceiveTimer (const boost::system::error_code& ecode, Buffer& buffer, ReceiveHandler handler, int remainingTimeout);
+			void HandleReceivePayloadTimer (const boost::system::error_code& ecode, size_t maxLen, ReceivePayloadHandler handler, int remainingTimeout);
 
 			void ScheduleSend ();
 			void HandleSendTimer (const boost::system::error_code& ecode);
@@ -258,8 +384,7 @@ namespace stream
 			void ScheduleAck (int timeout);
 			void HandleAckSendTimer (const boost::system::error_code& ecode);
 
-			void UpdatePacingTime ();
-			void ProcessWindowDrop ();
+			StreamRTT GetRTTEstimate () const { return StreamRTT{ m_RTT, m_MinRTT, m_SlowRTT, m_FastRTT, m_Jitter }; };
 			void ResetWindowSize ();
 			void CancelRemoteLeaseChange ();
 			
@@ -274,7 +399,7 @@ namespace stream
 			int32_t m_LastConfirmedReceivedSequenceNumber; // for limit inbound speed
 			StreamStatus m_Status;
 			bool m_IsIncoming, m_IsAckSendScheduled, m_IsNAcked, m_IsFirstACK, m_IsResendNeeded,
-				m_IsFirstRttSample, m_IsSendTime, m_IsWinDropped, m_IsChoking2, m_IsClientChoked,
+				m_IsFirstRttSample, m_IsSendTime, m_IsChoking2, m_IsClientChoked,
 				m_IsClientChoked2, m_IsTimeOutResend, m_IsImmediateAckRequested,
 				m_IsRemoteLeaseChangeInProgress, m_IsBufferEmpty, m_IsJavaClient, m_DontSign;
 			StreamingDestination& m_LocalDestination;
@@ -286,20 +411,21 @@ namespace stream
 			std::shared_ptr<const i2p::data::Lease> m_NextRemoteLease;
 			std::shared_ptr<i2p::tunnel::OutboundTunnel> m_CurrentOutboundTunnel;
 			std::queue<Packet *> m_ReceiveQueue;
-			std::set<Packet *, PacketCmp> m_SavedPackets;
-			std::set<Packet *, PacketCmp> m_SentPackets;
-			std::set<Packet *, PacketCmp> m_NACKedPackets;
+			PacketWindow m_SavedPackets; // out of order received
+			PacketWindow m_SentPackets; // not acked yet
+			PacketWindow m_NACKedPackets; // subset of sent, from last ACK
 			boost::asio::deadline_timer m_ReceiveTimer, m_SendTimer, m_ResendTimer, m_AckSendTimer;
 			size_t m_NumSentBytes, m_NumReceivedBytes;
 			uint16_t m_Port;
 
 			SendBufferQueue m_SendBuffer;
+			std::unique_ptr<CongestionControl> m_CongestionControl;
 			double m_RTT, m_MinRTT, m_SlowRTT, m_FastRTT;
-			float m_WindowSize, m_MaxWindowSize, m_LastWindowDropSize, m_WindowDropTargetSize;
-			int m_WindowIncCounter, m_RTO, m_AckDelay, m_PrevRTTSample;
+			float m_MaxWindowSize;
+			int m_RTO, m_AckDelay, m_PrevRTTSample;
 			double m_Jitter;
-			uint64_t m_MinPacingTime, m_PacingTime, m_PacingTimeRem, // microseconds
-				m_LastSendTime, m_LastACKRecieveTime, m_ACKRecieveInterval, m_RemoteLeaseChangeTime, m_LastWindowIncTime, m_LastACKRequestTime;	// milliseconds
+			uint64_t m_PacingTimeRem, // microseconds
+				m_LastSendTime, m_LastACKRecieveTime, m_ACKRecieveInterval, m_RemoteLeaseChangeTime, m_LastACKRequestTime;	// milliseconds
 			uint64_t m_LastACKSendTime, m_PacketACKInterval, m_PacketACKIntervalRem; // for limit inbound speed
 			int m_NumResendAttempts, m_NumPacketsToSend;
 			uint64_t m_JitterAccum;
@@ -7,6 +7,7 @@
 */
 
 #include <string.h>
+#include <deque>
 #include "I2PEndian.h"
 #include "Crypto.h"
 #include "Log.h"
@@ -18,6 +19,7 @@
 #include "ECIESX25519AEADRatchetSession.h"
 #include "Tunnel.h"
 #include "Transports.h"
+#include "Metrics.h"
 #include "TransitTunnel.h"
 
 namespace i2p
@@ -43,6 +45,27 @@ namespace tunnel
 		i2p::transport::transports.UpdateTotalTransitTransmittedBytes (TUNNEL_DATA_MSG_SIZE);
 	}
 
+	void TransitTunnel::EncryptTunnelMsgs (const std::vector<std::shared_ptr<const I2NPMessage> >& in,
+		const std::vector<std::shared_ptr<I2NPMessage> >& out)
+	{
+		size_t num = std::min (in.size (), out.size ());
+		if (!num) return;
+		if (!m_Encryption)
+		{
+			m_Encryption.reset (new i2p::crypto::TunnelEncryption);
+			m_Encryption->SetKeys (m_LayerKey, m_IVKey);
+		}
+		std::vector<const uint8_t *> inPayloads (num);
+		std::vector<uint8_t *> outPayloads (num);
+		for (size_t i = 0; i < num; i++)
+		{
+			inPayloads[i] = in[i]->GetPayload () + 4;
+			outPayloads[i] = out[i]->GetPayload () + 4;
+		}
+		m_Encryption->Encrypt (inPayloads.data (), outPayloads.data (), num);
+		i2p::transport::transports.UpdateTotalTransitTransmittedBytes (num*TUNNEL_DATA_MSG_SIZE);
+	}
+
 	std::string TransitTunnel::GetNextPeerName () const
 	{
 		return i2p::data::GetIdentHashAbbreviation (GetNextIdentHash ());
@@ -64,13 +87,6 @@ namespace tunnel
 
 	void TransitTunnelParticipant::HandleTunnelDataMsg (std::shared_ptr<i2p::I2NPMessage>&& tunnelMsg)
 	{
-		EncryptTunnelMsg (tunnelMsg, tunnelMsg);
-
-		m_NumTransmittedBytes += tunnelMsg->GetLength ();
-		htobe32buf (tunnelMsg->GetPayload (), GetNextTunnelID ());
-		// update header, expiration and size remain the same
-		tunnelMsg->SetMsgID (i2p::tunnel::tunnels.GetRng ()()); // assign new msgID
-		tunnelMsg->UpdateChks (); // new checksum TODO: remove later
 		m_TunnelDataMsgs.push_back (tunnelMsg);
 	}
 
@@ -78,6 +94,18 @@ namespace tunnel
 	{
 		if (!m_TunnelDataMsgs.empty ())
 		{
+			// encrypt all messages at once
+			std::vector<std::shared_ptr<const I2NPMessage> > in (m_TunnelDataMsgs.begin (), m_TunnelDataMsgs.end ());
+			std::vector<std::shared_ptr<I2NPMessage> > out (m_TunnelDataMsgs.begin (), m_TunnelDataMsgs.end ());
+			EncryptTunnelMsgs (in, out);
+			for (auto& tunnelMsg: m_TunnelDataMsgs)
+			{
+				m_NumTransmittedBytes += tunnelMsg->GetLength ();
+				htobe32buf (tunnelMsg->GetPayload (), GetNextTunnelID ());
+				// update header, expiration and size remain the same
+				tunnelMsg->SetMsgID (i2p::tunnel::tunnels.GetRng ()()); // assign new msgID
+				tunnelMsg->UpdateChks (); // new checksum TODO: remove later
+			}
 			auto num = m_TunnelDataMsgs.size ();
 			if (num > 1)
 				LogPrint (eLogDebug, "TransitTunnel: ", GetTunnelID (), "->", GetNextTunnelID (), " ", num);
@@ -197,8 +225,40 @@ namespace tunnel
 		}
 	}
 
+	static thread_local std::shared_ptr<i2p::crypto::CryptoKeyDecryptor> g_TunnelDecryptor; // TBM and build threads
+
+	static i2p::crypto::CryptoKeyDecryptor& GetTunnelDecryptor ()
+	{
+		if (!g_TunnelDecryptor) g_TunnelDecryptor = i2p::context.CreateTunnelDecryptor ();
+		return *g_TunnelDecryptor;
+	}
+
+	static auto& g_QueueLatencyMetric = i2p::metrics::GetRegistry ().GetHistogram ("transit_build_queue_latency_microseconds",
+		"Time tunnel build message waits in TBM queue", i2p::metrics::METRICS_MICROSECONDS_BUCKETS);
+	static auto& g_DecryptionLatencyMetric = i2p::metrics::GetRegistry ().GetHistogram ("transit_build_stage_latency_microseconds",
+		"Time of tunnel build messages batch processing stage", i2p::metrics::METRICS_MICROSECONDS_BUCKETS, "stage=\"decryption\"");
+	static auto& g_AdmissionLatencyMetric = i2p::metrics::GetRegistry ().GetHistogram ("transit_build_stage_latency_microseconds",
+		"Time of tunnel build messages batch processing stage", i2p::metrics::METRICS_MICROSECONDS_BUCKETS, "stage=\"admission\"");
+	static auto& g_ReplyLatencyMetric = i2p::metrics::GetRegistry ().GetHistogram ("transit_build_stage_latency_microseconds",
+		"Time of tunnel build messages batch processing stage", i2p::metrics::METRICS_MICROSECONDS_BUCKETS, "stage=\"reply\"");
+	static auto& g_AcceptedRequestsMetric = i2p::metrics::GetRegistry ().GetCounter ("transit_build_requests_total",
+		"Transit tunnel build requests", "result=\"accepted\"");
+	static auto& g_DeclinedRequestsMetric = i2p::metrics::GetRegistry ().GetCounter ("transit_build_requests_total",
+		"Transit tunnel build requests", "result=\"declined\"");
+
+	static void UpdateLatency (std::atomic<double>& latency, i2p::metrics::Histogram& metric, uint64_t t)
+	{
+		// single writer
+		latency.store ((1 - TRANSIT_TUNNELS_LATENCY_SMOOTHING_CONSTANT)*latency.load (std::memory_order_relaxed) +
+			TRANSIT_TUNNELS_LATENCY_SMOOTHING_CONSTANT*t, std::memory_order_relaxed);
+		metric.Observe (t);
+	}
+
 	TransitTunnels::TransitTunnels ():
-		m_IsRunning (false), m_Rng(i2p::util::GetMonotonicMicroseconds ()%1000000LL)
+		m_IsRunning (false), m_Rng(i2p::util::GetMonotonicMicroseconds ()%1000000LL),
+		m_NumBuildThreads (0), m_BuildStageNum (0), m_NumActiveBuildThreads (0), m_BuildStageRequests (nullptr),
+		m_NextBuildStageRequest (0), m_NumCompletedBuildStageRequests (0),
+		m_QueueLatency (0), m_DecryptionLatency (0), m_AdmissionLatency (0), m_ReplyLatency (0)
 	{
 	}
 		
@@ -210,6 +270,10 @@ namespace tunnel
 	void TransitTunnels::Start () 
 	{
 		m_IsRunning = true;
+		for (int i = 0; i < m_NumBuildThreads; i++)
+			m_BuildThreads.emplace_back (std::bind (&TransitTunnels::RunBuildThread, this, i));
+		if (m_NumBuildThreads)
+			LogPrint (eLogInfo, "TransitTunnel: Using ", m_NumBuildThreads, " tunnel build threads");
 		m_Thread.reset (new std::thread (std::bind (&TransitTunnels::Run, this)));
 	}
 		
@@ -222,14 +286,35 @@ namespace tunnel
 			m_Thread->join ();
 			m_Thread = nullptr;
 		}
+		if (!m_BuildThreads.empty ())
+		{
+			{
+				std::unique_lock<std::mutex> l(m_BuildStageMutex);
+				m_BuildStageStarted.notify_all ();
+			}
+			for (auto& it: m_BuildThreads)
+				it.join ();
+			m_BuildThreads.clear ();
+		}
 		m_TransitTunnels.clear ();
 	}	
 
+	void TransitTunnels::SetNumBuildThreads (int numBuildThreads)
+	{
+		if (numBuildThreads < 0) numBuildThreads = 0;
+		if (numBuildThreads > TRANSIT_TUNNELS_MAX_NUM_BUILD_THREADS) numBuildThreads = TRANSIT_TUNNELS_MAX_NUM_BUILD_THREADS;
+		if (m_BuildThreads.empty ())
+			m_NumBuildThreads = numBuildThreads;
+		else
+			LogPrint (eLogWarning, "TransitTunnel: Can't change number of tunnel build threads after start");
+	}
+
 	void TransitTunnels::Run () 
 	{
 		i2p::util::SetThreadName("TBM");
 		uint64_t lastTs = 0;
-		std::list<std::shared_ptr<I2NPMessage> > msgs;
+		std::deque<std::shared_ptr<I2NPMessage> > msgs;
+		std::vector<TransitTunnelBuildRequest> requests;
 		while (m_IsRunning)
 		{
 			try
@@ -237,24 +322,26 @@ namespace tunnel
 				if (m_TunnelBuildMsgQueue.Wait (TRANSIT_TUNNELS_QUEUE_WAIT_INTERVAL, 0))
 				{
 					m_TunnelBuildMsgQueue.GetWholeQueue (msgs);
-					while (!msgs.empty ())
+					auto mts = i2p::util::GetMonotonicMicroseconds ();
+					for (auto& it: msgs)
 					{
-						auto msg = msgs.front (); msgs.pop_front ();
-						if (!msg) continue;
-						uint8_t typeID = msg->GetTypeID ();
-						switch (typeID)
+						if (!it) continue;
+						uint8_t typeID = it->GetTypeID ();
+						if (typeID == eI2NPShortTunnelBuild || typeID == eI2NPVariableTunnelBuild)
 						{
-							case eI2NPShortTunnelBuild:
-								HandleShortTransitTunnelBuildMsg (std::move (msg));
-							break;	
-							case eI2NPVariableTunnelBuild:
-								HandleVariableTransitTunnelBuildMsg (std::move (msg));
-							break;	
-							default:
-								LogPrint (eLogWarning, "TransitTunnel: Unexpected message type ", (int) typeID);
+							UpdateLatency (m_QueueLatency, g_QueueLatencyMetric, mts - it->GetEnqueueTime ());
+							requests.emplace_back ();
+							requests.back ().msg = std::move (it);
 						}
-						if (!m_IsRunning) break;
-					}	
+						else
+							LogPrint (eLogWarning, "TransitTunnel: Unexpected message type ", (int) typeID);
+					}
+					msgs.clear ();
+					if (!requests.empty ())
+					{
+						HandleTunnelBuildMsgs (requests);
+						requests.clear ();
+					}
 				}	
 				if (m_IsRunning)
 				{
@@ -269,20 +356,129 @@ namespace tunnel
 			catch (std::exception& ex)
 			{
 				LogPrint (eLogError, "TransitTunnel: Runtime exception: ", ex.what ());
+				requests.clear ();
 			}
 		}
 	}
 
 	void TransitTunnels::PostTransitTunnelBuildMsg  (std::shared_ptr<I2NPMessage>&& msg)
 	{
-		if (msg) m_TunnelBuildMsgQueue.Put (msg);
+		if (msg)
+		{
+			msg->SetEnqueueTime (i2p::util::GetMonotonicMicroseconds ());
+			m_TunnelBuildMsgQueue.Put (msg);
+		}
 	}	
-		
-	void TransitTunnels::HandleShortTransitTunnelBuildMsg (std::shared_ptr<I2NPMessage>&& msg)
+
+	void TransitTunnels::HandleTunnelBuildMsgs (std::vector<TransitTunnelBuildRequest>& requests)
+	{
+		// decrypt our records in parallel
+		auto mts = i2p::util::GetMonotonicMicroseconds ();
+		RunBuildStage (requests, [this](TransitTunnelBuildRequest& request)
+			{
+				if (request.msg->GetTypeID () == eI2NPShortTunnelBuild)
+					DecryptShortTunnelBuildRequest (request);
+				else
+					DecryptVariableTunnelBuildRequest (request);
+			});
+		auto mts1 = i2p::util::GetMonotonicMicroseconds ();
+		UpdateLatency (m_DecryptionLatency, g_DecryptionLatencyMetric, mts1 - mts);
+		// accept or decline one by one, in order of arrival
+		for (auto& it: requests)
+			if (it.isValid) AdmitTransitTunnel (it);
+		mts = i2p::util::GetMonotonicMicroseconds ();
+		UpdateLatency (m_AdmissionLatency, g_AdmissionLatencyMetric, mts - mts1);
+		// encrypt replies in parallel and send in order
+		RunBuildStage (requests, [this](TransitTunnelBuildRequest& request)
+			{
+				if (!request.isValid) return;
+				if (request.msg->GetTypeID () == eI2NPShortTunnelBuild)
+					CreateShortTunnelBuildReply (request);
+				else
+					CreateVariableTunnelBuildReply (request);
+			});
+		for (auto& it: requests)
+			if (it.replyMsg) SendTunnelBuildReply (it);
+		UpdateLatency (m_ReplyLatency, g_ReplyLatencyMetric, i2p::util::GetMonotonicMicroseconds () - mts);
+	}
+
+	void TransitTunnels::RunBuildStage (std::vector<TransitTunnelBuildRequest>& requests,
+		std::function<void (TransitTunnelBuildRequest&)> stage)
 	{
-		if (!msg) return;
-		uint8_t * buf = msg->GetPayload();
-		size_t len = msg->GetPayloadLength();
+		if (m_BuildThreads.empty () || requests.size () < 2)
+		{
+			for (auto& it: requests)
+				stage (it);
+			return;
+		}
+		{
+			std::unique_lock<std::mutex> l(m_BuildStageMutex);
+			// build threads might be still leaving previous stage
+			m_BuildStageCompleted.wait (l, [this]{ return !m_NumActiveBuildThreads; });
+			m_BuildStageRequests = &requests;
+			m_BuildStage = stage;
+			m_NextBuildStageRequest = 0;
+			m_NumCompletedBuildStageRequests = 0;
+			m_BuildStageNum++;
+			m_BuildStageStarted.notify_all ();
+		}
+		ProcessBuildStage ();
+		std::unique_lock<std::mutex> l(m_BuildStageMutex);
+		m_BuildStageCompleted.wait (l, [this, &requests]
+			{ return m_NumCompletedBuildStageRequests == requests.size () && !m_NumActiveBuildThreads; });
+		m_BuildStageRequests = nullptr;
+		m_BuildStage = nullptr;
+	}
+
+	void TransitTunnels::ProcessBuildStage ()
+	{
+		if (!m_BuildStageRequests) return; // stage is over already
+		auto& requests = *m_BuildStageRequests;
+		size_t num = 0;
+		for (auto i = m_NextBuildStageRequest++; i < requests.size (); i = m_NextBuildStageRequest++)
+		{
+			try
+			{
+				m_BuildStage (requests[i]);
+			}
+			catch (std::exception& ex)
+			{
+				LogPrint (eLogError, "TransitTunnel: Runtime exception in build stage: ", ex.what ());
+				requests[i].isValid = false;
+			}
+			num++;
+		}
+		if (num && m_NumCompletedBuildStageRequests.fetch_add (num) + num == requests.size ())
+		{
+			std::unique_lock<std::mutex> l(m_BuildStageMutex);
+			m_BuildStageCompleted.notify_all ();
+		}
+	}
+
+	void TransitTunnels::RunBuildThread (int index)
+	{
+		i2p::util::SetThreadName (("TBM" + std::to_string (index)).c_str ());
+		uint64_t stageNum = 0;
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex> l(m_BuildStageMutex);
+				m_BuildStageStarted.wait (l, [this, stageNum]{ return !m_IsRunning || m_BuildStageNum != stageNum; });
+				if (!m_IsRunning) break;
+				stageNum = m_BuildStageNum;
+				m_NumActiveBuildThreads++;
+			}
+			ProcessBuildStage ();
+			std::unique_lock<std::mutex> l(m_BuildStageMutex);
+			m_NumActiveBuildThreads--;
+			if (!m_NumActiveBuildThreads) m_BuildStageCompleted.notify_all ();
+		}
+	}
+
+	void TransitTunnels::DecryptShortTunnelBuildRequest (TransitTunnelBuildRequest& request)
+	{
+		uint8_t * buf = request.msg->GetPayload();
+		size_t len = request.msg->GetPayloadLength();
 		int num = buf[0];
 		LogPrint (eLogDebug, "TransitTunnel: ShortTunnelBuild ", num, " records");
 		if (num > i2p::tunnel::MAX_NUM_RECORDS)
@@ -302,7 +498,9 @@ namespace tunnel
 			{
 				LogPrint (eLogDebug, "TransitTunnel: Short request record ", i, " is ours");
 				uint8_t clearText[SHORT_REQUEST_RECORD_CLEAR_TEXT_SIZE];
-				if (!i2p::context.DecryptTunnelShortRequestRecord (record + SHORT_REQUEST_RECORD_ENCRYPTED_OFFSET, clearText))
+				auto& noiseState = request.noiseState;
+				if (!i2p::context.DecryptTunnelShortRequestRecord (record + SHORT_REQUEST_RECORD_ENCRYPTED_OFFSET, clearText,
+					noiseState, GetTunnelDecryptor ()))
 				{
 					LogPrint (eLogWarning, "TransitTunnel: Can't decrypt short request record ", i);
 					return;
@@ -312,18 +510,15 @@ namespace tunnel
 					LogPrint (eLogWarning, "TransitTunnel: Unknown layer encryption type ", clearText[SHORT_REQUEST_RECORD_LAYER_ENCRYPTION_TYPE], " in short request record");
 					return;
 				}
-				auto& noiseState = i2p::context.GetCurrentNoiseState ();
-				uint8_t replyKey[32]; // AEAD/Chacha20/Poly1305
-				i2p::crypto::AESKey layerKey, ivKey; // AES
 				i2p::crypto::HKDF (noiseState.m_CK, nullptr, 0, "SMTunnelReplyKey", noiseState.m_CK);
-				memcpy (replyKey, noiseState.m_CK + 32, 32);
+				memcpy (request.replyKey, noiseState.m_CK + 32, 32); // AEAD/Chacha20/Poly1305
 				i2p::crypto::HKDF (noiseState.m_CK, nullptr, 0, "SMTunnelLayerKey", noiseState.m_CK);
-				memcpy (layerKey, noiseState.m_CK + 32, 32);
-				bool isEndpoint = clearText[SHORT_REQUEST_RECORD_FLAG_OFFSET] & TUNNEL_BUILD_RECORD_ENDPOINT_FLAG;
-				if (isEndpoint)
+				memcpy (request.layerKey, noiseState.m_CK + 32, 32);
+				request.flag = clearText[SHORT_REQUEST_RECORD_FLAG_OFFSET];
+				if (request.IsEndpoint ())
 				{
 					i2p::crypto::HKDF (noiseState.m_CK, nullptr, 0, "TunnelLayerIVKey", noiseState.m_CK);
-					memcpy (ivKey, noiseState.m_CK + 32, 32);
+					memcpy (request.ivKey, noiseState.m_CK + 32, 32);
 				}
 				else
 				{	
@@ -332,259 +527,241 @@ namespace tunnel
 						LogPrint (eLogWarning, "TransitTunnel: Next ident is ours in short request record");
 						return;
 					}	
-					memcpy (ivKey, noiseState.m_CK , 32);
-				}	
-
-				// check if we accept this tunnel
-				std::shared_ptr<i2p::tunnel::TransitTunnel> transitTunnel;
-				uint8_t retCode = 0;
-				if (i2p::context.AcceptsTunnels ())
-				{
-					auto congestionLevel = i2p::context.GetCongestionLevel (false);
-					if (congestionLevel < CONGESTION_LEVEL_FULL)
-					{	
-						if (congestionLevel >= CONGESTION_LEVEL_MEDIUM)
-						{	
-							// random reject depending on congestion level
-							int level = m_Rng () % (CONGESTION_LEVEL_FULL - CONGESTION_LEVEL_MEDIUM) + CONGESTION_LEVEL_MEDIUM;
-							if (congestionLevel > level)
-								retCode = 30;
-						}	
-					}	
-					else
-						retCode = 30;
-				}	
-				else	
-					retCode = 30;
-				
-				if (!retCode)
-				{
-					i2p::data::IdentHash nextIdent(clearText + SHORT_REQUEST_RECORD_NEXT_IDENT_OFFSET);
-					bool isEndpoint = clearText[SHORT_REQUEST_RECORD_FLAG_OFFSET] & TUNNEL_BUILD_RECORD_ENDPOINT_FLAG;
-					if (isEndpoint || !i2p::data::IsRouterDuplicated (nextIdent))
-					{	
-						// create new transit tunnel
-						transitTunnel = CreateTransitTunnel (
-							bufbe32toh (clearText + SHORT_REQUEST_RECORD_RECEIVE_TUNNEL_OFFSET),
-							nextIdent,
-							bufbe32toh (clearText + SHORT_REQUEST_RECORD_NEXT_TUNNEL_OFFSET),
-							layerKey, ivKey,
-							clearText[SHORT_REQUEST_RECORD_FLAG_OFFSET] & TUNNEL_BUILD_RECORD_GATEWAY_FLAG,
-							isEndpoint);
-						if (!AddTransitTunnel (transitTunnel))
-							retCode = 30;
-					}
-					else
-						// decline tunnel going to duplicated router 
-						retCode = 30;
-				}
-
-				// encrypt reply
-				uint8_t nonce[12];
-				memset (nonce, 0, 12);
-				uint8_t * reply = buf + 1;
-				for (int j = 0; j < num; j++)
-				{
-					nonce[4] = j; // nonce is record #
-					if (j == i)
-					{
-						memset (reply + SHORT_RESPONSE_RECORD_OPTIONS_OFFSET, 0, 2); // no options
-						reply[SHORT_RESPONSE_RECORD_RET_OFFSET] = retCode;
-						if (!i2p::crypto::AEADChaCha20Poly1305 (reply, SHORT_TUNNEL_BUILD_RECORD_SIZE - 16,
-							noiseState.m_H, 32, replyKey, nonce, reply, SHORT_TUNNEL_BUILD_RECORD_SIZE, true)) // encrypt
-						{
-							LogPrint (eLogWarning, "TransitTunnel: Short reply AEAD encryption failed");
-							return;
-						}
-					}
-					else
-						i2p::crypto::ChaCha20 (reply, SHORT_TUNNEL_BUILD_RECORD_SIZE, replyKey, nonce, reply);
-					reply += SHORT_TUNNEL_BUILD_RECORD_SIZE;
-				}
-				// send reply
-				auto onDrop = [transitTunnel]()
-					{
-						if (transitTunnel)
-						{
-							LogPrint (eLogDebug, "TransitTunnel: Failed to send reply for transit tunnel ", transitTunnel->GetTunnelID ());
-							auto t = transitTunnel->GetCreationTime ();
-							if (t > i2p::tunnel::TUNNEL_EXPIRATION_TIMEOUT)
-								// make transit tunnel expired 
-								transitTunnel->SetCreationTime (t - i2p::tunnel::TUNNEL_EXPIRATION_TIMEOUT);
-						}	
-					};
-				if (isEndpoint)
-				{
-					auto replyMsg = NewI2NPShortMessage ();
-					replyMsg->Concat (buf, len);
-					replyMsg->FillI2NPMessageHeader (eI2NPShortTunnelBuildReply, bufbe32toh (clearText + SHORT_REQUEST_RECORD_SEND_MSG_ID_OFFSET));
-					if (transitTunnel) replyMsg->onDrop = onDrop;
-					if (memcmp ((const uint8_t *)i2p::context.GetIdentHash (),
-						clearText + SHORT_REQUEST_RECORD_NEXT_IDENT_OFFSET, 32)) // reply IBGW is not local?
-					{
-						i2p::crypto::HKDF (noiseState.m_CK, nullptr, 0, "RGarlicKeyAndTag", noiseState.m_CK);
-						uint64_t tag;
-						memcpy (&tag, noiseState.m_CK, 8);
-						// we send it to reply tunnel
-						i2p::transport::transports.SendMessage (clearText + SHORT_REQUEST_RECORD_NEXT_IDENT_OFFSET,
-						CreateTunnelGatewayMsg (bufbe32toh (clearText + SHORT_REQUEST_RECORD_NEXT_TUNNEL_OFFSET),
-							i2p::garlic::WrapECIESX25519Message (replyMsg, noiseState.m_CK + 32, tag)));
-					}
-					else
-					{
-						// IBGW is local
-						uint32_t tunnelID = bufbe32toh (clearText + SHORT_REQUEST_RECORD_NEXT_TUNNEL_OFFSET);
-						auto tunnel = i2p::tunnel::tunnels.GetTunnel (tunnelID);
-						if (tunnel)
-						{	
-							tunnel->SendTunnelDataMsg (replyMsg);
-							tunnel->FlushTunnelDataMsgs ();
-						}	
-						else
-							LogPrint (eLogWarning, "I2NP: Tunnel ", tunnelID, " not found for short tunnel build reply");
-					}
-				}
-				else
-				{
-					auto msg = CreateI2NPMessage (eI2NPShortTunnelBuild, buf, len,
-							bufbe32toh (clearText + SHORT_REQUEST_RECORD_SEND_MSG_ID_OFFSET));
-					if (transitTunnel) msg->onDrop = onDrop;
-					i2p::transport::transports.SendMessage (clearText + SHORT_REQUEST_RECORD_NEXT_IDENT_OFFSET, msg);
+					memcpy (request.ivKey, noiseState.m_CK , 32);
 				}	
+				request.receiveTunnelID = bufbe32toh (clearText + SHORT_REQUEST_RECORD_RECEIVE_TUNNEL_OFFSET);
+				request.nextTunnelID = bufbe32toh (clearText + SHORT_REQUEST_RECORD_NEXT_TUNNEL_OFFSET);
+				request.nextIdent = i2p::data::IdentHash (clearText + SHORT_REQUEST_RECORD_NEXT_IDENT_OFFSET);
+				request.sendMsgID = bufbe32toh (clearText + SHORT_REQUEST_RECORD_SEND_MSG_ID_OFFSET);
+				request.recordIndex = i;
+				request.isValid = true;
 				return;
 			}
 			record += SHORT_TUNNEL_BUILD_RECORD_SIZE;
 		}
 	}	
-		
-	bool TransitTunnels::HandleBuildRequestRecords (int num, uint8_t * records, uint8_t * clearText)
+
+	void TransitTunnels::DecryptVariableTunnelBuildRequest (TransitTunnelBuildRequest& request)
 	{
+		uint8_t * buf = request.msg->GetPayload();
+		size_t len = request.msg->GetPayloadLength();
+		int num = buf[0];
+		LogPrint (eLogDebug, "TransitTunnel: VariableTunnelBuild ", num, " records");
+		if (num > i2p::tunnel::MAX_NUM_RECORDS)
+		{
+			LogPrint (eLogError, "TransitTunnle: Too many records in VaribleTunnelBuild message ", num);
+			return;
+		}
+		if (len < num*TUNNEL_BUILD_RECORD_SIZE + 1)
+		{
+			LogPrint (eLogError, "TransitTunnel: VaribleTunnelBuild message of ", num, " records is too short ", len);
+			return;
+		}
+		const uint8_t * records = buf + 1;
 		for (int i = 0; i < num; i++)
 		{
-			uint8_t * record = records + i*TUNNEL_BUILD_RECORD_SIZE;
+			const uint8_t * record = records + i*TUNNEL_BUILD_RECORD_SIZE;
 			if (!memcmp (record + BUILD_REQUEST_RECORD_TO_PEER_OFFSET, (const uint8_t *)i2p::context.GetRouterInfo ().GetIdentHash (), 16))
 			{
 				LogPrint (eLogDebug, "TransitTunnel: Build request record ", i, " is ours");
-				if (!i2p::context.DecryptTunnelBuildRecord (record + BUILD_REQUEST_RECORD_ENCRYPTED_OFFSET, clearText)) 
+				uint8_t clearText[ECIES_BUILD_REQUEST_RECORD_CLEAR_TEXT_SIZE];
+				if (!i2p::context.DecryptTunnelBuildRecord (record + BUILD_REQUEST_RECORD_ENCRYPTED_OFFSET, clearText,
+					request.noiseState, GetTunnelDecryptor ()))
 				{
 					LogPrint (eLogWarning, "TransitTunnel: Failed to decrypt tunnel build record");
-					return false;
+					return;
 				}	
+				request.flag = clearText[ECIES_BUILD_REQUEST_RECORD_FLAG_OFFSET];
 				if (!memcmp ((const uint8_t *)i2p::context.GetIdentHash (), clearText + ECIES_BUILD_REQUEST_RECORD_NEXT_IDENT_OFFSET, 32) && // if next ident is now ours
-				    !(clearText[ECIES_BUILD_REQUEST_RECORD_FLAG_OFFSET] & TUNNEL_BUILD_RECORD_ENDPOINT_FLAG)) // and not endpoint
+				    !request.IsEndpoint ()) // and not endpoint
 				{
 					LogPrint (eLogWarning, "TransitTunnel: Next ident is ours in tunnel build record");
-					return false;
-				}	
-				uint8_t retCode = 0;
-				// decide if we should accept tunnel
-				bool accept = i2p::context.AcceptsTunnels ();
-				if (accept)
-				{
-					auto congestionLevel = i2p::context.GetCongestionLevel (false);
-					if (congestionLevel >= CONGESTION_LEVEL_MEDIUM)
-					{	
-						if (congestionLevel < CONGESTION_LEVEL_FULL)
-						{
-							// random reject depending on congestion level
-							int level = m_Rng () % (CONGESTION_LEVEL_FULL - CONGESTION_LEVEL_MEDIUM) + CONGESTION_LEVEL_MEDIUM;
-							if (congestionLevel > level)
-								accept = false;
-						}	
-						else	
-							accept = false;
-					}	
+					return;
 				}	
-					
-				if (accept)
-				{
-					i2p::data::IdentHash nextIdent(clearText + ECIES_BUILD_REQUEST_RECORD_NEXT_IDENT_OFFSET);
-					bool isEndpoint = clearText[ECIES_BUILD_REQUEST_RECORD_FLAG_OFFSET] & TUNNEL_BUILD_RECORD_ENDPOINT_FLAG;
-					if (isEndpoint || !i2p::data::IsRouterDuplicated (nextIdent))
-					{	
-						auto transitTunnel = CreateTransitTunnel (
-								bufbe32toh (clearText + ECIES_BUILD_REQUEST_RECORD_RECEIVE_TUNNEL_OFFSET),
-								nextIdent,
-								bufbe32toh (clearText + ECIES_BUILD_REQUEST_RECORD_NEXT_TUNNEL_OFFSET),
-								clearText + ECIES_BUILD_REQUEST_RECORD_LAYER_KEY_OFFSET,
-								clearText + ECIES_BUILD_REQUEST_RECORD_IV_KEY_OFFSET,
-								clearText[ECIES_BUILD_REQUEST_RECORD_FLAG_OFFSET] & TUNNEL_BUILD_RECORD_GATEWAY_FLAG,
-								isEndpoint);
-						if (!AddTransitTunnel (transitTunnel))
-							retCode = 30;
-					}	
-					else
-						// decline tunnel going to duplicated router 
+				request.receiveTunnelID = bufbe32toh (clearText + ECIES_BUILD_REQUEST_RECORD_RECEIVE_TUNNEL_OFFSET);
+				request.nextTunnelID = bufbe32toh (clearText + ECIES_BUILD_REQUEST_RECORD_NEXT_TUNNEL_OFFSET);
+				request.nextIdent = i2p::data::IdentHash (clearText + ECIES_BUILD_REQUEST_RECORD_NEXT_IDENT_OFFSET);
+				request.sendMsgID = bufbe32toh (clearText + ECIES_BUILD_REQUEST_RECORD_SEND_MSG_ID_OFFSET);
+				memcpy (request.layerKey, clearText + ECIES_BUILD_REQUEST_RECORD_LAYER_KEY_OFFSET, 32);
+				memcpy (request.ivKey, clearText + ECIES_BUILD_REQUEST_RECORD_IV_KEY_OFFSET, 32);
+				memcpy (request.replyKey, clearText + ECIES_BUILD_REQUEST_RECORD_REPLY_KEY_OFFSET, 32);
+				memcpy (request.replyIV, clearText + ECIES_BUILD_REQUEST_RECORD_REPLY_IV_OFFSET, 16);
+				request.recordIndex = i;
+				request.isValid = true;
+				return;
+			}
+		}
+	}
+
+	void TransitTunnels::AdmitTransitTunnel (TransitTunnelBuildRequest& request)
+	{
+		// check if we accept this tunnel
+		uint8_t retCode = 0;
+		if (i2p::context.AcceptsTunnels ())
+		{
+			auto congestionLevel = i2p::context.GetCongestionLevel (false);
+			if (congestionLevel < CONGESTION_LEVEL_FULL)
+			{	
+				if (congestionLevel >= CONGESTION_LEVEL_MEDIUM)
+				{	
+					// random reject depending on congestion level
+					int level = m_Rng () % (CONGESTION_LEVEL_FULL - CONGESTION_LEVEL_MEDIUM) + CONGESTION_LEVEL_MEDIUM;
+					if (congestionLevel > level)
 						retCode = 30;
-				}
-				else
-					retCode = 30; // always reject with bandwidth reason (30)
-
-				// replace record to reply
-				memset (record + ECIES_BUILD_RESPONSE_RECORD_OPTIONS_OFFSET, 0, 2); // no options
-				record[ECIES_BUILD_RESPONSE_RECORD_RET_OFFSET] = retCode;
-				// encrypt reply
-				i2p::crypto::CBCEncryption encryption;
-				for (int j = 0; j < num; j++)
+				}	
+			}	
+			else
+				retCode = 30;
+		}	
+		else	
+			retCode = 30; // always reject with bandwidth reason (30)
+		
+		if (!retCode)
+		{
+			if (request.IsEndpoint () || !i2p::data::IsRouterDuplicated (request.nextIdent))
+			{	
+				// create new transit tunnel
+				request.transitTunnel = CreateTransitTunnel (request.receiveTunnelID, request.nextIdent, request.nextTunnelID,
+					request.layerKey, request.ivKey, request.IsGateway (), request.IsEndpoint ());
+				if (!AddTransitTunnel (request.transitTunnel))
 				{
-					uint8_t * reply = records + j*TUNNEL_BUILD_RECORD_SIZE;
-					if (j == i)
-					{
-						uint8_t nonce[12];
-						memset (nonce, 0, 12);
-						auto& noiseState = i2p::context.GetCurrentNoiseState ();
-						if (!i2p::crypto::AEADChaCha20Poly1305 (reply, TUNNEL_BUILD_RECORD_SIZE - 16,
-							noiseState.m_H, 32, noiseState.m_CK, nonce, reply, TUNNEL_BUILD_RECORD_SIZE, true)) // encrypt
-						{
-							LogPrint (eLogWarning, "TransitTunnel: Reply AEAD encryption failed");
-							return false;
-						}
-					}
-					else
-					{
-						encryption.SetKey (clearText + ECIES_BUILD_REQUEST_RECORD_REPLY_KEY_OFFSET);
-						encryption.Encrypt(reply, TUNNEL_BUILD_RECORD_SIZE, clearText + ECIES_BUILD_REQUEST_RECORD_REPLY_IV_OFFSET, reply);
-					}
+					request.transitTunnel = nullptr;
+					retCode = 30;
 				}
-				return true;
 			}
+			else
+				// decline tunnel going to duplicated router 
+				retCode = 30;
 		}
-		return false;
+		request.retCode = retCode;
+		if (retCode)
+			g_DeclinedRequestsMetric.Inc ();
+		else
+			g_AcceptedRequestsMetric.Inc ();
 	}
 
-	void TransitTunnels::HandleVariableTransitTunnelBuildMsg (std::shared_ptr<I2NPMessage>&& msg)
+	void TransitTunnels::CreateShortTunnelBuildReply (TransitTunnelBuildRequest& request)
 	{
-		if (!msg) return;
-		uint8_t * buf = msg->GetPayload();
-		size_t len = msg->GetPayloadLength();
+		uint8_t * buf = request.msg->GetPayload();
+		size_t len = request.msg->GetPayloadLength();
 		int num = buf[0];
-		LogPrint (eLogDebug, "TransitTunnel: VariableTunnelBuild ", num, " records");
-		if (num > i2p::tunnel::MAX_NUM_RECORDS)
+		auto& noiseState = request.noiseState;
+		// encrypt reply
+		uint8_t nonce[12];
+		memset (nonce, 0, 12);
+		uint8_t * reply = buf + 1;
+		for (int j = 0; j < num; j++)
 		{
-			LogPrint (eLogError, "TransitTunnle: Too many records in VaribleTunnelBuild message ", num);
-			return;
+			nonce[4] = j; // nonce is record #
+			if (j == request.recordIndex)
+			{
+				memset (reply + SHORT_RESPONSE_RECORD_OPTIONS_OFFSET, 0, 2); // no options
+				reply[SHORT_RESPONSE_RECORD_RET_OFFSET] = request.retCode;
+				if (!i2p::crypto::AEADChaCha20Poly1305 (reply, SHORT_TUNNEL_BUILD_RECORD_SIZE - 16,
+					noiseState.m_H, 32, request.replyKey, nonce, reply, SHORT_TUNNEL_BUILD_RECORD_SIZE, true)) // encrypt
+				{
+					LogPrint (eLogWarning, "TransitTunnel: Short reply AEAD encryption failed");
+					return;
+				}
+			}
+			else
+				i2p::crypto::ChaCha20 (reply, SHORT_TUNNEL_BUILD_RECORD_SIZE, request.replyKey, nonce, reply);
+			reply += SHORT_TUNNEL_BUILD_RECORD_SIZE;
 		}
-		if (len < num*TUNNEL_BUILD_RECORD_SIZE + 1)
+		// create reply
+		auto transitTunnel = request.transitTunnel;
+		auto onDrop = [transitTunnel]()
+			{
+				if (transitTunnel)
+				{
+					LogPrint (eLogDebug, "TransitTunnel: Failed to send reply for transit tunnel ", transitTunnel->GetTunnelID ());
+					auto t = transitTunnel->GetCreationTime ();
+					if (t > i2p::tunnel::TUNNEL_EXPIRATION_TIMEOUT)
+						// make transit tunnel expired 
+						transitTunnel->SetCreationTime (t - i2p::tunnel::TUNNEL_EXPIRATION_TIMEOUT);
+				}	
+			};
+		if (request.IsEndpoint ())
 		{
-			LogPrint (eLogError, "TransitTunnel: VaribleTunnelBuild message of ", num, " records is too short ", len);
-			return;
+			auto replyMsg = NewI2NPShortMessage ();
+			replyMsg->Concat (buf, len);
+			replyMsg->FillI2NPMessageHeader (eI2NPShortTunnelBuildReply, request.sendMsgID);
+			if (transitTunnel) replyMsg->onDrop = onDrop;
+			if (request.nextIdent != i2p::context.GetIdentHash ()) // reply IBGW is not local?
+			{
+				i2p::crypto::HKDF (noiseState.m_CK, nullptr, 0, "RGarlicKeyAndTag", noiseState.m_CK);
+				uint64_t tag;
+				memcpy (&tag, noiseState.m_CK, 8);
+				// we send it to reply tunnel
+				request.replyMsg = CreateTunnelGatewayMsg (request.nextTunnelID,
+					i2p::garlic::WrapECIESX25519Message (replyMsg, noiseState.m_CK + 32, tag));
+			}
+			else
+			{
+				// IBGW is local
+				request.replyMsg = replyMsg;
+				request.isReplyLocal = true;
+			}
+		}
+		else
+		{
+			request.replyMsg = CreateI2NPMessage (eI2NPShortTunnelBuild, buf, len, request.sendMsgID);
+			if (transitTunnel) request.replyMsg->onDrop = onDrop;
 		}
-		uint8_t clearText[ECIES_BUILD_REQUEST_RECORD_CLEAR_TEXT_SIZE];
-		if (HandleBuildRequestRecords (num, buf + 1, clearText))
+	}
+
+	void TransitTunnels::CreateVariableTunnelBuildReply (TransitTunnelBuildRequest& request)
+	{
+		uint8_t * buf = request.msg->GetPayload();
+		size_t len = request.msg->GetPayloadLength();
+		int num = buf[0];
+		uint8_t * records = buf + 1;
+		// replace record to reply
+		uint8_t * record = records + request.recordIndex*TUNNEL_BUILD_RECORD_SIZE;
+		memset (record + ECIES_BUILD_RESPONSE_RECORD_OPTIONS_OFFSET, 0, 2); // no options
+		record[ECIES_BUILD_RESPONSE_RECORD_RET_OFFSET] = request.retCode;
+		// encrypt reply
+		i2p::crypto::CBCEncryption encryption;
+		encryption.SetKey (request.replyKey);
+		for (int j = 0; j < num; j++)
 		{
-			if (clearText[ECIES_BUILD_REQUEST_RECORD_FLAG_OFFSET] & TUNNEL_BUILD_RECORD_ENDPOINT_FLAG) // we are endpoint of outboud tunnel
+			uint8_t * reply = records + j*TUNNEL_BUILD_RECORD_SIZE;
+			if (j == request.recordIndex)
 			{
-				// so we send it to reply tunnel
-				i2p::transport::transports.SendMessage (clearText + ECIES_BUILD_REQUEST_RECORD_NEXT_IDENT_OFFSET,
-					CreateTunnelGatewayMsg (bufbe32toh (clearText + ECIES_BUILD_REQUEST_RECORD_NEXT_TUNNEL_OFFSET),
-						eI2NPVariableTunnelBuildReply, buf, len,
-						bufbe32toh (clearText + ECIES_BUILD_REQUEST_RECORD_SEND_MSG_ID_OFFSET)));
+				uint8_t nonce[12];
+				memset (nonce, 0, 12);
+				if (!i2p::crypto::AEADChaCha20Poly1305 (reply, TUNNEL_BUILD_RECORD_SIZE - 16,
+					request.noiseState.m_H, 32, request.noiseState.m_CK, nonce, reply, TUNNEL_BUILD_RECORD_SIZE, true)) // encrypt
+				{
+					LogPrint (eLogWarning, "TransitTunnel: Reply AEAD encryption failed");
+					return;
+				}
 			}
 			else
-				i2p::transport::transports.SendMessage (clearText + ECIES_BUILD_REQUEST_RECORD_NEXT_IDENT_OFFSET,
-					CreateI2NPMessage (eI2NPVariableTunnelBuild, buf, len,
-						bufbe32toh (clearText + ECIES_BUILD_REQUEST_RECORD_SEND_MSG_ID_OFFSET)));
+				encryption.Encrypt (reply, TUNNEL_BUILD_RECORD_SIZE, request.replyIV, reply);
+		}
+		if (request.IsEndpoint ()) // we are endpoint of outboud tunnel
+			// so we send it to reply tunnel
+			request.replyMsg = CreateTunnelGatewayMsg (request.nextTunnelID, eI2NPVariableTunnelBuildReply, buf, len, request.sendMsgID);
+		else
+			request.replyMsg = CreateI2NPMessage (eI2NPVariableTunnelBuild, buf, len, request.sendMsgID);
+	}
+
+	void TransitTunnels::SendTunnelBuildReply (TransitTunnelBuildRequest& request)
+	{
+		if (request.isReplyLocal)
+		{
+			auto tunnel = i2p::tunnel::tunnels.GetTunnel (request.nextTunnelID);
+			if (tunnel)
+			{	
+				tunnel->SendTunnelDataMsg (request.replyMsg);
+				tunnel->FlushTunnelDataMsgs ();
+			}	
+			else
+				LogPrint (eLogWarning, "I2NP: Tunnel ", request.nextTunnelID, " not found for short tunnel build reply");
 		}
+		else
+			i2p::transport::transports.SendMessage (request.nextIdent, request.replyMsg);
 	}
 
 	bool TransitTunnels::AddTransitTunnel (std::shared_ptr<TransitTunnel> tunnel)
@@ -11,8 +11,13 @@
 
 #include <inttypes.h>
 #include <list>
+#include <vector>
 #include <mutex>
 #include <memory>
+#include <atomic>
+#include <thread>
+#include <functional>
+#include <condition_variable>
 #include "Crypto.h"
 #include "Queue.h"
 #include "I2NPProtocol.h"
@@ -39,6 +44,8 @@ namespace tunnel
 			void SendTunnelDataMsg (std::shared_ptr<i2p::I2NPMessage> msg) override;
 			void HandleTunnelDataMsg (std::shared_ptr<i2p::I2NPMessage>&& tunnelMsg) override;
 			void EncryptTunnelMsg (std::shared_ptr<const I2NPMessage> in, std::shared_ptr<I2NPMessage> out) override;
+			void EncryptTunnelMsgs (const std::vector<std::shared_ptr<const I2NPMessage> >& in,
+				const std::vector<std::shared_ptr<I2NPMessage> >& out) override;
 		
 		private:
 
@@ -65,7 +72,7 @@ namespace tunnel
 		private:
 
 			size_t m_NumTransmittedBytes;
-			std::list<std::shared_ptr<i2p::I2NPMessage> > m_TunnelDataMsgs;
+			std::list<std::shared_ptr<i2p::I2NPMessage> > m_TunnelDataMsgs; // encrypted at flush
 			std::unique_ptr<TunnelTransportSender> m_Sender;
 	};
 
@@ -119,7 +126,37 @@ namespace tunnel
 
 	
 	const int TRANSIT_TUNNELS_QUEUE_WAIT_INTERVAL = 10; // in seconds
-		
+	const int TRANSIT_TUNNELS_MAX_NUM_BUILD_THREADS = 16;
+	const double TRANSIT_TUNNELS_LATENCY_SMOOTHING_CONSTANT = 0.05; // exponentially weighted moving average per batch
+
+	struct TransitTunnelBuildRequest
+	{
+		std::shared_ptr<I2NPMessage> msg; // ShortTunnelBuild or VariableTunnelBuild, records are encrypted in place for reply
+		bool isValid = false; // our record found and decrypted
+		int recordIndex = -1;
+		uint8_t flag = 0;
+		uint32_t receiveTunnelID = 0, nextTunnelID = 0, sendMsgID = 0;
+		i2p::data::IdentHash nextIdent;
+		i2p::crypto::AESKey layerKey, ivKey;
+		uint8_t replyKey[32], replyIV[16]; // replyIV for VariableTunnelBuild only
+		i2p::crypto::NoiseSymmetricState noiseState;
+		uint8_t retCode = 0;
+		std::shared_ptr<TransitTunnel> transitTunnel;
+		std::shared_ptr<I2NPMessage> replyMsg; // nullptr if nothing to send
+		bool isReplyLocal = false; // replyMsg goes to our own inbound gateway with nextTunnelID
+
+		bool IsEndpoint () const { return flag & TUNNEL_BUILD_RECORD_ENDPOINT_FLAG; };
+		bool IsGateway () const { return flag & TUNNEL_BUILD_RECORD_GATEWAY_FLAG; };
+	};
+
+	struct TransitTunnelBuildStats
+	{
+		int numBuildThreads;
+		// average in microseconds
+		double queueLatency; // time in queue per message
+		double decryptionLatency, admissionLatency, replyLatency; // per batch
+	};
+
 	class TransitTunnels
 	{	
 		public:
@@ -130,6 +167,7 @@ namespace tunnel
 			void Start ();
 			void Stop ();
 			void PostTransitTunnelBuildMsg  (std::shared_ptr<I2NPMessage>&& msg);
+			void SetNumBuildThreads (int numBuildThreads);
 			
 			size_t GetNumTransitTunnels () const { return m_TransitTunnels.size (); }
 			int GetTransitTunnelsExpirationTimeout ();
@@ -139,10 +177,21 @@ namespace tunnel
 			bool AddTransitTunnel (std::shared_ptr<TransitTunnel> tunnel);
 			void ManageTransitTunnels (uint64_t ts);
 
-			void HandleShortTransitTunnelBuildMsg (std::shared_ptr<I2NPMessage>&& msg);
-			void HandleVariableTransitTunnelBuildMsg (std::shared_ptr<I2NPMessage>&& msg);
-			bool HandleBuildRequestRecords (int num, uint8_t * records, uint8_t * clearText);
-
+			void HandleTunnelBuildMsgs (std::vector<TransitTunnelBuildRequest>& requests);
+			// build threads, any order
+			void DecryptShortTunnelBuildRequest (TransitTunnelBuildRequest& request);
+			void DecryptVariableTunnelBuildRequest (TransitTunnelBuildRequest& request);
+			void CreateShortTunnelBuildReply (TransitTunnelBuildRequest& request);
+			void CreateVariableTunnelBuildReply (TransitTunnelBuildRequest& request);
+			// TBM thread, in order of arrival
+			void AdmitTransitTunnel (TransitTunnelBuildRequest& request);
+			void SendTunnelBuildReply (TransitTunnelBuildRequest& request);
+
+			// process requests in build threads and this one, returns when all are done
+			void RunBuildStage (std::vector<TransitTunnelBuildRequest>& requests,
+				std::function<void (TransitTunnelBuildRequest&)> stage);
+			void ProcessBuildStage ();
+			void RunBuildThread (int index);
 			void Run ();
 			
 		private:
@@ -152,12 +201,30 @@ namespace tunnel
 			std::list<std::shared_ptr<TransitTunnel> > m_TransitTunnels;
 			i2p::util::Queue<std::shared_ptr<I2NPMessage> > m_TunnelBuildMsgQueue;
 			std::mt19937 m_Rng;
-			
+			// build threads
+			int m_NumBuildThreads;
+			std::vector<std::thread> m_BuildThreads;
+			std::mutex m_BuildStageMutex;
+			std::condition_variable m_BuildStageStarted, m_BuildStageCompleted;
+			uint64_t m_BuildStageNum; // incremented for each new stage
+			int m_NumActiveBuildThreads;
+			std::vector<TransitTunnelBuildRequest> * m_BuildStageRequests;
+			std::function<void (TransitTunnelBuildRequest&)> m_BuildStage;
+			std::atomic<size_t> m_NextBuildStageRequest, m_NumCompletedBuildStageRequests;
+			// stats, written by TBM thread, read by HTTP and metrics
+			std::atomic<double> m_QueueLatency, m_DecryptionLatency, m_AdmissionLatency, m_ReplyLatency;
+
 		public:
 
 			// for HTTP only
 			const auto& GetTransitTunnels () const { return m_TransitTunnels; };
 			size_t GetTunnelBuildMsgQueueSize () const { return m_TunnelBuildMsgQueue.GetSize (); };
+			TransitTunnelBuildStats GetTunnelBuildStats () const
+			{
+				return { m_NumBuildThreads, m_QueueLatency.load (std::memory_order_relaxed),
+					m_DecryptionLatency.load (std::memory_order_relaxed), m_AdmissionLatency.load (std::memory_order_relaxed),
+					m_ReplyLatency.load (std::memory_order_relaxed) };
+			};
 	};
 }
 }
@@ -15,6 +15,7 @@
 #include "Transports.h"
 #include "Config.h"
 #include "HTTP.h"
+#include "Metrics.h"
 #include "util.h"
 
 using namespace i2p::data;
@@ -150,6 +151,74 @@ namespace transport
 		}	
 	}	
 		
+	std::shared_ptr<Peer> PeersTable::Find (const i2p::data::IdentHash& ident) const
+	{
+		auto& shard = GetShard (ident);
+		std::lock_guard<std::mutex> l(shard.mutex);
+		auto it = shard.indices.find (ident);
+		return it != shard.indices.end () ? shard.peers[it->second].second : nullptr;
+	}
+
+	std::shared_ptr<Peer> PeersTable::Insert (const i2p::data::IdentHash& ident, std::shared_ptr<Peer> peer)
+	{
+		auto& shard = GetShard (ident);
+		std::lock_guard<std::mutex> l(shard.mutex);
+		auto ret = shard.indices.emplace (ident, shard.peers.size ());
+		if (!ret.second) return shard.peers[ret.first->second].second; // already there
+		shard.peers.emplace_back (ident, peer);
+		m_Size++;
+		return peer;
+	}
+
+	bool PeersTable::Erase (const i2p::data::IdentHash& ident)
+	{
+		auto& shard = GetShard (ident);
+		std::lock_guard<std::mutex> l(shard.mutex);
+		auto it = shard.indices.find (ident);
+		if (it == shard.indices.end ()) return false;
+		size_t ind = it->second;
+		shard.indices.erase (it);
+		if (ind + 1 < shard.peers.size ())
+		{
+			// move last to the freed position
+			shard.peers[ind] = std::move (shard.peers.back ());
+			shard.indices[shard.peers[ind].first] = ind;
+		}
+		shard.peers.pop_back ();
+		m_Size--;
+		return true;
+	}
+
+	bool PeersTable::Contains (const i2p::data::IdentHash& ident) const
+	{
+		auto& shard = GetShard (ident);
+		std::lock_guard<std::mutex> l(shard.mutex);
+		return shard.indices.count (ident) > 0;
+	}
+
+	void PeersTable::Clear ()
+	{
+		for (auto& shard: m_Shards)
+		{
+			std::lock_guard<std::mutex> l(shard.mutex);
+			shard.indices.clear ();
+			shard.peers.clear ();
+		}
+		m_Size = 0;
+	}
+
+	std::vector<std::pair<i2p::data::IdentHash, std::shared_ptr<Peer> > > PeersTable::GetSnapshot () const
+	{
+		std::vector<std::pair<i2p::data::IdentHash, std::shared_ptr<Peer> > > peers;
+		peers.reserve (m_Size);
+		for (auto& shard: m_Shards)
+		{
+			std::lock_guard<std::mutex> l(shard.mutex);
+			peers.insert (peers.end (), shard.peers.begin (), shard.peers.end ());
+		}
+		return peers;
+	}
+
 	Transports transports;
 
 	Transports::Transports ():
@@ -320,6 +389,7 @@ namespace transport
 		if (m_NTCP2Server) m_NTCP2Server->Start ();
 		if (m_SSU2Server) m_SSU2Server->Start ();
 		if (m_SSU2Server) DetectExternalIP ();
+		RegisterMetrics ();
 
 		m_PeerCleanupTimer->expires_from_now (boost::posix_time::seconds(5 * SESSION_CREATION_TIMEOUT));
 		m_PeerCleanupTimer->async_wait (std::bind (&Transports::HandlePeerCleanupTimer, this, std::placeholders::_1));
@@ -372,7 +442,26 @@ namespace transport
 			delete m_Thread;
 			m_Thread = nullptr;
 		}
-		m_Peers.clear ();
+		m_Peers.Clear ();
+	}
+
+	void Transports::RegisterMetrics ()
+	{
+		auto& registry = i2p::metrics::GetRegistry ();
+		registry.SetCallback ("transport_sent_bytes_total", "Bytes sent by transports", i2p::metrics::eMetricTypeCounter,
+			[this]() { return (int64_t)m_TotalSentBytes.load (); });
+		registry.SetCallback ("transport_received_bytes_total", "Bytes received by transports", i2p::metrics::eMetricTypeCounter,
+			[this]() { return (int64_t)m_TotalReceivedBytes.load (); });
+		registry.SetCallback ("transport_transit_bytes_total", "Transit bytes sent by transports", i2p::metrics::eMetricTypeCounter,
+			[this]() { return (int64_t)m_TotalTransitTransmittedBytes.load (); });
+		registry.SetCallback ("transport_peers", "Connected and connecting peers", i2p::metrics::eMetricTypeGauge,
+			[this]() { return (int64_t)m_Peers.GetSize (); });
+		registry.SetCallback ("transport_sessions", "Transport sessions", i2p::metrics::eMetricTypeGauge,
+			[this]() { return m_NTCP2Server ? (int64_t)m_NTCP2Server->GetNumNTCP2Sessions () : 0; }, "transport=\"ntcp2\"");
+		registry.SetCallback ("transport_sessions", "Transport sessions", i2p::metrics::eMetricTypeGauge,
+			[this]() { return m_SSU2Server ? (int64_t)m_SSU2Server->GetNumSSU2Sessions () : 0; }, "transport=\"ssu2\"");
+		registry.SetCallback ("transport_congestion_level", "Router congestion level in percents", i2p::metrics::eMetricTypeGauge,
+			[this]() { return (int64_t)GetCongestionLevel (false); });
 	}
 
 	void Transports::Run ()
@@ -481,13 +570,7 @@ namespace transport
 			return nullptr;
 		}
 		if(RoutesRestricted() && !IsRestrictedPeer(ident)) return nullptr;
-		std::shared_ptr<Peer> peer;
-		{
-			std::lock_guard<std::mutex> l(m_PeersMutex);
-			auto it = m_Peers.find (ident);
-			if (it != m_Peers.end ())
-				peer = it->second;
-		}	
+		auto peer = m_Peers.Find (ident);
 		if (!peer)
 		{
 			// check if not banned
@@ -499,11 +582,7 @@ namespace transport
 				auto r = netdb.FindRouter (ident);
 				if (r && (r->IsUnreachable () || !r->IsReachableFrom (i2p::context.GetRouterInfo ()))) return nullptr; // router found but non-reachable
 
-				peer = std::make_shared<Peer>(r, i2p::util::GetSecondsSinceEpoch ());
-				{	
-					std::lock_guard<std::mutex> l(m_PeersMutex);
-					peer = m_Peers.emplace (ident, peer).first->second;
-				}
+				peer = m_Peers.Insert (ident, std::make_shared<Peer>(r, i2p::util::GetSecondsSinceEpoch ()));
 				if (peer)
 					connected = ConnectToPeer (ident, peer);
 			}
@@ -531,8 +610,7 @@ namespace transport
 					if (i2p::data::IsRouterBanned (ident))
 					{
 						LogPrint (eLogWarning, "Transports: Router ", ident.ToBase64 (), " is banned. Peer dropped");
-						std::lock_guard<std::mutex> l(m_PeersMutex);
-						m_Peers.erase (ident);
+						m_Peers.Erase (ident);
 						return nullptr;
 					}	
 				}	
@@ -551,8 +629,7 @@ namespace transport
 			{
 				LogPrint (eLogWarning, "Transports: Delayed messages queue size to ",
 					ident.ToBase64 (), " exceeds ", MAX_NUM_DELAYED_MESSAGES);
-				std::lock_guard<std::mutex> l(m_PeersMutex);
-				m_Peers.erase (ident);
+				m_Peers.Erase (ident);
 			}
 		}
 		return nullptr;
@@ -634,16 +711,14 @@ namespace transport
 			if (!i2p::context.IsLimitedConnectivity () && peer->router->IsReachableFrom (i2p::context.GetRouterInfo ()))
 				i2p::data::netdb.SetUnreachable (ident, true); // we are here because all connection attempts failed but router claimed them
 			peer->Done ();
-			std::lock_guard<std::mutex> l(m_PeersMutex);
-			m_Peers.erase (ident);
+			m_Peers.Erase (ident);
 			return false;
 		}
 		else if (i2p::data::IsRouterBanned (ident))
 		{
 			LogPrint (eLogWarning, "Transports: Router ", ident.ToBase64 (), " is banned. Peer dropped");
 			peer->Done ();
-			std::lock_guard<std::mutex> l(m_PeersMutex);
-			m_Peers.erase (ident);
+			m_Peers.Erase (ident);
 			return false;
 		}
 		else // otherwise request RI
@@ -752,18 +827,9 @@ namespace transport
 
 	void Transports::HandleRequestComplete (std::shared_ptr<const i2p::data::RouterInfo> r, i2p::data::IdentHash ident)
 	{
-		std::shared_ptr<Peer> peer;
-		{
-			std::lock_guard<std::mutex> l(m_PeersMutex);
-			auto it = m_Peers.find (ident);
-			if (it != m_Peers.end ())
-			{
-				if (r)
-					peer = it->second;
-				else
-					m_Peers.erase (it);
-			}	
-		}
+		auto peer = m_Peers.Find (ident);
+		if (peer && !r)
+			m_Peers.Erase (ident);
 				
 		if (peer && !peer->router && r)
 		{
@@ -890,10 +956,9 @@ namespace transport
 			auto remoteIdentity = session->GetRemoteIdentity ();
 			if (!remoteIdentity) return;
 			auto ident = remoteIdentity->GetIdentHash ();
-			auto it = m_Peers.find (ident);
-			if (it != m_Peers.end ())
+			auto peer = m_Peers.Find (ident);
+			if (peer)
 			{
-				auto peer = it->second;
 				if (peer->numAttempts > 1)
 				{
 					// exclude failed transports
@@ -919,7 +984,7 @@ namespace transport
 				peer->numAttempts = 0;
 				peer->router = nullptr; // we don't need RouterInfo after successive connect
 				bool sendDatabaseStore = true;
-				if (it->second->delayedMessages.size () > 0)
+				if (peer->delayedMessages.size () > 0)
 				{
 					// check if first message is our DatabaseStore (publishing)
 					auto firstMsg = peer->delayedMessages.front ();
@@ -957,8 +1022,7 @@ namespace transport
 				auto peer = std::make_shared<Peer>(r, ts);
 				peer->sessions.push_back (session);
 				peer->router = nullptr;
-				std::lock_guard<std::mutex> l(m_PeersMutex);
-				m_Peers.emplace (ident, peer);
+				m_Peers.Insert (ident, peer);
 			}
 		});
 	}
@@ -970,10 +1034,9 @@ namespace transport
 			auto remoteIdentity = session->GetRemoteIdentity ();
 			if (!remoteIdentity) return;
 			auto ident = remoteIdentity->GetIdentHash ();
-			auto it = m_Peers.find (ident);
-			if (it != m_Peers.end ())
+			auto peer = m_Peers.Find (ident);
+			if (peer)
 			{
-				auto peer = it->second;
 				bool wasConnected = peer->IsConnected ();
 				peer->sessions.remove (session);
 				if (!peer->IsConnected ())
@@ -986,10 +1049,7 @@ namespace transport
 					}
 					else
 					{
-						{
-							std::lock_guard<std::mutex> l(m_PeersMutex);
-							m_Peers.erase (it);
-						}
+						m_Peers.Erase (ident);
 						// delete buffer of just disconnected router 
 						auto r = i2p::data::netdb.FindRouter (ident);
 						if (r && !r->IsUpdated ()) r->ScheduleBufferToDelete ();
@@ -1001,13 +1061,7 @@ namespace transport
 
 	bool Transports::IsConnected (const i2p::data::IdentHash& ident) const
 	{
-		std::lock_guard<std::mutex> l(m_PeersMutex);
-#if __cplusplus >= 202002L // C++20
-		return m_Peers.contains (ident);
-#else		
-		auto it = m_Peers.find (ident);
-		return it != m_Peers.end ();
-#endif		
+		return m_Peers.Contains (ident);
 	}
 
 	void Transports::HandlePeerCleanupTimer (const boost::system::error_code& ecode)
@@ -1015,36 +1069,31 @@ namespace transport
 		if (ecode != boost::asio::error::operation_aborted)
 		{
 			auto ts = i2p::util::GetSecondsSinceEpoch ();
-			for (auto it = m_Peers.begin (); it != m_Peers.end (); )
+			for (auto& it: m_Peers.GetSnapshot ())
 			{
-				it->second->sessions.remove_if (
+				it.second->sessions.remove_if (
 					[](std::shared_ptr<TransportSession> session)->bool
 					{
 						return !session || !session->IsEstablished ();
 					});
- 				if (!it->second->IsConnected () && ts > it->second->creationTime + SESSION_CREATION_TIMEOUT)
+ 				if (!it.second->IsConnected () && ts > it.second->creationTime + SESSION_CREATION_TIMEOUT)
 				{
-					LogPrint (eLogWarning, "Transports: Session to peer ", it->first.ToBase64 (), " has not been created in ", SESSION_CREATION_TIMEOUT, " seconds");
+					LogPrint (eLogWarning, "Transports: Session to peer ", it.first.ToBase64 (), " has not been created in ", SESSION_CREATION_TIMEOUT, " seconds");
 				/*	if (!it->second.router) 
 					{	 
 						// if router for ident not found mark it unreachable
 						auto profile = i2p::data::GetRouterProfile (it->first);
 						if (profile) profile->Unreachable ();
 					}	*/
-					std::lock_guard<std::mutex> l(m_PeersMutex);
-					it = m_Peers.erase (it);
+					m_Peers.Erase (it.first);
 				}
-				else
+				else if (ts > it.second->nextRouterInfoUpdateTime)
 				{
-					if (ts > it->second->nextRouterInfoUpdateTime)
-					{
-						auto session = it->second->sessions.front ();
-						if (session)
-							session->SendLocalRouterInfo (true);
-						it->second->nextRouterInfoUpdateTime = ts + PEER_ROUTER_INFO_UPDATE_INTERVAL +
-							m_Rng() % PEER_ROUTER_INFO_UPDATE_INTERVAL_VARIANCE;
-					}
-					++it;
+					auto session = it.second->sessions.front ();
+					if (session)
+						session->SendLocalRouterInfo (true);
+					it.second->nextRouterInfoUpdateTime = ts + PEER_ROUTER_INFO_UPDATE_INTERVAL +
+						m_Rng() % PEER_ROUTER_INFO_UPDATE_INTERVAL_VARIANCE;
 				}
 			}
 			bool ipv4Testing = i2p::context.GetTesting ();
@@ -1074,94 +1123,25 @@ namespace transport
 	template<typename Filter>
 	std::shared_ptr<const i2p::data::RouterInfo> Transports::GetRandomPeer (Filter filter) const
 	{
-		if (m_Peers.empty()) return nullptr;
+		if (m_Peers.IsEmpty ()) return nullptr;
 		auto ts = i2p::util::GetSecondsSinceEpoch ();
-		bool found = false;
+		uint32_t rnd[2];
+		RAND_bytes ((uint8_t *)rnd, sizeof (rnd));
 		i2p::data::IdentHash ident;
-		{
-			uint16_t inds[3];
-			RAND_bytes ((uint8_t *)inds, sizeof (inds));
-			std::lock_guard<std::mutex> l(m_PeersMutex);
-			auto count = m_Peers.size ();
-			if(count == 0) return nullptr;
-			inds[0] %= count;
-			auto it = m_Peers.begin ();
-			std::advance (it, inds[0]);
-			// try random peer
-			if (it != m_Peers.end () && filter (it->second))
-			{
-				ident = it->first;
-				found = true;
-			}
-			else
-			{
-				// try some peers around
-				auto it1 = m_Peers.begin ();
-				if (inds[0])
-				{
-					// before
-					inds[1] %= inds[0];
-					std::advance (it1, (inds[1] + inds[0])/2);
-				}
-				else
-					it1 = it;
-				auto it2 = it;
-				if (inds[0] < m_Peers.size () - 1)
-				{
-					// after
-					inds[2] %= (m_Peers.size () - 1 - inds[0]); inds[2] /= 2;
-					std::advance (it2, inds[2]);
-				}
-				// it1 - from, it2 - to
-				it = it1;
-				while (it != it2 && it != m_Peers.end ())
+		// try random peer
+		bool found = m_Peers.GetRandom (rnd[0], filter, ident);
+		if (!found)
+			// try peers from another random position, not selected recently
+			found = m_Peers.FindFrom (rnd[1],
+				[ts, &filter](std::shared_ptr<Peer> peer)->bool
 				{
-					if (ts > it->second->lastSelectionTime + PEER_SELECTION_MIN_INTERVAL &&
-					    filter (it->second))
+					if (ts > peer->lastSelectionTime + PEER_SELECTION_MIN_INTERVAL && filter (peer))
 					{
-						ident = it->first;
-						it->second->lastSelectionTime = ts;
-						found = true;
-						break;
+						peer->lastSelectionTime = ts;
+						return true;
 					}
-					it++;
-				}
-				if (!found)
-				{
-					// still not found, try from the beginning
-					it = m_Peers.begin ();
-					while (it != it1 && it != m_Peers.end ())
-					{
-						if (ts > it->second->lastSelectionTime + PEER_SELECTION_MIN_INTERVAL &&
-						    filter (it->second))
-						{
-							ident = it->first;
-							it->second->lastSelectionTime = ts;
-							found = true;
-							break;
-						}
-						it++;
-					}
-					if (!found)
-					{
-						// still not found, try to the beginning
-						it = it2;
-						while (it != m_Peers.end ())
-						{
-							if (ts > it->second->lastSelectionTime + PEER_SELECTION_MIN_INTERVAL &&
-							    filter (it->second))
-							{
-								ident = it->first;
-								it->second->lastSelectionTime = ts;
-								found = true;
-								break;
-							}
-							it++;
-						}
-					}
-				}
-			}
-		}
+					return false;
+				}, ident);
 		return found ? i2p::data::netdb.FindRouter (ident) : nullptr;
 	}
 
@@ -16,6 +16,7 @@
 #include <functional>
 #include <unordered_map>
 #include <unordered_set>
+#include <array>
 #include <vector>
 #include <queue>
 #include <string>
@@ -107,6 +108,81 @@ namespace transport
 		void UpdateParams (std::shared_ptr<const i2p::data::RouterInfo> router);
 	};
 
+	const size_t PEERS_TABLE_NUM_SHARDS = 16; // must be power of 2
+	class PeersTable // striped by ident, dense array per shard for random selection
+	{
+		public:
+
+			PeersTable (): m_Size (0) {};
+
+			std::shared_ptr<Peer> Find (const i2p::data::IdentHash& ident) const;
+			std::shared_ptr<Peer> Insert (const i2p::data::IdentHash& ident, std::shared_ptr<Peer> peer); // returns existing if any
+			bool Erase (const i2p::data::IdentHash& ident);
+			bool Contains (const i2p::data::IdentHash& ident) const;
+			void Clear ();
+			size_t GetSize () const { return m_Size; };
+			bool IsEmpty () const { return !m_Size; };
+			std::vector<std::pair<i2p::data::IdentHash, std::shared_ptr<Peer> > > GetSnapshot () const;
+
+			// filter is called with shard locked
+			template<typename Filter>
+			bool GetRandom (uint32_t rnd, Filter filter, i2p::data::IdentHash& ident) const; // one random peer
+			template<typename Filter>
+			bool FindFrom (uint32_t rnd, Filter filter, i2p::data::IdentHash& ident) const; // first matching from random position
+
+		private:
+
+			struct Shard
+			{
+				mutable std::mutex mutex;
+				std::unordered_map<i2p::data::IdentHash, size_t> indices; // ident -> position in peers
+				std::vector<std::pair<i2p::data::IdentHash, std::shared_ptr<Peer> > > peers;
+			};
+
+			Shard& GetShard (const i2p::data::IdentHash& ident) { return m_Shards[ident.GetLL ()[0] & (PEERS_TABLE_NUM_SHARDS - 1)]; };
+			const Shard& GetShard (const i2p::data::IdentHash& ident) const { return m_Shards[ident.GetLL ()[0] & (PEERS_TABLE_NUM_SHARDS - 1)]; };
+
+		private:
+
+			std::array<Shard, PEERS_TABLE_NUM_SHARDS> m_Shards;
+			std::atomic<size_t> m_Size;
+	};
+
+	template<typename Filter>
+	bool PeersTable::GetRandom (uint32_t rnd, Filter filter, i2p::data::IdentHash& ident) const
+	{
+		auto& shard = m_Shards[rnd & (PEERS_TABLE_NUM_SHARDS - 1)];
+		std::lock_guard<std::mutex> l(shard.mutex);
+		if (shard.peers.empty ()) return false;
+		auto& it = shard.peers[(rnd / PEERS_TABLE_NUM_SHARDS) % shard.peers.size ()];
+		if (!filter (it.second)) return false;
+		ident = it.first;
+		return true;
+	}
+
+	template<typename Filter>
+	bool PeersTable::FindFrom (uint32_t rnd, Filter filter, i2p::data::IdentHash& ident) const
+	{
+		for (size_t i = 0; i < PEERS_TABLE_NUM_SHARDS; i++)
+		{
+			auto& shard = m_Shards[(rnd + i) & (PEERS_TABLE_NUM_SHARDS - 1)];
+			std::lock_guard<std::mutex> l(shard.mutex);
+			size_t size = shard.peers.size ();
+			if (!size) continue;
+			size_t start = (rnd / PEERS_TABLE_NUM_SHARDS) % size;
+			for (size_t j = 0; j < size; j++)
+			{
+				auto& it = shard.peers[(start + j) % size];
+				if (filter (it.second))
+				{
+					ident = it.first;
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
 	const uint64_t SESSION_CREATION_TIMEOUT = 15; // in seconds
 	const int PEER_TEST_INTERVAL = 68*60; // in seconds
 	const int PEER_TEST_INTERVAL_VARIANCE = 3*60; // in seconds
@@ -167,7 +243,7 @@ namespace transport
 			uint32_t GetOutBandwidth15s () const { return m_OutBandwidth15s; };
 			uint32_t GetTransitBandwidth15s () const { return m_TransitBandwidth15s; };
 			int GetCongestionLevel (bool longTerm) const;
-			size_t GetNumPeers () const { return m_Peers.size (); };
+			size_t GetNumPeers () const { return m_Peers.GetSize (); };
 			std::shared_ptr<const i2p::data::RouterInfo> GetRandomPeer (bool isHighBandwidth) const;
 
 			/** get a trusted first hop for restricted routes */
@@ -202,6 +278,7 @@ namespace transport
 			void UpdateBandwidthValues (int interval, uint32_t& in, uint32_t& out, uint32_t& transit);
 
 			void DetectExternalIP ();
+			void RegisterMetrics ();
 
 			template<typename Filter>
 				std::shared_ptr<const i2p::data::RouterInfo> GetRandomPeer (Filter filter) const;
@@ -217,8 +294,7 @@ namespace transport
 
 			SSU2Server * m_SSU2Server;
 			NTCP2Server * m_NTCP2Server;
-			mutable std::mutex m_PeersMutex;
-			std::unordered_map<i2p::data::IdentHash, std::shared_ptr<Peer> > m_Peers;
+			PeersTable m_Peers;
 
 			X25519KeysPairSupplier m_X25519KeysPairSupplier;
 
@@ -250,7 +326,6 @@ namespace transport
 			// for HTTP only
 			const NTCP2Server * GetNTCP2Server () const { return m_NTCP2Server; };
 			const SSU2Server * GetSSU2Server () const { return m_SSU2Server; };
-			const decltype(m_Peers)& GetPeers () const { return m_Peers; };
 	};
 
 	extern Transports transports;
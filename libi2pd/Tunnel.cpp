@@ -12,6 +12,7 @@
 #include <thread>
 #include <algorithm>
 #include <vector>
+#include <deque>
 #include "Crypto.h"
 #include "RouterContext.h"
 #include "Log.h"
@@ -20,6 +21,7 @@
 #include "Transports.h"
 #include "NetDb.hpp"
 #include "Config.h"
+#include "Metrics.h"
 #include "Tunnel.h"
 #include "TunnelPool.h"
 #include "util.h"
@@ -237,6 +239,31 @@ namespace tunnel
 		}
 	}
 
+	void Tunnel::EncryptTunnelMsgs (const std::vector<std::shared_ptr<const I2NPMessage> >& in,
+		const std::vector<std::shared_ptr<I2NPMessage> >& out)
+	{
+		size_t num = std::min (in.size (), out.size ());
+		if (!num) return;
+		std::vector<const uint8_t *> inPayloads (num);
+		std::vector<uint8_t *> outPayloads (num);
+		for (size_t i = 0; i < num; i++)
+		{
+			inPayloads[i] = in[i]->GetPayload () + 4;
+			outPayloads[i] = out[i]->GetPayload () + 4;
+		}
+		bool isFirst = true;
+		for (auto& it: m_Hops)
+		{
+			it.decryption.Decrypt (inPayloads.data (), outPayloads.data (), num);
+			if (isFirst)
+			{
+				// next hops in place
+				inPayloads.assign (outPayloads.begin (), outPayloads.end ());
+				isFirst = false;
+			}
+		}
+	}
+
 	void Tunnel::SendTunnelDataMsg (std::shared_ptr<i2p::I2NPMessage> msg)
 	{
 		LogPrint (eLogWarning, "Tunnel: Can't send I2NP messages without delivery instructions");
@@ -263,6 +290,15 @@ namespace tunnel
 		m_State = state;
 	}
 
+	bool Tunnel::SetEstablished ()
+	{
+		// tunnels thread might change state at the same time
+		auto state = GetState ();
+		while (state != eTunnelStateEstablished && state != eTunnelStateTestFailed && state != eTunnelStateExpiring)
+			if (m_State.compare_exchange_weak (state, eTunnelStateEstablished)) return true;
+		return false;
+	}
+
 	void Tunnel::VisitTunnelHops(TunnelHopVisitor v)
 	{
 		// hops are in inverted order, we must return in direct order
@@ -272,10 +308,8 @@ namespace tunnel
 
 	void InboundTunnel::HandleTunnelDataMsg (std::shared_ptr<I2NPMessage>&& msg)
 	{
-		if (!IsEstablished () && GetState () != eTunnelStateExpiring) 
+		if (SetEstablished ()) // incoming messages means a tunnel is alive
 		{	
-			// incoming messages means a tunnel is alive
-			SetState (eTunnelStateEstablished); 
 			auto pool = GetTunnelPool ();
 			if (pool)
 			{
@@ -284,9 +318,21 @@ namespace tunnel
 				if (dest) dest->SetLeaseSetUpdated (true);
 			}	
 		}	
-		EncryptTunnelMsg (msg, msg);
-		msg->from = GetSharedFromThis ();
-		m_Endpoint.HandleDecryptedTunnelDataMsg (msg);
+		m_TunnelDataMsgs.push_back (std::move (msg)); // decrypted at flush
+	}
+
+	void InboundTunnel::FlushTunnelDataMsgs ()
+	{
+		if (m_TunnelDataMsgs.empty ()) return;
+		std::vector<std::shared_ptr<const I2NPMessage> > in (m_TunnelDataMsgs.begin (), m_TunnelDataMsgs.end ());
+		EncryptTunnelMsgs (in, m_TunnelDataMsgs);
+		auto from = GetSharedFromThis ();
+		for (auto& it: m_TunnelDataMsgs)
+		{
+			it->from = from;
+			m_Endpoint.HandleDecryptedTunnelDataMsg (it);
+		}
+		m_TunnelDataMsgs.clear ();
 	}
 
 	bool InboundTunnel::Recreate ()
@@ -404,9 +450,88 @@ namespace tunnel
 		}
 	}
 
+	static thread_local TunnelDataShard * g_CurrentDataShard = nullptr; // set in tunnel data threads only
+
+	TunnelDataShard::TunnelDataShard (int index):
+		m_Index (index), m_IsRunning (false),
+		m_Rng(i2p::util::GetMonotonicMicroseconds ()%1000000LL + index)
+	{
+	}
+
+	TunnelDataShard::~TunnelDataShard ()
+	{
+		Stop ();
+	}
+
+	void TunnelDataShard::Start ()
+	{
+		if (!m_IsRunning)
+		{
+			m_IsRunning = true;
+			m_Thread.reset (new std::thread (std::bind (&TunnelDataShard::Run, this)));
+		}
+	}
+
+	void TunnelDataShard::Stop ()
+	{
+		if (m_IsRunning)
+		{
+			m_IsRunning = false;
+			m_Queue.WakeUp ();
+			if (m_Thread)
+			{
+				m_Thread->join ();
+				m_Thread = nullptr;
+			}
+		}
+	}
+
+	void TunnelDataShard::Run ()
+	{
+		i2p::util::SetThreadName (("TunnelData" + std::to_string (m_Index)).c_str ());
+		g_CurrentDataShard = this;
+
+		std::deque<std::shared_ptr<I2NPMessage> > msgs;
+		std::shared_ptr<TunnelBase> prevTunnel; // its TunnelData messages are not flushed yet
+		while (m_IsRunning)
+		{
+			try
+			{
+				if (!m_Queue.IsEmpty () || m_Queue.Wait (1,0)) // 1 sec
+				{
+					m_Queue.GetWholeQueue (msgs);
+					auto mts = i2p::util::GetMillisecondsSinceEpoch ();
+					int numMsgs = 0;
+					while (!msgs.empty ())
+					{
+						auto msg = msgs.front (); msgs.pop_front ();
+						if (msg && !msg->IsExpired (mts))
+						{
+							prevTunnel = tunnels.HandleTunnelDataMsg (std::move (msg), prevTunnel);
+							numMsgs++;
+						}
+						if (msgs.empty () && numMsgs < MAX_TUNNEL_MSGS_BATCH_SIZE && !m_Queue.IsEmpty ())
+							m_Queue.GetWholeQueue (msgs); // try more
+					}
+				}
+				if (prevTunnel)
+				{
+					prevTunnel->FlushTunnelDataMsgs (); // flush last, also after exception
+					prevTunnel = nullptr;
+				}
+			}
+			catch (std::exception& ex)
+			{
+				LogPrint (eLogError, "Tunnel: Runtime exception in data thread ", m_Index, ": ", ex.what ());
+			}
+		}
+		g_CurrentDataShard = nullptr;
+	}
+
 	Tunnels tunnels;
 
-	Tunnels::Tunnels (): m_IsRunning (false), m_Thread (nullptr), m_MaxNumTransitTunnels (DEFAULT_MAX_NUM_TRANSIT_TUNNELS),
+	Tunnels::Tunnels (): m_IsRunning (false), m_Thread (nullptr), m_NumDataThreads (0),
+		m_MaxNumTransitTunnels (DEFAULT_MAX_NUM_TRANSIT_TUNNELS),
 		m_TotalNumSuccesiveTunnelCreations (0), m_TotalNumFailedTunnelCreations (0), // for normal average
 		m_TunnelCreationSuccessRate (TCSR_START_VALUE), m_TunnelCreationAttemptsNum(0),
 		m_Rng(i2p::util::GetMonotonicMicroseconds ()%1000000LL)
@@ -529,9 +654,46 @@ namespace tunnel
 
 	void Tunnels::Start ()
 	{
+		if (m_NumDataThreads > 0 && !GetDataShards ())
+		{
+			DataShardsPtr shards (new DataShards ());
+			for (int i = 0; i < m_NumDataThreads; i++)
+			{
+				shards->emplace_back (new TunnelDataShard (i));
+				shards->back ()->Start ();
+			}
+#ifdef __cpp_lib_atomic_shared_ptr
+			m_DataShards = shards;
+#else
+			boost::atomic_store (&m_DataShards, shards);
+#endif
+			LogPrint (eLogInfo, "Tunnel: Using ", m_NumDataThreads, " tunnel data threads");
+		}
 		m_IsRunning = true;
 		m_Thread = new std::thread (std::bind (&Tunnels::Run, this));
 		m_TransitTunnels.Start ();
+		RegisterMetrics ();
+	}
+
+	void Tunnels::RegisterMetrics ()
+	{
+		auto& registry = i2p::metrics::GetRegistry ();
+		registry.SetCallback ("tunnels", "Established tunnels", i2p::metrics::eMetricTypeGauge,
+			[this]() { return (int64_t)CountInboundTunnels (); }, "type=\"inbound\"");
+		registry.SetCallback ("tunnels", "Established tunnels", i2p::metrics::eMetricTypeGauge,
+			[this]() { return (int64_t)CountOutboundTunnels (); }, "type=\"outbound\"");
+		registry.SetCallback ("tunnels", "Established tunnels", i2p::metrics::eMetricTypeGauge,
+			[this]() { return (int64_t)CountTransitTunnels (); }, "type=\"transit\"");
+		registry.SetCallback ("tunnel_queue_size", "Tunnel messages waiting for processing", i2p::metrics::eMetricTypeGauge,
+			[this]() { return (int64_t)GetQueueSize (); });
+		registry.SetCallback ("tunnel_build_queue_size", "Transit tunnel build messages waiting for processing", i2p::metrics::eMetricTypeGauge,
+			[this]() { return (int64_t)GetTBMQueueSize (); });
+		registry.SetCallback ("tunnel_builds_total", "Tunnel build attempts of our tunnels", i2p::metrics::eMetricTypeCounter,
+			[this]() { return (int64_t)m_TotalNumSuccesiveTunnelCreations; }, "result=\"success\"");
+		registry.SetCallback ("tunnel_builds_total", "Tunnel build attempts of our tunnels", i2p::metrics::eMetricTypeCounter,
+			[this]() { return (int64_t)m_TotalNumFailedTunnelCreations; }, "result=\"failed\"");
+		registry.SetCallback ("tunnel_creation_success_rate", "Tunnel creation success rate in percents", i2p::metrics::eMetricTypeGauge,
+			[this]() { return (int64_t)GetTunnelCreationSuccessRate (); });
 	}
 
 	void Tunnels::Stop ()
@@ -545,6 +707,46 @@ namespace tunnel
 			delete m_Thread;
 			m_Thread = 0;
 		}
+		// transports might still post tunnel data, it goes to m_Queue now
+#ifdef __cpp_lib_atomic_shared_ptr
+		auto shards = m_DataShards.exchange (nullptr);
+#else
+		auto shards = boost::atomic_exchange (&m_DataShards, DataShardsPtr ());
+#endif
+		if (shards)
+		{
+			for (auto& it: *shards)
+				it->Stop ();
+		} // shards and their queues are deleted with last reference
+	}
+
+	void Tunnels::SetNumDataThreads (int numDataThreads)
+	{
+		if (numDataThreads < 0) numDataThreads = 0;
+		if (numDataThreads > MAX_NUM_TUNNEL_DATA_THREADS) numDataThreads = MAX_NUM_TUNNEL_DATA_THREADS;
+		if (!GetDataShards ())
+			m_NumDataThreads = numDataThreads;
+		else
+			LogPrint (eLogWarning, "Tunnel: Can't change number of tunnel data threads after start");
+	}
+
+	std::mt19937& Tunnels::GetRng ()
+	{
+		return g_CurrentDataShard ? g_CurrentDataShard->GetRng () : m_Rng;
+	}
+
+	bool Tunnels::IsDataThread () const
+	{
+		return g_CurrentDataShard;
+	}
+
+	Tunnels::DataShardsPtr Tunnels::GetDataShards () const
+	{
+#ifdef __cpp_lib_atomic_shared_ptr
+		return m_DataShards;
+#else
+		return boost::atomic_load (&m_DataShards);
+#endif
 	}
 
 	void Tunnels::Run ()
@@ -553,7 +755,8 @@ namespace tunnel
 		std::this_thread::sleep_for (std::chrono::seconds(1)); // wait for other parts are ready
 
 		uint64_t lastTs = 0, lastPoolsTs = 0, lastMemoryPoolTs = 0;
-		std::list<std::shared_ptr<I2NPMessage> > msgs;
+		std::deque<std::shared_ptr<I2NPMessage> > msgs;
+		std::shared_ptr<TunnelBase> prevTunnel; // its TunnelData messages are not flushed yet
 		while (m_IsRunning)
 		{
 			try
@@ -563,8 +766,6 @@ namespace tunnel
 					m_Queue.GetWholeQueue (msgs);
 					auto mts = i2p::util::GetMillisecondsSinceEpoch ();
 					int numMsgs = 0;
-					uint32_t prevTunnelID = 0, tunnelID = 0;
-					std::shared_ptr<TunnelBase> prevTunnel;
 					while (!msgs.empty ())
 					{
 						auto msg = msgs.front (); msgs.pop_front ();
@@ -575,27 +776,14 @@ namespace tunnel
 						{
 							case eI2NPTunnelData:
 							case eI2NPTunnelGateway:
-							{
-								tunnelID = bufbe32toh (msg->GetPayload ());
-								if (tunnelID == prevTunnelID)
-									tunnel = prevTunnel;
-								else if (prevTunnel)
-									prevTunnel->FlushTunnelDataMsgs ();
-
-								if (!tunnel)
-									tunnel = GetTunnel (tunnelID);
-								if (tunnel)
-								{
-									if (typeID == eI2NPTunnelData)
-										tunnel->HandleTunnelDataMsg (std::move (msg));
-									else // tunnel gateway assumed
-										HandleTunnelGatewayMsg (tunnel, msg);
-								}
-								else
-									LogPrint (eLogWarning, "Tunnel: Tunnel not found, tunnelID=", tunnelID, " previousTunnelID=", prevTunnelID, " type=", (int)typeID);
-
-								break;
-							}
+								// might come here only if no data threads
+								tunnel = HandleTunnelDataMsg (std::move (msg), prevTunnel);
+							break;
+							case eI2NPTunnelTest:
+								// forwarded from data threads, pools are managed in this thread
+								if (msg->from && msg->from->GetTunnelPool ())
+									msg->from->GetTunnelPool ()->ProcessTunnelTest (msg);
+							break;
 							case eI2NPShortTunnelBuild:
 								HandleShortTunnelBuildMsg (msg);
 							break;	
@@ -616,19 +804,20 @@ namespace tunnel
 								LogPrint (eLogWarning, "Tunnel: Unexpected message type ", (int) typeID);
 						}
 
-						prevTunnelID = tunnelID;
+						if (prevTunnel && !tunnel)
+							prevTunnel->FlushTunnelDataMsgs (); // batch ends with another message
 						prevTunnel = tunnel;
 						numMsgs++;	
 						
-						if (msgs.empty ())
-						{	
-							if (numMsgs < MAX_TUNNEL_MSGS_BATCH_SIZE && !m_Queue.IsEmpty ())
-								m_Queue.GetWholeQueue (msgs); // try more
-							else if (tunnel)
-								tunnel->FlushTunnelDataMsgs (); // otherwise flush last
-						}	
+						if (msgs.empty () && numMsgs < MAX_TUNNEL_MSGS_BATCH_SIZE && !m_Queue.IsEmpty ())
+							m_Queue.GetWholeQueue (msgs); // try more
 					}
 				}
+				if (prevTunnel)
+				{
+					prevTunnel->FlushTunnelDataMsgs (); // flush last, also after exception
+					prevTunnel = nullptr;
+				}
 
 				if (i2p::transport::transports.IsOnline())
 				{
@@ -648,8 +837,7 @@ namespace tunnel
 					if (ts - lastMemoryPoolTs >= TUNNEL_MEMORY_POOL_MANAGE_INTERVAL ||
 					    ts + TUNNEL_MEMORY_POOL_MANAGE_INTERVAL < lastMemoryPoolTs) // manage memory pool every 2 minutes
 					{
-						m_I2NPTunnelEndpointMessagesMemoryPool.CleanUpMt ();
-						m_I2NPTunnelMessagesMemoryPool.CleanUpMt ();
+						i2p::util::Slab::CleanUpAll ();
 						lastMemoryPoolTs = ts;
 					}
 				}
@@ -661,6 +849,31 @@ namespace tunnel
 		}
 	}
 
+	std::shared_ptr<TunnelBase> Tunnels::HandleTunnelDataMsg (std::shared_ptr<I2NPMessage>&& msg, std::shared_ptr<TunnelBase> prevTunnel)
+	{
+		uint8_t typeID = msg->GetTypeID ();
+		uint32_t tunnelID = bufbe32toh (msg->GetPayload ());
+		std::shared_ptr<TunnelBase> tunnel;
+		if (prevTunnel && prevTunnel->GetTunnelID () == tunnelID)
+			tunnel = prevTunnel;
+		else
+		{
+			if (prevTunnel) prevTunnel->FlushTunnelDataMsgs ();
+			tunnel = GetTunnel (tunnelID);
+		}
+		if (tunnel)
+		{
+			if (typeID == eI2NPTunnelData)
+				tunnel->HandleTunnelDataMsg (std::move (msg));
+			else // tunnel gateway assumed
+				HandleTunnelGatewayMsg (tunnel, msg);
+		}
+		else
+			LogPrint (eLogWarning, "Tunnel: Tunnel not found, tunnelID=", tunnelID, " previousTunnelID=",
+				prevTunnel ? prevTunnel->GetTunnelID () : 0, " type=", (int)typeID);
+		return tunnel;
+	}
+
 	void Tunnels::HandleTunnelGatewayMsg (std::shared_ptr<TunnelBase> tunnel, std::shared_ptr<I2NPMessage> msg)
 	{
 		if (!tunnel)
@@ -962,13 +1175,48 @@ namespace tunnel
 		}
 	}
 
+	int Tunnels::GetDataShardIndex (std::shared_ptr<const I2NPMessage> msg, size_t numShards) const
+	{
+		if (!numShards) return -1;
+		auto typeID = msg->GetTypeID ();
+		if ((typeID != eI2NPTunnelData && typeID != eI2NPTunnelGateway) || msg->GetPayloadLength () < 4)
+			return -1;
+		// same tunnel always goes to the same thread to keep messages order
+		return bufbe32toh (msg->GetPayload ()) % numShards;
+	}
+
 	void Tunnels::PostTunnelData (std::shared_ptr<I2NPMessage> msg)
 	{
-		if (msg) m_Queue.Put (msg);
+		if (!msg) return;
+		auto shards = GetDataShards ();
+		int ind = shards ? GetDataShardIndex (msg, shards->size ()) : -1;
+		if (ind >= 0)
+			(*shards)[ind]->PostTunnelData (msg);
+		else
+			m_Queue.Put (msg);
 	}
 
 	void Tunnels::PostTunnelData (std::list<std::shared_ptr<I2NPMessage> >& msgs)
 	{
+		auto shards = GetDataShards ();
+		if (shards)
+		{
+			std::vector<std::list<std::shared_ptr<I2NPMessage> > > shardMsgs (shards->size ());
+			for (auto it = msgs.begin (); it != msgs.end ();)
+			{
+				int ind = *it ? GetDataShardIndex (*it, shards->size ()) : -1;
+				if (ind >= 0)
+				{
+					auto next = std::next (it);
+					shardMsgs[ind].splice (shardMsgs[ind].end (), msgs, it);
+					it = next;
+				}
+				else
+					it++;
+			}
+			for (size_t i = 0; i < shardMsgs.size (); i++)
+				(*shards)[i]->PostTunnelData (shardMsgs[i]);
+		}
 		m_Queue.Put (msgs);
 	}
 
@@ -1074,19 +1322,29 @@ namespace tunnel
 		if (endpoint)
 		{
 			// should fit two tunnel message + tunnel gateway header, enough for one garlic encrypted streaming packet
-			auto msg = m_I2NPTunnelEndpointMessagesMemoryPool.AcquireSharedMt ();
+			auto msg = NewI2NPMessageBuffer<I2NP_TUNNEL_ENPOINT_MESSAGE_SIZE> ();
 			msg->Align (6);
 			msg->offset += TUNNEL_GATEWAY_HEADER_SIZE; // reserve room for TunnelGateway header
 			return msg;
 		}
 		else
 		{
-			auto msg = m_I2NPTunnelMessagesMemoryPool.AcquireSharedMt ();
+			auto msg = NewI2NPMessageBuffer<I2NP_TUNNEL_MESSAGE_SIZE> ();
 			msg->Align (12);
 			return msg;
 		}
 	}
 
+	size_t Tunnels::GetQueueSize () const
+	{
+		size_t size = m_Queue.GetSize ();
+		auto shards = GetDataShards ();
+		if (shards)
+			for (const auto& it: *shards)
+				size += it->GetQueueSize ();
+		return size;
+	}
+
 	int Tunnels::GetTransitTunnelsExpirationTimeout ()
 	{
 		return m_TransitTunnels.GetTransitTunnelsExpirationTimeout ();
@@ -18,7 +18,9 @@
 #include <thread>
 #include <mutex>
 #include <memory>
+#include <atomic>
 #include <random>
+#include <boost/shared_ptr.hpp>
 #include "util.h"
 #include "Queue.h"
 #include "Crypto.h"
@@ -47,6 +49,7 @@ namespace tunnel
 	const int TUNNEL_MANAGE_INTERVAL = 15; // in seconds
 	const int TUNNEL_POOLS_MANAGE_INTERVAL = 5; // in seconds
 	const int TUNNEL_MEMORY_POOL_MANAGE_INTERVAL = 120; // in seconds
+	const int MAX_NUM_TUNNEL_DATA_THREADS = 64;
 
 	const size_t I2NP_TUNNEL_MESSAGE_SIZE = TUNNEL_DATA_MSG_SIZE + I2NP_HEADER_SIZE + 34; // reserved for alignment and NTCP 16 + 6 + 12
 	const size_t I2NP_TUNNEL_ENPOINT_MESSAGE_SIZE = 2*TUNNEL_DATA_MSG_SIZE + I2NP_HEADER_SIZE + TUNNEL_GATEWAY_HEADER_SIZE + 28; // reserved for alignment and NTCP 16 + 6 + 6
@@ -93,7 +96,8 @@ namespace tunnel
 			i2p::data::RouterInfo::CompatibleTransports GetFarEndTransports () const { return m_FarEndTransports; };
 			TunnelState GetState () const { return m_State; };
 			void SetState (TunnelState state);
-			bool IsEstablished () const { return m_State == eTunnelStateEstablished || m_State == eTunnelStateTestFailed; };
+			bool SetEstablished (); // might be called from tunnel data thread, returns false if already established or expiring
+			bool IsEstablished () const { auto state = GetState (); return state == eTunnelStateEstablished || state == eTunnelStateTestFailed; };
 			bool IsFailed () const { return m_State == eTunnelStateFailed; };
 			bool IsRecreated () const { return m_IsRecreated; };
 			void SetRecreated (bool recreated) { m_IsRecreated = recreated; };
@@ -109,6 +113,8 @@ namespace tunnel
 			// implements TunnelBase
 			void SendTunnelDataMsg (std::shared_ptr<i2p::I2NPMessage> msg) override;
 			void EncryptTunnelMsg (std::shared_ptr<const I2NPMessage> in, std::shared_ptr<I2NPMessage> out) override;
+			void EncryptTunnelMsgs (const std::vector<std::shared_ptr<const I2NPMessage> >& in,
+				const std::vector<std::shared_ptr<I2NPMessage> >& out) override;
 
 			/** @brief add latency sample */
 			void AddLatencySample(const int us) { m_Latency = LatencyIsKnown() ? (m_Latency + us) >> 1 : us; }
@@ -129,7 +135,7 @@ namespace tunnel
 			std::vector<TunnelHop> m_Hops;
 			bool m_IsShortBuildMessage;
 			std::shared_ptr<TunnelPool> m_Pool; // pool, tunnel belongs to, or null
-			TunnelState m_State;
+			std::atomic<TunnelState> m_State;
 			i2p::data::RouterInfo::CompatibleTransports m_FarEndTransports;
 			bool m_IsRecreated; // if tunnel is replaced by new, or new tunnel requested to replace
 			int m_Latency; // in microseconds
@@ -166,6 +172,7 @@ namespace tunnel
 
 			InboundTunnel (std::shared_ptr<TunnelConfig> config): Tunnel (config), m_Endpoint (true) {};
 			void HandleTunnelDataMsg (std::shared_ptr<I2NPMessage>&& msg) override;
+			void FlushTunnelDataMsgs () override;
 			virtual size_t GetNumReceivedBytes () const { return m_Endpoint.GetNumReceivedBytes (); };
 			bool IsInbound() const override { return true; }
 			bool Recreate () override;
@@ -183,6 +190,7 @@ namespace tunnel
 		private:
 
 			TunnelEndpoint m_Endpoint;
+			std::vector<std::shared_ptr<I2NPMessage> > m_TunnelDataMsgs; // not decrypted yet
 	};
 
 	class ZeroHopsInboundTunnel: public InboundTunnel
@@ -211,8 +219,44 @@ namespace tunnel
 			size_t m_NumSentBytes;
 	};
 
+	class TunnelDataShard
+	{
+		public:
+
+			TunnelDataShard (int index);
+			~TunnelDataShard ();
+
+			void Start ();
+			void Stop ();
+			void PostTunnelData (std::shared_ptr<I2NPMessage> msg) { m_Queue.Put (msg); };
+			void PostTunnelData (std::list<std::shared_ptr<I2NPMessage> >& msgs) { m_Queue.Put (msgs); }; // and cleanup msgs
+			std::mt19937& GetRng () { return m_Rng; };
+			size_t GetQueueSize () const { return m_Queue.GetSize (); };
+
+		private:
+
+			void Run ();
+
+		private:
+
+			int m_Index;
+			bool m_IsRunning;
+			std::unique_ptr<std::thread> m_Thread;
+			i2p::util::Queue<std::shared_ptr<I2NPMessage> > m_Queue;
+			std::mt19937 m_Rng;
+	};
+
 	class Tunnels
 	{
+		friend class TunnelDataShard;
+
+		typedef std::vector<std::unique_ptr<TunnelDataShard> > DataShards;
+#ifdef __cpp_lib_atomic_shared_ptr
+		typedef std::shared_ptr<DataShards> DataShardsPtr;
+#else
+		typedef boost::shared_ptr<DataShards> DataShardsPtr;
+#endif
+
 		public:
 
 			Tunnels ();
@@ -248,7 +292,11 @@ namespace tunnel
 			void SetMaxNumTransitTunnels (uint32_t maxNumTransitTunnels);
 			uint32_t GetMaxNumTransitTunnels () const { return m_MaxNumTransitTunnels; };
 			int GetCongestionLevel() const { return m_MaxNumTransitTunnels ? CONGESTION_LEVEL_FULL * m_TransitTunnels.GetNumTransitTunnels () / m_MaxNumTransitTunnels : CONGESTION_LEVEL_FULL; }
-			std::mt19937& GetRng () { return m_Rng; }
+			void SetNumDataThreads (int numDataThreads); // 0 - handle tunnel data in tunnels thread, must be called before Start
+			void SetNumBuildThreads (int numBuildThreads) { m_TransitTunnels.SetNumBuildThreads (numBuildThreads); }; // 0 - decrypt in TBM thread, must be called before Start
+			int GetNumDataThreads () const { return m_NumDataThreads; };
+			std::mt19937& GetRng (); // of calling tunnel data thread
+			bool IsDataThread () const; // true if called from tunnel data thread
 			
 		private:
 
@@ -259,6 +307,9 @@ namespace tunnel
 			template<class TTunnel>
 			std::shared_ptr<TTunnel> GetPendingTunnel (uint32_t replyMsgID, const std::map<uint32_t, std::shared_ptr<TTunnel> >& pendingTunnels);
 
+			DataShardsPtr GetDataShards () const;
+			int GetDataShardIndex (std::shared_ptr<const I2NPMessage> msg, size_t numShards) const; // -1 if not tunnel data
+			std::shared_ptr<TunnelBase> HandleTunnelDataMsg (std::shared_ptr<I2NPMessage>&& msg, std::shared_ptr<TunnelBase> prevTunnel); // returns tunnel
 			void HandleTunnelGatewayMsg (std::shared_ptr<TunnelBase> tunnel, std::shared_ptr<I2NPMessage> msg);
 			void HandleShortTunnelBuildMsg (std::shared_ptr<I2NPMessage> msg);
 			void HandleVariableTunnelBuildMsg (std::shared_ptr<I2NPMessage> msg);
@@ -272,6 +323,7 @@ namespace tunnel
 			template<class PendingTunnels>
 			void ManagePendingTunnels (PendingTunnels& pendingTunnels, uint64_t ts);
 			void ManageTunnelPools (uint64_t ts);
+			void RegisterMetrics ();
 
 			std::shared_ptr<ZeroHopsInboundTunnel> CreateZeroHopsInboundTunnel (std::shared_ptr<TunnelPool> pool);
 			std::shared_ptr<ZeroHopsOutboundTunnel> CreateZeroHopsOutboundTunnel (std::shared_ptr<TunnelPool> pool);
@@ -298,8 +350,6 @@ namespace tunnel
 
 			bool m_IsRunning;
 			std::thread * m_Thread;
-			i2p::util::MemoryPoolMt<I2NPMessageBuffer<I2NP_TUNNEL_ENPOINT_MESSAGE_SIZE> > m_I2NPTunnelEndpointMessagesMemoryPool;
-			i2p::util::MemoryPoolMt<I2NPMessageBuffer<I2NP_TUNNEL_MESSAGE_SIZE> > m_I2NPTunnelMessagesMemoryPool;
 			std::map<uint32_t, std::shared_ptr<InboundTunnel> > m_PendingInboundTunnels; // by replyMsgID
 			std::map<uint32_t, std::shared_ptr<OutboundTunnel> > m_PendingOutboundTunnels; // by replyMsgID
 			std::list<std::shared_ptr<InboundTunnel> > m_InboundTunnels;
@@ -310,6 +360,12 @@ namespace tunnel
 			std::list<std::shared_ptr<TunnelPool>> m_Pools;
 			std::shared_ptr<TunnelPool> m_ExploratoryPool;
 			i2p::util::Queue<std::shared_ptr<I2NPMessage> > m_Queue;
+			int m_NumDataThreads;
+#ifdef __cpp_lib_atomic_shared_ptr
+			std::atomic<DataShardsPtr> m_DataShards; // TunnelData and TunnelGateway by tunnelID, null if not running
+#else
+			DataShardsPtr m_DataShards; // TunnelData and TunnelGateway by tunnelID, null if not running
+#endif
 			uint32_t m_MaxNumTransitTunnels;
 			// count of tunnels for total TCSR algorithm
 			int m_TotalNumSuccesiveTunnelCreations, m_TotalNumFailedTunnelCreations;
@@ -329,8 +385,9 @@ namespace tunnel
 			size_t CountInboundTunnels() const;
 			size_t CountOutboundTunnels() const;
 
-			size_t GetQueueSize () const { return m_Queue.GetSize (); };
+			size_t GetQueueSize () const;
 			size_t GetTBMQueueSize () const { return m_TransitTunnels.GetTunnelBuildMsgQueueSize (); };
+			TransitTunnelBuildStats GetTBMStats () const { return m_TransitTunnels.GetTunnelBuildStats (); };
 			int GetTunnelCreationSuccessRate () const { return std::round(m_TunnelCreationSuccessRate * 100); } // in percents
 			double GetPreciseTunnelCreationSuccessRate () const { return m_TunnelCreationSuccessRate * 100; } // in percents
 			int GetTotalTunnelCreationSuccessRate () const // in percents
@@ -13,6 +13,7 @@
 #include <memory>
 #include <future>
 #include <list>
+#include <vector>
 #include "Timestamp.h"
 #include "I2NPProtocol.h"
 #include "Identity.h"
@@ -58,6 +59,12 @@ namespace tunnel
 			virtual void SendTunnelDataMsg (std::shared_ptr<i2p::I2NPMessage> msg) = 0;
 			virtual void FlushTunnelDataMsgs () {};
 			virtual void EncryptTunnelMsg (std::shared_ptr<const I2NPMessage> in, std::shared_ptr<I2NPMessage> out) = 0;
+			virtual void EncryptTunnelMsgs (const std::vector<std::shared_ptr<const I2NPMessage> >& in,
+				const std::vector<std::shared_ptr<I2NPMessage> >& out) // in and out of same size
+			{
+				for (size_t i = 0; i < in.size () && i < out.size (); i++)
+					EncryptTunnelMsg (in[i], out[i]);
+			};
 			uint32_t GetNextTunnelID () const { return m_NextTunnelID; };
 			const i2p::data::IdentHash& GetNextIdentHash () const { return m_NextIdent; };
 			virtual uint32_t GetTunnelID () const { return m_TunnelID; }; // as known at our side
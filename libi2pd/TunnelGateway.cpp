@@ -224,13 +224,16 @@ namespace tunnel
 		m_Buffer.CompleteCurrentTunnelDataMessage ();
 		std::list<std::shared_ptr<I2NPMessage> > newTunnelMsgs;
 		const auto& tunnelDataMsgs = m_Buffer.GetTunnelDataMsgs ();
-		for (auto& tunnelMsg : tunnelDataMsgs)
+		std::vector<std::shared_ptr<I2NPMessage> > encryptedMsgs (tunnelDataMsgs.size ());
+		for (auto& it: encryptedMsgs)
+			it = CreateEmptyTunnelDataMsg (false);
+		m_Tunnel.EncryptTunnelMsgs (tunnelDataMsgs, encryptedMsgs); // all at once
+		for (size_t i = 0; i < encryptedMsgs.size (); i++)
 		{
-			auto newMsg = CreateEmptyTunnelDataMsg (false);
-			m_Tunnel.EncryptTunnelMsg (tunnelMsg, newMsg);
+			auto& newMsg = encryptedMsgs[i];
 			htobe32buf (newMsg->GetPayload (), m_Tunnel.GetNextTunnelID ());
 			newMsg->FillI2NPMessageHeader (eI2NPTunnelData);
-			if (tunnelMsg->onDrop) newMsg->onDrop = tunnelMsg->onDrop;
+			if (tunnelDataMsgs[i]->onDrop) newMsg->onDrop = tunnelDataMsgs[i]->onDrop;
 			newTunnelMsgs.push_back (newMsg);
 			m_NumSentBytes += TUNNEL_DATA_MSG_SIZE;
 		}
@@ -131,6 +131,196 @@ namespace i2p
 {
 namespace util
 {
+	static std::mutex g_SlabsMutex;
+	static std::atomic<int> g_NumSlabsWithCache{0};
+	static Slab * g_SlabsWithCache[SLAB_MAX_NUM_CLASSES]; // by index
+
+	static std::vector<Slab *>& GetSlabs ()
+	{
+		static auto slabs = new std::vector<Slab *>(); // never deleted, as slabs
+		return *slabs;
+	}
+
+	struct SlabThreadCache
+	{
+		struct Entry
+		{
+			void * blocks[SLAB_THREAD_CACHE_SIZE];
+			size_t num = 0;
+			uint64_t numAcquired = 0; // not added to slab's counter yet
+		};
+
+		~SlabThreadCache ();
+
+		Entry entries[SLAB_MAX_NUM_CLASSES];
+	};
+
+	static thread_local bool g_IsSlabThreadCacheDestroyed = false; // blocks go to heap directly after that
+	static thread_local SlabThreadCache g_SlabThreadCache;
+
+	SlabThreadCache::~SlabThreadCache ()
+	{
+		g_IsSlabThreadCacheDestroyed = true;
+		for (int i = 0; i < SLAB_MAX_NUM_CLASSES; i++)
+		{
+			auto& entry = entries[i];
+			if (!entry.num && !entry.numAcquired) continue;
+			auto slab = g_SlabsWithCache[i];
+			slab->Flush (entry.blocks, entry.num);
+			slab->m_NumAcquired.fetch_add (entry.numAcquired, std::memory_order_relaxed);
+		}
+	}
+
+	Slab::Slab (size_t blockSize):
+		m_BlockSize (blockSize), m_CacheSize (GetSlabThreadCacheSize (blockSize)), m_BatchSize (m_CacheSize/2),
+		m_Index (-1), m_Depot (nullptr), m_DepotSize (0), m_MinDepotSize (0),
+		m_NumAcquired (0), m_NumAllocated (0), m_NumLive (0), m_NumPeakLive (0)
+	{
+		std::lock_guard<std::mutex> l(g_SlabsMutex);
+		int index = g_NumSlabsWithCache.load ();
+		if (index < SLAB_MAX_NUM_CLASSES)
+		{
+			m_Index = index;
+			g_SlabsWithCache[index] = this;
+			g_NumSlabsWithCache.store (index + 1);
+		}
+		GetSlabs ().push_back (this);
+	}
+
+	void * Slab::Allocate ()
+	{
+		if (m_Index < 0 || g_IsSlabThreadCacheDestroyed)
+		{
+			m_NumAcquired.fetch_add (1, std::memory_order_relaxed);
+			UpdateNumLive (1);
+			return AllocateFromHeap ();
+		}
+		auto& entry = g_SlabThreadCache.entries[m_Index];
+		if (!entry.num) Refill (entry.blocks, entry.num);
+		if (++entry.numAcquired >= m_CacheSize)
+		{
+			m_NumAcquired.fetch_add (entry.numAcquired, std::memory_order_relaxed);
+			entry.numAcquired = 0;
+		}
+		return entry.blocks[--entry.num];
+	}
+
+	void Slab::Deallocate (void * p)
+	{
+		if (!p) return;
+		if (m_Index < 0 || g_IsSlabThreadCacheDestroyed)
+		{
+			::operator delete (p);
+			UpdateNumLive (-1);
+			return;
+		}
+		auto& entry = g_SlabThreadCache.entries[m_Index];
+		if (entry.num >= m_CacheSize)
+		{
+			entry.num -= m_BatchSize;
+			Flush (entry.blocks + entry.num, m_BatchSize);
+		}
+		entry.blocks[entry.num++] = p;
+	}
+
+	void * Slab::AllocateFromHeap ()
+	{
+		m_NumAllocated.fetch_add (1, std::memory_order_relaxed);
+		return ::operator new (m_BlockSize);
+	}
+
+	void Slab::Refill (void * * blocks, size_t& num)
+	{
+		{
+			std::lock_guard<std::mutex> l(m_DepotMutex);
+			while (m_Depot && num < m_BatchSize)
+			{
+				blocks[num++] = m_Depot;
+				m_Depot = *(void * *)m_Depot; // next
+				m_DepotSize--;
+			}
+			if (m_DepotSize < m_MinDepotSize) m_MinDepotSize = m_DepotSize;
+		}
+		if (!num) blocks[num++] = AllocateFromHeap (); // depot is empty
+		UpdateNumLive (num);
+	}
+
+	void Slab::Flush (void * * blocks, size_t num)
+	{
+		if (!num) return;
+		{
+			std::lock_guard<std::mutex> l(m_DepotMutex);
+			for (size_t i = 0; i < num; i++)
+			{
+				*(void * *)blocks[i] = m_Depot; // next
+				m_Depot = blocks[i];
+			}
+			m_DepotSize += num;
+		}
+		UpdateNumLive (-(int64_t)num);
+	}
+
+	void Slab::UpdateNumLive (int64_t delta)
+	{
+		auto numLive = m_NumLive.fetch_add (delta, std::memory_order_relaxed) + delta;
+		auto peak = m_NumPeakLive.load (std::memory_order_relaxed);
+		while (numLive > peak && !m_NumPeakLive.compare_exchange_weak (peak, numLive, std::memory_order_relaxed)) ;
+	}
+
+	void Slab::CleanUp ()
+	{
+		void * head = nullptr;
+		{
+			std::lock_guard<std::mutex> l(m_DepotMutex);
+			// blocks were not requested from depot since last cleanup
+			for (size_t i = 0; i < m_MinDepotSize && m_Depot; i++)
+			{
+				auto block = m_Depot;
+				m_Depot = *(void * *)block;
+				*(void * *)block = head;
+				head = block;
+				m_DepotSize--;
+			}
+			m_MinDepotSize = m_DepotSize;
+		}
+		while (head)
+		{
+			auto tmp = head;
+			head = *(void * *)head; // next
+			::operator delete (tmp);
+		}
+	}
+
+	SlabStats Slab::GetStats () const
+	{
+		SlabStats stats;
+		stats.blockSize = m_BlockSize;
+		stats.threadCacheSize = m_CacheSize;
+		stats.numAcquired = m_NumAcquired.load (std::memory_order_relaxed);
+		auto numAllocated = m_NumAllocated.load (std::memory_order_relaxed);
+		stats.numHits = stats.numAcquired > numAllocated ? stats.numAcquired - numAllocated : 0;
+		stats.numLive = m_NumLive.load (std::memory_order_relaxed);
+		stats.numPeakLive = m_NumPeakLive.load (std::memory_order_relaxed);
+		std::lock_guard<std::mutex> l(m_DepotMutex);
+		stats.numFree = m_DepotSize;
+		return stats;
+	}
+
+	void Slab::CleanUpAll ()
+	{
+		std::lock_guard<std::mutex> l(g_SlabsMutex);
+		for (auto it: GetSlabs ())
+			it->CleanUp ();
+	}
+
+	std::vector<SlabStats> Slab::GetAllStats ()
+	{
+		std::vector<SlabStats> stats;
+		std::lock_guard<std::mutex> l(g_SlabsMutex);
+		for (auto it: GetSlabs ())
+			stats.push_back (it->GetStats ());
+		return stats;
+	}
 
 	void RunnableService::StartIOService ()
 	{
@@ -14,6 +14,8 @@
 #include <map>
 #include <functional>
 #include <memory>
+#include <vector>
+#include <atomic>
 #include <mutex>
 #include <thread>
 #include <utility>
@@ -173,6 +175,221 @@ namespace util
 			std::mutex m_Mutex;
 	};
 
+	const int SLAB_MAX_NUM_CLASSES = 16; // with thread caches, others go to heap directly
+	const size_t SLAB_THREAD_CACHE_SIZE = 32; // max blocks per thread per class
+	const size_t SLAB_MIN_THREAD_CACHE_SIZE = 2;
+	const size_t SLAB_THREAD_CACHE_MAX_BYTES = 256*1024; // per thread per class, fewer blocks for large classes
+
+	inline size_t GetSlabThreadCacheSize (size_t blockSize)
+	{
+		auto num = SLAB_THREAD_CACHE_MAX_BYTES/blockSize;
+		if (num < SLAB_MIN_THREAD_CACHE_SIZE) return SLAB_MIN_THREAD_CACHE_SIZE;
+		return num < SLAB_THREAD_CACHE_SIZE ? num : SLAB_THREAD_CACHE_SIZE;
+	}
+
+	struct SlabStats
+	{
+		size_t blockSize, threadCacheSize; // half of thread cache is moved to/from depot at once
+		uint64_t numAcquired, numHits; // hit means served without heap allocation
+		int64_t numLive, numPeakLive; // outside of depot, including thread caches
+		size_t numFree; // in depot
+	};
+
+	/**
+	 * Size class of fixed size blocks shared by all threads.
+	 * Each thread has own cache of free blocks, half of cache is moved to/from common depot at once,
+	 * so block released by another thread returns to depot through that thread's cache.
+	 * Slabs are never deleted, blocks might be released after exit from main
+	 */
+	class Slab
+	{
+		public:
+
+			Slab (size_t blockSize);
+			Slab (const Slab&) = delete;
+			Slab& operator= (const Slab&) = delete;
+
+			void * Allocate ();
+			void Deallocate (void * p);
+			void CleanUp (); // return blocks unused since last cleanup to heap
+			SlabStats GetStats () const;
+
+			static void CleanUpAll ();
+			static std::vector<SlabStats> GetAllStats ();
+
+		private:
+
+			void * AllocateFromHeap ();
+			void Refill (void * * blocks, size_t& num); // from depot or heap
+			void Flush (void * * blocks, size_t num); // to depot
+			void UpdateNumLive (int64_t delta);
+
+		private:
+
+			size_t m_BlockSize, m_CacheSize, m_BatchSize; // thread cache
+			int m_Index; // in thread caches, -1 if no cache
+			void * m_Depot; // linked list of free blocks
+			size_t m_DepotSize, m_MinDepotSize; // min since last cleanup
+			mutable std::mutex m_DepotMutex;
+			std::atomic<uint64_t> m_NumAcquired, m_NumAllocated; // allocated from heap
+			std::atomic<int64_t> m_NumLive, m_NumPeakLive;
+
+		friend struct SlabThreadCache;
+	};
+
+	template<size_t blockSize>
+	Slab& GetSlab ()
+	{
+		static_assert (blockSize >= sizeof (void *), "slab block must fit pointer");
+		static Slab * slab = new Slab (blockSize); // never deleted
+		return *slab;
+	}
+
+	template<typename T>
+	struct SlabAllocator // for std::allocate_shared, single objects of same size share slab
+	{
+		typedef T value_type;
+
+		SlabAllocator () = default;
+		template<typename U>
+		SlabAllocator (const SlabAllocator<U>&) {}
+
+		T * allocate (size_t n)
+		{
+			if (n != 1) return static_cast<T *>(::operator new (n*sizeof (T)));
+			return static_cast<T *>(GetSlab<sizeof (T)> ().Allocate ());
+		}
+
+		void deallocate (T * p, size_t n)
+		{
+			if (n != 1) ::operator delete (p);
+			else GetSlab<sizeof (T)> ().Deallocate (p);
+		}
+
+		template<typename U>
+		bool operator== (const SlabAllocator<U>&) const { return true; }
+		template<typename U>
+		bool operator!= (const SlabAllocator<U>&) const { return false; }
+	};
+
+	const size_t SEQUENCE_WINDOW_INITIAL_CAPACITY = 64; // must be power of 2
+	template<typename T>
+	class SequenceWindow // circular buffer of pointers indexed by sequence number, grows if span doesn't fit
+	{
+		public:
+
+			class Iterator // in sequence number order, skips missing elements
+			{
+				public:
+
+					Iterator (const SequenceWindow * window, uint32_t seqn): m_Window (window), m_Seqn (seqn) {};
+					T * operator* () const { return m_Window->GetSlot (m_Seqn); };
+					Iterator& operator++ () { m_Seqn = m_Window->GetNext (m_Seqn + 1); return *this; };
+					bool operator== (const Iterator& other) const { return m_Seqn == other.m_Seqn; };
+					bool operator!= (const Iterator& other) const { return m_Seqn != other.m_Seqn; };
+					uint32_t GetSeqn () const { return m_Seqn; };
+
+				private:
+
+					const SequenceWindow * m_Window;
+					uint32_t m_Seqn;
+			};
+
+			SequenceWindow (size_t capacity = SEQUENCE_WINDOW_INITIAL_CAPACITY):
+				m_Slots (capacity, nullptr), m_First (0), m_Last (0), m_Size (0) {};
+
+			bool Insert (uint32_t seqn, T * t) // false if element with same seqn is already there
+			{
+				if (!m_Size)
+				{
+					m_First = seqn;
+					m_Last = seqn + 1;
+				}
+				else if (seqn < m_First)
+				{
+					Grow (m_Last - seqn);
+					m_First = seqn;
+				}
+				else if (seqn >= m_Last)
+				{
+					Grow (seqn - m_First + 1);
+					m_Last = seqn + 1;
+				}
+				else if (GetSlot (seqn))
+					return false; // duplicate
+				m_Slots[seqn & (m_Slots.size () - 1)] = t;
+				m_Size++;
+				return true;
+			}
+
+			T * Find (uint32_t seqn) const
+			{
+				if (seqn < m_First || seqn >= m_Last) return nullptr;
+				return GetSlot (seqn);
+			}
+
+			T * Remove (uint32_t seqn) // doesn't invalidate iterators
+			{
+				auto t = Find (seqn);
+				if (!t) return nullptr;
+				m_Slots[seqn & (m_Slots.size () - 1)] = nullptr;
+				m_Size--;
+				if (!m_Size)
+					m_First = m_Last;
+				else if (seqn == m_First)
+					m_First = GetNext (seqn + 1);
+				return t;
+			}
+
+			void Clear ()
+			{
+				for (uint32_t seqn = m_First; seqn != m_Last; seqn++)
+					m_Slots[seqn & (m_Slots.size () - 1)] = nullptr;
+				m_First = m_Last = 0;
+				m_Size = 0;
+			}
+
+			T * GetFirst () const { return m_Size ? GetSlot (m_First) : nullptr; };
+			uint32_t GetFirstSeqn () const { return m_First; };
+			uint32_t GetLastSeqn () const { return m_Last - 1; }; // if not empty
+			size_t GetSize () const { return m_Size; };
+			bool IsEmpty () const { return !m_Size; };
+			size_t GetCapacity () const { return m_Slots.size (); };
+
+			Iterator begin () const { return Iterator (this, m_First); };
+			Iterator end () const { return Iterator (this, m_Last); };
+
+		private:
+
+			T * GetSlot (uint32_t seqn) const { return m_Slots[seqn & (m_Slots.size () - 1)]; };
+
+			uint32_t GetNext (uint32_t seqn) const // first present from seqn or m_Last
+			{
+				while (seqn != m_Last && !GetSlot (seqn)) seqn++;
+				return seqn;
+			}
+
+			void Grow (uint32_t span)
+			{
+				size_t capacity = m_Slots.size ();
+				if (span <= capacity) return;
+				while (capacity < span) capacity <<= 1;
+				std::vector<T *> slots (capacity, nullptr);
+				for (uint32_t seqn = m_First; seqn != m_Last; seqn++)
+				{
+					auto t = GetSlot (seqn);
+					if (t) slots[seqn & (capacity - 1)] = t;
+				}
+				m_Slots.swap (slots);
+			}
+
+		private:
+
+			std::vector<T *> m_Slots;
+			uint32_t m_First, m_Last; // [m_First, m_Last), m_Last is not decreased on remove
+			size_t m_Size;
+	};
+
 	class RunnableService
 	{
 		protected:
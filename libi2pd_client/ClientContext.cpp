@@ -481,6 +481,7 @@ namespace client
 		options.Insert (I2CP_PARAM_STREAMING_DONT_SIGN, GetI2CPOption(section, I2CP_PARAM_STREAMING_DONT_SIGN, DEFAULT_DONT_SIGN));
 		options.Insert (I2CP_PARAM_STREAMING_PROFILE, GetI2CPOption(section, I2CP_PARAM_STREAMING_PROFILE, DEFAULT_STREAMING_PROFILE));
 		options.Insert (I2CP_PARAM_STREAMING_MAX_WINDOW_SIZE, GetI2CPOption(section, I2CP_PARAM_STREAMING_MAX_WINDOW_SIZE, i2p::stream::MAX_WINDOW_SIZE));
+		options.Insert (I2CP_PARAM_STREAMING_CONGESTION_CONTROL, GetI2CPStringOption(section, I2CP_PARAM_STREAMING_CONGESTION_CONTROL, DEFAULT_STREAMING_CONGESTION_CONTROL));
 		options.Insert (I2CP_PARAM_LEASESET_TYPE, GetI2CPOption(section, I2CP_PARAM_LEASESET_TYPE, DEFAULT_LEASESET_TYPE));
 #if OPENSSL_PQ
 		std::string encType = GetI2CPStringOption(section, I2CP_PARAM_LEASESET_ENCRYPTION_TYPE, isServer ? "6,4" : "6,4,0");
@@ -534,6 +535,8 @@ namespace client
 			options.Insert (I2CP_PARAM_STREAMING_PROFILE, value);
 		if (i2p::config::GetOption(prefix + I2CP_PARAM_STREAMING_MAX_WINDOW_SIZE, value))
 			options.Insert (I2CP_PARAM_STREAMING_MAX_WINDOW_SIZE, value);
+		if (i2p::config::GetOption(prefix + I2CP_PARAM_STREAMING_CONGESTION_CONTROL, value))
+			options.Insert (I2CP_PARAM_STREAMING_CONGESTION_CONTROL, value);
 	}
 
 	void ClientContext::ReadTunnels ()
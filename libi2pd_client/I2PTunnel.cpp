@@ -264,10 +264,16 @@ namespace client
 			if (m_Stream->GetStatus () == i2p::stream::eStreamStatusNew ||
 				m_Stream->GetStatus () == i2p::stream::eStreamStatusOpen) // regular
 			{
-				m_Stream->AsyncReceive (boost::asio::buffer (m_StreamBuffer, I2P_TUNNEL_CONNECTION_STREAM_BUFFER_SIZE),
-					std::bind (&I2PTunnelConnection::HandleStreamReceive, shared_from_this (),
-					std::placeholders::_1, std::placeholders::_2),
-					I2P_TUNNEL_CONNECTION_MAX_IDLE);
+				if (IsPayloadWritable ())
+					m_Stream->AsyncReceivePayload (I2P_TUNNEL_CONNECTION_STREAM_BUFFER_SIZE,
+						std::bind (&I2PTunnelConnection::HandleStreamReceivePayload, shared_from_this (),
+						std::placeholders::_1, std::placeholders::_2),
+						I2P_TUNNEL_CONNECTION_MAX_IDLE);
+				else
+					m_Stream->AsyncReceive (boost::asio::buffer (m_StreamBuffer, I2P_TUNNEL_CONNECTION_STREAM_BUFFER_SIZE),
+						std::bind (&I2PTunnelConnection::HandleStreamReceive, shared_from_this (),
+						std::placeholders::_1, std::placeholders::_2),
+						I2P_TUNNEL_CONNECTION_MAX_IDLE);
 			}
 			else // closed by peer
 			{
@@ -302,6 +308,38 @@ namespace client
 			Write (m_StreamBuffer, bytes_transferred);
 	}
 
+	void I2PTunnelConnection::HandleStreamReceivePayload (const boost::system::error_code& ecode, std::shared_ptr<i2p::stream::ReceivedPayload> payload)
+	{
+		if (ecode)
+		{
+			if (ecode != boost::asio::error::operation_aborted)
+			{
+				LogPrint (eLogError, "I2PTunnel: Stream read error: ", ecode.message ());
+				if (ecode == boost::asio::error::timed_out && m_Stream && m_Stream->IsOpen ())
+					StreamReceive ();
+				else
+					Terminate ();
+			}
+			else
+				Terminate ();
+		}
+		else
+			WritePayload (payload);
+	}
+
+	void I2PTunnelConnection::WritePayload (std::shared_ptr<i2p::stream::ReceivedPayload> payload)
+	{
+		// payload keeps stream packets until written
+		auto handler = [s = shared_from_this (), payload](const boost::system::error_code& ecode, std::size_t bytes_transferred)
+			{
+				s->HandleWrite (ecode);
+			};
+		if (m_SSL)
+			boost::asio::async_write (*m_SSL, payload->buffers, boost::asio::transfer_all (), handler);
+		else
+			boost::asio::async_write (*m_Socket, payload->buffers, boost::asio::transfer_all (), handler);
+	}
+
 	void I2PTunnelConnection::Write (const uint8_t * buf, size_t len)
 	{
 		if (m_SSL)
@@ -63,7 +63,10 @@ namespace client
 			void Receive ();
 			void StreamReceive ();
 			void HandleStreamReceive (const boost::system::error_code& ecode, std::size_t bytes_transferred);
+			void HandleStreamReceivePayload (const boost::system::error_code& ecode, std::shared_ptr<i2p::stream::ReceivedPayload> payload);
+			virtual bool IsPayloadWritable () const { return true; }; // stream data goes to socket as is, without Write
 			virtual void Write (const uint8_t * buf, size_t len); // can be overloaded
+			void WritePayload (std::shared_ptr<i2p::stream::ReceivedPayload> payload);
 			virtual void WriteToStream (const uint8_t * buf, size_t len); // can be overloaded
 
 			std::shared_ptr<boost::asio::ip::tcp::socket> GetSocket () const { return m_Socket; };
@@ -99,6 +102,7 @@ namespace client
 
 		protected:
 
+			bool IsPayloadWritable () const override { return m_HeaderSent; };
 			void Write (const uint8_t * buf, size_t len) override;
 
 		private:
@@ -117,6 +121,7 @@ namespace client
 
 		protected:
 
+			bool IsPayloadWritable () const override { return m_HeaderSent; };
 			void Write (const uint8_t * buf, size_t len) override;
 			void WriteToStream (const uint8_t * buf, size_t len) override;
 
@@ -137,6 +142,7 @@ namespace client
 
 		protected:
 
+			bool IsPayloadWritable () const override { return false; };
 			void Write (const uint8_t * buf, size_t len) override;
 
 		private:
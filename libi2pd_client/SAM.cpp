@@ -1080,8 +1080,8 @@ namespace client
 			if (m_Stream->GetStatus () == i2p::stream::eStreamStatusNew ||
 				m_Stream->GetStatus () == i2p::stream::eStreamStatusOpen) // regular
 			{
-				m_Stream->AsyncReceive (boost::asio::buffer (m_StreamBuffer, SAM_STREAM_BUFFER_SIZE),
-						std::bind (&SAMSocket::HandleI2PReceive, shared_from_this(),
+				m_Stream->AsyncReceivePayload (SAM_STREAM_BUFFER_SIZE,
+						std::bind (&SAMSocket::HandleI2PReceivePayload, shared_from_this(),
 						std::placeholders::_1, std::placeholders::_2),
 							SAM_SOCKET_CONNECTION_MAX_IDLE);
 			}
@@ -1163,6 +1163,33 @@ namespace client
 		}
 	}
 
+	void SAMSocket::WriteI2PPayload (std::shared_ptr<i2p::stream::ReceivedPayload> payload)
+	{
+		boost::asio::async_write (
+			m_Socket,
+			payload->buffers,
+			boost::asio::transfer_all(),
+			[s = shared_from_this (), payload](const boost::system::error_code& ecode, size_t bytes_transferred)
+			{
+				s->HandleWriteI2PData (ecode, bytes_transferred); // payload keeps stream packets until written
+			});
+	}
+
+	void SAMSocket::HandleI2PReceivePayload (const boost::system::error_code& ecode, std::shared_ptr<i2p::stream::ReceivedPayload> payload)
+	{
+		if (ecode)
+		{
+			LogPrint (eLogError, "SAM: Stream read error: ", ecode.message ());
+			auto s = shared_from_this ();
+			if (ecode != boost::asio::error::operation_aborted)
+				boost::asio::post (m_Owner.GetService (), [s] { s->Terminate ("stream read error"); });
+			else
+				boost::asio::post (m_Owner.GetService (), [s] { s->Terminate ("stream read error (op aborted)"); });
+		}
+		else if (m_SocketType != SAMSocketType::eSAMSocketTypeTerminated)
+			WriteI2PPayload (payload);
+	}
+
 	void SAMSocket::HandleWriteI2PData (const boost::system::error_code& ecode, size_t bytes_transferred)
 	{
 		if (ecode)
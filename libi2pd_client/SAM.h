@@ -142,6 +142,7 @@ namespace client
 
 			void I2PReceive ();
 			void HandleI2PReceive (const boost::system::error_code& ecode, std::size_t bytes_transferred);
+			void HandleI2PReceivePayload (const boost::system::error_code& ecode, std::shared_ptr<i2p::stream::ReceivedPayload> payload);
 			void HandleI2PAccept (std::shared_ptr<i2p::stream::Stream> stream);
 			void HandleI2PForward (std::shared_ptr<i2p::stream::Stream> stream, boost::asio::ip::tcp::endpoint ep);
 			void HandleWriteI2PData (const boost::system::error_code& ecode, size_t sz);
@@ -173,6 +174,7 @@ namespace client
 			void SendSessionCreateReplyOk ();
 
 			void WriteI2PData(size_t sz);
+			void WriteI2PPayload (std::shared_ptr<i2p::stream::ReceivedPayload> payload);
 			void WriteI2PDataImmediate(uint8_t * ptr, size_t sz);
 
 			void HandleWriteI2PDataImmediate(const boost::system::error_code & ec, uint8_t * buff);
@@ -0,0 +1,144 @@
+#include <cassert>
+#include <chrono>
+#include <inttypes.h>
+#include <iostream>
+#include <string.h>
+#include <vector>
+#include <openssl/rand.h>
+
+#include "Signature.h"
+#include "Ed25519Batch.h"
+
+using namespace i2p::crypto;
+
+struct Signed
+{
+	uint8_t pub[32], sig[64];
+	std::vector<uint8_t> msg;
+};
+
+static std::vector<Signed> CreateSigned (int num)
+{
+	std::vector<Signed> res (num);
+	for (auto& it: res)
+	{
+		uint8_t priv[32];
+		CreateEDDSA25519RandomKeys (priv, it.pub);
+		it.msg.resize (300 + rand () % 700); // RouterInfo size
+		RAND_bytes (it.msg.data (), it.msg.size ());
+		EDDSA25519Signer signer (priv);
+		signer.Sign (it.msg.data (), it.msg.size (), it.sig);
+	}
+	return res;
+}
+
+static std::vector<bool> BatchVerify (const std::vector<Signed>& sigs)
+{
+	Ed25519BatchVerifier batch;
+	for (const auto& it: sigs)
+		batch.Add (it.pub, it.msg.data (), it.msg.size (), it.sig);
+	std::vector<bool> results;
+	batch.Verify (results);
+	return results;
+}
+
+static bool IndividualVerify (const Signed& s)
+{
+	EDDSA25519Verifier verifier;
+	verifier.SetPublicKey (s.pub);
+	return verifier.Verify (s.msg.data (), s.msg.size (), s.sig);
+}
+
+int main ()
+{
+	// all valid
+	{
+		for (int num: { 1, 3, 4, 5, 64, 300 })
+		{
+			auto sigs = CreateSigned (num);
+			auto results = BatchVerify (sigs);
+			assert (results.size () == (size_t)num);
+			for (auto r: results) assert (r);
+		}
+	}
+	// bad signatures are found
+	{
+		auto sigs = CreateSigned (100);
+		sigs[0].msg[10] ^= 1; // message changed
+		sigs[17].sig[5] ^= 0x40; // R changed
+		sigs[18].sig[40] ^= 0x01; // s changed
+		sigs[50].pub[3] ^= 0x10; // another key
+		memset (sigs[51].pub, 0xFF, 32); // not a point
+		// s + l is not canonical
+		static const uint8_t l[32] =
+		{
+			0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58, 0xd6, 0x9c, 0xf7, 0xa2, 0xde, 0xf9, 0xde, 0x14,
+			0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10
+		};
+		int carry = 0;
+		for (int i = 0; i < 32; i++)
+		{
+			int v = sigs[99].sig[32 + i] + l[i] + carry;
+			sigs[99].sig[32 + i] = v; carry = v >> 8;
+		}
+		auto results = BatchVerify (sigs);
+		for (size_t i = 0; i < sigs.size (); i++)
+			assert (results[i] == IndividualVerify (sigs[i]));
+		for (size_t i: { 0, 17, 18, 50, 51, 99 })
+			assert (!results[i]);
+		assert (results[1] && results[98]);
+	}
+	// small order component, must match OpenSSL regardless of batch size
+	{
+		static const uint8_t order8[32] =
+		{
+			0x26, 0xe8, 0x95, 0x8f, 0xc2, 0xb2, 0x27, 0xb0, 0x45, 0xc3, 0xf4, 0x89, 0xf2, 0xef, 0x98, 0xf0,
+			0xd5, 0xdf, 0xac, 0x05, 0xd3, 0xc6, 0x33, 0x39, 0xb1, 0x38, 0x02, 0x88, 0x6d, 0x53, 0xfc, 0x05
+		};
+		auto sigs = CreateSigned (64);
+		std::vector<size_t> torsion;
+		for (size_t i = 0; i < 8; i++)
+		{
+			// A is of order 8, R is identity and s is zero, cofactored equation holds always
+			auto& it = sigs[i*8];
+			memcpy (it.pub, order8, 32);
+			memset (it.sig, 0, 64); it.sig[0] = 1;
+			torsion.push_back (i*8);
+		}
+		// R with order 8 component
+		memcpy (sigs[63].sig, order8, 32);
+		size_t numRejected = 0;
+		for (size_t num: { 4, 16, 64 })
+		{
+			std::vector<Signed> part (sigs.begin (), sigs.begin () + num);
+			auto results = BatchVerify (part);
+			for (size_t i = 0; i < num; i++)
+				assert (results[i] == IndividualVerify (part[i]));
+		}
+		for (auto i: torsion)
+			if (!IndividualVerify (sigs[i])) numRejected++;
+		assert (numRejected > 0 && !IndividualVerify (sigs[63]));
+	}
+	// all bad
+	{
+		auto sigs = CreateSigned (20);
+		for (auto& it: sigs) it.sig[63] ^= 0x04;
+		auto results = BatchVerify (sigs);
+		for (auto r: results) assert (!r);
+	}
+	// benchmark
+	{
+		const int num = 1000;
+		auto sigs = CreateSigned (num);
+		auto start = std::chrono::steady_clock::now ();
+		for (const auto& it: sigs)
+			assert (IndividualVerify (it));
+		double t = std::chrono::duration<double>(std::chrono::steady_clock::now () - start).count ();
+		start = std::chrono::steady_clock::now ();
+		auto results = BatchVerify (sigs);
+		double t1 = std::chrono::duration<double>(std::chrono::steady_clock::now () - start).count ();
+		for (auto r: results) assert (r);
+		std::cout << "Ed25519 verify: " << num/t << " sigs/sec individual, " << num/t1 << " sigs/sec batch" << std::endl;
+	}
+	return 0;
+}
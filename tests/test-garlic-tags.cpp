@@ -0,0 +1,80 @@
+#include <cassert>
+#include <inttypes.h>
+#include <memory>
+#include <vector>
+
+#include "ECIESX25519AEADRatchetSession.h"
+#include "Garlic.h"
+#include "Timestamp.h"
+
+using namespace i2p::garlic;
+
+struct TrimmedTagSet: public SymmetricKeyTagSet
+{
+	TrimmedTagSet (const uint8_t * key): SymmetricKeyTagSet (nullptr, key) {}
+	bool IsIndexExpired (int index) const override { return index < trimBehind; };
+	int trimBehind = 0;
+};
+
+int main ()
+{
+	uint8_t key[32] = { 0 };
+	const int numTags = 10000;
+	auto tagset1 = std::make_shared<ReceiveRatchetTagSet>(nullptr); // no session, terminated
+	auto tagset2 = std::make_shared<SymmetricKeyTagSet>(nullptr, key);
+	ECIESX25519TagsTable tags;
+	ECIESX25519AEADRatchetIndexTagset indexTagset;
+	assert (!tags.Extract (1, indexTagset));
+	// insert and extract
+	for (int i = 0; i < numTags; i++)
+	{
+		tags.Insert (i*2, i, tagset1);
+		tags.Insert (i*2 + 1, i, tagset2);
+	}
+	assert (tags.GetNumTags () == 2*numTags);
+	assert (tags.GetNumTagsets () == 2);
+	tags.Insert (0, 12345, tagset2); // existing tag is not replaced
+	assert (tags.GetNumTags () == 2*numTags);
+	for (int i = 0; i < numTags; i += 2)
+	{
+		assert (tags.Extract (i*2, indexTagset));
+		assert (indexTagset.index == i && indexTagset.tagset == tagset1);
+		assert (tags.Extract (i*2 + 1, indexTagset));
+		assert (indexTagset.index == i && indexTagset.tagset == tagset2);
+		assert (!tags.Extract (i*2, indexTagset)); // used
+	}
+	assert (tags.GetNumTags () == numTags);
+	assert (!tags.Extract (2*numTags, indexTagset));
+	// drop whole tagset at once
+	auto ts = i2p::util::GetSecondsSinceEpoch ();
+	assert (tags.CleanupExpired (ts) == numTags/2);
+	assert (tags.GetNumTags () == numTags/2);
+	assert (tags.GetNumTagsets () == 1);
+	for (int i = 1; i < numTags; i += 2)
+	{
+		assert (!tags.Extract (i*2, indexTagset)); // stale
+		assert (tags.Extract (i*2 + 1, indexTagset));
+		assert (indexTagset.index == i && indexTagset.tagset == tagset2);
+	}
+	assert (!tags.GetNumTags ());
+	// empty tagsets are dropped and table shrinks
+	assert (tags.CleanupExpired (ts) == 0);
+	assert (!tags.GetNumTagsets ());
+	assert (tags.GetCapacity () == ECIESX25519_TAGS_TABLE_MIN_CAPACITY);
+	// tag of dropped tagset can be inserted again
+	tags.Insert (2, 7, tagset1);
+	assert (tags.Extract (2, indexTagset));
+	assert (indexTagset.index == 7 && indexTagset.tagset == tagset1);
+	// tags behind trim index are purged by cleanup
+	auto tagset3 = std::make_shared<TrimmedTagSet>(key);
+	for (int i = 0; i < numTags; i++)
+		tags.Insert (i*2 + 1, i, tagset3);
+	tagset3->trimBehind = numTags/4;
+	assert (tags.CleanupExpired (ts) == numTags/4);
+	assert (tags.GetNumTags () == numTags - numTags/4);
+	assert (!tags.Extract (1, indexTagset));
+	assert (tags.Extract ((numTags/4)*2 + 1, indexTagset));
+	assert (indexTagset.index == numTags/4 && indexTagset.tagset == tagset3);
+	tags.Clear ();
+	assert (!tags.GetNumTags () && !tags.GetNumTagsets ());
+}
@@ -0,0 +1,70 @@
+#include <cassert>
+#include <inttypes.h>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Log.h"
+
+using namespace i2p::log;
+
+static std::vector<std::string> GetLines (const std::string& text)
+{
+	std::vector<std::string> lines;
+	std::stringstream s (text);
+	std::string line;
+	while (std::getline (s, line))
+		lines.push_back (line);
+	return lines;
+}
+
+int main ()
+{
+	auto& logger = Logger ();
+	logger.SetLogLevel ("debug");
+	// text, from many threads, some records don't fit to thread buffer
+	auto out = std::make_shared<std::stringstream>();
+	logger.SendTo (out);
+	logger.Start ();
+	const int numThreads = 4, numMsgs = 5000;
+	std::vector<std::thread> threads;
+	for (int i = 0; i < numThreads; i++)
+		threads.emplace_back ([i]()
+			{
+				for (int j = 0; j < numMsgs; j++)
+					LogPrint (eLogInfo, "Test: thread ", i, " msg ", j, " ", 1.5, ' ', std::string ("str"), " ", (uint8_t)'x', " ", true);
+			});
+	for (auto& it: threads) it.join ();
+	std::string longText (LOG_MAX_RECORD_SIZE, 'a');
+	LogPrint (eLogWarning, "Test: ", longText);
+	LogPrint (eLogDebug, "Test: ", (const char *)nullptr, "null");
+	logger.Stop ();
+	auto lines = GetLines (out->str ());
+	assert (lines.size () == numThreads*numMsgs + 3); // with "Logging level set"
+	assert (lines[1].find ("/info - Test: thread ") != std::string::npos);
+	assert (lines[1].find (" 1.5 str x 1") != std::string::npos);
+	assert (lines[numThreads*numMsgs + 1].find ("/warn - Test: " + longText) != std::string::npos);
+	assert (lines[numThreads*numMsgs + 2].find ("/debug - Test: null") != std::string::npos);
+
+	// json with rate limit
+	out = std::make_shared<std::stringstream>();
+	logger.SendTo (out);
+	logger.SetLogFormat ("json");
+	logger.SetRateLimit (2);
+	logger.Start ();
+	for (int i = 0; i < 10; i++)
+		LogPrint (eLogError, "Test: \"quoted\"\tmessage");
+	logger.Stop ();
+	lines = GetLines (out->str ());
+	assert (lines.size () == 2);
+	assert (lines[0].find ("\"level\":\"error\",\"module\":\"Test\",\"msg\":\"\\\"quoted\\\"\\tmessage\"}") != std::string::npos);
+	logger.Start ();
+	LogPrint (eLogError, "Test: other");
+	std::this_thread::sleep_for (std::chrono::milliseconds (LOG_RATE_LIMIT_INTERVAL*1000 + 100));
+	logger.Stop ();
+	lines = GetLines (out->str ());
+	assert (lines.size () == 4);
+	assert (lines[3].find ("\"msg\":\"Suppressed 8 repeated messages: Test: \\\"quoted\\\"\\tmessage\"") != std::string::npos);
+}
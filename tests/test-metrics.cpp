@@ -0,0 +1,66 @@
+#include <cassert>
+#include <inttypes.h>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Metrics.h"
+
+using namespace i2p::metrics;
+
+static bool Contains (const std::string& text, const std::string& line)
+{
+	return text.find (line + "\n") != std::string::npos;
+}
+
+int main ()
+{
+	Registry registry;
+	// counter from many threads
+	auto& counter = registry.GetCounter ("test_events_total", "Test events", "kind=\"a\"");
+	assert (&counter == &registry.GetCounter ("test_events_total", "Test events", "kind=\"a\""));
+	const int numThreads = 8, numIncs = 100000;
+	std::vector<std::thread> threads;
+	for (int i = 0; i < numThreads; i++)
+		threads.emplace_back ([&counter]()
+			{
+				for (int j = 0; j < numIncs; j++)
+					counter.Inc ();
+			});
+	for (auto& it: threads) it.join ();
+	assert (counter.GetValue () == (uint64_t)numThreads*numIncs);
+	registry.GetCounter ("test_events_total", "Test events", "kind=\"b\"").Inc (5);
+	// gauge
+	auto& gauge = registry.GetGauge ("test_depth", "Test depth");
+	gauge.Set (10); gauge.Add (-3);
+	assert (gauge.GetValue () == 7);
+	// histogram
+	auto& histogram = registry.GetHistogram ("test_latency", "Test latency", { 10, 100 });
+	histogram.Observe (5); histogram.Observe (10); histogram.Observe (50); histogram.Observe (1000);
+	assert (histogram.GetCount () == 4);
+	// callbacks, last one wins
+	registry.SetCallback ("test_value", "Test value", eMetricTypeGauge, []() { return (int64_t)1; });
+	registry.SetCallback ("test_value", "Test value", eMetricTypeGauge, []() { return (int64_t)42; });
+	registry.SetCallback ("test_depth", "Test depth", eMetricTypeCounter, []() { return (int64_t)0; }); // wrong type, ignored
+	registry.GetGauge ("test_events_total", "Test events", "kind=\"c\"").Set (3); // wrong type with new labels, not exposed
+
+	std::stringstream s;
+	registry.WritePrometheusText (s);
+	auto text = s.str ();
+	assert (Contains (text, "# HELP i2pd_test_events_total Test events"));
+	assert (Contains (text, "# TYPE i2pd_test_events_total counter"));
+	assert (Contains (text, "i2pd_test_events_total{kind=\"a\"} 800000"));
+	assert (Contains (text, "i2pd_test_events_total{kind=\"b\"} 5"));
+	assert (text.find ("kind=\"c\"") == std::string::npos);
+	assert (Contains (text, "# TYPE i2pd_test_depth gauge"));
+	assert (Contains (text, "i2pd_test_depth 7"));
+	assert (Contains (text, "# TYPE i2pd_test_latency histogram"));
+	assert (Contains (text, "i2pd_test_latency_bucket{le=\"10\"} 2"));
+	assert (Contains (text, "i2pd_test_latency_bucket{le=\"100\"} 3"));
+	assert (Contains (text, "i2pd_test_latency_bucket{le=\"+Inf\"} 4"));
+	assert (Contains (text, "i2pd_test_latency_sum 1065"));
+	assert (Contains (text, "i2pd_test_latency_count 4"));
+	assert (Contains (text, "i2pd_test_value 42"));
+	assert (text.find ("# HELP i2pd_test_events_total") == text.rfind ("# HELP i2pd_test_events_total")); // once per family
+}
@@ -0,0 +1,101 @@
+#include <cassert>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <string.h>
+#include <unistd.h>
+#include <openssl/rand.h>
+
+#include "FS.h"
+#include "NetDbSnapshot.h"
+
+using namespace i2p::data;
+
+int main ()
+{
+	char dir[] = "/tmp/i2pd-snapshot-XXXXXX";
+	assert (mkdtemp (dir));
+	std::string path = std::string (dir) + "/" + NETDB_SNAPSHOT_FILE;
+
+	const size_t num = 5000;
+	std::vector<std::vector<uint8_t> > buffers (num);
+	std::vector<NetDbSnapshotEntry> entries (num);
+	for (size_t i = 0; i < num; i++)
+	{
+		buffers[i].resize (400 + rand () % 600);
+		RAND_bytes (buffers[i].data (), buffers[i].size ());
+		auto& entry = entries[i];
+		entry.ident = IdentHash (buffers[i].data ());
+		entry.timestamp = 1700000000000LL + i;
+		entry.caps = i & 0xFF;
+		entry.transports = (i + 1) & 0xFF;
+		entry.version = 965 + i;
+		entry.buf = buffers[i].data ();
+		entry.len = buffers[i].size ();
+	}
+	// round trip
+	{
+		auto start = std::chrono::steady_clock::now ();
+		assert (WriteNetDbSnapshot (path, entries));
+		double t = std::chrono::duration<double>(std::chrono::steady_clock::now () - start).count ();
+		assert (!i2p::fs::Exists (path + ".tmp"));
+
+		start = std::chrono::steady_clock::now ();
+		NetDbSnapshot snapshot;
+		assert (snapshot.Open (path));
+		assert (snapshot.GetNumEntries () == num);
+		assert (snapshot.GetCreationTime () > 0);
+		NetDbSnapshotEntry entry;
+		for (size_t i = 0; i < num; i++)
+		{
+			assert (snapshot.GetEntry (i, entry));
+			assert (entry.ident == entries[i].ident);
+			assert (entry.timestamp == entries[i].timestamp);
+			assert (entry.caps == entries[i].caps && entry.transports == entries[i].transports);
+			assert (entry.version == entries[i].version);
+			assert (entry.len == buffers[i].size () && !memcmp (entry.buf, buffers[i].data (), entry.len));
+		}
+		assert (!snapshot.GetEntry (num, entry));
+		double t1 = std::chrono::duration<double>(std::chrono::steady_clock::now () - start).count ();
+		std::cout << "Snapshot of " << num << " RouterInfos: written in " << t*1000 << " ms, mapped and read in " << t1*1000 << " ms" << std::endl;
+	}
+	// empty
+	{
+		assert (WriteNetDbSnapshot (path, {}));
+		NetDbSnapshot snapshot;
+		assert (snapshot.Open (path));
+		assert (!snapshot.GetNumEntries ());
+	}
+	// malformed
+	{
+		NetDbSnapshot snapshot;
+		assert (!snapshot.Open (path + ".none"));
+		{
+			std::ofstream f(path, std::ofstream::binary | std::ofstream::trunc);
+			f << "i2pdnetd";
+		}
+		assert (!snapshot.Open (path));
+		// index is truncated
+		assert (WriteNetDbSnapshot (path, entries));
+		assert (truncate (path.c_str (), NETDB_SNAPSHOT_HEADER_SIZE + NETDB_SNAPSHOT_INDEX_ENTRY_SIZE*10) == 0);
+		assert (!snapshot.Open (path));
+		// data is truncated, only last entries are lost
+		assert (WriteNetDbSnapshot (path, entries));
+		{
+			std::ifstream f(path, std::ifstream::binary | std::ifstream::ate);
+			size_t size = f.tellg ();
+			assert (truncate (path.c_str (), size - buffers[num - 1].size () - 1) == 0);
+		}
+		assert (snapshot.Open (path));
+		NetDbSnapshotEntry entry;
+		assert (snapshot.GetEntry (0, entry));
+		assert (!snapshot.GetEntry (num - 1, entry));
+		snapshot.Close ();
+		assert (!snapshot.IsOpen ());
+	}
+	i2p::fs::Remove (path);
+	rmdir (dir);
+	return 0;
+}
@@ -0,0 +1,77 @@
+#include <cassert>
+#include <inttypes.h>
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+#include <openssl/rand.h>
+
+#include "Transports.h"
+
+using namespace i2p::transport;
+using namespace i2p::data;
+
+int main ()
+{
+	const int numPeers = 5000;
+	PeersTable table;
+	std::vector<IdentHash> idents (numPeers);
+	for (auto& it: idents)
+		RAND_bytes (it, 32);
+	for (auto& it: idents)
+	{
+		auto peer = std::make_shared<Peer> (nullptr, 0);
+		assert (table.Insert (it, peer) == peer);
+	}
+	assert (table.GetSize () == numPeers);
+	// existing is returned
+	auto peer = table.Find (idents[0]);
+	assert (peer);
+	assert (table.Insert (idents[0], std::make_shared<Peer> (nullptr, 0)) == peer);
+	assert (table.GetSize () == numPeers);
+	for (auto& it: idents)
+		assert (table.Contains (it));
+	// erase every other
+	for (int i = 0; i < numPeers; i += 2)
+		assert (table.Erase (idents[i]));
+	assert (!table.Erase (idents[0]));
+	assert (table.GetSize () == numPeers/2);
+	for (int i = 0; i < numPeers; i++)
+		assert (table.Contains (idents[i]) == (i & 1));
+	auto snapshot = table.GetSnapshot ();
+	assert (snapshot.size () == numPeers/2);
+	for (auto& it: snapshot)
+		assert (table.Find (it.first) == it.second);
+	// random selection
+	std::set<IdentHash> selected;
+	for (uint32_t i = 0; i < 1000; i++)
+	{
+		IdentHash ident;
+		if (table.GetRandom (i*7919, [](std::shared_ptr<const Peer> p) { return true; }, ident))
+		{
+			assert (table.Contains (ident));
+			selected.insert (ident);
+		}
+	}
+	assert (selected.size () > 500);
+	auto marked = table.Find (idents[1]);
+	marked->isEligible = true;
+	IdentHash ident;
+	assert (table.FindFrom (12345, [](std::shared_ptr<const Peer> p) { return p->isEligible; }, ident));
+	assert (ident == idents[1]);
+	assert (!table.GetRandom (0, [](std::shared_ptr<const Peer> p) { return false; }, ident));
+	// concurrent readers with writer
+	std::thread reader ([&table, &idents]()
+		{
+			for (int j = 0; j < 10; j++)
+				for (auto& it: idents)
+					table.Find (it);
+		});
+	for (int i = 0; i < numPeers; i += 2)
+		table.Insert (idents[i], std::make_shared<Peer> (nullptr, 0));
+	reader.join ();
+	assert (table.GetSize () == numPeers);
+	table.Clear ();
+	assert (table.IsEmpty ());
+	return 0;
+}
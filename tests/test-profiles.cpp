@@ -0,0 +1,81 @@
+#include <cassert>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+#include <openssl/rand.h>
+
+#include "FS.h"
+#include "Timestamp.h"
+#include "Profiling.h"
+
+using namespace i2p::data;
+
+static IdentHash RandomIdent ()
+{
+	uint8_t buf[32];
+	RAND_bytes (buf, 32);
+	return IdentHash (buf);
+}
+
+int main ()
+{
+	char dir[] = "/tmp/i2pd-profiles-XXXXXX";
+	assert (mkdtemp (dir));
+	i2p::fs::DetectDataDir (dir);
+
+	// legacy profile is imported once
+	auto ident = RandomIdent ();
+	auto b64 = ident.ToBase64 ();
+	std::string iniDir = i2p::fs::DataDirPath ("peerProfiles", std::string ("p") + b64[0]);
+	assert (i2p::fs::CreateDirectory (i2p::fs::DataDirPath ("peerProfiles")));
+	assert (i2p::fs::CreateDirectory (iniDir));
+	std::string iniFile = iniDir + "/profile-" + b64 + ".txt";
+	{
+		std::ofstream f(iniFile);
+		f << PEER_PROFILE_LAST_UPDATE_TIMESTAMP << " = " << i2p::util::GetSecondsSinceEpoch () << "\n";
+		f << "[" << PEER_PROFILE_SECTION_PARTICIPATION << "]\n" << PEER_PROFILE_PARTICIPATION_AGREED << " = 7\n";
+		f << "[" << PEER_PROFILE_SECTION_USAGE << "]\n" << PEER_PROFILE_USAGE_DUPLICATED << " = true\n";
+	}
+	InitProfilesStorage ();
+	assert (!i2p::fs::Exists (iniFile));
+	assert (i2p::fs::Exists (i2p::fs::DataDirPath (PEER_PROFILES_FILE)));
+	{
+		RouterProfile profile;
+		profile.Load (ident);
+		assert (profile.IsReal () && profile.IsDuplicated ());
+	}
+	// unknown ident gives empty profile
+	{
+		RouterProfile profile;
+		profile.Load (RandomIdent ());
+		assert (!profile.IsReal () && !profile.IsDuplicated ());
+	}
+	// saved profile survives restart
+	auto ident1 = RandomIdent ();
+	{
+		RouterProfile profile;
+		profile.Connected ();
+		profile.Save (ident1);
+	}
+	SaveProfiles (); // writes file
+	InitProfilesStorage (); // reads file
+	{
+		RouterProfile profile;
+		profile.Load (ident1);
+		assert (profile.IsReal () && !profile.IsDuplicated ());
+		profile.Load (ident);
+		assert (profile.IsReal () && profile.IsDuplicated ());
+	}
+	// corrupted file is ignored
+	{
+		std::ofstream f(i2p::fs::DataDirPath (PEER_PROFILES_FILE), std::ofstream::binary | std::ofstream::trunc);
+		f << "garbage";
+	}
+	InitProfilesStorage ();
+
+	i2p::fs::Remove (i2p::fs::DataDirPath (PEER_PROFILES_FILE));
+	rmdir (iniDir.c_str ());
+	rmdir (i2p::fs::DataDirPath ("peerProfiles").c_str ());
+	rmdir (dir);
+	return 0;
+}
@@ -0,0 +1,156 @@
+#include <cassert>
+#include <inttypes.h>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <list>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+
+#include "Queue.h"
+
+using namespace i2p::util;
+
+const int NUM_PRODUCERS = 4;
+const uint64_t NUM_ELEMENTS_PER_PRODUCER = 200000;
+
+struct Element
+{
+	int producer;
+	uint64_t seqn;
+};
+
+// previous implementation, mutex + std::list, for comparison only
+template<typename Element>
+class MutexQueue
+{
+	public:
+
+		void Put (Element e)
+		{
+			std::unique_lock<std::mutex> l(m_QueueMutex);
+			m_Queue.push_back (std::move(e));
+			m_NonEmpty.notify_one ();
+		}
+
+		bool Wait (int sec, int usec)
+		{
+			std::unique_lock<std::mutex> l(m_QueueMutex);
+			return m_NonEmpty.wait_for (l, std::chrono::seconds (sec) + std::chrono::milliseconds (usec)) != std::cv_status::timeout;
+		}
+
+		bool IsEmpty ()
+		{
+			std::unique_lock<std::mutex> l(m_QueueMutex);
+			return m_Queue.empty ();
+		}
+
+		template<typename Container>
+		void GetWholeQueue (Container& queue)
+		{
+			queue.clear ();
+			std::list<Element> q;
+			{
+				std::unique_lock<std::mutex> l(m_QueueMutex);
+				m_Queue.swap (q);
+			}
+			for (auto& it: q) queue.push_back (std::move (it));
+		}
+
+	private:
+
+		std::list<Element> m_Queue;
+		std::mutex m_QueueMutex;
+		std::condition_variable m_NonEmpty;
+};
+
+template<typename Q>
+double Run (Q& queue, bool checkOrder)
+{
+	auto start = std::chrono::steady_clock::now ();
+	std::vector<std::thread> producers;
+	for (int i = 0; i < NUM_PRODUCERS; i++)
+		producers.emplace_back ([&queue, i]()
+			{
+				for (uint64_t j = 0; j < NUM_ELEMENTS_PER_PRODUCER; j++)
+					queue.Put (std::make_shared<Element> (Element{i, j}));
+			});
+
+	std::vector<uint64_t> expected (NUM_PRODUCERS, 0);
+	uint64_t total = 0;
+	std::deque<std::shared_ptr<Element> > elements;
+	while (total < NUM_PRODUCERS*NUM_ELEMENTS_PER_PRODUCER)
+	{
+		if (queue.IsEmpty () && !queue.Wait (1, 0)) continue;
+		queue.GetWholeQueue (elements);
+		for (const auto& it: elements)
+		{
+			assert (it);
+			if (checkOrder)
+				assert (it->seqn == expected[it->producer]); // FIFO per producer
+			expected[it->producer] = it->seqn + 1;
+			total++;
+		}
+	}
+	for (auto& it: producers)
+		it.join ();
+	assert (queue.IsEmpty ());
+	return std::chrono::duration<double>(std::chrono::steady_clock::now () - start).count ();
+}
+
+int main ()
+{
+	// single thread
+	{
+		Queue<std::shared_ptr<int> > queue;
+		assert (queue.IsEmpty ());
+		assert (!queue.Get ());
+		for (int i = 0; i < 1000; i++)
+			queue.Put (std::make_shared<int>(i));
+		assert (queue.GetSize () == 1000);
+		assert (*queue.Peek () == 0);
+		for (int i = 0; i < 500; i++)
+			assert (*queue.Get () == i);
+		std::list<std::shared_ptr<int> > l;
+		for (int i = 1000; i < 1100; i++)
+			l.push_back (std::make_shared<int>(i));
+		queue.Put (l);
+		assert (l.empty ());
+		std::deque<std::shared_ptr<int> > d;
+		queue.GetWholeQueue (d);
+		assert (d.size () == 600);
+		for (int i = 0; i < 600; i++)
+			assert (*d[i] == i + 500);
+		assert (queue.IsEmpty ());
+		assert (!queue.Wait (0, 10)); // timeout
+		queue.WakeUp ();
+		assert (queue.Wait (1, 0)); // woken up
+	}
+	// no limit of queue size
+	{
+		Queue<std::shared_ptr<int> > queue;
+		const int num = 4096*QUEUE_SEGMENT_SIZE + 1000;
+		auto el = std::make_shared<int>(1);
+		for (int i = 0; i < num; i++)
+			queue.Put (el);
+		assert (queue.GetSize () == num);
+		std::deque<std::shared_ptr<int> > d;
+		queue.GetWholeQueue (d);
+		assert ((int)d.size () == num);
+		assert (queue.IsEmpty ());
+		d.clear ();
+		assert (el.use_count () == 1);
+	}
+	// multiple producers
+	Queue<std::shared_ptr<Element> > queue;
+	double t = Run (queue, true);
+	MutexQueue<std::shared_ptr<Element> > mutexQueue;
+	double t1 = Run (mutexQueue, true);
+	auto num = NUM_PRODUCERS*NUM_ELEMENTS_PER_PRODUCER;
+	std::cout << "Queue: " << num/t << " elements/sec, mutex queue: " << num/t1 << " elements/sec" << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,166 @@
+#include <cassert>
+#include <chrono>
+#include <inttypes.h>
+#include <iostream>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "util.h"
+
+using namespace i2p::util;
+
+struct Packet
+{
+	uint32_t seqn;
+	uint32_t GetSeqn () const { return seqn; };
+};
+
+struct Ack
+{
+	uint32_t ackThrough;
+	std::vector<uint32_t> nacks;
+};
+
+struct PacketCmp
+{
+	bool operator() (const Packet * p1, const Packet * p2) const
+	{
+		return p1->GetSeqn () < p2->GetSeqn ();
+	};
+};
+
+// sender keeps a full window, receiver acks every other packet and NACKs losses
+static std::vector<Ack> RecordAcks (int numPackets, int windowSize, double lossRate)
+{
+	std::mt19937 rng (12345);
+	std::uniform_real_distribution<double> dist (0, 1);
+	std::vector<Ack> acks;
+	std::set<uint32_t> lost;
+	for (int seqn = 1; seqn < numPackets; seqn++)
+	{
+		if (dist (rng) < lossRate)
+			lost.insert (seqn);
+		if (seqn % 2) continue;
+		Ack ack;
+		ack.ackThrough = seqn;
+		// lost packets are resent and received a window later
+		for (auto it = lost.begin (); it != lost.end ();)
+			if (*it + windowSize < (uint32_t)seqn)
+				it = lost.erase (it);
+			else
+				it++;
+		for (auto it: lost)
+			if (ack.nacks.size () < 255) ack.nacks.push_back (it);
+		acks.push_back (ack);
+	}
+	return acks;
+}
+
+template<typename Window, typename Insert, typename Find, typename Remove>
+static uint64_t Replay (const std::vector<Ack>& acks, std::vector<Packet>& packets, Window& sent,
+	Insert insert, Find find, Remove remove, double& time)
+{
+	uint64_t checksum = 0;
+	uint32_t nextSeqn = 1;
+	auto start = std::chrono::steady_clock::now ();
+	for (const auto& ack: acks)
+	{
+		while (nextSeqn <= ack.ackThrough + 1 && nextSeqn < packets.size ())
+			insert (sent, &packets[nextSeqn++]);
+		Window nacked;
+		for (auto seqn: ack.nacks)
+		{
+			auto packet = find (sent, seqn);
+			if (packet) insert (nacked, packet);
+		}
+		std::vector<uint32_t> acked;
+		for (auto it: sent)
+		{
+			auto seqn = it->GetSeqn ();
+			if (seqn > ack.ackThrough) break;
+			if (!find (nacked, seqn)) acked.push_back (seqn);
+		}
+		for (auto seqn: acked)
+		{
+			remove (sent, seqn);
+			checksum = checksum * 31 + seqn;
+		}
+	}
+	time = std::chrono::duration<double>(std::chrono::steady_clock::now () - start).count ();
+	return checksum;
+}
+
+int main ()
+{
+	// basic operations
+	{
+		std::vector<Packet> packets (1000);
+		for (size_t i = 0; i < packets.size (); i++)
+			packets[i].seqn = i;
+		SequenceWindow<Packet> window (4);
+		assert (window.IsEmpty ());
+		assert (window.begin () == window.end ());
+		assert (window.Insert (10, &packets[10]));
+		assert (window.Insert (5, &packets[5]));
+		assert (window.Insert (700, &packets[700])); // grows
+		assert (!window.Insert (5, &packets[5])); // duplicate
+		assert (window.GetSize () == 3);
+		assert (window.GetCapacity () >= 696);
+		assert (window.GetFirst () == &packets[5]);
+		assert (window.GetFirstSeqn () == 5 && window.GetLastSeqn () == 700);
+		assert (window.Find (10) == &packets[10]);
+		assert (!window.Find (11));
+		assert (!window.Find (1000));
+		std::vector<uint32_t> seqns;
+		for (auto it = window.begin (); it != window.end (); ++it)
+		{
+			assert (*it == &packets[it.GetSeqn ()]);
+			seqns.push_back (it.GetSeqn ());
+		}
+		assert ((seqns == std::vector<uint32_t>{ 5, 10, 700 }));
+		// remove while iterating
+		for (auto it = window.begin (); it != window.end ();)
+		{
+			auto seqn = (*it)->GetSeqn ();
+			++it;
+			assert (window.Remove (seqn) == &packets[seqn]);
+		}
+		assert (window.IsEmpty ());
+		assert (!window.Remove (5));
+		assert (window.Insert (3, &packets[3]));
+		assert (window.GetFirst () == &packets[3]);
+		window.Clear ();
+		assert (window.IsEmpty () && !window.Find (3));
+	}
+	// replay of ACK patterns against std::set
+	{
+		const int numPackets = 200000;
+		auto acks = RecordAcks (numPackets, 512, 0.02);
+		std::vector<Packet> packets (numPackets);
+		for (size_t i = 0; i < packets.size (); i++)
+			packets[i].seqn = i;
+
+		double t, t1;
+		std::set<Packet *, PacketCmp> sentSet;
+		auto checksum = Replay (acks, packets, sentSet,
+			[](std::set<Packet *, PacketCmp>& s, Packet * p) { s.insert (p); },
+			[&packets](std::set<Packet *, PacketCmp>& s, uint32_t seqn) -> Packet *
+			{
+				auto it = s.find (&packets[seqn]);
+				return it != s.end () ? *it : nullptr;
+			},
+			[&packets](std::set<Packet *, PacketCmp>& s, uint32_t seqn) { s.erase (&packets[seqn]); }, t);
+
+		SequenceWindow<Packet> sentWindow;
+		auto checksum1 = Replay (acks, packets, sentWindow,
+			[](SequenceWindow<Packet>& w, Packet * p) { w.Insert (p->GetSeqn (), p); },
+			[](SequenceWindow<Packet>& w, uint32_t seqn) { return w.Find (seqn); },
+			[](SequenceWindow<Packet>& w, uint32_t seqn) { w.Remove (seqn); }, t1);
+
+		assert (checksum == checksum1);
+		assert (sentSet.size () == sentWindow.GetSize ());
+		std::cout << "ACK replay: " << acks.size ()/t << " acks/sec set, " << acks.size ()/t1 << " acks/sec ring" << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,92 @@
+#include <cassert>
+#include <inttypes.h>
+#include <memory>
+#include <vector>
+#include <thread>
+
+#include "util.h"
+
+using namespace i2p::util;
+
+struct Buffer
+{
+	uint8_t buf[1000];
+};
+
+struct LargeBuffer
+{
+	uint8_t buf[62000];
+};
+
+template<typename T>
+static SlabStats GetBufferStats ()
+{
+	for (const auto& it: Slab::GetAllStats ())
+		if (it.blockSize >= sizeof (T) && it.blockSize < sizeof (T) + 64) // control block included
+			return it;
+	assert (false);
+	return SlabStats ();
+}
+
+int main ()
+{
+	SlabAllocator<Buffer> allocator;
+	// same thread
+	{
+		std::vector<std::shared_ptr<Buffer> > buffers;
+		for (int i = 0; i < 1000; i++)
+		{
+			buffers.push_back (std::allocate_shared<Buffer> (allocator));
+			buffers.back ()->buf[999] = i & 0xFF;
+		}
+		for (int i = 0; i < 1000; i++)
+			assert (buffers[i]->buf[999] == (i & 0xFF));
+		auto stats = GetBufferStats<Buffer> ();
+		assert (stats.numLive == 1000);
+		assert (stats.numPeakLive == 1000);
+		assert (stats.numHits == 0);
+		buffers.clear ();
+		stats = GetBufferStats<Buffer> ();
+		assert (stats.numFree + stats.threadCacheSize >= 1000); // everything except thread cache returned to depot
+		for (int i = 0; i < 1000; i++)
+			buffers.push_back (std::allocate_shared<Buffer> (allocator));
+		buffers.clear ();
+		stats = GetBufferStats<Buffer> ();
+		assert (stats.numPeakLive <= 1000 + (int64_t)stats.threadCacheSize/2); // reused, up to one batch in thread cache
+		assert (stats.numHits >= 1000 - stats.threadCacheSize);
+	}
+	// allocated by one thread, released by another
+	{
+		const int numBuffers = 10000;
+		std::vector<std::shared_ptr<Buffer> > buffers;
+		std::thread producer ([&buffers, &allocator]()
+			{
+				for (int i = 0; i < numBuffers; i++)
+					buffers.push_back (std::allocate_shared<Buffer> (allocator));
+			});
+		producer.join ();
+		std::thread consumer ([&buffers]() { buffers.clear (); });
+		consumer.join (); // thread cache is returned to depot at thread exit
+		auto stats = GetBufferStats<Buffer> ();
+		assert (stats.numLive <= (int64_t)stats.threadCacheSize); // main thread's cache only
+		assert ((int64_t)stats.numFree + stats.numLive >= numBuffers);
+		Slab::CleanUpAll (); // mark unused
+		Slab::CleanUpAll (); // free them
+		stats = GetBufferStats<Buffer> ();
+		assert (!stats.numFree);
+	}
+	// large blocks, thread cache is limited by bytes
+	{
+		SlabAllocator<LargeBuffer> largeAllocator;
+		std::vector<std::shared_ptr<LargeBuffer> > buffers;
+		for (int i = 0; i < 100; i++)
+			buffers.push_back (std::allocate_shared<LargeBuffer> (largeAllocator));
+		buffers.clear ();
+		auto stats = GetBufferStats<LargeBuffer> ();
+		assert (stats.threadCacheSize == GetSlabThreadCacheSize (stats.blockSize));
+		assert (stats.threadCacheSize < SLAB_THREAD_CACHE_SIZE);
+		assert (stats.numLive <= (int64_t)stats.threadCacheSize);
+		assert ((int64_t)stats.numFree + stats.numLive == 100);
+	}
+	return 0;
+}
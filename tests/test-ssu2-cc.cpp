@@ -0,0 +1,157 @@
+#include <cassert>
+#include <cmath>
+#include <inttypes.h>
+#include <iostream>
+#include <deque>
+#include <memory>
+#include <random>
+
+#include "SSU2Session.h"
+
+using namespace i2p::transport;
+
+// lossy bottleneck link, 1 ms ticks, sender paced like SSU2Session
+const int SIMULATION_TIME = 60000; // milliseconds
+const int BASE_RTT = 100; // milliseconds
+const size_t PAYLOAD_SIZE = 1400;
+const double BOTTLENECK_RATE = 1000; // bytes per millisecond
+const size_t QUEUE_LIMIT = 140; // packets, 2 BDP
+const double LOSS_RATE = 0.005;
+
+struct Result
+{
+	double goodput; // bytes per millisecond
+	double avgQueue;
+	int numLosses, maxBurst;
+};
+
+struct InFlight
+{
+	std::unique_ptr<SSU2SentPacket> packet;
+	uint64_t arrivalTime; // at receiver, 0 if not yet
+	bool isLost;
+};
+
+static Result Simulate (SSU2CongestionControlType type)
+{
+	auto cc = CreateSSU2CongestionControl (type, PAYLOAD_SIZE);
+	std::mt19937 rng (12345);
+	std::uniform_real_distribution<double> dist (0, 1);
+	std::deque<InFlight> inFlight; // FIFO link keeps order
+	std::deque<SSU2SentPacket *> queue; // bottleneck queue
+	double rtt = SSU2_UNKNOWN_RTT, linkCredit = 0, queueSum = 0;
+	size_t bytesInFlight = 0;
+	uint64_t nextSendTime = 0, delivered = 0; // in microseconds, bytes
+	int numLosses = 0, maxBurst = 0;
+	for (uint64_t ts = 1; ts <= SIMULATION_TIME; ts++)
+	{
+		// bottleneck
+		linkCredit += BOTTLENECK_RATE;
+		while (!queue.empty () && linkCredit >= queue.front ()->payloadSize)
+		{
+			auto packet = queue.front (); queue.pop_front ();
+			for (auto& it: inFlight)
+				if (it.packet.get () == packet) { it.arrivalTime = ts + BASE_RTT/2; break; }
+			linkCredit -= packet->payloadSize;
+		}
+		if (queue.empty () && linkCredit > PAYLOAD_SIZE) linkCredit = PAYLOAD_SIZE;
+		queueSum += queue.size ();
+		// single Ack block for all arrived packets
+		SSU2AckSample ack{ ts, 0, -1, 0, 0 };
+		size_t numLostBytes = 0;
+		while (!inFlight.empty ())
+		{
+			auto& front = inFlight.front ();
+			if (front.isLost)
+			{
+				// resent after RTO
+				if (ts < front.packet->sendTime + 2*BASE_RTT) break;
+				numLosses++;
+				numLostBytes += front.packet->payloadSize;
+				bytesInFlight -= front.packet->payloadSize;
+				inFlight.pop_front ();
+				continue;
+			}
+			if (!front.arrivalTime || ts < front.arrivalTime) break;
+			if (ack.rttSample < 0)
+			{
+				ack.rttSample = ts - front.packet->sendTime;
+				rtt = rtt != SSU2_UNKNOWN_RTT ? SSU2_RTT_EWMA_ALPHA*ack.rttSample + (1.0 - SSU2_RTT_EWMA_ALPHA)*rtt : ack.rttSample;
+			}
+			cc->OnPacketAcked (front.packet.get (), ts);
+			ack.numAckedBytes += front.packet->payloadSize;
+			bytesInFlight -= front.packet->payloadSize;
+			delivered += front.packet->payloadSize;
+			inFlight.pop_front ();
+		}
+		if (ack.numAckedBytes)
+		{
+			ack.rtt = rtt;
+			ack.bytesInFlight = bytesInFlight;
+			cc->OnAck (ack);
+		}
+		if (numLostBytes)
+			cc->OnLoss (numLostBytes, bytesInFlight, ts);
+		// sender, always has data
+		uint64_t mts = ts*1000;
+		int numSent = 0;
+		while (bytesInFlight < cc->GetWindow () &&
+			(!cc->GetPacingRate () || nextSendTime <= mts + SSU2_PACING_QUANTUM))
+		{
+			auto packet = std::make_unique<SSU2SentPacket>();
+			packet->payloadSize = PAYLOAD_SIZE;
+			packet->sendTime = ts;
+			bytesInFlight += packet->payloadSize;
+			cc->OnPacketSent (packet.get (), bytesInFlight, ts);
+			if (cc->GetPacingRate ())
+			{
+				if (nextSendTime < mts) nextSendTime = mts;
+				nextSendTime += packet->payloadSize*1000000LL/cc->GetPacingRate ();
+			}
+			bool isLost = dist (rng) < LOSS_RATE;
+			if (!isLost)
+			{
+				if (queue.size () < QUEUE_LIMIT)
+					queue.push_back (packet.get ());
+				else
+					isLost = true; // tail drop
+			}
+			inFlight.push_back ({ std::move (packet), 0, isLost });
+			numSent++;
+		}
+		if (ts > 2*BASE_RTT && numSent > maxBurst) maxBurst = numSent; // initial window is sent before first RTT sample
+		assert (cc->GetWindow () >= SSU2_MIN_WINDOW_SIZE*PAYLOAD_SIZE && cc->GetWindow () <= SSU2_MAX_WINDOW_SIZE*PAYLOAD_SIZE);
+	}
+	return Result{ (double)delivered/SIMULATION_TIME, queueSum/SIMULATION_TIME, numLosses, maxBurst };
+}
+
+int main ()
+{
+	const char * names[] = { "default", "cubic", "bbr" };
+	Result results[3];
+	for (int i = 0; i < 3; i++)
+	{
+		results[i] = Simulate ((SSU2CongestionControlType)i);
+		std::cout << names[i] << ": goodput " << results[i].goodput << " bytes/ms, queue " << results[i].avgQueue
+			<< ", losses " << results[i].numLosses << ", max burst " << results[i].maxBurst << std::endl;
+	}
+	auto& def = results[eSSU2CongestionControlDefault];
+	auto& cubic = results[eSSU2CongestionControlCubic];
+	auto& bbr = results[eSSU2CongestionControlBBR];
+	// all must make progress without exceeding the bottleneck
+	for (auto& it: results)
+		assert (it.goodput > 0.3*BOTTLENECK_RATE && it.goodput <= BOTTLENECK_RATE);
+	assert (cubic.goodput > 0.4*BOTTLENECK_RATE); // loss based, backs off on random losses
+	assert (bbr.goodput > 0.6*BOTTLENECK_RATE);
+	// default one fills the queue up to tail drops
+	assert (cubic.avgQueue < def.avgQueue && cubic.numLosses < def.numLosses);
+	assert (bbr.avgQueue < QUEUE_LIMIT/4 && bbr.numLosses < def.numLosses);
+	// paced, no window sized bursts
+	for (auto& it: results)
+		assert (it.maxBurst < (int)SSU2_MIN_WINDOW_SIZE);
+	// deterministic
+	auto bbr1 = Simulate (eSSU2CongestionControlBBR);
+	assert (bbr1.goodput == bbr.goodput && bbr1.numLosses == bbr.numLosses);
+	auto cubic1 = Simulate (eSSU2CongestionControlCubic);
+	assert (cubic1.goodput == cubic.goodput && cubic1.numLosses == cubic.numLosses);
+}
@@ -0,0 +1,115 @@
+#include <cassert>
+#include <chrono>
+#include <inttypes.h>
+#include <iostream>
+#include <algorithm>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "SSU2Session.h"
+
+using namespace i2p::transport;
+
+// packets arrive reordered, some are delayed by up to 200 packets
+static std::vector<uint32_t> CreateArrivals (int numPackets)
+{
+	std::mt19937 rng (12345);
+	std::uniform_real_distribution<double> dist (0, 1);
+	std::vector<std::pair<uint32_t, uint32_t> > keys; // arrival position -> packetNum
+	for (int i = 1; i < numPackets; i++)
+		keys.emplace_back (dist (rng) < 0.02 ? i + rng () % 200 : i, i);
+	std::stable_sort (keys.begin (), keys.end (),
+		[](const auto& k1, const auto& k2) { return k1.first < k2.first; });
+	std::vector<uint32_t> arrivals;
+	for (auto& it: keys) arrivals.push_back (it.second);
+	return arrivals;
+}
+
+// receiver side like UpdateReceivePacketNum and CreateAckBlock, compared against std::set
+template<typename Received, typename Insert, typename Prev, typename RemoveBefore>
+static uint64_t Replay (const std::vector<uint32_t>& arrivals, Received& received, Insert insert, Prev prev,
+	RemoveBefore removeBefore, double& time)
+{
+	uint64_t checksum = 0;
+	uint32_t receivePacketNum = 0;
+	auto start = std::chrono::steady_clock::now ();
+	for (auto packetNum: arrivals)
+	{
+		if (packetNum == receivePacketNum + 1)
+		{
+			receivePacketNum = packetNum;
+			while (prev (received, receivePacketNum + 2) == receivePacketNum + 1) receivePacketNum++;
+			removeBefore (received, receivePacketNum + 1);
+		}
+		else
+			insert (received, packetNum);
+		// walk down like Ack block creation
+		uint32_t it = prev (received, 0xFFFFFFFF);
+		for (int j = 0; it && j < 64; j++)
+		{
+			checksum = checksum*31 + it;
+			it = prev (received, it);
+		}
+		checksum = checksum*31 + receivePacketNum;
+	}
+	time = std::chrono::duration<double>(std::chrono::steady_clock::now () - start).count ();
+	return checksum;
+}
+
+int main ()
+{
+	// received packets
+	{
+		SSU2ReceivedPacketsWindow window (64);
+		assert (window.IsEmpty () && !window.GetFirst () && !window.GetLast ());
+		assert (window.Insert (100));
+		assert (window.Insert (70));
+		assert (window.Insert (1000)); // grows
+		assert (!window.Insert (70)); // duplicate
+		assert (window.GetSize () == 3);
+		assert (window.GetCapacity () >= 931);
+		assert (window.GetFirst () == 70 && window.GetLast () == 1000);
+		assert (window.Contains (100) && !window.Contains (101) && !window.Contains (2000));
+		assert (window.GetPrev (0xFFFFFFFF) == 1000);
+		assert (window.GetPrev (1000) == 100);
+		assert (window.GetPrev (100) == 70);
+		assert (!window.GetPrev (70));
+		window.RemoveBefore (100);
+		assert (window.GetSize () == 2 && window.GetFirst () == 100);
+		window.RemoveBefore (101);
+		assert (window.GetSize () == 1 && window.GetFirst () == 1000 && !window.GetPrev (1000));
+		window.RemoveBefore (2000);
+		assert (window.IsEmpty ());
+		assert (window.Insert (5));
+		assert (window.GetFirst () == 5 && window.GetLast () == 5);
+		window.Clear ();
+		assert (window.IsEmpty () && !window.Contains (5));
+	}
+	// replay of receive patterns against std::set
+	{
+		const int numPackets = 500000;
+		auto arrivals = CreateArrivals (numPackets);
+		double t, t1;
+		std::set<uint32_t> receivedSet;
+		auto checksum = Replay (arrivals, receivedSet,
+			[](std::set<uint32_t>& s, uint32_t n) { s.insert (n); },
+			[](const std::set<uint32_t>& s, uint32_t n) -> uint32_t
+			{
+				auto it = s.lower_bound (n);
+				return it != s.begin () ? *(--it) : 0;
+			},
+			[](std::set<uint32_t>& s, uint32_t n) { s.erase (s.begin (), s.lower_bound (n)); }, t);
+
+		SSU2ReceivedPacketsWindow receivedWindow;
+		auto checksum1 = Replay (arrivals, receivedWindow,
+			[](SSU2ReceivedPacketsWindow& w, uint32_t n) { w.Insert (n); },
+			[](const SSU2ReceivedPacketsWindow& w, uint32_t n) { return w.GetPrev (n); },
+			[](SSU2ReceivedPacketsWindow& w, uint32_t n) { w.RemoveBefore (n); }, t1);
+
+		assert (checksum == checksum1);
+		assert (receivedSet.size () == receivedWindow.GetSize ());
+		std::cout << "Receive replay: " << numPackets/t << " packets/sec set, " << numPackets/t1 << " packets/sec bitmap" << std::endl;
+	}
+	return 0;
+}
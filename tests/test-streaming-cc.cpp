@@ -0,0 +1,139 @@
+#include <cassert>
+#include <cmath>
+#include <inttypes.h>
+#include <iostream>
+#include <deque>
+#include <memory>
+#include <random>
+
+#include "Streaming.h"
+
+using namespace i2p::stream;
+
+// lossy bottleneck link, 1 ms ticks
+const int SIMULATION_TIME = 60000; // milliseconds
+const int BASE_RTT = 100; // milliseconds
+const double BOTTLENECK_RATE = 0.5; // packets per millisecond
+const size_t QUEUE_LIMIT = 100; // packets, 2 BDP
+const double LOSS_RATE = 0.005;
+
+struct Result
+{
+	double goodput; // packets per millisecond
+	double avgQueue;
+	int numLosses;
+};
+
+struct InFlight
+{
+	std::unique_ptr<Packet> packet;
+	uint64_t arrivalTime; // at receiver, 0 if lost
+	bool isLost;
+};
+
+static Result Simulate (CongestionControlType type)
+{
+	auto cc = CreateCongestionControl (type, MAX_WINDOW_SIZE, 0);
+	std::mt19937 rng (12345);
+	std::uniform_real_distribution<double> dist (0, 1);
+	std::deque<InFlight> inFlight; // FIFO link keeps order
+	std::deque<Packet *> queue; // bottleneck queue
+	StreamRTT rtt{ INITIAL_RTT, INITIAL_RTT, INITIAL_RTT, INITIAL_RTT, 0 };
+	bool isFirstSample = true;
+	uint32_t sequenceNumber = 0, ackThrough = 0;
+	double sendCredit = 0, linkCredit = 0, queueSum = 0;
+	uint64_t delivered = 0;
+	int numLosses = 0;
+	for (uint64_t ts = 1; ts <= SIMULATION_TIME; ts++)
+	{
+		// bottleneck
+		linkCredit += BOTTLENECK_RATE;
+		while (linkCredit >= 1 && !queue.empty ())
+		{
+			auto packet = queue.front (); queue.pop_front ();
+			for (auto& it: inFlight)
+				if (it.packet.get () == packet) { it.arrivalTime = ts + BASE_RTT/2; break; }
+			linkCredit -= 1;
+		}
+		if (queue.empty () && linkCredit > 1) linkCredit = 1;
+		queueSum += queue.size ();
+		// acks, one per packet
+		while (!inFlight.empty ())
+		{
+			auto& front = inFlight.front ();
+			if (front.isLost)
+			{
+				// detected by following packets
+				if (ts < front.packet->sendTime + BASE_RTT) break;
+				numLosses++;
+				inFlight.pop_front ();
+				cc->OnLoss (sequenceNumber, inFlight.size (), ts);
+				continue;
+			}
+			if (!front.arrivalTime || ts < front.arrivalTime) break;
+			int rttSample = ts - front.packet->sendTime;
+			cc->OnPacketAcked (front.packet.get (), ts);
+			ackThrough = front.packet->GetSeqn ();
+			inFlight.pop_front ();
+			delivered++;
+			if (isFirstSample)
+			{
+				rtt = StreamRTT{ (double)rttSample, (double)rttSample, (double)rttSample, (double)rttSample, rttSample/5.0 + 3 };
+				isFirstSample = false;
+			}
+			else
+			{
+				rtt.rtt = (rtt.rtt + rttSample)/2;
+				rtt.slowRTT = SLOWRTT_EWMA_ALPHA*rtt.rtt + (1.0 - SLOWRTT_EWMA_ALPHA)*rtt.slowRTT;
+				rtt.fastRTT = RTT_EWMA_ALPHA*rtt.rtt + (1.0 - RTT_EWMA_ALPHA)*rtt.fastRTT;
+				if (rtt.minRTT > rtt.rtt) rtt.minRTT = rtt.rtt;
+			}
+			StreamAck ack{ ts, rttSample, 1, (int)inFlight.size (), ackThrough, sequenceNumber, false, false, false };
+			cc->OnAck (rtt, ack);
+		}
+		// sender, always has data
+		auto pacingTime = cc->GetPacingTime ();
+		assert (pacingTime > 0);
+		sendCredit += 1000.0/pacingTime;
+		if (sendCredit > cc->GetWindowSize ()) sendCredit = cc->GetWindowSize ();
+		int numSent = 0;
+		while (sendCredit >= 1 && inFlight.size () < cc->GetWindowSize ())
+		{
+			auto packet = std::make_unique<Packet>();
+			htobe32buf (packet->buf + 8, sequenceNumber++);
+			packet->len = 22;
+			packet->sendTime = ts;
+			cc->OnPacketSent (packet.get (), inFlight.size (), ts);
+			bool isLost = dist (rng) < LOSS_RATE;
+			if (!isLost)
+			{
+				if (queue.size () < QUEUE_LIMIT)
+					queue.push_back (packet.get ());
+				else
+					isLost = true; // tail drop
+			}
+			inFlight.push_back ({ std::move (packet), 0, isLost });
+			sendCredit -= 1; numSent++;
+		}
+		if (numSent)
+			cc->OnSendTime (numSent, rtt, false, ts);
+		assert (cc->GetWindowSize () >= MIN_WINDOW_SIZE && cc->GetWindowSize () <= MAX_WINDOW_SIZE);
+	}
+	return Result{ (double)delivered/SIMULATION_TIME, queueSum/SIMULATION_TIME, numLosses };
+}
+
+int main ()
+{
+	auto delay = Simulate (eCongestionControlDelay);
+	auto bbr = Simulate (eCongestionControlBBR);
+	std::cout << "delay: goodput " << delay.goodput << " packets/ms, queue " << delay.avgQueue << ", losses " << delay.numLosses << std::endl;
+	std::cout << "bbr: goodput " << bbr.goodput << " packets/ms, queue " << bbr.avgQueue << ", losses " << bbr.numLosses << std::endl;
+	// both must make progress without overflowing the bottleneck
+	assert (delay.goodput > 0.4*BOTTLENECK_RATE);
+	assert (bbr.goodput > 0.5*BOTTLENECK_RATE && bbr.goodput <= BOTTLENECK_RATE);
+	assert (bbr.avgQueue < QUEUE_LIMIT/4);
+	assert (bbr.goodput >= delay.goodput); // delay-based one backs off on random losses
+	// deterministic
+	auto bbr1 = Simulate (eCongestionControlBBR);
+	assert (bbr1.goodput == bbr.goodput && bbr1.numLosses == bbr.numLosses);
+}
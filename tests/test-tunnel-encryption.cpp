@@ -0,0 +1,68 @@
+#include <cassert>
+#include <string.h>
+#include <inttypes.h>
+#include <iostream>
+#include <vector>
+#include <chrono>
+
+#include "Crypto.h"
+#include "TunnelBase.h"
+
+using namespace i2p::crypto;
+
+const size_t NUM_MSGS = 100; // per batch
+const int NUM_ITERATIONS = 200;
+
+int main ()
+{
+	AESKey layerKey, ivKey;
+	RAND_bytes (layerKey, 32);
+	RAND_bytes (ivKey, 32);
+	std::vector<uint8_t> msgs (NUM_MSGS*i2p::tunnel::TUNNEL_DATA_MSG_SIZE);
+	RAND_bytes (msgs.data (), msgs.size ());
+	auto encrypted = msgs, batchEncrypted = msgs; // tunnelID remains the same
+	std::vector<const uint8_t *> in (NUM_MSGS);
+	std::vector<uint8_t *> out (NUM_MSGS);
+	for (size_t i = 0; i < NUM_MSGS; i++)
+	{
+		in[i] = msgs.data () + i*i2p::tunnel::TUNNEL_DATA_MSG_SIZE + 4; // after tunnelID
+		out[i] = batchEncrypted.data () + i*i2p::tunnel::TUNNEL_DATA_MSG_SIZE + 4;
+	}
+
+	// batch must match one by one
+	TunnelEncryption encryption;
+	encryption.SetKeys (layerKey, ivKey);
+	for (size_t i = 0; i < NUM_MSGS; i++)
+		encryption.Encrypt (in[i], encrypted.data () + i*i2p::tunnel::TUNNEL_DATA_MSG_SIZE + 4);
+	encryption.Encrypt (in.data (), out.data (), NUM_MSGS);
+	assert (encrypted == batchEncrypted);
+	assert (memcmp (encrypted.data (), msgs.data (), i2p::tunnel::TUNNEL_DATA_MSG_SIZE));
+	assert (!memcmp (encrypted.data (), msgs.data (), 4));
+
+	// decryption reverses, in place
+	TunnelDecryption decryption;
+	decryption.SetKeys (layerKey, ivKey);
+	decryption.Decrypt ((const uint8_t * const *)out.data (), out.data (), NUM_MSGS);
+	assert (batchEncrypted == msgs);
+	decryption.Decrypt (encrypted.data () + 4, encrypted.data () + 4);
+	assert (!memcmp (encrypted.data (), msgs.data (), i2p::tunnel::TUNNEL_DATA_MSG_SIZE));
+
+	// benchmark
+	auto start = std::chrono::steady_clock::now ();
+	for (int j = 0; j < NUM_ITERATIONS; j++)
+		for (size_t i = 0; i < NUM_MSGS; i++)
+			encryption.Encrypt (out[i], out[i]);
+	double t = std::chrono::duration<double>(std::chrono::steady_clock::now () - start).count ();
+	start = std::chrono::steady_clock::now ();
+	for (int j = 0; j < NUM_ITERATIONS; j++)
+		encryption.Encrypt ((const uint8_t * const *)out.data (), out.data (), NUM_MSGS);
+	double t1 = std::chrono::duration<double>(std::chrono::steady_clock::now () - start).count ();
+	start = std::chrono::steady_clock::now ();
+	for (int j = 0; j < NUM_ITERATIONS; j++)
+		decryption.Decrypt ((const uint8_t * const *)out.data (), out.data (), NUM_MSGS);
+	double t2 = std::chrono::duration<double>(std::chrono::steady_clock::now () - start).count ();
+	auto num = NUM_MSGS*NUM_ITERATIONS;
+	std::cout << "Tunnel encryption: " << num/t << " msgs/sec, batch: " << num/t1 << " msgs/sec, batch decryption: " << num/t2 << " msgs/sec" << std::endl;
+
+	return 0;
+}